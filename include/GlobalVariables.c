@@ -2,12 +2,46 @@
 // GLOBAL VARIABLES (!!!! WE USE #define and capital letters only !!!!)
 // -----------------------------------------------------------------------
 
-#define MAX_ENTITY_COUNT 1024
+#ifndef MAX_ENTITY_COUNT
+#define MAX_ENTITY_COUNT 1024 // Can be raised from the build (e.g. for the benchmarks), at most 65535 so handles keep 16 generation bits
+#endif
 #define MAX_LIGHTS 40
 
 #define PLAYABLE_WIDTH 400
 #define GRID_WIDTH 13
-#define GRID_HEIGHT 13
+#define GRID_HEIGHT 13 // At most 32, obstacle_column_mask keeps one bit per row
+
+// COLLISION BROAD PHASE
+// Uniform grid centered on the origin, entities outside of it are clamped into the border cells
+#define COLLISION_CELL_SIZE 64
+#define COLLISION_GRID_WIDTH 32  // 32 * 64 = 2048 units, covers the playable area with margin
+#define COLLISION_GRID_HEIGHT 32
+#define COLLISION_GRID_PADDING 8.0f // Obstacles can grow slightly (wave effect) after the grid is built
+
+// PARTICLES
+#ifndef MAX_PARTICLE_COUNT
+#define MAX_PARTICLE_COUNT 2048 // New particles are dropped once the store is full
+#endif
+#define WEATHER_MAX_BATCHES 16 // Times flakes can be added to one weather layer before they share a start time
+#define MAX_PARTICLE_WORKER_THREADS 7 // The main thread always takes a share of the work too
+#define PARTICLE_PARALLEL_THRESHOLD 8192 // Below this many particles/flakes per job everything runs on the main thread, worker threads start the first time it is reached
+
+// SIMULATION
+// simulate_tick() always advances the game by SIMULATION_DT, rendering interpolates between the last two ticks
+#define SIMULATION_TICK_RATE 120
+#define SIMULATION_DT (1.0 / SIMULATION_TICK_RATE)
+#define MAX_SIMULATION_TICKS_PER_FRAME 8 // Drops time instead of spiraling when a frame takes too long
+
+// AUDIO
+#define MAX_AUDIO_VOICES 24 // Past this the lowest priority, then quietest, then oldest sound effects are faded out
+// Sound effect priorities, higher ones steal voices from lower ones
+#define SFX_PRIORITY_BLOP 0
+#define SFX_PRIORITY_COLLISION 1
+#define SFX_PRIORITY_GAME_EVENT 2 // Missed shot, game over
+#define SFX_PRIORITY_UI 3
+// How many of the same clip can play at once, a new one steals the oldest
+#define SFX_MAX_INSTANCES_BLOP 3 // Per blop variant
+#define SFX_MAX_INSTANCES_COLLISION 4
 
 // Here we can define configuration (setup) variables for certain game designs
 
@@ -21,4 +55,10 @@
 #define SPAWN_RATE_BEAM_OBSTACLE    0.05
 #define SPAWN_RATE_INVERTED_BEAM_OBSTACLE   0.05
 
-#define DROP_RATE_POSITIVE_EFFECT 0.05
\ No newline at end of file
+#define DROP_RATE_POSITIVE_EFFECT 0.05
+
+// BENCHMARKS
+// Set this to 1 (or -DRUN_GAME_BENCHMARKS=1) to run the headless benchmarks in include/benchmarks.c instead of the game.
+#ifndef RUN_GAME_BENCHMARKS
+#define RUN_GAME_BENCHMARKS 0
+#endif
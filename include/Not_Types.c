@@ -58,6 +58,16 @@ typedef enum ParticleKind {
 	PFX_MAX,
 } ParticleKind;
 
+typedef enum ParticleJob {
+	PARTICLE_JOB_NIL = 0,
+
+	PARTICLE_JOB_UPDATE = 1,
+	PARTICLE_JOB_RENDER = 2,
+	PARTICLE_JOB_QUIT = 3,
+
+	PARTICLE_JOB_MAX,
+} ParticleJob;
+
 typedef enum ObstacleType {
 	OBSTACLE_NIL = 0,
 
@@ -21,28 +21,83 @@ typedef struct Scene_Cbuffer {
 	int light_count;
 } Scene_Cbuffer;
 
+// Generational handle into one of the fixed size arrays in World, packed in 32 bits.
+// The low HANDLE_INDEX_BITS are the slot index + 1 (so 0 is always the null handle), just enough for MAX_ENTITY_COUNT.
+// The remaining bits are the slot generation (21 bits with the default 1024 entities).
+// Destroying whatever lives in a slot bumps its generation, so old handles resolve to NULL instead of dangling.
+// A slot is retired once its generation no longer fits in the handle, so an old handle never matches a new one.
+typedef u32 Handle;
+#define NULL_HANDLE 0
+#define HANDLE_INDEX_BITS ( \
+	MAX_ENTITY_COUNT < (1 << 10) ? 10 : \
+	MAX_ENTITY_COUNT < (1 << 11) ? 11 : \
+	MAX_ENTITY_COUNT < (1 << 12) ? 12 : \
+	MAX_ENTITY_COUNT < (1 << 13) ? 13 : \
+	MAX_ENTITY_COUNT < (1 << 14) ? 14 : \
+	MAX_ENTITY_COUNT < (1 << 15) ? 15 : 16)
+#define HANDLE_GENERATION_BITS    (32 - HANDLE_INDEX_BITS)
+#define HANDLE_INDEX_MASK         ((1u << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_MAX_GENERATION     ((1u << HANDLE_GENERATION_BITS) - 1)
+#define HANDLE_INDEX(handle)      ((int)((handle) & HANDLE_INDEX_MASK) - 1)
+#define HANDLE_GENERATION(handle) ((u32)(handle) >> HANDLE_INDEX_BITS)
+_Static_assert(MAX_ENTITY_COUNT <= HANDLE_INDEX_MASK, "MAX_ENTITY_COUNT does not fit in the handle index bits");
+_Static_assert(HANDLE_GENERATION_BITS >= 16, "Handles need at least 16 generation bits");
+
+// Free list over one of the World arrays, used to hand out slots in O(1)
+typedef struct SlotPool {
+	u16 free_slots[MAX_ENTITY_COUNT];  // Stack of free slot indices
+	u32 generations[MAX_ENTITY_COUNT]; // Current generation of each slot, above HANDLE_MAX_GENERATION once retired
+	int free_count;
+	int retired_count;
+} SlotPool;
+
 typedef struct TimedEvent {
     bool is_valid;
 	TimedEventWorldType worldtype;
     TimedEventType type;     // Which timed event are we referencing
 	float interval;          // Time before the event starts
-    float interval_timer;    // Timer for the interval
     float duration;
     float duration_timer;          // Duration of the event
-    float progress;          // Current progress of the event
     int counter;             // Count how many loops we have done (useful)
+	// --- Owned by the TimerScheduler ---
+	float64 start_time;      // Scheduler time when the current interval started
+	float64 expire_time;     // Scheduler time when the current interval ends
+	int heap_index;          // Position in TimerScheduler.heap while waiting for the interval
+	int active_index;        // Position in TimerScheduler.active while inside the duration
+	bool is_scheduled;       // Waiting in the heap
+	bool is_active;          // Inside the duration window
+	bool is_finished;        // What timer_finished() returns this tick
 } TimedEvent;
 
+// Min-heap on expire_time for waiting timers, a dense list for timers inside their duration.
+// Waiting timers cost nothing per tick, only expiring and active ones are touched.
+typedef struct TimerScheduler {
+	TimedEvent* events; // Indices below point into this array
+	int capacity;
+	float64 time;       // Only advances while the game is running and not paused
+
+	int* heap;
+	int heap_count;
+	int* active;
+	int active_count;
+	int* fired;         // Timers whose is_finished was set this tick
+	int fired_count;
+
+	Allocator allocator;
+} TimerScheduler;
+
 typedef struct Entity {
-    TimedEvent* timer;
-	TimedEvent* second_timer;
-	TimedEvent* third_timer;
-	struct Entity* child;
+	Handle timer;
+	Handle second_timer;
+	Handle third_timer;
+	Handle child;
 	// --- Entity Attributes ---
 	enum EntityType entitytype;
 	Vector2 size;
 	Vector2 start_size;
 	Vector2 position;
+	Vector2 previous_position;   // Position at the start of the last simulation tick, used to interpolate rendering
+	bool has_previous_position;  // False until the entity has lived through a tick
 	Vector2 velocity;
 	Vector2 acceleration;
 	Vector2 deceleration;
@@ -73,7 +128,7 @@ typedef struct Entity {
 
 typedef struct Effect{
 	bool is_valid;
-	TimedEvent* timer;
+	Handle timer;
 	float effect_duration;
 	enum EffectType effect_type;
 	enum EffectSpawn effect_spawn;
@@ -92,18 +147,30 @@ typedef struct Player{
 	bool enhanced_projectile_speed;
 } Player;
 
-typedef struct ObstacleTuple {
-	Entity* obstacle;
-	int x;
-	int y;
-} ObstacleTuple;
+// Rebuilt once per tick in update_game(), every collidable entity is linked into the cell of its center.
+// Entities created after the rebuild aren't in any cell, they are kept in the spawned list until the next one.
+typedef struct CollisionGrid {
+	int cell_head[COLLISION_GRID_WIDTH * COLLISION_GRID_HEIGHT]; // First entity index in each cell, -1 if empty
+	int next[MAX_ENTITY_COUNT];  // Next entity index in the same cell, -1 terminates the list
+	Handle handles[MAX_ENTITY_COUNT]; // Entity each index held at the rebuild, so a reused slot isn't mistaken for it
+	int spawned[MAX_ENTITY_COUNT];    // Entity indices created since the rebuild
+	bool is_spawned[MAX_ENTITY_COUNT];
+	int spawned_count;
+	float max_half_extent;       // Largest half size of any entity in the grid
+	float max_travel;            // Largest distance any entity in the grid can move this tick
+} CollisionGrid;
 
 typedef struct World {
 	Entity entities[MAX_ENTITY_COUNT];
-	ObstacleTuple obstacle_list[MAX_ENTITY_COUNT];
     TimedEvent timedevents[MAX_ENTITY_COUNT];
 	Effect effects[MAX_ENTITY_COUNT];
 
+	SlotPool entity_pool;
+	SlotPool timedevent_pool;
+	SlotPool effect_pool;
+
+	TimerScheduler timer_scheduler;
+
 	Vector2 playable_width;
 	Vector4 world_background;
 } World;
\ No newline at end of file
@@ -0,0 +1,639 @@
+// -----------------------------------------------------------------------
+// Headless benchmarks (enable with RUN_GAME_BENCHMARKS in GlobalVariables.c)
+// These run before the game loop starts and never draw anything.
+// -----------------------------------------------------------------------
+
+void benchmark_entity_allocator() {
+	const int n_cycles = 1000000;
+
+	// Plain create/destroy, the same slot is handed out every time
+	float64 start_seconds = os_get_elapsed_seconds();
+	u64 start_cycles = rdtsc();
+	for (int i = 0; i < n_cycles; i++) {
+		Entity* entity = create_entity();
+		Handle handle = get_entity_handle(entity);
+		destroy_entity(entity);
+		assert(get_entity(handle) == NULL, "Handle should be stale after destroy_entity");
+	}
+	u64 end_cycles = rdtsc();
+	float64 end_seconds = os_get_elapsed_seconds();
+
+	print("Entity create/destroy: %d cycles took %.2f ms (%llu cycles per create/destroy)\n", n_cycles, (end_seconds - start_seconds) * 1000.0, (end_cycles - start_cycles) / n_cycles);
+
+	// Boss stage like pattern: a bunch of live entities, projectiles spawned and destroyed out of order
+	Entity* live[MAX_ENTITY_COUNT / 2];
+	for (int i = 0; i < ARRAY_COUNT(live); i++) {
+		live[i] = create_entity();
+	}
+
+	start_seconds = os_get_elapsed_seconds();
+	start_cycles = rdtsc();
+	for (int i = 0; i < n_cycles; i++) {
+		int slot = get_random_int_in_range(0, ARRAY_COUNT(live) - 1);
+		destroy_entity(live[slot]);
+		live[slot] = create_entity();
+	}
+	end_cycles = rdtsc();
+	end_seconds = os_get_elapsed_seconds();
+
+	print("Entity create/destroy with %d live entities: %d cycles took %.2f ms (%llu cycles per create/destroy)\n", (int)ARRAY_COUNT(live), n_cycles, (end_seconds - start_seconds) * 1000.0, (end_cycles - start_cycles) / n_cycles);
+
+	for (int i = 0; i < ARRAY_COUNT(live); i++) {
+		destroy_entity(live[i]);
+	}
+	assert(world->entity_pool.free_count + world->entity_pool.retired_count == MAX_ENTITY_COUNT, "Entity slots leaked during benchmark");
+
+	// With a large MAX_ENTITY_COUNT the handles have fewer generation bits and the first loop retires slots.
+	// No handle outlives the benchmark, so start the rest from a fresh pool.
+	slot_pool_init(&world->entity_pool);
+}
+
+// Reference for find_projectile_collision, this is what update_game did before the broad phase
+Entity* find_projectile_collision_brute_force(Entity* projectile) {
+	for (int j = 0; j < MAX_ENTITY_COUNT; j++) {
+		Entity* other_entity = &world->entities[j];
+		if (!other_entity->is_valid) continue;
+		if (other_entity == projectile) continue;
+		if (projectile_collides_with(projectile, other_entity)) return other_entity;
+	}
+	return NULL;
+}
+
+// Raise MAX_ENTITY_COUNT from the build (e.g. -DMAX_ENTITY_COUNT=8192) to measure thousands of projectiles
+void benchmark_projectile_collisions() {
+	const float arena_size = 1024.0f;
+	bool was_paused = is_game_paused;
+	is_game_paused = true;
+
+	for (int n_projectiles = 64; n_projectiles <= MAX_ENTITY_COUNT; n_projectiles *= 2) {
+		for (int i = 0; i < n_projectiles; i++) {
+			Entity* projectile = create_entity();
+			projectile->entitytype = ENTITY_PROJECTILE;
+			projectile->size = v2(8, 8);
+			projectile->position = v2(get_random_float32_in_range(-arena_size / 2, arena_size / 2), get_random_float32_in_range(-arena_size / 2, arena_size / 2));
+		}
+
+		u64 start_cycles = rdtsc();
+		int brute_force_hits = 0;
+		for (int i = 0; i < n_projectiles; i++) {
+			if (find_projectile_collision_brute_force(&world->entities[i]) != NULL) brute_force_hits++;
+		}
+		u64 brute_force_cycles = rdtsc() - start_cycles;
+
+		start_cycles = rdtsc();
+		rebuild_collision_grid();
+		int grid_hits = 0;
+		for (int i = 0; i < n_projectiles; i++) {
+			if (find_projectile_collision(&world->entities[i]) != NULL) grid_hits++;
+		}
+		u64 grid_cycles = rdtsc() - start_cycles;
+
+		for (int i = 0; i < n_projectiles; i++) {
+			Entity* projectile = &world->entities[i];
+			assert(find_projectile_collision(projectile) == find_projectile_collision_brute_force(projectile), "Broad phase picked a different collision than the full scan");
+		}
+		assert(grid_hits == brute_force_hits, "Broad phase hit count mismatch");
+
+		// Something created after the rebuild in a reused slot, right on top of the first projectile
+		Entity* first = &world->entities[0];
+		destroy_entity(&world->entities[1]);
+		Entity* spawned = create_entity();
+		assert(spawned == &world->entities[1], "Expected the destroyed slot to be handed out again");
+		spawned->entitytype = ENTITY_OBSTACLE;
+		spawned->size = v2(16, 16);
+		spawned->position = v2_sub(first->position, v2(8, 8));
+		assert(find_projectile_collision(first) == spawned, "Broad phase missed an entity created after the rebuild");
+		for (int i = 0; i < n_projectiles; i++) {
+			Entity* projectile = &world->entities[i];
+			assert(find_projectile_collision(projectile) == find_projectile_collision_brute_force(projectile), "Broad phase picked a different collision after a slot was reused");
+		}
+
+		print("Projectile collisions, %d projectiles (%d hits): full scan %llu cycles, grid %llu cycles\n", n_projectiles, grid_hits, brute_force_cycles, grid_cycles);
+
+		for (int i = 0; i < n_projectiles; i++) {
+			destroy_entity(&world->entities[i]);
+		}
+	}
+
+	is_game_paused = was_paused;
+	assert(world->entity_pool.free_count == MAX_ENTITY_COUNT, "Entity slots leaked during benchmark");
+}
+
+// Quad generation for the main_game_loop scene, recording it per render pass vs once and replaying it
+void benchmark_scene_recording() {
+	const int n_frames = 1000;
+	const int n_render_passes = 2; // light pass + bloom map pass
+
+	player = create_player();
+	summon_world(SPAWN_RATE_ALL_OBSTACLES);
+	for (int i = 0; i < 200; i++) {
+		Entity* projectile = create_entity();
+		projectile->entitytype = ENTITY_PROJECTILE;
+		projectile->size = v2(10, 10);
+		projectile->color = COLOR_WHITE;
+		projectile->position = v2(get_random_float32_in_range(-500, 500), get_random_float32_in_range(-400, 400));
+	}
+	for (int i = 0; i < 50; i++) {
+		particle_emit(v2(get_random_float32_in_range(-500, 500), get_random_float32_in_range(-400, 400)), COLOR_WHITE, 10, PFX_BOUNCE);
+	}
+
+	Draw_Frame frame;
+	draw_frame_init(&frame);
+	current_draw_frame = &frame;
+
+	// Before: the whole world is walked again for every pass
+	float64 start_seconds = os_get_elapsed_seconds();
+	u64 start_cycles = rdtsc();
+	for (int i = 0; i < n_frames; i++) {
+		for (int pass = 0; pass < n_render_passes; pass++) {
+			draw_frame_reset(&frame);
+			draw_game();
+		}
+	}
+	u64 redraw_cycles = rdtsc() - start_cycles;
+	float64 redraw_seconds = os_get_elapsed_seconds() - start_seconds;
+	u64 n_quads = draw_frame_get_quad_count(&frame);
+
+	// After: recorded once, every other pass reuses the quads
+	start_seconds = os_get_elapsed_seconds();
+	start_cycles = rdtsc();
+	for (int i = 0; i < n_frames; i++) {
+		draw_frame_reset(&frame);
+		draw_game();
+		for (int pass = 1; pass < n_render_passes; pass++) {
+			draw_frame_reuse(&frame);
+		}
+	}
+	u64 record_cycles = rdtsc() - start_cycles;
+	float64 record_seconds = os_get_elapsed_seconds() - start_seconds;
+
+	assert(draw_frame_get_quad_count(&frame) == n_quads, "Reusing the Draw_Frame should keep all recorded quads");
+
+	print("Scene quad generation (%llu quads, %d passes): redraw per pass %.2f ms/frame (%llu cycles), record once %.2f ms/frame (%llu cycles)\n", n_quads, n_render_passes, redraw_seconds * 1000.0 / n_frames, redraw_cycles / n_frames, record_seconds * 1000.0 / n_frames, record_cycles / n_frames);
+
+	draw_frame_deinit(&frame);
+	current_draw_frame = 0;
+	remove_all_particles();
+	clean_world();
+}
+
+// The per-poll timer logic TimerScheduler replaced, every timer is touched every tick
+typedef struct PolledTimer {
+	float interval;
+	float interval_timer;
+	float duration;
+	float duration_timer;
+	int counter;
+} PolledTimer;
+
+bool polled_timer_finished(PolledTimer* timer, float64 dt) {
+	if (timer->interval_timer >= timer->interval) {
+		if (timer->duration_timer < timer->duration) {
+			timer->duration_timer += dt;
+			return true;
+		}
+		timer->duration_timer = 0;
+		timer->interval_timer -= timer->interval;
+		timer->counter++;
+		return true;
+	}
+	timer->interval_timer += dt;
+	return false;
+}
+
+void benchmark_timer_scheduler_case(const char* name, float min_interval, float max_interval, int duration_every_nth) {
+	const int n_timers = 100000;
+	const int n_ticks = SIMULATION_TICK_RATE * 10; // 10 seconds of game time
+	Allocator allocator = get_heap_allocator();
+
+	TimedEvent* timers = alloc(allocator, n_timers * sizeof(TimedEvent));
+	PolledTimer* polled = alloc(allocator, n_timers * sizeof(PolledTimer));
+	memset(timers, 0, n_timers * sizeof(TimedEvent));
+	memset(polled, 0, n_timers * sizeof(PolledTimer));
+
+	TimerScheduler scheduler;
+	timer_scheduler_init(&scheduler, timers, n_timers, allocator);
+
+	for (int i = 0; i < n_timers; i++) {
+		timers[i].is_valid = true;
+		timers[i].interval = get_random_float32_in_range(min_interval, max_interval);
+		timers[i].duration = (i % duration_every_nth == 0) ? get_random_float32_in_range(0.1f, 2.0f) : 0.0f;
+		timer_scheduler_add(&scheduler, &timers[i], 0);
+
+		polled[i].interval = timers[i].interval;
+		polled[i].duration = timers[i].duration;
+	}
+
+	u64 polled_cycles = 0;
+	u64 scheduled_cycles = 0;
+	u64 n_scheduled_finished = 0;
+	u64 n_polled_finished = 0;
+	for (int tick = 0; tick < n_ticks; tick++) {
+		u64 start_cycles = rdtsc();
+		for (int i = 0; i < n_timers; i++) {
+			if (polled_timer_finished(&polled[i], SIMULATION_DT)) n_polled_finished++;
+		}
+		polled_cycles += rdtsc() - start_cycles;
+
+		start_cycles = rdtsc();
+		timer_scheduler_tick(&scheduler, SIMULATION_DT, true);
+		scheduled_cycles += rdtsc() - start_cycles;
+		n_scheduled_finished += scheduler.fired_count;
+	}
+
+	// Polling notices an expired interval one tick late and loses that tick every cycle, allow for that drift
+	for (int i = 0; i < n_timers; i++) {
+		float cycle_time = timers[i].interval + timers[i].duration;
+		int allowed_drift = 1 + (int)(polled[i].counter * 2 * SIMULATION_DT / cycle_time + 1);
+		assert(abs(timers[i].counter - polled[i].counter) <= allowed_drift, "Timer %d fired %d times, polling fired %d times", i, timers[i].counter, polled[i].counter);
+	}
+	assert(scheduler.heap_count + scheduler.active_count == n_timers, "Timers were lost by the scheduler");
+
+	// Paused ticks must not advance anything
+	int fired_before_pause = 0;
+	for (int i = 0; i < n_timers; i++) fired_before_pause += timers[i].counter;
+	for (int tick = 0; tick < n_ticks; tick++) {
+		timer_scheduler_tick(&scheduler, SIMULATION_DT, false);
+	}
+	int fired_after_pause = 0;
+	for (int i = 0; i < n_timers; i++) fired_after_pause += timers[i].counter;
+	assert(fired_before_pause == fired_after_pause, "Timers advanced while paused");
+
+	// Removing half of them keeps the heap consistent
+	for (int i = 0; i < n_timers; i += 2) {
+		timer_scheduler_remove(&scheduler, &timers[i]);
+	}
+	assert(scheduler.heap_count + scheduler.active_count == n_timers / 2, "Removed timers are still scheduled");
+	for (int i = 1; i < scheduler.heap_count; i++) {
+		assert(timers[scheduler.heap[(i - 1) / 2]].expire_time <= timers[scheduler.heap[i]].expire_time, "Timer heap order is broken");
+	}
+
+	print("Timers (%cs): %d timers over %d ticks, polling %llu cycles/tick (%llu finished), scheduler %llu cycles/tick (%llu finished)\n", name, n_timers, n_ticks, polled_cycles / n_ticks, n_polled_finished, scheduled_cycles / n_ticks, n_scheduled_finished);
+
+	timer_scheduler_deinit(&scheduler);
+	dealloc(allocator, timers);
+	dealloc(allocator, polled);
+}
+
+void benchmark_timer_scheduler() {
+	benchmark_timer_scheduler_case("busy, 0.1-20s intervals", 0.1f, 20.0f, 4);
+	benchmark_timer_scheduler_case("idle, 30-120s intervals", 30.0f, 120.0f, 4);
+}
+
+// Reference for the particle store, this is the array of structs layout and update loop the game used before
+typedef struct LegacyParticle {
+	ParticleFlags flags;
+	Vector4 col;
+	Vector2 size;
+	Vector2 pos;
+	Vector2 velocity;
+	Vector2 acceleration;
+	float friction;
+	float64 end_time;
+	float fade_out_vel_range;
+	bool immortal;
+	float identifier;
+	ParticleKind kind;
+} LegacyParticle;
+
+void legacy_particle_update(LegacyParticle* ps, int n, float32 dt, Vector2 window_size) {
+	for (int i = 0; i < n; i++) {
+		LegacyParticle* p = &ps[i];
+		if (!(p->flags & PARTICLE_FLAGS_valid)) continue;
+
+		if (p->end_time && has_reached_end_time(os_get_elapsed_seconds(), p->end_time)) {
+			memset(p, 0, sizeof(LegacyParticle));
+			continue;
+		}
+		if (p->flags & PARTICLE_FLAGS_fade_out_with_velocity && v2_length(p->velocity) < 0.01) {
+			memset(p, 0, sizeof(LegacyParticle));
+		}
+		if (p->flags & PARTICLE_FLAGS_gravity) {
+			p->acceleration = v2_mulf(v2(0, PARTICLE_GRAVITY), p->identifier == 0 ? 1.0f : p->identifier);
+		}
+		if (p->flags & PARTICLE_FLAGS_physics) {
+			if (p->flags & PARTICLE_FLAGS_friction) {
+				p->acceleration = v2_sub(p->acceleration, v2_mulf(p->velocity, p->friction));
+			}
+			p->velocity = v2_add(p->velocity, v2_mulf(p->acceleration, dt));
+			p->pos = v2_add(p->pos, v2_mulf(p->velocity, dt));
+			p->acceleration = (Vector2){0};
+		}
+		// Used to happen in particle_render
+		if (is_position_outside_walls_and_bottom(p->pos, window_size) && !p->immortal) {
+			memset(p, 0, sizeof(LegacyParticle));
+		}
+	}
+}
+
+// 100k particles, half effect-like (friction + gravity) and half weather-like (gravity only).
+// Lifetimes and bounds are large enough that nothing dies, so both layouts can be compared particle by particle.
+void benchmark_particle_store() {
+	const int n_particles = 100000;
+	const int n_updates = 200;
+	const float32 dt = (float32)SIMULATION_DT;
+	const Vector2 window_size = v2(1000000, 1000000);
+	Allocator allocator = get_heap_allocator();
+
+	LegacyParticle* legacy = alloc(allocator, n_particles * sizeof(LegacyParticle));
+	memset(legacy, 0, n_particles * sizeof(LegacyParticle));
+	ParticleStore store;
+	particle_store_init(&store, n_particles, allocator);
+
+	float64 end_time = os_get_elapsed_seconds() + 3600.0;
+	for (int i = 0; i < n_particles; i++) {
+		LegacyParticle* p = &legacy[i];
+		p->flags = PARTICLE_FLAGS_valid | PARTICLE_FLAGS_physics | PARTICLE_FLAGS_gravity;
+		p->pos = v2(get_random_float32_in_range(-500, 500), get_random_float32_in_range(-400, 400));
+		p->velocity = v2(get_random_float32_in_range(-200, 200), get_random_float32_in_range(-200, 200));
+		p->identifier = get_random_float32_in_range(0, 1);
+		p->end_time = end_time;
+		if (i % 2 == 0) {
+			p->flags |= PARTICLE_FLAGS_friction;
+			p->friction = 0.5f;
+		}
+
+		int s = particle_store_push(&store, PFX_NIL);
+		store.flags[s] = p->flags;
+		store.pos_x[s] = p->pos.x;
+		store.pos_y[s] = p->pos.y;
+		store.vel_x[s] = p->velocity.x;
+		store.vel_y[s] = p->velocity.y;
+		store.acc_y[s] = PARTICLE_GRAVITY * (p->identifier == 0 ? 1.0f : p->identifier);
+		store.friction[s] = p->friction;
+		store.identifier[s] = p->identifier;
+		store.end_time[s] = p->end_time;
+	}
+
+	u64 start_cycles = rdtsc();
+	for (int i = 0; i < n_updates; i++) {
+		legacy_particle_update(legacy, n_particles, dt, window_size);
+	}
+	u64 legacy_cycles = rdtsc() - start_cycles;
+
+	start_cycles = rdtsc();
+	for (int i = 0; i < n_updates; i++) {
+		particle_store_update(&store, os_get_elapsed_seconds(), dt, window_size);
+	}
+	u64 store_cycles = rdtsc() - start_cycles;
+
+	start_cycles = rdtsc();
+	for (int i = 0; i < n_updates; i++) {
+		particle_store_integrate(&store, dt);
+	}
+	u64 integrate_cycles = rdtsc() - start_cycles;
+
+	// Bring the reference up to the same number of steps before comparing
+	for (int i = 0; i < n_updates; i++) {
+		legacy_particle_update(legacy, n_particles, dt, window_size);
+	}
+
+	assert(store.count == n_particles, "No particle should have died during the benchmark");
+	for (int i = 0; i < n_particles; i++) {
+		assert(fabsf(store.pos_x[i] - legacy[i].pos.x) < 0.01f && fabsf(store.pos_y[i] - legacy[i].pos.y) < 0.01f, "Particle store diverged from the array of structs reference at %d", i);
+	}
+
+	u64 n_steps = (u64)n_particles * n_updates;
+	print("Particle update (%d particles): array of structs %.2f cycles/particle, SoA store %.2f cycles/particle (integrate only %.2f)\n", n_particles, (float64)legacy_cycles / n_steps, (float64)store_cycles / n_steps, (float64)integrate_cycles / n_steps);
+
+	particle_store_deinit(&store);
+	dealloc(allocator, legacy);
+}
+
+// Snow drawn from the stateless weather layer vs the same number of snow particles integrated and drawn
+// from a particle store, which is what every weather particle used to cost.
+void benchmark_weather() {
+	const int n_frames = 200;
+	const Vector2 window_size = v2(1280, 720);
+	Allocator allocator = get_heap_allocator();
+
+	Draw_Frame frame;
+	draw_frame_init(&frame);
+
+	for (int n_flakes = 1000; n_flakes <= 64000; n_flakes *= 4) {
+		ParticleStore store;
+		particle_store_init(&store, n_flakes, allocator);
+		for (int i = 0; i < n_flakes; i++) {
+			float a = get_random_float32_in_range(0, 1);
+			int p = particle_store_push(&store, PFX_SNOW);
+			store.pos_x[p] = get_random_float32_in_range(-window_size.x / 2, window_size.x / 2);
+			store.pos_y[p] = get_random_float32_in_range(-window_size.y / 2, window_size.y / 2);
+			store.vel_x[p] = get_random_float32_in_range(-10, 10);
+			store.vel_y[p] = a * -20;
+			store.acc_y[p] = PARTICLE_GRAVITY * a;
+			store.size[p] = v2(a * 3, a * 3);
+			store.col[p] = COLOR_WHITE;
+		}
+
+		u64 start_cycles = rdtsc();
+		for (int frame_index = 0; frame_index < n_frames; frame_index++) {
+			draw_frame_reset(&frame);
+			particle_store_update(&store, os_get_elapsed_seconds(), (float32)SIMULATION_DT, v2(1000000, 1000000));
+			for (int i = 0; i < store.count; i++) {
+				Vector2 pos = v2(store.pos_x[i], store.pos_y[i]);
+				if (is_position_outside_bounds(pos, window_size)) continue;
+				draw_centered_in_frame_rect(pos, store.size[i], store.col[i], &frame);
+			}
+		}
+		u64 store_cycles = rdtsc() - start_cycles;
+		particle_store_deinit(&store);
+
+		Weather saved_weather = weather;
+		weather_clear_all();
+		weather.time = 0;
+		weather_add_flakes(PFX_SNOW, n_flakes);
+		weather.time = 30.0; // Well into the first cycle so most flakes are on screen
+		int n_drawn = 0;
+
+		start_cycles = rdtsc();
+		for (int frame_index = 0; frame_index < n_frames; frame_index++) {
+			draw_frame_reset(&frame);
+			weather_advance(SIMULATION_DT);
+			n_drawn = weather_render(window_size, &frame);
+		}
+		u64 weather_cycles = rdtsc() - start_cycles;
+		weather = saved_weather;
+
+		print("Snow (%d flakes, %d on screen): particle store %llu cycles/frame, stateless weather %llu cycles/frame\n", n_flakes, n_drawn, store_cycles / n_frames, weather_cycles / n_frames);
+	}
+
+	draw_frame_deinit(&frame);
+}
+
+// Fills the store the same way for every run so the results can be compared between thread counts
+void benchmark_fill_particle_store(ParticleStore* store, int n_particles, Vector2 window_size, float64 max_end_time) {
+	u64 backup_seed = seed_for_random;
+	seed_for_random = 1234;
+	particle_store_clear(store);
+	for (int i = 0; i < n_particles; i++) {
+		int p = particle_store_push(store, PFX_EFFECT);
+		store->flags[p] |= PARTICLE_FLAGS_physics | PARTICLE_FLAGS_friction | PARTICLE_FLAGS_gravity;
+		store->pos_x[p] = get_random_float32_in_range(-window_size.x / 2, window_size.x / 2);
+		store->pos_y[p] = get_random_float32_in_range(-window_size.y / 2, window_size.y / 2);
+		store->vel_x[p] = get_random_float32_in_range(-50, 50);
+		store->vel_y[p] = get_random_float32_in_range(-50, 50);
+		store->acc_y[p] = PARTICLE_GRAVITY;
+		store->friction[p] = 0.5f;
+		store->size[p] = v2(2, 2);
+		store->col[p] = COLOR_WHITE;
+		if (i % 10 == 0) store->end_time[p] = get_random_float32_in_range(0, max_end_time); // Some die on the way
+	}
+	seed_for_random = backup_seed;
+}
+
+u64 benchmark_hash_bytes(u64 hash, void* data, u64 size) {
+	u8* bytes = (u8*)data;
+	for (u64 i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	return hash;
+}
+
+// Update + quad generation on 0..N worker threads (plus the main thread), 2k to 1M particles.
+// Checks that the store and the quads are identical for every thread count.
+void benchmark_particle_workers() {
+	const int n_frames = 20;
+	const float32 dt = (float32)SIMULATION_DT;
+	const Vector2 window_size = v2(1280, 720);
+	Allocator allocator = get_heap_allocator();
+	int max_threads = min((int)os_get_number_of_logical_processors() - 1, MAX_PARTICLE_WORKER_THREADS);
+
+	Weather saved_weather = weather;
+	weather_clear_all();
+
+	for (int n_particles = 2000; n_particles <= 1024000; n_particles *= 8) {
+		ParticleStore store;
+		particle_store_init(&store, n_particles, allocator);
+		Draw_Frame frame;
+		draw_frame_init_reserve(&frame, n_particles);
+
+		u64 serial_hash = 0;
+		float64 serial_seconds = 0;
+		int n_threads = 0;
+		while (true) {
+			ParticleWorkerPool pool;
+			particle_worker_pool_init(&pool, n_threads, allocator);
+			pool.parallel_threshold = 0;
+			benchmark_fill_particle_store(&store, n_particles, window_size, n_frames * dt);
+
+			u64 hash = 14695981039346656037ULL;
+			float64 start_seconds = os_get_elapsed_seconds();
+			for (int i = 0; i < n_frames; i++) {
+				draw_frame_reset(&frame);
+				particle_workers_update(&pool, &store, i * dt, dt, window_size);
+				particle_workers_render(&pool, &store, window_size, &frame);
+			}
+			float64 seconds = os_get_elapsed_seconds() - start_seconds;
+
+			hash = benchmark_hash_bytes(hash, store.pos_x, store.count * sizeof(float32));
+			hash = benchmark_hash_bytes(hash, store.pos_y, store.count * sizeof(float32));
+			draw_frame_flush(&frame);
+			for (u64 i = 0; i < growing_array_get_valid_count(frame.quad_buffer); i++) {
+				// Corners and color, the rest of Draw_Quad has padding
+				Draw_Quad q;
+				draw_frame_unpack_quad(&frame, &frame.quad_buffer[i], &q);
+				hash = benchmark_hash_bytes(hash, &q, offsetof(Draw_Quad, image));
+			}
+			if (n_threads == 0) {
+				serial_hash = hash;
+				serial_seconds = seconds;
+			}
+			assert(hash == serial_hash, "Particle workers gave a different result with %d threads", n_threads);
+
+			print("Particle workers (%d particles, %d alive, main + %d threads): %.3f ms/frame, %.2fx speedup\n", n_particles, store.count, n_threads, seconds * 1000.0 / n_frames, serial_seconds / seconds);
+			particle_worker_pool_deinit(&pool);
+
+			if (n_threads >= max_threads) break;
+			n_threads = min(n_threads ? n_threads * 2 : 1, max_threads);
+		}
+
+		draw_frame_deinit(&frame);
+		particle_store_deinit(&store);
+	}
+
+	weather = saved_weather;
+}
+
+// The kind of quads the game draws: mostly axis aligned rects and circles, some rotated rects and text
+void benchmark_draw_quad_mix(Draw_Frame* frame, int n_quads) {
+	for (int i = 0; i < n_quads; i++) {
+		Vector2 pos = v2(get_random_float32_in_range(-600, 600), get_random_float32_in_range(-340, 340));
+		Vector4 col = v4(get_random_float32_in_range(0, 1), get_random_float32_in_range(0, 1), get_random_float32_in_range(0, 1), 1);
+		int kind = i % 20;
+		if (kind < 14) {
+			draw_rect_in_frame(pos, v2(8, 8), col, frame);
+		} else if (kind < 17) {
+			draw_circle_in_frame(pos, v2(6, 6), col, frame);
+		} else if (kind < 19) {
+			Matrix4 xform = m4_translate(m4_scalar(1.0), v3(pos.x, pos.y, 0));
+			xform = m4_rotate_z(xform, (float32)i);
+			draw_rect_xform_in_frame(xform, v2(12, 2), col, frame);
+		} else {
+			draw_text_in_frame(font_light, STR("x"), font_height, pos, v2(0.4, 0.4), col, frame);
+		}
+	}
+}
+
+// Draw_Quad_Packed + extras vs storing a full Draw_Quad per quad like before
+void benchmark_quad_format() {
+	const int n_frames = 200;
+	const int n_quads = 20000;
+
+	Draw_Frame frame;
+	draw_frame_init(&frame);
+	Draw_Quad* full_quads = 0;
+	growing_array_init_virtual((void**)&full_quads, sizeof(Draw_Quad), n_quads * 2);
+
+	u64 backup_seed = seed_for_random;
+	seed_for_random = 1234;
+
+	u64 record_cycles = 0;
+	u64 expand_cycles = 0;
+	float64 record_seconds = 0;
+	for (int frame_index = 0; frame_index < n_frames; frame_index++) {
+		draw_frame_reset(&frame);
+
+		float64 start_seconds = os_get_elapsed_seconds();
+		u64 start_cycles = rdtsc();
+		benchmark_draw_quad_mix(&frame, n_quads);
+		draw_frame_flush(&frame);
+		record_cycles += rdtsc() - start_cycles;
+		record_seconds += os_get_elapsed_seconds() - start_seconds;
+
+		// What the renderer does at submit time. The full quads are what the quad buffer used to hold.
+		growing_array_clear((void**)&full_quads);
+		u64 count = growing_array_get_valid_count(frame.quad_buffer);
+		Draw_Quad* expanded = (Draw_Quad*)growing_array_add_multiple_empty((void**)&full_quads, count);
+		start_cycles = rdtsc();
+		for (u64 i = 0; i < count; i++) {
+			draw_frame_unpack_quad(&frame, &frame.quad_buffer[i], &expanded[i]);
+		}
+		expand_cycles += rdtsc() - start_cycles;
+	}
+	seed_for_random = backup_seed;
+
+	u64 count = growing_array_get_valid_count(frame.quad_buffer);
+	u64 n_extras = growing_array_get_valid_count(frame.quad_extras);
+	u64 packed_bytes = count * sizeof(Draw_Quad_Packed) + n_extras * sizeof(Vector4);
+	u64 full_bytes = count * sizeof(Draw_Quad);
+	u64 total_quads = (u64)n_frames * count;
+
+	print("Quad format (%llu quads/frame): packed %llu KB/frame (%llu B/quad + %llu extras), full %llu KB/frame (%llu B/quad)\n", count, packed_bytes / 1024, (u64)sizeof(Draw_Quad_Packed), n_extras, full_bytes / 1024, (u64)sizeof(Draw_Quad));
+	print("    record %llu cycles/quad (%.1f M quads/s), expand at submit %llu cycles/quad\n", record_cycles / total_quads, (float64)total_quads / record_seconds / 1000000.0, expand_cycles / total_quads);
+
+	growing_array_deinit((void**)&full_quads);
+	draw_frame_deinit(&frame);
+}
+
+void run_game_benchmarks() {
+	print("Running game benchmarks...\n");
+
+	benchmark_entity_allocator();
+	benchmark_projectile_collisions();
+	benchmark_timer_scheduler();
+	benchmark_scene_recording();
+	benchmark_quad_format();
+	benchmark_particle_store();
+	benchmark_weather();
+	benchmark_particle_workers();
+
+	print("Game benchmarks done!\n");
+}
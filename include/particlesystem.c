@@ -1,35 +1,664 @@
+// Structure of arrays particle store. Everything in [0, count) is alive, removing a particle moves the last
+// one into its slot. The integrated lanes are 32 byte aligned so particle_store_integrate() can push 8 particles
+// at a time through the simd.c kernels.
+// Every kind also keeps a dense list of its particle indices, so counting and removing one kind never scans the store.
+typedef struct ParticleStore {
+	int count;
+	int capacity;
+	int dropped_count; // Pushes that failed because the store was full
 
+	int kind_count[PFX_MAX];
+	int* kind_members;  // kind_members[kind * capacity + n] is the index of the n:th particle of that kind
+	int* kind_position; // Where particle i sits in its kind's list
 
-typedef struct Particle {
-	ParticleFlags flags;
-	Vector4 col;
-	Vector2 size;
-	Vector2 pos;
-	Vector2 velocity;
-	Vector2 acceleration;
-	float friction;
-	float64 end_time;
-	float fade_out_vel_range;
-	bool immortal;
-	float identifier;
-	ParticleKind kind;
-} Particle;
-Particle particles[2048] = {0};
-int particle_cursor = 0;
-
-Particle* particle_new() {
-	Particle* p = &particles[particle_cursor];
-	particle_cursor += 1;
-	if (particle_cursor >= (sizeof(particles) / sizeof(particles[0]))) {
-		particle_cursor = 0;
-	}
-	if (p->flags & PARTICLE_FLAGS_valid) {
-		log_warning("too many particles, overwriting existing");
-	}
-	p->flags |= PARTICLE_FLAGS_valid;
+	// Integrated every update
+	float32* pos_x;
+	float32* pos_y;
+	float32* vel_x;
+	float32* vel_y;
+	float32* acc_x; // Constant per particle (gravity), friction is applied on top of it
+	float32* acc_y;
+	float32* friction; // 0 unless PARTICLE_FLAGS_friction
+
+	float64* end_time; // 0 means the particle has no lifetime
+	Vector4* col;
+	Vector2* size;
+	ParticleFlags* flags;
+	float* fade_out_vel_range;
+	float* identifier;
+	ParticleKind* kind;
+
+	void* memory;
+	Allocator allocator;
+} ParticleStore;
+ParticleStore particles = {0};
+
+#define PARTICLE_LANE_ALIGNMENT 32
+#define PARTICLE_GRAVITY -40.2f
+
+void* particle_store_carve(u64* cursor, u64 size) {
+	*cursor = align_next(*cursor, PARTICLE_LANE_ALIGNMENT);
+	void* p = (void*)*cursor;
+	*cursor += size;
 	return p;
 }
 
-void particle_clear(Particle* p) {
-	memset(p, 0, sizeof(Particle));
-}
\ No newline at end of file
+// Lays out every array in one block, first pass with a null base only measures it
+void particle_store_layout(ParticleStore* store, u64 base, int capacity) {
+	u64 cursor = base;
+	store->pos_x              = particle_store_carve(&cursor, capacity * sizeof(float32));
+	store->pos_y              = particle_store_carve(&cursor, capacity * sizeof(float32));
+	store->vel_x              = particle_store_carve(&cursor, capacity * sizeof(float32));
+	store->vel_y              = particle_store_carve(&cursor, capacity * sizeof(float32));
+	store->acc_x              = particle_store_carve(&cursor, capacity * sizeof(float32));
+	store->acc_y              = particle_store_carve(&cursor, capacity * sizeof(float32));
+	store->friction           = particle_store_carve(&cursor, capacity * sizeof(float32));
+	store->end_time           = particle_store_carve(&cursor, capacity * sizeof(float64));
+	store->col                = particle_store_carve(&cursor, capacity * sizeof(Vector4));
+	store->size               = particle_store_carve(&cursor, capacity * sizeof(Vector2));
+	store->flags              = particle_store_carve(&cursor, capacity * sizeof(ParticleFlags));
+	store->fade_out_vel_range = particle_store_carve(&cursor, capacity * sizeof(float));
+	store->identifier         = particle_store_carve(&cursor, capacity * sizeof(float));
+	store->kind               = particle_store_carve(&cursor, capacity * sizeof(ParticleKind));
+	store->kind_members       = particle_store_carve(&cursor, (u64)capacity * PFX_MAX * sizeof(int));
+	store->kind_position      = particle_store_carve(&cursor, capacity * sizeof(int));
+	store->memory             = (void*)cursor; // One past the end, only meaningful for the measuring pass
+}
+
+void particle_store_init(ParticleStore* store, int capacity, Allocator allocator) {
+	memset(store, 0, sizeof(ParticleStore));
+	capacity = (int)align_next(capacity, 8);
+
+	particle_store_layout(store, 0, capacity);
+	u64 size = (u64)store->memory + PARTICLE_LANE_ALIGNMENT;
+
+	void* memory = alloc(allocator, size);
+	particle_store_layout(store, align_next((u64)memory, PARTICLE_LANE_ALIGNMENT), capacity);
+	store->memory = memory;
+	store->allocator = allocator;
+	store->capacity = capacity;
+}
+
+void particle_store_deinit(ParticleStore* store) {
+	if (store->memory) dealloc(store->allocator, store->memory);
+	memset(store, 0, sizeof(ParticleStore));
+}
+
+// Returns the index of a zeroed particle or -1 if the store is full
+int particle_store_push(ParticleStore* store, ParticleKind kind) {
+	assert(kind >= 0 && kind < PFX_MAX, "Invalid particle kind %d", kind);
+	if (store->count >= store->capacity) {
+		store->dropped_count += 1;
+		return -1;
+	}
+	int i = store->count;
+	store->count += 1;
+
+	int n = store->kind_count[kind];
+	store->kind_members[kind * store->capacity + n] = i;
+	store->kind_position[i] = n;
+	store->kind_count[kind] = n + 1;
+
+	store->pos_x[i] = 0;
+	store->pos_y[i] = 0;
+	store->vel_x[i] = 0;
+	store->vel_y[i] = 0;
+	store->acc_x[i] = 0;
+	store->acc_y[i] = 0;
+	store->friction[i] = 0;
+	store->end_time[i] = 0;
+	store->col[i] = v4(0, 0, 0, 0);
+	store->size[i] = v2(0, 0);
+	store->flags[i] = PARTICLE_FLAGS_valid;
+	store->fade_out_vel_range[i] = 0;
+	store->identifier[i] = 0;
+	store->kind[i] = kind;
+	return i;
+}
+
+void particle_store_remove(ParticleStore* store, int i) {
+	assert(i >= 0 && i < store->count, "Particle index out of range");
+
+	// Take i out of its kind list, the kind's last member fills the hole
+	ParticleKind kind = store->kind[i];
+	int* members = &store->kind_members[kind * store->capacity];
+	int n = store->kind_count[kind] - 1;
+	int moved_member = members[n];
+	members[store->kind_position[i]] = moved_member;
+	store->kind_position[moved_member] = store->kind_position[i];
+	store->kind_count[kind] = n;
+
+	int last = store->count - 1;
+	store->count = last;
+	if (i == last) return;
+
+	// The last particle moves into slot i, point its kind list entry there
+	store->kind_members[store->kind[last] * store->capacity + store->kind_position[last]] = i;
+	store->kind_position[i] = store->kind_position[last];
+
+	store->pos_x[i] = store->pos_x[last];
+	store->pos_y[i] = store->pos_y[last];
+	store->vel_x[i] = store->vel_x[last];
+	store->vel_y[i] = store->vel_y[last];
+	store->acc_x[i] = store->acc_x[last];
+	store->acc_y[i] = store->acc_y[last];
+	store->friction[i] = store->friction[last];
+	store->end_time[i] = store->end_time[last];
+	store->col[i] = store->col[last];
+	store->size[i] = store->size[last];
+	store->flags[i] = store->flags[last];
+	store->fade_out_vel_range[i] = store->fade_out_vel_range[last];
+	store->identifier[i] = store->identifier[last];
+	store->kind[i] = store->kind[last];
+}
+
+// Only touches particles of that kind
+void particle_store_remove_kind(ParticleStore* store, ParticleKind kind) {
+	while (store->kind_count[kind] > 0) {
+		particle_store_remove(store, store->kind_members[kind * store->capacity + store->kind_count[kind] - 1]);
+	}
+}
+
+void particle_store_clear(ParticleStore* store) {
+	store->count = 0;
+	memset(store->kind_count, 0, sizeof(store->kind_count));
+}
+
+// a = acc - vel * friction, vel += a * dt, pos += vel * dt
+// begin has to be a multiple of 8 so the lanes stay aligned
+void particle_store_integrate_range(ParticleStore* store, int begin, int end, float32 dt) {
+	alignat(PARTICLE_LANE_ALIGNMENT) float32 dt_lanes[8];
+	alignat(PARTICLE_LANE_ALIGNMENT) float32 a[8];
+	alignat(PARTICLE_LANE_ALIGNMENT) float32 t[8];
+	for (int lane = 0; lane < 8; lane++) dt_lanes[lane] = dt;
+
+	assert(begin % 8 == 0, "Particle ranges have to start on a multiple of 8");
+	int wide_end = begin + ((end - begin) & ~7);
+	for (int i = begin; i < wide_end; i += 8) {
+		simd_mul_float32_256_aligned(store->vel_x + i, store->friction + i, t);
+		simd_sub_float32_256_aligned(store->acc_x + i, t, a);
+		simd_mul_float32_256_aligned(a, dt_lanes, a);
+		simd_add_float32_256_aligned(store->vel_x + i, a, store->vel_x + i);
+		simd_mul_float32_256_aligned(store->vel_x + i, dt_lanes, t);
+		simd_add_float32_256_aligned(store->pos_x + i, t, store->pos_x + i);
+
+		simd_mul_float32_256_aligned(store->vel_y + i, store->friction + i, t);
+		simd_sub_float32_256_aligned(store->acc_y + i, t, a);
+		simd_mul_float32_256_aligned(a, dt_lanes, a);
+		simd_add_float32_256_aligned(store->vel_y + i, a, store->vel_y + i);
+		simd_mul_float32_256_aligned(store->vel_y + i, dt_lanes, t);
+		simd_add_float32_256_aligned(store->pos_y + i, t, store->pos_y + i);
+	}
+
+	for (int i = wide_end; i < end; i++) {
+		store->vel_x[i] += (store->acc_x[i] - store->vel_x[i] * store->friction[i]) * dt;
+		store->vel_y[i] += (store->acc_y[i] - store->vel_y[i] * store->friction[i]) * dt;
+		store->pos_x[i] += store->vel_x[i] * dt;
+		store->pos_y[i] += store->vel_y[i] * dt;
+	}
+}
+
+void particle_store_integrate(ParticleStore* store, float32 dt) {
+	particle_store_integrate_range(store, 0, store->count, dt);
+}
+
+// Expired, stopped or fallen out of the window
+bool particle_store_is_dead(ParticleStore* store, int i, float64 now, Vector2 window_size) {
+	if (store->end_time[i] && has_reached_end_time(now, store->end_time[i])) return true;
+	if (store->flags[i] & PARTICLE_FLAGS_fade_out_with_velocity && v2_length(v2(store->vel_x[i], store->vel_y[i])) < 0.01) return true;
+	return is_position_outside_walls_and_bottom(v2(store->pos_x[i], store->pos_y[i]), window_size);
+}
+
+// Integrates, then drops dead particles.
+// now is sampled once by the caller so every particle sees the same time.
+void particle_store_update(ParticleStore* store, float64 now, float32 dt, Vector2 window_size) {
+	particle_store_integrate(store, dt);
+
+	// Backwards so the particle swapped into a removed slot has already been visited
+	for (int i = store->count - 1; i >= 0; i--) {
+		if (particle_store_is_dead(store, i, now, window_size)) {
+			particle_store_remove(store, i);
+		}
+	}
+}
+
+void particle_store_render_range(ParticleStore* store, int begin, int end, Vector2 window_size, Draw_Frame* draw_frame) {
+	for (int i = begin; i < end; i++) {
+		Vector2 pos = v2(store->pos_x[i], store->pos_y[i]);
+		if (is_position_outside_bounds(pos, window_size)) {
+			continue;
+		}
+
+		Vector4 col = store->col[i];
+		if (store->flags[i] & PARTICLE_FLAGS_fade_out_with_velocity) {
+			col.a *= float_alpha(fabsf(v2_length(v2(store->vel_x[i], store->vel_y[i]))), 0, store->fade_out_vel_range[i]);
+		}
+
+		draw_centered_in_frame_rect(pos, store->size[i], col, draw_frame);
+	}
+}
+
+// The game's particles live in the global store, a full store drops new particles (see particles.dropped_count)
+int particle_new(ParticleKind kind) {
+	return particle_store_push(&particles, kind);
+}
+
+void particle_remove(int i) {
+	particle_store_remove(&particles, i);
+}
+
+Vector2 particle_position(int i) {
+	return v2(particles.pos_x[i], particles.pos_y[i]);
+}
+
+void particle_set_position(int i, Vector2 pos) {
+	particles.pos_x[i] = pos.x;
+	particles.pos_y[i] = pos.y;
+}
+
+Vector2 particle_velocity(int i) {
+	return v2(particles.vel_x[i], particles.vel_y[i]);
+}
+
+void particle_set_velocity(int i, Vector2 velocity) {
+	particles.vel_x[i] = velocity.x;
+	particles.vel_y[i] = velocity.y;
+}
+
+// Gravity used to be recomputed every update, it only depends on the identifier so it's baked into acc_y at emit time
+void particle_set_gravity(int i) {
+	float scale = particles.identifier[i] == 0 ? 1.0f : particles.identifier[i];
+	particles.acc_y[i] = PARTICLE_GRAVITY * scale;
+}
+
+// -----------------------------------------------------------------------
+// Weather (SNOW, ASH, LEAF, RAIN, WIND)
+// Flakes have no per-particle state, flake j of a layer is computed from (seed, j, time) every frame,
+// the same way oogabooga/ext_particles.c draws its emissions. A falling flake spawns above the window at a
+// fixed height and falls until it passes the bottom, then starts a new cycle with a new x. Every cycle of a
+// flake takes the same time, so the cycle and the time into it are a single division.
+// -----------------------------------------------------------------------
+
+// Flakes added together start falling at the same time. The stages add flakes once per stage,
+// when all batches are taken new flakes just join the last one.
+typedef struct WeatherBatch {
+	int first_flake;
+	float64 start_time;
+} WeatherBatch;
+
+typedef struct WeatherLayer {
+	int flake_count;
+	u64 seed;
+	WeatherBatch batches[WEATHER_MAX_BATCHES];
+	int batch_count;
+} WeatherLayer;
+
+typedef struct Weather {
+	WeatherLayer layers[PFX_MAX]; // Only the weather kinds are used
+	float64 time;                 // Advanced by the simulation, so weather stops while the game is paused
+} Weather;
+Weather weather = {0};
+
+bool is_weather_kind(ParticleKind kind) {
+	return kind == PFX_SNOW || kind == PFX_ASH || kind == PFX_LEAF || kind == PFX_RAIN || kind == PFX_WIND;
+}
+
+// splitmix64
+u64 weather_hash(u64 x) {
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+float32 weather_random_float32_in_range(u64* state, float32 min, float32 max) {
+	*state = weather_hash(*state);
+	return min + (max - min) * (float32)((*state >> 40) * (1.0 / (1ULL << 24)));
+}
+
+void weather_add_flakes(ParticleKind kind, int n_flakes) {
+	assert(is_weather_kind(kind), "Not a weather particle kind %d", kind);
+	if (n_flakes <= 0) return;
+
+	WeatherLayer* layer = &weather.layers[kind];
+	if (layer->flake_count == 0) {
+		layer->seed = get_random();
+		layer->batch_count = 0;
+	}
+	if (layer->batch_count < WEATHER_MAX_BATCHES) {
+		layer->batches[layer->batch_count].first_flake = layer->flake_count;
+		layer->batches[layer->batch_count].start_time = weather.time;
+		layer->batch_count += 1;
+	}
+	layer->flake_count += n_flakes;
+}
+
+void weather_clear(ParticleKind kind) {
+	memset(&weather.layers[kind], 0, sizeof(WeatherLayer));
+}
+
+void weather_clear_all() {
+	memset(weather.layers, 0, sizeof(weather.layers));
+}
+
+void weather_advance(float64 dt) {
+	weather.time += dt;
+}
+
+// Where flake j of a layer is at `age` seconds after its batch started. Returns false while it's not on screen.
+bool weather_sample_flake(ParticleKind kind, u64 seed, int j, float64 age, Vector2 window_size, Vector2* pos, Vector2* size, Vector4* col) {
+	u64 rng = weather_hash(seed ^ (u64)j);
+	float32 a = weather_random_float32_in_range(&rng, 0, 1); // Depth, near flakes are bigger and faster
+
+	if (kind == PFX_WIND) {
+		// Blows from the right edge to the left one
+		float32 speed = max(50 * a, 10.0f);
+		float64 period = window_size.x / speed;
+		u64 cycle = (u64)(age / period);
+		float32 t = (float32)(age - cycle * period);
+
+		u64 cycle_rng = weather_hash(rng + cycle);
+		float32 y = weather_random_float32_in_range(&cycle_rng, -window_size.y / 2, window_size.y / 2);
+		float32 vy = weather_random_float32_in_range(&cycle_rng, -5, 5);
+
+		*pos = v2(window_size.x / 2 - speed * t, y + vy * t);
+		*size = v2_mulf(v2(10, 1), a * 2);
+		*col = v4(0.7, 0.7, 1.0, 0.01);
+		return !is_position_outside_bounds(*pos, window_size);
+	}
+
+	float32 fall_speed = 0;
+	switch (kind) {
+		case PFX_SNOW: {
+			fall_speed = 20 * a;
+			*size = v2_mulf(v2(1, 1), a * 3);
+			*col = v4(1.0, 1.0, 1.0, 1.0);
+		} break;
+		case PFX_ASH: {
+			fall_speed = 10 * a;
+			*size = v2_mulf(v2(1, 1), a * 2);
+			*col = v4(0.5, 0.3, 0.1, 1.0);
+		} break;
+		case PFX_LEAF: {
+			fall_speed = 15 * a;
+			*size = v2_mulf(v2(2, 2), a * 3);
+			*col = v4(weather_random_float32_in_range(&rng, 0.1, 0.3), weather_random_float32_in_range(&rng, 0.5, 0.8), weather_random_float32_in_range(&rng, 0.1, 0.2), 1.0);
+		} break;
+		case PFX_RAIN: {
+			fall_speed = 300 * a;
+			*size = v2_mulf(v2(0.5, 4), a * 4);
+			*col = v4(0.3, 0.3, 1.0, 0.5);
+		} break;
+		default: break;
+	}
+	float32 spawn_y = weather_random_float32_in_range(&rng, window_size.y / 2, 3 * window_size.y);
+	float32 gravity = -PARTICLE_GRAVITY * (a == 0 ? 1.0f : a);
+
+	// Solve spawn_y - fall_speed*t - gravity*t^2/2 = -window_size.y/2 for t
+	float32 distance = spawn_y + window_size.y / 2;
+	float64 period = (-fall_speed + sqrt(fall_speed * fall_speed + 2 * gravity * distance)) / gravity;
+	u64 cycle = (u64)(age / period);
+	float32 t = (float32)(age - cycle * period);
+
+	float32 y = spawn_y - fall_speed * t - 0.5f * gravity * t * t;
+	if (y > window_size.y / 2) return false;
+
+	u64 cycle_rng = weather_hash(rng + cycle);
+	float32 x = weather_random_float32_in_range(&cycle_rng, -window_size.x / 2, window_size.x / 2);
+	float32 vx = kind == PFX_RAIN ? 0 : weather_random_float32_in_range(&cycle_rng, kind == PFX_ASH ? -5 : -10, kind == PFX_ASH ? 5 : 10);
+
+	// Drifting out of a wall comes back in through the other one
+	x = fmodf(x + vx * t + window_size.x / 2, window_size.x);
+	if (x < 0) x += window_size.x;
+
+	*pos = v2(x - window_size.x / 2, y);
+	return true;
+}
+
+int weather_flake_count() {
+	int n = 0;
+	for (ParticleKind kind = 0; kind < PFX_MAX; kind++) {
+		n += weather.layers[kind].flake_count;
+	}
+	return n;
+}
+
+// Draws flakes [begin, end) counted over all layers, returns the number drawn
+int weather_render_range(Vector2 window_size, Draw_Frame* draw_frame, int begin, int end) {
+	int n_drawn = 0;
+	int first_flake = 0;
+	for (ParticleKind kind = 0; kind < PFX_MAX; kind++) {
+		WeatherLayer* layer = &weather.layers[kind];
+		int layer_begin = max(begin - first_flake, 0);
+		int layer_end = min(end - first_flake, layer->flake_count);
+		first_flake += layer->flake_count;
+
+		int batch = 0;
+		for (int j = layer_begin; j < layer_end; j++) {
+			while (batch + 1 < layer->batch_count && j >= layer->batches[batch + 1].first_flake) batch++;
+
+			Vector2 pos, size;
+			Vector4 col;
+			float64 age = weather.time - layer->batches[batch].start_time;
+			if (!weather_sample_flake(kind, layer->seed, j, age, window_size, &pos, &size, &col)) continue;
+
+			draw_centered_in_frame_rect(pos, size, col, draw_frame);
+			n_drawn++;
+		}
+	}
+	return n_drawn;
+}
+
+int weather_render(Vector2 window_size, Draw_Frame* draw_frame) {
+	return weather_render_range(window_size, draw_frame, 0, weather_flake_count());
+}
+
+// -----------------------------------------------------------------------
+// Particle workers
+// Same setup as oogabooga/examples/threaded_drawing.c: every worker thread waits on its own start semaphore,
+// does its slice of the job and signals its done semaphore. The main thread runs slice 0 itself.
+// Slices are fixed index ranges and the per-worker Draw_Frames are appended in worker order, so the store,
+// the removals and the quads come out exactly as if everything ran on one thread.
+// -----------------------------------------------------------------------
+
+typedef struct ParticleWorkerPool ParticleWorkerPool;
+
+typedef struct ParticleWorker {
+	Thread thread;
+	Binary_Semaphore start_sem;
+	Binary_Semaphore done_sem;
+	ParticleWorkerPool* pool;
+	int index;
+
+	Draw_Frame weather_frame;
+	Draw_Frame particle_frame;
+	int n_flakes_drawn;
+} ParticleWorker;
+
+typedef struct ParticleWorkerPool {
+	ParticleWorker* workers; // workers[0] is the main thread and has no Thread
+	int worker_count;
+	int parallel_threshold;  // Jobs smaller than this run on the main thread only
+	bool is_started;         // Threads are started by the first job that is big enough to be split
+
+	// The current job, written by the main thread before the workers are started
+	ParticleJob job;
+	ParticleStore* store;
+	float64 now;
+	float32 dt;
+	Vector2 window_size;
+	Draw_Frame* target;      // Render state (projection, camera, z & scissor) is copied from here
+
+	bool* dead;              // Filled by PARTICLE_JOB_UPDATE, removals happen on the main thread afterwards
+	int dead_capacity;
+
+	Allocator allocator;
+} ParticleWorkerPool;
+ParticleWorkerPool particle_workers = {0};
+
+// Slices are multiples of 8 so every worker integrates whole SIMD lanes
+void particle_worker_slice(int n, int worker_count, int worker_index, int* begin, int* end) {
+	int slice = (int)align_next((n + worker_count - 1) / worker_count, 8);
+	*begin = min(worker_index * slice, n);
+	*end = min(*begin + slice, n);
+}
+
+// Quads only depend on the projection, the camera and the top of the z & scissor stacks
+void particle_worker_prepare_frame(Draw_Frame* frame, Draw_Frame* target) {
+	draw_frame_clear_quads(frame);
+	frame->projection = target->projection;
+	frame->camera_xform = target->camera_xform;
+
+	frame->z_count = 0;
+	if (target->z_count > 0) frame->z_stack[frame->z_count++] = target->z_stack[target->z_count - 1];
+	frame->scissor_count = 0;
+	if (target->scissor_count > 0) frame->scissor_stack[frame->scissor_count++] = target->scissor_stack[target->scissor_count - 1];
+}
+
+void particle_worker_run(ParticleWorkerPool* pool, int worker_index) {
+	ParticleWorker* worker = &pool->workers[worker_index];
+	ParticleStore* store = pool->store;
+	int begin, end;
+
+	switch (pool->job) {
+		case PARTICLE_JOB_UPDATE: {
+			particle_worker_slice(store->count, pool->worker_count, worker_index, &begin, &end);
+			particle_store_integrate_range(store, begin, end, pool->dt);
+			for (int i = begin; i < end; i++) {
+				pool->dead[i] = particle_store_is_dead(store, i, pool->now, pool->window_size);
+			}
+		} break;
+		case PARTICLE_JOB_RENDER: {
+			particle_worker_prepare_frame(&worker->weather_frame, pool->target);
+			particle_worker_slice(weather_flake_count(), pool->worker_count, worker_index, &begin, &end);
+			worker->n_flakes_drawn = weather_render_range(pool->window_size, &worker->weather_frame, begin, end);
+
+			particle_worker_prepare_frame(&worker->particle_frame, pool->target);
+			particle_worker_slice(store->count, pool->worker_count, worker_index, &begin, &end);
+			particle_store_render_range(store, begin, end, pool->window_size, &worker->particle_frame);
+		} break;
+		default: break;
+	}
+}
+
+void particle_worker_thread(Thread* t) {
+	ParticleWorker* worker = (ParticleWorker*)t->data;
+	ParticleWorkerPool* pool = worker->pool;
+	while (true) {
+		os_binary_semaphore_wait(&worker->start_sem);
+		if (pool->job == PARTICLE_JOB_QUIT) break;
+		particle_worker_run(pool, worker->index);
+		os_binary_semaphore_signal(&worker->done_sem);
+	}
+}
+
+// Nothing is started here, the threads only exist once a job reaches parallel_threshold.
+// With the game's MAX_PARTICLE_COUNT that only happens for very heavy weather, so usually never.
+void particle_worker_pool_init(ParticleWorkerPool* pool, int thread_count, Allocator allocator) {
+	memset(pool, 0, sizeof(ParticleWorkerPool));
+	pool->allocator = allocator;
+	pool->worker_count = thread_count + 1;
+	pool->parallel_threshold = PARTICLE_PARALLEL_THRESHOLD;
+	pool->workers = alloc(allocator, pool->worker_count * sizeof(ParticleWorker));
+	memset(pool->workers, 0, pool->worker_count * sizeof(ParticleWorker));
+}
+
+void particle_worker_pool_start(ParticleWorkerPool* pool) {
+	for (int i = 0; i < pool->worker_count; i++) {
+		ParticleWorker* worker = &pool->workers[i];
+		worker->pool = pool;
+		worker->index = i;
+		draw_frame_init(&worker->weather_frame);
+		draw_frame_init(&worker->particle_frame);
+		if (i == 0) continue;
+
+		os_binary_semaphore_init(&worker->start_sem, false);
+		os_binary_semaphore_init(&worker->done_sem, false);
+		os_thread_init(&worker->thread, particle_worker_thread);
+		worker->thread.data = worker;
+		os_thread_start(&worker->thread);
+	}
+	pool->is_started = true;
+}
+
+void particle_worker_pool_deinit(ParticleWorkerPool* pool) {
+	pool->job = PARTICLE_JOB_QUIT;
+	for (int i = 0; pool->is_started && i < pool->worker_count; i++) {
+		ParticleWorker* worker = &pool->workers[i];
+		if (i > 0) {
+			os_binary_semaphore_signal(&worker->start_sem);
+			os_thread_join(&worker->thread);
+			os_thread_destroy(&worker->thread);
+			os_binary_semaphore_destroy(&worker->start_sem);
+			os_binary_semaphore_destroy(&worker->done_sem);
+		}
+		draw_frame_deinit(&worker->weather_frame);
+		draw_frame_deinit(&worker->particle_frame);
+	}
+	if (pool->dead) dealloc(pool->allocator, pool->dead);
+	dealloc(pool->allocator, pool->workers);
+	memset(pool, 0, sizeof(ParticleWorkerPool));
+}
+
+// The main thread does slice 0 and waits for the rest
+void particle_worker_pool_dispatch(ParticleWorkerPool* pool, ParticleJob job) {
+	if (!pool->is_started) particle_worker_pool_start(pool);
+	pool->job = job;
+	for (int i = 1; i < pool->worker_count; i++) {
+		os_binary_semaphore_signal(&pool->workers[i].start_sem);
+	}
+	particle_worker_run(pool, 0);
+	for (int i = 1; i < pool->worker_count; i++) {
+		os_binary_semaphore_wait(&pool->workers[i].done_sem);
+	}
+}
+
+// Same result as particle_store_update
+void particle_workers_update(ParticleWorkerPool* pool, ParticleStore* store, float64 now, float32 dt, Vector2 window_size) {
+	if (pool->worker_count <= 1 || store->count < pool->parallel_threshold) {
+		particle_store_update(store, now, dt, window_size);
+		return;
+	}
+
+	if (pool->dead_capacity < store->capacity) {
+		if (pool->dead) dealloc(pool->allocator, pool->dead);
+		pool->dead = alloc(pool->allocator, store->capacity * sizeof(bool));
+		pool->dead_capacity = store->capacity;
+	}
+	pool->store = store;
+	pool->now = now;
+	pool->dt = dt;
+	pool->window_size = window_size;
+	particle_worker_pool_dispatch(pool, PARTICLE_JOB_UPDATE);
+
+	// Backwards like particle_store_update, a particle swapped into slot i was already checked and is alive
+	for (int i = store->count - 1; i >= 0; i--) {
+		if (pool->dead[i]) particle_store_remove(store, i);
+	}
+}
+
+// Draws the weather and then the store into draw_frame, returns the number of flakes drawn
+int particle_workers_render(ParticleWorkerPool* pool, ParticleStore* store, Vector2 window_size, Draw_Frame* draw_frame) {
+	if (pool->worker_count <= 1 || max(store->count, weather_flake_count()) < pool->parallel_threshold) {
+		int n_flakes_drawn = weather_render(window_size, draw_frame);
+		particle_store_render_range(store, 0, store->count, window_size, draw_frame);
+		return n_flakes_drawn;
+	}
+
+	pool->store = store;
+	pool->window_size = window_size;
+	pool->target = draw_frame;
+	particle_worker_pool_dispatch(pool, PARTICLE_JOB_RENDER);
+
+	int n_flakes_drawn = 0;
+	for (int i = 0; i < pool->worker_count; i++) {
+		ParticleWorker* worker = &pool->workers[i];
+		draw_frame_append(draw_frame, &worker->weather_frame);
+		n_flakes_drawn += worker->n_flakes_drawn;
+	}
+	for (int i = 0; i < pool->worker_count; i++) {
+		ParticleWorker* worker = &pool->workers[i];
+		draw_frame_append(draw_frame, &worker->particle_frame);
+	}
+	return n_flakes_drawn;
+}
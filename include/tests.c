@@ -0,0 +1,62 @@
+// -----------------------------------------------------------------------
+// Game tests (run together with the engine tests when RUN_TESTS is set)
+// These run before the game loop starts, on an empty world.
+// -----------------------------------------------------------------------
+
+// Drops look at obstacle_column_mask, it has to follow obstacles being created and destroyed
+void test_obstacle_clearance() {
+	const int x = 3;
+	Entity* low = create_entity();
+	low->entitytype = ENTITY_OBSTACLE;
+	low->grid_position = v2(x, 1);
+	obstacle_grid_set(x, 1, low);
+	Entity* high = create_entity();
+	high->entitytype = ENTITY_OBSTACLE;
+	high->grid_position = v2(x, 4);
+	obstacle_grid_set(x, 4, high);
+
+	assert(!check_clearance_below(x, 6), "Drop above two obstacles should be blocked");
+	assert(check_clearance_below(x, 1), "Nothing below the lowest obstacle");
+
+	destroy_entity(low);
+	assert(!check_clearance_below(x, 6), "Drop should still be blocked by the higher obstacle");
+	assert(check_clearance_below(x, 4), "Drop should go through once the obstacle below is destroyed");
+
+	// Type changed after it was indexed, destroying it must still clear its cell
+	high->entitytype = ENTITY_NIL;
+	destroy_entity(high);
+	assert(check_clearance_below(x, 6), "Drop should go through once every obstacle below is destroyed");
+	assert(obstacle_column_mask[x] == 0 && obstacle_count == 0, "Obstacle index out of sync after destroying everything");
+
+	clean_world();
+}
+
+// A slot whose generation can't grow anymore is retired, old handles must not wrap around to a new entity
+void test_handle_generation_saturation() {
+	Entity* entity = create_entity();
+	int index = (int)(entity - world->entities);
+	world->entity_pool.generations[index] = HANDLE_MAX_GENERATION;
+	Handle handle = get_entity_handle(entity);
+	assert(HANDLE_INDEX(handle) == index && HANDLE_GENERATION(handle) == HANDLE_MAX_GENERATION, "Handle does not round trip");
+	assert(get_entity(handle) == entity, "Handle with the last generation should still resolve");
+
+	destroy_entity(entity);
+	assert(get_entity(handle) == NULL, "Handle should be stale after destroy_entity");
+	assert(world->entity_pool.retired_count == 1, "Saturated slot should be retired");
+	Entity* next = create_entity();
+	assert(next != entity, "Retired slot was handed out again");
+	destroy_entity(next);
+
+	// Nothing holds a handle anymore, give the retired slot back for the game
+	slot_pool_init(&world->entity_pool);
+}
+
+void run_game_tests() {
+	print("Testing handle generation saturation... ");
+	test_handle_generation_saturation();
+	print("OK!\n");
+
+	print("Testing obstacle clearance... ");
+	test_obstacle_clearance();
+	print("OK!\n");
+}
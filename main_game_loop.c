@@ -38,6 +38,9 @@ LightSource lights[MAX_LIGHTS];
 Draw_Frame* current_draw_frame = 0;
 float stage_times[100];
 bool occupied_grid[GRID_WIDTH][GRID_HEIGHT]; // Tracks occupied cells
+Handle obstacle_grid[GRID_WIDTH][GRID_HEIGHT]; // Obstacle entity in each cell, NULL_HANDLE if empty
+u32 obstacle_column_mask[GRID_WIDTH]; // Bit y is set while a live obstacle sits in cell (x, y)
+CollisionGrid collision_grid;
 float stage_timer;
 
 float charge_time_projectile;
@@ -52,6 +55,15 @@ Gfx_Font* font_bold = NULL;
 Gfx_Image* heart_sprite = NULL;
 Gfx_Image* effect_heart_sprite = NULL;
 Gfx_Image* background_sprite = NULL;
+
+// Decoded once at startup (load_sound_effects), played straight from memory
+Audio_Clip_Handle sfx_blop[4];
+Audio_Clip_Handle sfx_thud;
+Audio_Clip_Handle sfx_wall_thud;
+Audio_Clip_Handle sfx_impact_021;
+Audio_Clip_Handle sfx_impact_038;
+Audio_Clip_Handle sfx_button_click;
+Audio_Clip_Handle sfx_menu_button;
  
 bool debug_mode = false;
 bool game_over = false;
@@ -79,9 +91,11 @@ bool is_graphics_settings_active = false;
 //
 
 Vector2 mouse_position; // the current mouse position
-float64 delta_t; // The difference in time between frames
-float64 now;
-TimedEvent* color_switch_event = 0;
+float64 delta_t; // The fixed time step of the current simulation tick (SIMULATION_DT)
+float64 simulation_time; // Advances by delta_t every simulation tick, anything time dependent inside a tick reads this instead of the wall clock
+float64 now; // Wall clock of the current frame, only for rendering
+float64 render_alpha = 1.0; // How far rendering is between the previous and the current tick (0 - 1)
+Handle color_switch_event = NULL_HANDLE;
 Entity* mouse_entity = 0;
 Player* player = 0;
 World* world = 0; // Create an empty world to use for functions below
@@ -92,230 +106,491 @@ Gfx_Image* final_image = 0;
 // -----------------------------------------------------------------------
 //                  CREATE FUNCTIONS FOR ARRAY LOOKUP
 // -----------------------------------------------------------------------
-TimedEvent* create_timedevent(World* world) {
-	TimedEvent* timedevent_found = 0;
-	timedevent_found = alloc(get_heap_allocator(), sizeof(TimedEvent));
-	memset(timedevent_found, 0, sizeof(TimedEvent));
+void slot_pool_init(SlotPool* pool) {
+	// Pushed in reverse so slot 0 is handed out first
 	for (int i = 0; i < MAX_ENTITY_COUNT; i++) {
-		TimedEvent* existing_timedevent = &world->timedevents[i];
-		if (!existing_timedevent->is_valid) {
-			timedevent_found = existing_timedevent;
-			break;
+		pool->free_slots[i] = MAX_ENTITY_COUNT - 1 - i;
+		pool->generations[i] = 0;
+	}
+	pool->free_count = MAX_ENTITY_COUNT;
+	pool->retired_count = 0;
+}
+
+int slot_pool_acquire(SlotPool* pool) {
+	assert(pool->free_count > 0, "No more free slots!");
+	pool->free_count--;
+	return pool->free_slots[pool->free_count];
+}
+
+void slot_pool_release(SlotPool* pool, int index) {
+	pool->generations[index]++; // Every handle still pointing at this slot is now stale
+	if (pool->generations[index] > HANDLE_MAX_GENERATION) {
+		// No handle can hold this generation, so nothing resolves to the slot anymore. Never hand it out again instead of wrapping.
+		pool->retired_count++;
+		return;
+	}
+	pool->free_slots[pool->free_count] = index;
+	pool->free_count++;
+}
+
+Handle slot_pool_handle(SlotPool* pool, int index) {
+	return (pool->generations[index] << HANDLE_INDEX_BITS) | (u32)(index + 1);
+}
+
+// Returns the slot index the handle points to, or -1 if the handle is null or stale
+int slot_pool_resolve(SlotPool* pool, Handle handle) {
+	int index = HANDLE_INDEX(handle);
+	if (index < 0 || index >= MAX_ENTITY_COUNT) return -1;
+	if (pool->generations[index] != HANDLE_GENERATION(handle)) return -1;
+	return index;
+}
+
+// -----------------------------------------------------------------------
+//                         TIMER SCHEDULER
+// -----------------------------------------------------------------------
+
+void timer_scheduler_init(TimerScheduler* scheduler, TimedEvent* events, int capacity, Allocator allocator) {
+	memset(scheduler, 0, sizeof(TimerScheduler));
+	scheduler->events = events;
+	scheduler->capacity = capacity;
+	scheduler->allocator = allocator;
+	scheduler->heap   = alloc(allocator, capacity * sizeof(int));
+	scheduler->active = alloc(allocator, capacity * sizeof(int));
+	scheduler->fired  = alloc(allocator, capacity * sizeof(int));
+}
+
+void timer_scheduler_deinit(TimerScheduler* scheduler) {
+	dealloc(scheduler->allocator, scheduler->heap);
+	dealloc(scheduler->allocator, scheduler->active);
+	dealloc(scheduler->allocator, scheduler->fired);
+	memset(scheduler, 0, sizeof(TimerScheduler));
+}
+
+void timer_heap_swap(TimerScheduler* scheduler, int a, int b) {
+	int temp = scheduler->heap[a];
+	scheduler->heap[a] = scheduler->heap[b];
+	scheduler->heap[b] = temp;
+	scheduler->events[scheduler->heap[a]].heap_index = a;
+	scheduler->events[scheduler->heap[b]].heap_index = b;
+}
+
+bool timer_heap_less(TimerScheduler* scheduler, int a, int b) {
+	return scheduler->events[scheduler->heap[a]].expire_time < scheduler->events[scheduler->heap[b]].expire_time;
+}
+
+void timer_heap_sift_up(TimerScheduler* scheduler, int position) {
+	while (position > 0) {
+		int parent = (position - 1) / 2;
+		if (!timer_heap_less(scheduler, position, parent)) break;
+		timer_heap_swap(scheduler, position, parent);
+		position = parent;
+	}
+}
+
+void timer_heap_sift_down(TimerScheduler* scheduler, int position) {
+	while (true) {
+		int smallest = position;
+		int left = 2 * position + 1;
+		int right = left + 1;
+		if (left  < scheduler->heap_count && timer_heap_less(scheduler, left, smallest))  smallest = left;
+		if (right < scheduler->heap_count && timer_heap_less(scheduler, right, smallest)) smallest = right;
+		if (smallest == position) break;
+		timer_heap_swap(scheduler, position, smallest);
+		position = smallest;
+	}
+}
+
+void timer_heap_push(TimerScheduler* scheduler, int index) {
+	assert(scheduler->heap_count < scheduler->capacity, "Timer heap is full");
+	TimedEvent* timedevent = &scheduler->events[index];
+	timedevent->heap_index = scheduler->heap_count;
+	timedevent->is_scheduled = true;
+	scheduler->heap[scheduler->heap_count++] = index;
+	timer_heap_sift_up(scheduler, timedevent->heap_index);
+}
+
+void timer_heap_remove(TimerScheduler* scheduler, int position) {
+	int index = scheduler->heap[position];
+	int last = --scheduler->heap_count;
+	if (position != last) {
+		timer_heap_swap(scheduler, position, last);
+		timer_heap_sift_down(scheduler, position);
+		timer_heap_sift_up(scheduler, position);
+	}
+	scheduler->events[index].is_scheduled = false;
+	scheduler->events[index].heap_index = -1;
+}
+
+void timer_active_remove(TimerScheduler* scheduler, int position) {
+	int index = scheduler->active[position];
+	int last = --scheduler->active_count;
+	scheduler->active[position] = scheduler->active[last];
+	scheduler->events[scheduler->active[position]].active_index = position;
+	scheduler->events[index].is_active = false;
+	scheduler->events[index].active_index = -1;
+}
+
+void timer_mark_finished(TimerScheduler* scheduler, int index) {
+	if (scheduler->events[index].is_finished) return;
+	scheduler->events[index].is_finished = true;
+	scheduler->fired[scheduler->fired_count++] = index;
+}
+
+// Starts the interval, elapsed is how far into it the timer already is
+void timer_scheduler_add(TimerScheduler* scheduler, TimedEvent* timedevent, float elapsed) {
+	int index = (int)(timedevent - scheduler->events);
+	assert(index >= 0 && index < scheduler->capacity, "TimedEvent is not owned by this scheduler");
+	timedevent->start_time = scheduler->time - elapsed;
+	timedevent->expire_time = timedevent->start_time + timedevent->interval;
+	timer_heap_push(scheduler, index);
+}
+
+void timer_scheduler_remove(TimerScheduler* scheduler, TimedEvent* timedevent) {
+	if (timedevent->is_scheduled) timer_heap_remove(scheduler, timedevent->heap_index);
+	if (timedevent->is_active)    timer_active_remove(scheduler, timedevent->active_index);
+
+	if (timedevent->is_finished) {
+		int index = (int)(timedevent - scheduler->events);
+		for (int i = 0; i < scheduler->fired_count; i++) {
+			if (scheduler->fired[i] == index) {
+				scheduler->fired[i] = scheduler->fired[--scheduler->fired_count];
+				break;
+			}
+		}
+		timedevent->is_finished = false;
+	}
+}
+
+void timer_scheduler_set_interval(TimerScheduler* scheduler, TimedEvent* timedevent, float interval) {
+	timedevent->interval = interval;
+	if (timedevent->is_scheduled) {
+		timedevent->expire_time = timedevent->start_time + interval;
+		timer_heap_sift_down(scheduler, timedevent->heap_index);
+		timer_heap_sift_up(scheduler, timedevent->heap_index);
+	}
+}
+
+// Advances all timers by dt, paused games still report timers inside their duration as finished
+void timer_scheduler_tick(TimerScheduler* scheduler, float64 dt, bool advance) {
+	// Ready flags only live for one tick
+	for (int i = 0; i < scheduler->fired_count; i++) {
+		scheduler->events[scheduler->fired[i]].is_finished = false;
+	}
+	scheduler->fired_count = 0;
+
+	if (advance) {
+		scheduler->time += dt;
+
+		// Expired intervals either start their duration or fire right away
+		while (scheduler->heap_count > 0 && scheduler->events[scheduler->heap[0]].expire_time <= scheduler->time) {
+			int index = scheduler->heap[0];
+			TimedEvent* timedevent = &scheduler->events[index];
+			timer_heap_remove(scheduler, 0);
+
+			if (timedevent->duration > 0) {
+				timedevent->duration_timer = 0;
+				timedevent->is_active = true;
+				timedevent->active_index = scheduler->active_count;
+				scheduler->active[scheduler->active_count++] = index;
+			} else {
+				if (timedevent->counter != -1) timedevent->counter++;
+				timer_mark_finished(scheduler, index);
+			}
+		}
+
+		// Pushed back after the loop so a zero interval fires once per tick instead of forever
+		for (int i = 0; i < scheduler->fired_count; i++) {
+			TimedEvent* timedevent = &scheduler->events[scheduler->fired[i]];
+			timedevent->start_time = timedevent->expire_time;
+			timedevent->expire_time = timedevent->start_time + timedevent->interval;
+			timer_heap_push(scheduler, scheduler->fired[i]);
+		}
+	}
+
+	// Timers inside their duration are finished every tick until it runs out
+	for (int i = 0; i < scheduler->active_count;) {
+		int index = scheduler->active[i];
+		TimedEvent* timedevent = &scheduler->events[index];
+
+		if (!advance || timedevent->duration_timer < timedevent->duration) {
+			if (advance) timedevent->duration_timer += dt;
+			timer_mark_finished(scheduler, index);
+			i++;
+			continue;
 		}
+
+		// Duration is over, start the next interval from now
+		timer_active_remove(scheduler, i);
+		timedevent->duration_timer = 0;
+		if (timedevent->counter != -1) timedevent->counter++;
+		timer_mark_finished(scheduler, index);
+		timer_scheduler_add(scheduler, timedevent, 0);
 	}
-	assert(timedevent_found, "No more free timedevent slots!");
+}
+
+// Time spent in the current interval
+float timer_scheduler_interval_timer(TimerScheduler* scheduler, TimedEvent* timedevent) {
+	if (timedevent->is_active) return timedevent->interval;
+	if (!timedevent->is_scheduled) return 0;
+	return (float)(scheduler->time - timedevent->start_time);
+}
+
+// Progress of the current interval (0 - 1)
+float timer_scheduler_progress(TimerScheduler* scheduler, TimedEvent* timedevent) {
+	if (timedevent->interval <= 0) return timedevent->is_active ? 1.0f : 0.0f;
+	float progress = timer_scheduler_interval_timer(scheduler, timedevent) / timedevent->interval;
+	return fminf(fmaxf(progress, 0.0f), 1.0f);
+}
+
+void initialize_world_pools(World* world) {
+	slot_pool_init(&world->entity_pool);
+	slot_pool_init(&world->timedevent_pool);
+	slot_pool_init(&world->effect_pool);
+	timer_scheduler_init(&world->timer_scheduler, world->timedevents, MAX_ENTITY_COUNT, get_heap_allocator());
+}
+
+TimedEvent* create_timedevent(World* world) {
+	int index = slot_pool_acquire(&world->timedevent_pool);
+	TimedEvent* timedevent_found = &world->timedevents[index];
+	memset(timedevent_found, 0, sizeof(TimedEvent));
 	timedevent_found->is_valid = true;
 	return timedevent_found;
 }
 
 void destroy_timedevent(TimedEvent* timedevent) {
+	if (timedevent == NULL || !timedevent->is_valid) return;
+	timer_scheduler_remove(&world->timer_scheduler, timedevent);
 	memset(timedevent, 0, sizeof(TimedEvent));
+	slot_pool_release(&world->timedevent_pool, (int)(timedevent - world->timedevents));
+}
+
+TimedEvent* get_timedevent(Handle handle) {
+	int index = slot_pool_resolve(&world->timedevent_pool, handle);
+	return (index < 0) ? NULL : &world->timedevents[index];
+}
+
+Handle get_timedevent_handle(TimedEvent* timedevent) {
+	return slot_pool_handle(&world->timedevent_pool, (int)(timedevent - world->timedevents));
 }
 
 Entity* create_entity() {
-	Entity* entity_found = 0;
-	entity_found = alloc(get_heap_allocator(), sizeof(Entity));
+	int index = slot_pool_acquire(&world->entity_pool);
+	Entity* entity_found = &world->entities[index];
 	memset(entity_found, 0, sizeof(Entity));
-	for (int i = 0; i < MAX_ENTITY_COUNT; i++) {
-		Entity* existing_entity = &world->entities[i];
-		if (!existing_entity->is_valid) {
-			entity_found = existing_entity;
-			break;
-		}
-	}
-	assert(entity_found, "No more free entities!");
 	entity_found->is_valid = true;
+
+	// Not linked into the collision grid until the next rebuild, find_projectile_collision checks these on the side
+	if (!collision_grid.is_spawned[index]) {
+		collision_grid.is_spawned[index] = true;
+		collision_grid.spawned[collision_grid.spawned_count] = index;
+		collision_grid.spawned_count++;
+	}
 	return entity_found;
 }
 
+Entity* get_entity(Handle handle) {
+	int index = slot_pool_resolve(&world->entity_pool, handle);
+	return (index < 0) ? NULL : &world->entities[index];
+}
+
+Handle get_entity_handle(Entity* entity) {
+	return slot_pool_handle(&world->entity_pool, (int)(entity - world->entities));
+}
+
+// Where the entity should be drawn this frame, between its last two simulated positions
+Vector2 get_render_position(Entity* entity) {
+	if (!entity->has_previous_position) return entity->position; // Spawned during the last tick
+	return v2_lerp(entity->previous_position, entity->position, (float)render_alpha);
+}
+
+void obstacle_grid_set(int x, int y, Entity* obstacle) {
+	assert(obstacle_grid[x][y] == NULL_HANDLE, "Obstacle grid cell (%d, %d) is already taken", x, y);
+	occupied_grid[x][y] = true;
+	obstacle_grid[x][y] = get_entity_handle(obstacle);
+	obstacle_column_mask[x] |= (1u << y);
+	obstacle_count++;
+}
+
+Entity* obstacle_grid_get(int x, int y) {
+	return get_entity(obstacle_grid[x][y]);
+}
+
+// Cells stay occupied until the world is cleaned, only the index entry is dropped.
+// Does nothing unless this entity is the one indexed at its grid_position, so it's safe to call for any entity.
+void obstacle_grid_remove(Entity* obstacle) {
+	int x = obstacle->grid_position.x;
+	int y = obstacle->grid_position.y;
+	if (x < 0 || x >= GRID_WIDTH || y < 0 || y >= GRID_HEIGHT) return;
+	if (obstacle_grid[x][y] == NULL_HANDLE || obstacle_grid[x][y] != get_entity_handle(obstacle)) return;
+
+	obstacle_grid[x][y] = NULL_HANDLE;
+	obstacle_column_mask[x] &= ~(1u << y);
+	obstacle_count--;
+}
+
 void destroy_entity(Entity* entity) {
-	if (entity->timer != NULL)        destroy_timedevent(entity->timer);
-	if (entity->second_timer != NULL) destroy_timedevent(entity->second_timer);
-	if (entity->third_timer != NULL)  destroy_timedevent(entity->third_timer);
-	if (entity->child != NULL)        destroy_entity(entity->child);
+	if (entity == NULL || !entity->is_valid) return; // Already destroyed, the slot is back on the free list
+
+	obstacle_grid_remove(entity); // Not only for ENTITY_OBSTACLE, in case the type was changed after it was indexed
+
+	Entity* child = get_entity(entity->child);
+	destroy_timedevent(get_timedevent(entity->timer));
+	destroy_timedevent(get_timedevent(entity->second_timer));
+	destroy_timedevent(get_timedevent(entity->third_timer));
+
 	memset(entity, 0, sizeof(Entity));
+	slot_pool_release(&world->entity_pool, (int)(entity - world->entities));
+
+	destroy_entity(child);
 }
 
 Effect* create_effect() {
-	Effect* effect_found = 0;
-	effect_found = alloc(get_heap_allocator(), sizeof(Effect));
+	int index = slot_pool_acquire(&world->effect_pool);
+	Effect* effect_found = &world->effects[index];
 	memset(effect_found, 0, sizeof(Effect));
-
-	for (int i = 0; i < MAX_ENTITY_COUNT; i++) {
-		Effect* existing_effect = &world->effects[i];
-		if (!existing_effect->is_valid) {
-			effect_found = existing_effect;
-			break;
-		}
-	}
-	assert(effect_found, "No more free effect slots!");
 	effect_found->is_valid = true;
-
-	TimedEvent* timer = 0;
-	timer->is_valid = true;
-	effect_found->timer = timer;
-	
 	return effect_found;
 }
 
 void destroy_effect(Effect* effect) {
+	if (effect == NULL || !effect->is_valid) return;
 	memset(effect, 0, sizeof(Effect));
+	slot_pool_release(&world->effect_pool, (int)(effect - world->effects));
 }
 
 // -----------------------------------------------------------------------
 //                         TIMER FUNCTIONS
 // -----------------------------------------------------------------------
 
+// Set by timer_scheduler_tick() once per simulation tick, polling does not advance the timer
 bool timer_finished(TimedEvent* timed_event) {
-	// Progress calculation
-	timed_event->progress = timed_event->interval_timer / timed_event->interval;
-
-	// Ensure progress is clamped between 0 and 1
-	timed_event->progress = fminf(fmaxf(timed_event->progress, 0.0f), 1.0f);
-
-	// Check if the timer has exceeded the switch interval
-	if (timed_event->interval_timer >= timed_event->interval) {
-
-		if (timed_event->duration_timer < timed_event->duration)
-		{
-			if (!is_game_paused && is_game_running) timed_event->duration_timer += delta_t;
-			return true;
-		}
-		else if (timed_event->duration_timer > timed_event->duration)
-		{
-			timed_event->duration_timer = 0;
-		}
-		
-		timed_event->interval_timer -= timed_event->interval; // Reset the timer
+	if (timed_event == NULL) return false; // Stale or null handle
+	return timed_event->is_finished;
+}
 
-		if (timed_event->counter != -1) timed_event->counter++; 
-		
-		return true;
-	}
-	else
-	{
-		// Update the timer with the elapsed time
-    	if (!is_game_paused && is_game_running) timed_event->interval_timer += delta_t;
-	}
+float timer_progress(TimedEvent* timed_event) {
+	return timer_scheduler_progress(&world->timer_scheduler, timed_event);
+}
 
-	return false;
+void set_timer_interval(TimedEvent* timed_event, float interval) {
+	timer_scheduler_set_interval(&world->timer_scheduler, timed_event, interval);
 }
 
-TimedEvent* initialize_color_switch_event() {
+Handle initialize_color_switch_event() {
 	TimedEvent* te = create_timedevent(world);
 
 	te->type = TIMED_EVENT_COLOR_SWITCH;
 	te->worldtype = TIMED_EVENT_TYPE_WORLD;
 	te->interval = 4.0f;
-	te->interval_timer = 0.0f;
 	te->duration = 0.0f;
-	te->progress = 0.0f;
 	te->counter = 0;
 
-	return te;
+	timer_scheduler_add(&world->timer_scheduler, te, 0.0f);
+
+	return get_timedevent_handle(te);
 }
 
-TimedEvent* initialize_drop_event() {
+Handle initialize_drop_event() {
 	TimedEvent* te = create_timedevent(world);
 
 	te->type = TIMED_EVENT_DROP;
 	te->worldtype = TIMED_EVENT_TYPE_ENTITY;
 	te->interval = 10.0f;
-	te->interval_timer = get_random_float32_in_range(0, 0.5*te->interval);
 	te->duration = 10.0f;
-	te->progress = 0.0f;
 	te->counter = 0;
 
-	return te;
+	timer_scheduler_add(&world->timer_scheduler, te, get_random_float32_in_range(0, 0.5*te->interval));
+
+	return get_timedevent_handle(te);
 }
 
-TimedEvent* initialize_beam_event() {
+Handle initialize_beam_event() {
 	TimedEvent* te = create_timedevent(world);
 
 	te->type = TIMED_EVENT_BEAM;
 	te->worldtype = TIMED_EVENT_TYPE_ENTITY;
 	te->interval = 10.0f;
-	te->interval_timer = get_random_float32_in_range(0, 0.5*te->interval);
 	te->duration = 2.0f;
-	te->progress = 0.0f;
 	te->counter = 0;
 
-	return te;
+	timer_scheduler_add(&world->timer_scheduler, te, get_random_float32_in_range(0, 0.5*te->interval));
+
+	return get_timedevent_handle(te);
 }
 
-TimedEvent* initialize_effect_event(float interval) {
+Handle initialize_effect_event(float interval) {
 	TimedEvent* te = create_timedevent(world);
 
     te->type = TIMED_EVENT_EFFECT;
     te->worldtype = TIMED_EVENT_TYPE_ENTITY;
     te->interval = interval; // Interval for new random values
-    te->interval_timer = 0.0f;
     te->duration = 0.0f;
     te->duration_timer = 0.0f;
-    te->progress = 0.0f;
     te->counter = -1;
 
-    return te;
+    timer_scheduler_add(&world->timer_scheduler, te, 0.0f);
+
+    return get_timedevent_handle(te);
 }
 
-TimedEvent* initialize_boss_movement_event(float interval) {
+Handle initialize_boss_movement_event(float interval) {
 	TimedEvent* te = create_timedevent(world);
 
     te->type = TIMED_EVENT_BOSS_MOVEMENT;
     te->worldtype = TIMED_EVENT_TYPE_ENTITY;
     te->interval = interval; // Interval for new random values
-    te->interval_timer = 0.0f;
     te->duration = 0.0f;
     te->duration_timer = 0.0f;
-    te->progress = 0.0f;
     te->counter = -1;
 
-    return te;
+    timer_scheduler_add(&world->timer_scheduler, te, 0.0f);
+
+    return get_timedevent_handle(te);
 }
 
-TimedEvent* initialize_boss_attack_event(float interval) {
+Handle initialize_boss_attack_event(float interval) {
 	TimedEvent* te = create_timedevent(world);
 
     te->type = TIMED_EVENT_BOSS_ATTACK;
     te->worldtype = TIMED_EVENT_TYPE_ENTITY;
     te->interval = interval; // Interval for new random values
-    te->interval_timer = 0.0f;
     te->duration = 0.0f;
     te->duration_timer = 0.0f;
-    te->progress = 0.0f;
     te->counter = -1;
 
-    return te;
+    timer_scheduler_add(&world->timer_scheduler, te, 0.0f);
+
+    return get_timedevent_handle(te);
 }
 
-TimedEvent* initialize_boss_next_stage_event(float interval) {
+Handle initialize_boss_next_stage_event(float interval) {
 	TimedEvent* te = create_timedevent(world);
 
     te->type = TIMED_EVENT_BOSS_NEXT_STAGE;
     te->worldtype = TIMED_EVENT_TYPE_ENTITY;
     te->interval = interval; // Interval for new random values
-    te->interval_timer = 0.0f;
     te->duration = 0.0f;
     te->duration_timer = 0.0f;
-    te->progress = 0.0f;
     te->counter = 0;
 
-    return te;
+    timer_scheduler_add(&world->timer_scheduler, te, 0.0f);
+
+    return get_timedevent_handle(te);
 }
 
-TimedEvent* initialize_rolling_text_event(float interval) {
+Handle initialize_rolling_text_event(float interval) {
 	TimedEvent* te = create_timedevent(world);
 
     te->type = TIMED_EVENT_ROLLING_TEXT;
     te->worldtype = TIMED_EVENT_TYPE_WORLD;
     te->interval = interval; // Interval for new random values
-    te->interval_timer = 0.0f;
     te->duration = 0.0f;
     te->duration_timer = 0.0f;
-    te->progress = 0.0f;
     te->counter = 0;
 
-    return te;
+    timer_scheduler_add(&world->timer_scheduler, te, 0.0f);
+
+    return get_timedevent_handle(te);
 }
 
 // -----------------------------------------------------------------------
@@ -351,259 +626,86 @@ void create_circular_light_source(Vector2 position, Vector4 color, float intensi
 }
 
 int number_of_certain_particle(ParticleKind kind) {
-	int n = 0;
-	for (int i = 0; i < ARRAY_COUNT(particles); i++) {
-		Particle* p = &particles[i];
-		if (p->kind == kind) {
-			n++;
-		}
-	}
-	return n;
+	if (is_weather_kind(kind)) return weather.layers[kind].flake_count;
+	return particles.kind_count[kind];
 }
 
 void remove_all_particles() {
-	for (int i = 0; i < ARRAY_COUNT(particles); i++) {
-		Particle* p = &particles[i];
-		particle_clear(p);
-	}
+	particle_store_clear(&particles);
+	weather_clear_all();
 }
 
 void remove_all_particle_type(ParticleKind kind) {
-	for (int i = 0; i < ARRAY_COUNT(particles); i++) {
-		Particle* p = &particles[i];
-		if (p->kind == kind) {
-			particle_clear(p);
-		}
+	if (is_weather_kind(kind)) {
+		weather_clear(kind);
+		return;
 	}
+	particle_store_remove_kind(&particles, kind);
 }
 
 void particle_update() {
-	for (int i = 0; i < ARRAY_COUNT(particles); i++) {
-		Particle* p = &particles[i];
-		if (!(p->flags & PARTICLE_FLAGS_valid)) {
-			continue;
-		}
-
-		if (p->end_time && has_reached_end_time(os_get_elapsed_seconds(), p->end_time)) {
-			particle_clear(p);
-			continue;
-		}
-
-		if (p->flags & PARTICLE_FLAGS_fade_out_with_velocity && v2_length(p->velocity) < 0.01) {
-			particle_clear(p);
-		}
-
-		if (p->flags & PARTICLE_FLAGS_gravity) {
-			Vector2 gravity = v2(0, -40.2f);
-			if (p->identifier == 0) {
-				p->acceleration = gravity;
-			}
-			else
-			{
-				p->acceleration = v2_mulf(gravity, p->identifier);
-			}
-		}
-
-		if (p->flags & PARTICLE_FLAGS_physics) {
-			if (p->flags & PARTICLE_FLAGS_friction) {
-				p->acceleration = v2_sub(p->acceleration, v2_mulf(p->velocity, p->friction));
-			}
-			p->velocity = v2_add(p->velocity, v2_mulf(p->acceleration, delta_t));
-			Vector2 next_pos = v2_add(p->pos, v2_mulf(p->velocity, delta_t));
-			p->acceleration = (Vector2){0};
-			p->pos = next_pos;
-		}
-	}
+	particle_workers_update(&particle_workers, &particles, simulation_time, delta_t, v2(window.width, window.height));
+	weather_advance(delta_t);
 }
 
 int particle_render() {
-	number_of_particles = 0;
-	for (int i = 0; i < ARRAY_COUNT(particles); i++) {
-		Particle* p = &particles[i];
-		if (!(p->flags & PARTICLE_FLAGS_valid)) {
-			continue;
-		}
-		number_of_particles++;
-
-		Vector2 window_size = v2(window.width, window.height);
-		if (is_position_outside_walls_and_bottom(p->pos, window_size)) {
-			if (p->immortal) 
-				{	
-					if (p->kind == PFX_WIND) 
-					{
-						if (p->pos.x < -window.width / 2) 
-						{
-							p->pos = v2(window.width / 2, get_random_float32_in_range(-window.height / 2, window.height / 2));
-							p->velocity = v2(get_random_float32_in_range(-30, -10), get_random_float32_in_range(-5, 5));
-						}
-					}
-					else 
-					{
-						p->velocity = v2(get_random_float32_in_range(-10, 10), p->identifier * -20);
-						p->pos = v2(get_random_float32_in_range(-window.width / 2, window.width / 2), get_random_float32_in_range(window.height / 2, 3 * window.height));
-					}
-				}
-
-			else
-			{
-				particle_clear(p);
-				continue;
-			}
-		} else if (is_position_outside_bounds(p->pos, window_size)) {
-			continue;
-		}
-
-
-		Vector4 col = p->col;
-		if (p->flags & PARTICLE_FLAGS_fade_out_with_velocity) {
-			col.a *= float_alpha(fabsf(v2_length(p->velocity)), 0, p->fade_out_vel_range);
-		}
-
-		draw_centered_in_frame_rect(p->pos, p->size, col, current_draw_frame);
-	}
+	number_of_particles = particles.count + particle_workers_render(&particle_workers, &particles, v2(window.width, window.height), current_draw_frame);
 	return number_of_particles;
 }
 
 void particle_emit(Vector2 pos, Vector4 color, int n_particles, ParticleKind kind) {
+	if (is_weather_kind(kind)) {
+		weather_add_flakes(kind, n_particles);
+		return;
+	}
+
+	float64 now = simulation_time;
 	switch (kind) {
 		case PFX_BOUNCE: {
 			for (int i = 0; i < n_particles; i++) {
-				Particle* p = particle_new();
-				p->kind = PFX_BOUNCE;
-				p->flags |= PARTICLE_FLAGS_physics | PARTICLE_FLAGS_friction | PARTICLE_FLAGS_fade_out_with_velocity;
-				p->pos = pos;
-				p->col = color;
-				p->velocity = v2_normalize(v2(get_random_float32_in_range(-1, 1), get_random_float32_in_range(-1, 1)));
-				p->velocity = v2_mulf(p->velocity, get_random_float32_in_range(200, 200));
-				p->friction = 20.0f;
-				p->fade_out_vel_range = 30.0f;
-				p->size = v2(1, 1);
+				int p = particle_new(PFX_BOUNCE);
+				if (p < 0) break;
+				particles.flags[p] |= PARTICLE_FLAGS_physics | PARTICLE_FLAGS_friction | PARTICLE_FLAGS_fade_out_with_velocity;
+				particle_set_position(p, pos);
+				particles.col[p] = color;
+				particle_set_velocity(p, v2_normalize(v2(get_random_float32_in_range(-1, 1), get_random_float32_in_range(-1, 1))));
+				particle_set_velocity(p, v2_mulf(particle_velocity(p), get_random_float32_in_range(200, 200)));
+				particles.friction[p] = 20.0f;
+				particles.fade_out_vel_range[p] = 30.0f;
+				particles.size[p] = v2(1, 1);
 			}
 		} break;
 		case PFX_EFFECT: {
 			for (int i = 0; i < n_particles; i++) {
-				Particle* p = particle_new();
-				p->kind = PFX_EFFECT;
-				p->flags |= PARTICLE_FLAGS_physics | PARTICLE_FLAGS_friction | PARTICLE_FLAGS_fade_out_with_velocity | PARTICLE_FLAGS_gravity;
-				p->pos = v2(pos.x + get_random_int_in_range(-10, 10), pos.y + get_random_int_in_range(-10, 10));
-				p->col = color;
-				p->velocity = v2_normalize(v2(get_random_float32_in_range(-1, 1), get_random_float32_in_range(-1, 1)));
-				p->velocity = v2_mulf(p->velocity, get_random_float32_in_range(100, 200));
-				p->friction = get_random_float32_in_range(30.0f, 30.0f);
-				p->fade_out_vel_range = 20.0f;
-				p->end_time = os_get_elapsed_seconds() + get_random_float32_in_range(1.0f, 2.0f);
-				p->size = v2(4, 4);
+				int p = particle_new(PFX_EFFECT);
+				if (p < 0) break;
+				particles.flags[p] |= PARTICLE_FLAGS_physics | PARTICLE_FLAGS_friction | PARTICLE_FLAGS_fade_out_with_velocity | PARTICLE_FLAGS_gravity;
+				particle_set_position(p, v2(pos.x + get_random_int_in_range(-10, 10), pos.y + get_random_int_in_range(-10, 10)));
+				particles.col[p] = color;
+				particle_set_velocity(p, v2_normalize(v2(get_random_float32_in_range(-1, 1), get_random_float32_in_range(-1, 1))));
+				particle_set_velocity(p, v2_mulf(particle_velocity(p), get_random_float32_in_range(100, 200)));
+				particles.friction[p] = get_random_float32_in_range(30.0f, 30.0f);
+				particles.fade_out_vel_range[p] = 20.0f;
+				particles.end_time[p] = now + get_random_float32_in_range(1.0f, 2.0f);
+				particles.size[p] = v2(4, 4);
+				particle_set_gravity(p);
 			}
 		} break;
 		case PFX_HARD_OBSTACLE: {
 			for (int i = 0; i < n_particles; i++) {
-				Particle* p = particle_new();
-				p->kind = PFX_HARD_OBSTACLE;
-				p->flags |= PARTICLE_FLAGS_physics | PARTICLE_FLAGS_friction | PARTICLE_FLAGS_fade_out_with_velocity;
-				p->pos = pos;
-				p->col = color;
-				p->velocity = v2_normalize(v2(get_random_float32_in_range(-1, 1), get_random_float32_in_range(-1, 1)));
-				p->velocity = v2_mulf(p->velocity, get_random_float32_in_range(100, 200));
-				p->friction = get_random_float32_in_range(30.0f, 30.0f);
-				p->fade_out_vel_range = 30.0f;
-				p->end_time = os_get_elapsed_seconds() + get_random_float32_in_range(1.0f, 2.0f);
-				p->size = v2(3, 3);
-			}
-		} break;
-		case PFX_ASH: {
-			for (int i = 0; i < n_particles; i++) {
-				Particle* p = particle_new();
-				p->kind = PFX_ASH;
-				float z = get_random_float32_in_range(0, 20);
-				float a = float_alpha(z, 0, 20);
-
-				// Ge partikeln fysikegenskaper och rotation
-				p->flags |= PARTICLE_FLAGS_physics | PARTICLE_FLAGS_gravity;
-				
-				// Placering och initial hastighet
-				p->pos = v2(get_random_float32_in_range(-window.width / 2, window.width / 2), get_random_float32_in_range(window.height / 2, 3*window.height));
-				p->col = v4(0.5, 0.3, 0.1, 1.0);  // Mörka askliknande färger
-				p->velocity = v2(get_random_float32_in_range(-5, 5), a * -10); // Långsammare fall
-				p->size = v2_mulf(v2(1, 1), a * 2);  // Mindre storlek än snö
-				p->immortal = true;
-				p->identifier = a;
-			}
-		} break;
-		case PFX_LEAF: {
-			for (int i = 0; i < n_particles; i++) {
-				Particle* p = particle_new();
-				p->kind = PFX_LEAF;
-				float z = get_random_float32_in_range(0, 20);
-				float a = float_alpha(z, 0, 20);
-
-				// Ge partikeln fysikegenskaper och gravitation
-				p->flags |= PARTICLE_FLAGS_physics | PARTICLE_FLAGS_gravity;
-				
-				// Placering och initial hastighet
-				p->pos = v2(get_random_float32_in_range(-window.width / 2, window.width / 2), get_random_float32_in_range(window.height / 2, 3*window.height));
-				p->col = v4(0.1 + (rand() / (float)RAND_MAX) * (0.3 - 0.1), 0.5 + (rand() / (float)RAND_MAX) * (0.8 - 0.5), 0.1 + (rand() / (float)RAND_MAX) * (0.2 - 0.1), 1.0);
-				p->velocity = v2(get_random_float32_in_range(-10, 10), a * -15);  // Långsamt fallande
-				p->size = v2_mulf(v2(2, 2), a * 3);  // Större, oregelbunden storlek
-				p->immortal = true;
-				p->identifier = a;
-			}
-		} break;
-		case PFX_RAIN: {
-			for (int i = 0; i < n_particles; i++) {
-				Particle* p = particle_new();
-				p->kind = PFX_RAIN;
-				float z = get_random_float32_in_range(0, 20);
-				float a = float_alpha(z, 0, 20);
-
-				// Ge partikeln fysik och gravitation, men ingen rotation
-				p->flags |= PARTICLE_FLAGS_physics | PARTICLE_FLAGS_gravity;
-				
-				// Placering och initial hastighet
-				p->pos = v2(get_random_float32_in_range(-window.width / 2, window.width / 2), get_random_float32_in_range(window.height / 2, 3*window.height));
-				p->col = v4(0.3, 0.3, 1.0, 0.5);  // Blå genomskinliga droppar
-				p->velocity = v2(0, a * -300);  // Snabbare fall för regn
-				p->size = v2_mulf(v2(0.5, 4), a * 4);  // Smala, långa droppar
-				p->immortal = true;
-				p->identifier = a;
-			}
-		} break;
-
-		case PFX_WIND: { 			//DENNA ÄR RIKTIGT FUL...
-			for (int i = 0; i < n_particles; i++) {
-				Particle* p = particle_new();
-				p->kind = PFX_WIND;
-
-				// Generera ett slumptal för avstånd från höger sidan
-				float z = get_random_float32_in_range(0, 20);
-				float a = float_alpha(z, 0, 20);
-				
-				// Ge partikeln fysikegenskaper
-				p->flags |= PARTICLE_FLAGS_physics; // Ingen gravitation för vind
-				p->pos = v2(window.width / 2, get_random_float32_in_range(-window.height / 2, window.height / 2)); // Starta från höger sida
-				p->col = v4(0.7, 0.7, 1.0, 0.01); // Ljusblå färg för vinda
-				p->velocity = v2(-50 * a, get_random_float32_in_range(-5, 5)); // Blåser åt vänster med mindre vertikal rörelse för mer stabilitet
-				p->size = v2_mulf(v2(10, 1), a * 2); // Längre partikelstorlek för vind, med varierande storlek
-				p->immortal = true; // Partiklarna ska finnas kvar
-				p->identifier = a; // Identifiera partikeln
-			}
-		} break;
-		case PFX_SNOW: {
-			for (int i = 0; i < n_particles; i++) {
-				Particle* p = particle_new();
-				p->kind = PFX_SNOW;
-				float z = get_random_float32_in_range(0, 20);
-				float a = float_alpha(z, 0, 20);
-				
-				p->flags |= PARTICLE_FLAGS_physics | PARTICLE_FLAGS_gravity;
-				p->pos = v2(get_random_float32_in_range(-window.width / 2, window.width / 2), get_random_float32_in_range(window.height / 2, 3*window.height));
-				p->col = v4(1.0, 1.0, 1.0, 1.0);
-				p->velocity = v2(get_random_float32_in_range(-10, 10), a*-20);
-				p->size = v2_mulf(v2(1, 1), a*3);
-				p->immortal = true;
-				p->identifier = a;
+				int p = particle_new(PFX_HARD_OBSTACLE);
+				if (p < 0) break;
+				particles.flags[p] |= PARTICLE_FLAGS_physics | PARTICLE_FLAGS_friction | PARTICLE_FLAGS_fade_out_with_velocity;
+				particle_set_position(p, pos);
+				particles.col[p] = color;
+				particle_set_velocity(p, v2_normalize(v2(get_random_float32_in_range(-1, 1), get_random_float32_in_range(-1, 1))));
+				particle_set_velocity(p, v2_mulf(particle_velocity(p), get_random_float32_in_range(100, 200)));
+				particles.friction[p] = get_random_float32_in_range(30.0f, 30.0f);
+				particles.fade_out_vel_range[p] = 30.0f;
+				particles.end_time[p] = now + get_random_float32_in_range(1.0f, 2.0f);
+				particles.size[p] = v2(3, 3);
 			}
 		} break;
-
 		default: { log("Something went wrong with particle generation"); } break;
 	}
 }
@@ -733,8 +835,7 @@ void summon_projectile_drop_boss_stage_30(Entity* entity, Vector2 spawn_pos) {
 }
 
 void setup_beam(Entity* beam_obstacle, Entity* beam) {
-	TimedEvent* timed_event = initialize_beam_event();
-	beam->timer = timed_event;
+	beam->timer = initialize_beam_event();
 	beam->color = v4(1, 0, 0, 0.7);
 
 	float beam_height = beam_obstacle->size.y + window.height;
@@ -821,8 +922,8 @@ void setup_boss_stage_20(Entity* entity) {
 
 	// Beam Functionality of the boss
 	Entity* beam = create_entity();
-	entity->child = beam;
-	entity->child->timer = initialize_beam_event(); // Boss attack event
+	beam->timer = initialize_beam_event(); // Boss attack event
+	entity->child = get_entity_handle(beam);
 }
 
 void setup_boss_stage_30(Entity* entity) {
@@ -857,6 +958,7 @@ void setup_block_obstacle(Entity* entity, int x, int y) {
     entity->obstacle_type = OBSTACLE_BLOCK;
     entity->health = 9999;
     entity->size = v2(30, 30);
+    entity->color = rgba(30, 30, 30, 255);
 
     // Define Tetris block matrices as statically allocated arrays
     int I_block[1][4] = { { 1, 1, 1, 1 } };  // 1x4
@@ -928,21 +1030,23 @@ void setup_block_obstacle(Entity* entity, int x, int y) {
                     continue; // Skip if out of bounds or already occupied
                 }
 
-				// Mark the grid cell as occupied
-                occupied_grid[grid_x][grid_y] = true;
-
                 Entity* block_entity;
                 if (i == 0 && j == 0) {
-                    // First block is the main entity itself
+                    // First block is the main entity itself, setup_obstacle() indexes it at its own cell
                     block_entity = entity;
+                    occupied_grid[grid_x][grid_y] = true;
                 } else {
                     block_entity = create_entity();
+                    block_entity->grid_position = v2(grid_x, grid_y);
+                    obstacle_grid_set(grid_x, grid_y, block_entity);
+                    number_of_block_obstacles++;
                 }
 
 				block_entity->entitytype = ENTITY_OBSTACLE;
                 block_entity->obstacle_type = OBSTACLE_BLOCK;
                 block_entity->health = 9999;
                 block_entity->size = v2(30, 30);
+                block_entity->color = rgba(30, 30, 30, 255);
                 block_entity->matrix_position = v2(i, j);
 
                 // Position based on the matrix (adjust 40 units for space between blocks)
@@ -951,7 +1055,7 @@ void setup_block_obstacle(Entity* entity, int x, int y) {
 
                 if (previous_chain != entity || (i != 0 && j != 0)) {
                     // Chain the previous entity to the new one
-                    previous_chain->child = block_entity;
+                    previous_chain->child = get_entity_handle(block_entity);
                     previous_chain = block_entity;
                 }
             }
@@ -1009,7 +1113,7 @@ void setup_obstacle(Entity* entity, int x_index, int y_index) {
 
 		Entity* beam = create_entity();
 		setup_beam(entity, beam);
-		entity->child = beam;
+		entity->child = get_entity_handle(beam);
 	}
 	else if(random_value <= SPAWN_RATE_BEAM_OBSTACLE + SPAWN_RATE_INVERTED_BEAM_OBSTACLE + SPAWN_RATE_DROP_OBSTACLE + SPAWN_RATE_HARD_OBSTACLE + SPAWN_RATE_BLOCK_OBSTACLE) {
         entity->obstacle_type = OBSTACLE_BEAM;
@@ -1020,7 +1124,7 @@ void setup_obstacle(Entity* entity, int x_index, int y_index) {
 
 		Entity* beam = create_entity();
 		setup_beam(entity, beam);
-		entity->child = beam;
+		entity->child = get_entity_handle(beam);
     }
 	else 
 	{
@@ -1031,12 +1135,7 @@ void setup_obstacle(Entity* entity, int x_index, int y_index) {
 	}
 
 	// Mark the grid cell as occupied
-    occupied_grid[x_index][y_index] = true;
-
-	world->obstacle_list[obstacle_count].obstacle = entity;
-	world->obstacle_list[obstacle_count].x = x_index;
-	world->obstacle_list[obstacle_count].y = y_index;
-	obstacle_count++;
+	obstacle_grid_set(x_index, y_index, entity);
 }
 
 void setup_effect_entity(Entity* entity, Entity* obstacle) {
@@ -1058,7 +1157,9 @@ void initialize_occupied_grid() {
     for (int i = 0; i < GRID_WIDTH; i++) {
         for (int j = 0; j < GRID_HEIGHT; j++) {
             occupied_grid[i][j] = false;
+            obstacle_grid[i][j] = NULL_HANDLE;
         }
+        obstacle_column_mask[i] = 0;
     }
 }
 
@@ -1198,38 +1299,13 @@ Vector2 MOUSE_POSITION() {
 }
 
 // Function to check clearance below a tile
-bool check_clearance_below(ObstacleTuple obstacle_list[], int obstacle_count, int x, int y) {
-    // Ensure the y+1 is within the matrix bounds
-    if (y == 0) {
-        return true; 
-    }
-
-    // Iterate through all rows below (x, y), i.e., (x, y-1) down to (x, 0)
-    for (int i = y - 1; i >= 0; i--) {
-        int found = 0;  // Flag to check if there's a tile at (x, i)
-        
-        // Check if there's an obstacle at (x, i)
-        for (int j = 0; j < obstacle_count; j++) {
-            if (obstacle_list[j].x == x && obstacle_list[j].y == i) {
-                found = 1;  // We found a tile at (x, i)
-                
-                // If the obstacle is not clear (i.e., not NULL), return 0
-                if (obstacle_list[j].obstacle != NULL && obstacle_list[j].obstacle->obstacle_type != OBSTACLE_NIL) {
-                    return false;  // If the obstacle is not destroyed, return 0
-                }
-                break;  // Break the inner loop once we've found the tile
-            }
-        }
-        
-        // If no obstacle was found at (x, i), it means the tile is clear, so continue checking
-    }
-
-    // If we made it through the loop, all tiles below are clear
-    return true;
+bool check_clearance_below(int x, int y) {
+	// All cells in column x below row y, i.e., (x, y-1) down to (x, 0)
+	u32 below_mask = (1u << y) - 1;
+	return (obstacle_column_mask[x] & below_mask) == 0;
 }
 
 void clean_world() {
-	initialize_occupied_grid();
 	for (int i = 0; i < MAX_ENTITY_COUNT; i++) {
 		Effect* effect = &world->effects[i];
 		Entity* entity = &world->entities[i];
@@ -1243,11 +1319,8 @@ void clean_world() {
 		if (entity->entitytype == ENTITY_EFFECT && effect->is_valid) {
 			destroy_effect(effect);
 		}
-		if (world->obstacle_list[i].obstacle != NULL) {
-            destroy_entity(world->obstacle_list[i].obstacle);  // Destroy the obstacle
-            world->obstacle_list[i].obstacle = NULL;           // Nullify the reference
-        }
 	}
+	initialize_occupied_grid();
 
 	stage_timer = 0;
 	obstacle_count = 0;
@@ -1294,10 +1367,10 @@ void propagate_wave(Entity* hit_obstacle) {
 
     Vector2 hit_position = hit_obstacle->position;
     // Iterate over all obstacles to propagate the wave
-    for (int i = 0; i < obstacle_count; i++) {
-        Entity* current_obstacle = world->obstacle_list[i].obstacle;
+    for (int i = 0; i < GRID_WIDTH * GRID_HEIGHT; i++) {
+        Entity* current_obstacle = obstacle_grid_get(i / GRID_HEIGHT, i % GRID_HEIGHT);
 		
-        if (current_obstacle != hit_obstacle) {  // Skip the hit obstacle itself
+        if (current_obstacle != NULL && current_obstacle != hit_obstacle) {  // Skip the hit obstacle itself
             float distance = v2_dist(hit_position, current_obstacle->position);
 
             // If within the wave radius, apply wave effect
@@ -1324,22 +1397,9 @@ void apply_damage(Entity* entity, float damage) {
 				Entity* effect_entity = create_entity();
 				setup_effect_entity(effect_entity, entity);
 			}
-			
-			// Get the grid position of the obstacle from the entity
-			Vector2 position = entity->grid_position;
-			int x = position.x;
-			int y = position.y;
 
-			// Find the corresponding tuple in world->obstacle_list and nullify the obstacle
-			for (int i = 0; i < MAX_ENTITY_COUNT; i++) {
-				if (world->obstacle_list[i].x == x && world->obstacle_list[i].y == y) {
-					destroy_entity(world->obstacle_list[i].obstacle);  // Nullify the obstacle
-					world->obstacle_list[i].x = 0;
-					world->obstacle_list[i].y = 0;
-					obstacle_count--;
-					break;
-				}
-			}
+			// Removes the obstacle from obstacle_grid through its grid_position
+			destroy_entity(entity);
 		}
 		else
 		{
@@ -1348,22 +1408,46 @@ void apply_damage(Entity* entity, float damage) {
 	}
 }
 
+void load_sound_effects() {
+	sfx_blop[0]      = audio_clip_bank_load(STR("res/sound_effects/blop1.wav"));
+	sfx_blop[1]      = audio_clip_bank_load(STR("res/sound_effects/blop2.wav"));
+	sfx_blop[2]      = audio_clip_bank_load(STR("res/sound_effects/blop3.wav"));
+	sfx_blop[3]      = audio_clip_bank_load(STR("res/sound_effects/blop4.wav"));
+	sfx_thud         = audio_clip_bank_load(STR("res/sound_effects/thud1.wav"));
+	sfx_wall_thud    = audio_clip_bank_load(STR("res/sound_effects/vägg_thud.wav"));
+	sfx_impact_021   = audio_clip_bank_load(STR("res/sound_effects/Impact_021.wav"));
+	sfx_impact_038   = audio_clip_bank_load(STR("res/sound_effects/Impact_038.wav"));
+	sfx_button_click = audio_clip_bank_load(STR("res/sound_effects/Button_Click.wav"));
+	sfx_menu_button  = audio_clip_bank_load(STR("res/sound_effects/menu_button_sound.wav"));
+	
+	audio_set_max_voices(MAX_AUDIO_VOICES);
+	for (int i = 0; i < 4; i++) {
+		audio_clip_bank_set_limits(sfx_blop[i], SFX_PRIORITY_BLOP, SFX_MAX_INSTANCES_BLOP);
+	}
+	audio_clip_bank_set_limits(sfx_thud,         SFX_PRIORITY_COLLISION, SFX_MAX_INSTANCES_COLLISION);
+	audio_clip_bank_set_limits(sfx_wall_thud,    SFX_PRIORITY_COLLISION, SFX_MAX_INSTANCES_COLLISION);
+	audio_clip_bank_set_limits(sfx_impact_021,   SFX_PRIORITY_GAME_EVENT, 0);
+	audio_clip_bank_set_limits(sfx_impact_038,   SFX_PRIORITY_GAME_EVENT, 0);
+	audio_clip_bank_set_limits(sfx_button_click, SFX_PRIORITY_UI, 0);
+	audio_clip_bank_set_limits(sfx_menu_button,  SFX_PRIORITY_UI, 0);
+}
+
 void play_random_blop_sound() {
     // Slumpa ett tal mellan 0 och 3
     int random_sound = rand() % 4;
 
     switch (random_sound) {
         case 0:
-			play_one_audio_clip(STR("res/sound_effects/blop1.wav"), 1.0);
+			play_one_audio_clip_handle(sfx_blop[0], 1.0);
             break;
         case 1:
-            play_one_audio_clip(STR("res/sound_effects/blop2.wav"), 1.0);
+            play_one_audio_clip_handle(sfx_blop[1], 1.0);
             break;
         case 2:
-            play_one_audio_clip(STR("res/sound_effects/blop3.wav"), 1.0);
+            play_one_audio_clip_handle(sfx_blop[2], 1.0);
             break;
         case 3:
-            play_one_audio_clip(STR("res/sound_effects/blop4.wav"), 1.0);
+            play_one_audio_clip_handle(sfx_blop[3], 1.0);
             break;
     }
 }
@@ -1395,13 +1479,13 @@ void timed_event_info(TimedEvent* te, int index, float* y_offset) {
         temp = sprint(get_temporary_allocator(), STR("%s, Duration: %.2f"), temp, te->duration);
     }
     if (te->interval != 0.0f) {
-        temp = sprint(get_temporary_allocator(), STR("%s, I-timer: %.2f"), temp, te->interval_timer);
+        temp = sprint(get_temporary_allocator(), STR("%s, I-timer: %.2f"), temp, timer_scheduler_interval_timer(&world->timer_scheduler, te));
     }
     if (te->duration != 0.0f) {
         temp = sprint(get_temporary_allocator(), STR("%s, D-timer: %.2f"), temp, te->duration_timer);
     }
     if (te->interval != 0.0f) {
-        temp = sprint(get_temporary_allocator(), STR("%s, Progress: %.2f"), temp, te->progress);
+        temp = sprint(get_temporary_allocator(), STR("%s, Progress: %.2f"), temp, timer_progress(te));
     }
     if (te->counter >= 0) {
         temp = sprint(get_temporary_allocator(), STR("%s, Counter: %d"), temp, te->counter);
@@ -1411,7 +1495,7 @@ void timed_event_info(TimedEvent* te, int index, float* y_offset) {
     draw_text(font_light, 
         temp, 
         font_height, 
-        v2(-window.width / 2, window.height / 2 - 225 - *y_offset),  // Adjust y-position based on y_offset
+        v2(-window.width / 2, window.height / 2 - 275 - *y_offset),  // Adjust y-position based on y_offset
         v2(0.4, 0.4), 
         COLOR_GREEN
     );
@@ -1503,6 +1587,109 @@ bool rect_rect_collision(Entity* rect1, Entity* rect2, bool rect1_centered, bool
     return true; // Collision detected
 }
 
+// -----------------------------------------------------------------------
+//                      COLLISION BROAD PHASE
+// -----------------------------------------------------------------------
+
+int collision_grid_cell_coord(float value, int cell_count) {
+	int cell = (int)floorf(value / COLLISION_CELL_SIZE) + cell_count / 2;
+	return clamp(cell, 0, cell_count - 1);
+}
+
+bool is_collidable_entity(Entity* entity) {
+	switch (entity->entitytype) {
+		case ENTITY_PLAYER:
+		case ENTITY_BOSS:
+		case ENTITY_OBSTACLE:
+		case ENTITY_PROJECTILE:
+		case ENTITY_EFFECT: return true;
+		default: return false;
+	}
+}
+
+void rebuild_collision_grid() {
+	for (int i = 0; i < ARRAY_COUNT(collision_grid.cell_head); i++) {
+		collision_grid.cell_head[i] = -1;
+	}
+	collision_grid.max_half_extent = 0;
+	collision_grid.max_travel = 0;
+	for (int i = 0; i < collision_grid.spawned_count; i++) {
+		collision_grid.is_spawned[collision_grid.spawned[i]] = false;
+	}
+	collision_grid.spawned_count = 0;
+
+	// Walk backwards so every cell list ends up in ascending entity index order
+	for (int i = MAX_ENTITY_COUNT - 1; i >= 0; i--) {
+		Entity* entity = &world->entities[i];
+		if (!entity->is_valid || !is_collidable_entity(entity)) continue;
+
+		int cx = collision_grid_cell_coord(entity->position.x, COLLISION_GRID_WIDTH);
+		int cy = collision_grid_cell_coord(entity->position.y, COLLISION_GRID_HEIGHT);
+		int cell = cy * COLLISION_GRID_WIDTH + cx;
+		collision_grid.next[i] = collision_grid.cell_head[cell];
+		collision_grid.cell_head[cell] = i;
+		collision_grid.handles[i] = get_entity_handle(entity);
+
+		float half_extent = fmaxf(entity->size.x, entity->size.y) / 2.0f;
+		collision_grid.max_half_extent = fmaxf(collision_grid.max_half_extent, half_extent);
+		if (!is_game_paused) {
+			collision_grid.max_travel = fmaxf(collision_grid.max_travel, v2_length(entity->velocity) * delta_t);
+		}
+	}
+}
+
+bool projectile_collides_with(Entity* projectile, Entity* other_entity) {
+	switch (other_entity->entitytype) {
+		case ENTITY_PLAYER:
+		case ENTITY_BOSS:
+		case ENTITY_OBSTACLE:    return circle_rect_collision(projectile, other_entity);
+		case ENTITY_PROJECTILE:
+		case ENTITY_EFFECT:      return circle_circle_collision(projectile, other_entity);
+		default:                 return false;
+	}
+}
+
+// Returns the lowest index entity the projectile collides with (same pick as a full scan over world->entities),
+// but only looks at the grid cells the projectile can reach this tick plus whatever was created since the rebuild.
+Entity* find_projectile_collision(Entity* projectile) {
+	float reach = fmaxf(projectile->size.x, projectile->size.y) / 2.0f + collision_grid.max_half_extent + collision_grid.max_travel + COLLISION_GRID_PADDING;
+
+	int min_x = collision_grid_cell_coord(projectile->position.x - reach, COLLISION_GRID_WIDTH);
+	int max_x = collision_grid_cell_coord(projectile->position.x + reach, COLLISION_GRID_WIDTH);
+	int min_y = collision_grid_cell_coord(projectile->position.y - reach, COLLISION_GRID_HEIGHT);
+	int max_y = collision_grid_cell_coord(projectile->position.y + reach, COLLISION_GRID_HEIGHT);
+
+	int best_index = MAX_ENTITY_COUNT;
+	for (int cy = min_y; cy <= max_y; cy++) {
+		for (int cx = min_x; cx <= max_x; cx++) {
+			for (int i = collision_grid.cell_head[cy * COLLISION_GRID_WIDTH + cx]; i != -1; i = collision_grid.next[i]) {
+				if (i >= best_index) break; // Lists are sorted, nothing better in this cell
+				Entity* other_entity = &world->entities[i];
+				if (!other_entity->is_valid) continue; // Destroyed earlier this tick
+				if (collision_grid.handles[i] != get_entity_handle(other_entity)) continue; // Slot reused, the new entity is in the spawned list
+				if (other_entity == projectile) continue;
+
+				if (projectile_collides_with(projectile, other_entity)) {
+					best_index = i;
+					break;
+				}
+			}
+		}
+	}
+
+	for (int s = 0; s < collision_grid.spawned_count; s++) {
+		int i = collision_grid.spawned[s];
+		if (i >= best_index) continue;
+		Entity* other_entity = &world->entities[i];
+		if (!other_entity->is_valid) continue;
+		if (other_entity == projectile) continue;
+
+		if (projectile_collides_with(projectile, other_entity)) best_index = i;
+	}
+
+	return (best_index < MAX_ENTITY_COUNT) ? &world->entities[best_index] : NULL;
+}
+
 // -----------------------------------------------------------------------
 //                   HANDLE COLLISION FUNCTIONS
 // -----------------------------------------------------------------------
@@ -1514,7 +1701,7 @@ void handle_projectile_collision(Entity* projectile, Entity* obstacle) {
 	if (obstacle->obstacle_type == OBSTACLE_BLOCK) 
 	{
 		projectile_bounce(projectile, obstacle);
-		play_one_audio_clip(STR("res/sound_effects/thud1.wav"), 1.0);
+		play_one_audio_clip_handle(sfx_thud, 1.0);
 	} 
 	else
 	{
@@ -1525,9 +1712,10 @@ void handle_projectile_collision(Entity* projectile, Entity* obstacle) {
 }
 
 void handle_beam_collision(Entity* entity) {
-    if (entity->child != NULL) {
-		if (entity->child->is_visible) {
-			if (rect_rect_collision(entity->child, player->entity, false, true)) {
+    Entity* beam = get_entity(entity->child);
+    if (beam != NULL) {
+		if (beam->is_visible) {
+			if (rect_rect_collision(beam, player->entity, false, true)) {
 				if (!player->is_immune) {
 					number_of_shots_missed++;
 					camera_shake(0.3);
@@ -1758,13 +1946,65 @@ void handle_player_attack(Entity* projectile) {
 //                   UPDATE FUNCTIONS FOR UPDATE LOOP
 // -----------------------------------------------------------------------
 
+void update_beam(Entity* entity) {
+    Entity* beam = get_entity(entity->child);
+    if (beam != NULL) {
+        float max_beam_size = 5.0f;
+
+        if (timer_finished(get_timedevent(beam->timer))) {
+			if (!beam->is_visible) {
+				//play_one_audio_clip(STR("res/sound_effects/laser.wav"), 0.5);
+				camera_shake(0.2);
+			}
+			beam->is_visible = true;
+
+            // The real beam (red), centered on the entity
+			float beam_shoot_alpha = powf(min(get_timedevent(beam->timer)->duration_timer, 1.0f), 3);
+
+			beam->size = v2_mul(v2(max_beam_size, entity->position.y + window.height / 2), v2(1, beam_shoot_alpha));
+			beam->position = v2_sub(entity->position, v2(beam->size.x / 2, beam->size.y + entity->size.y / 2));
+        }
+		else
+		{
+			beam->is_visible = false;
+		}
+    }
+}
+
+void update_inverted_beam(Entity* entity) {
+    Entity* beam = get_entity(entity->child);
+    if (beam != NULL) {
+        float max_beam_size = 5.0f;
+
+        if (timer_finished(get_timedevent(beam->timer))) {
+            if (!beam->is_visible) {
+                //play_one_audio_clip(STR("res/sound_effects/laser.wav"), 0.5);
+                camera_shake(0.2);
+            }
+            beam->is_visible = true;
+
+            // The real beam (red), centered on the entity
+            float beam_shoot_alpha = powf(min(get_timedevent(beam->timer)->duration_timer, 1.0f), 3);
+
+            beam->size = v2_mul(v2(max_beam_size, -(entity->position.y - window.height/2 )), v2(1, beam_shoot_alpha));
+            beam->position = v2_sub(entity->position, v2(beam->size.x / 2, -(beam->size.y + entity->size.y / 2)));
+        }
+        else
+        {
+            beam->is_visible = false;
+        }
+    }
+}
+
 void update_entity_rolling_text(Entity* entity) {
-	if (entity->timer->is_valid) {
-		if (timer_finished(entity->timer)) {
-			if (entity->timer->counter <= entity->text.count) {
+	TimedEvent* timer = get_timedevent(entity->timer);
+	if (timer != NULL) {
+		if (timer_finished(timer)) {
+			if (timer->counter <= entity->text.count) {
 				entity->counter++;
 			} else {
-				entity->timer->is_valid = false; // Removes the timer once finished.
+				destroy_timedevent(timer); // Removes the timer once finished.
+				entity->timer = NULL_HANDLE;
 			}
 		}
 	}
@@ -1790,8 +2030,8 @@ Vector2 update_boss_stage_10_velocity(Vector2 velocity)
 {
     // Example of modifying the velocity based on a sine wave
     float velocity_amplitude = get_random_float32_in_range(10.0, 15.0); // Amplitude for velocity changes
-    float new_velocity_x = velocity_amplitude * (sin(now) + 0.5f * sin(2.0f * now)); // Modify x velocity
-    float new_velocity_y = velocity_amplitude * (sin(now + 0.5f) + 0.3f * sin(3.0f * now)); // Modify y velocity
+    float new_velocity_x = velocity_amplitude * (sin(simulation_time) + 0.5f * sin(2.0f * simulation_time)); // Modify x velocity
+    float new_velocity_y = velocity_amplitude * (sin(simulation_time + 0.5f) + 0.3f * sin(3.0f * simulation_time)); // Modify y velocity
 
     return v2(new_velocity_x, new_velocity_y); // Return updated velocity
 }
@@ -1799,13 +2039,13 @@ Vector2 update_boss_stage_10_velocity(Vector2 velocity)
 void update_boss_stage_10(Entity* entity) 
 {
 	// Movement timer
-    if (timer_finished(entity->timer)) {
+    if (timer_finished(get_timedevent(entity->timer))) {
 		// Update the velocity
         entity->velocity = update_boss_stage_10_velocity(entity->velocity);
     }
 
 	// Attack timer
-	if (timer_finished(entity->second_timer)) {
+	if (timer_finished(get_timedevent(entity->second_timer))) {
 		entity->is_visible = false;
 		Entity* p1 = create_entity();
 		Entity* p2 = create_entity();
@@ -1813,6 +2053,10 @@ void update_boss_stage_10(Entity* entity)
 		summon_icicle(p2, v2_sub(entity->position, v2(entity->size.x, 0)));
 	}
 
+    // Size scaling using a sine wave for a 3D effect
+    float size_scale = 1.0f + 0.5f * sin(simulation_time); // Scale between 0.5 and 1.5
+    entity->size = v2_mulf(entity->start_size, size_scale); // Use start_size for scaling
+
 	update_boss_position_if_over_limit(entity);
 }
 
@@ -1831,8 +2075,8 @@ Vector2 update_boss_stage_20_velocity(Vector2 velocity)
 {
     // Example of modifying the velocity based on a sine wave
     float velocity_amplitude = get_random_float32_in_range(10.0, 15.0); // Amplitude for velocity changes
-    float new_velocity_x = velocity_amplitude * (sin(now) + 0.5f * sin(2.0f * now)); // Modify x velocity
-    float new_velocity_y = velocity_amplitude * (sin(now + 0.5f) + 0.3f * sin(3.0f * now)); // Modify y velocity
+    float new_velocity_x = velocity_amplitude * (sin(simulation_time) + 0.5f * sin(2.0f * simulation_time)); // Modify x velocity
+    float new_velocity_y = velocity_amplitude * (sin(simulation_time + 0.5f) + 0.3f * sin(3.0f * simulation_time)); // Modify y velocity
 
     return v2(new_velocity_x, new_velocity_y); // Return updated velocity
 }
@@ -1843,20 +2087,21 @@ void update_boss_stage_20(Entity* entity)
     static float cooldown_timer = 0.0f;
     static bool teleport_ready = false;
 
-    if (timer_finished(entity->timer)) {
+    if (timer_finished(get_timedevent(entity->timer))) {
         entity->velocity = update_boss_stage_20_velocity(entity->velocity);
     }  
 
-    if (entity->child != NULL) {
-        if (timer_finished(entity->child->timer)) {
-            summon_beam(entity->child, v2_sub(entity->position, v2(entity->size.x, 0)));
+    Entity* beam = get_entity(entity->child);
+    if (beam != NULL) {
+        if (timer_finished(get_timedevent(beam->timer))) {
+            summon_beam(beam, v2_sub(entity->position, v2(entity->size.x, 0)));
             handle_beam_collision(entity);
             teleport_timer = 1.0f;
             teleport_ready = false;
         }
     }
 
-    if (!entity->child->is_visible && teleport_timer > 0.0f) {
+    if (beam != NULL && !beam->is_visible && teleport_timer > 0.0f) {
         teleport_timer -= delta_t;
 
         if (teleport_timer <= 0.0f) {
@@ -1875,65 +2120,84 @@ void update_boss_stage_20(Entity* entity)
     }
 
     update_boss_position_if_over_limit(entity);
+    update_beam(entity);
+}
+
+Vector2 update_boss_stage_30_position(Vector2 current_position) {
+	float new_x = get_random_float32_in_range(-world->playable_width.x/2 + 40.0f, world->playable_width.y/2 - 40.0f);
+	Vector2 new_position = v2(new_x, 200); 
+
+    return new_position;
+}
+
+Vector2 update_boss_stage_30_velocity(Vector2 velocity, Entity* entity) {
+	float velocity_amplitude = 100.0f;
+	TimedEvent* phase_timer = get_timedevent(entity->third_timer);
+    if (phase_timer != NULL && phase_timer->counter) {
+        // Sinusrörelse i första fasen
+        float new_velocity_x = velocity_amplitude * (sin(simulation_time) + 0.5f * sin(2.0f * simulation_time)); 
+        return v2(new_velocity_x, 0);  // Returnera x-hastighet för sinusrörelse
+    } else {
+        // I andra fasen ska hastigheten vara noll
+        return v2(0, 0);  // Ingen rörelse, noll hastighet
+    }
 }
 
 void update_boss_stage_30(Entity* entity) {
+	// The boss owns its timers until it is destroyed, so these handles should never be stale
+	TimedEvent* attack_timer = get_timedevent(entity->second_timer);
+	TimedEvent* phase_timer = get_timedevent(entity->third_timer);
+	assert(attack_timer != NULL && phase_timer != NULL, "Boss stage 30 timers are stale");
+
     // Om andra timern (för attacker) har löpt ut, skapa en projektil
-    if (timer_finished(entity->second_timer)) {
+    if (timer_finished(attack_timer)) {
         Entity* p1 = create_entity();
         summon_projectile_drop_boss_stage_30(p1, v2_add(entity->position, v2(0, -entity->size.y)));
 
         // Om bossen är i andra fasen, förläng intervallet för nästa attack
-        if (!entity->third_timer->counter) {
-            entity->second_timer->interval = 3.0f;  // Exempel: Gör attacker långsammare i andra fasen
+        if (!phase_timer->counter) {
+            set_timer_interval(attack_timer, 3.0f);  // Exempel: Gör attacker långsammare i andra fasen
         }
     }
 
     // Om tredje timern (övergång till andra fasen) har löpt ut
-    if (timer_finished(entity->third_timer)) {
+    if (timer_finished(phase_timer)) {
         entity->velocity = v2(0, 0);  // Nollställ hastigheten
 
         // När bossen går in i andra fasen, justera attackintervallet
-        entity->second_timer->interval = 5.0f;  // Öka intervallet (sakta ner attacker) i andra fasen
+        set_timer_interval(attack_timer, 5.0f);  // Öka intervallet (sakta ner attacker) i andra fasen
     }
-	update_boss_position_if_over_limit(entity);
-}
-
-Vector2 update_boss_stage_30_position(Vector2 current_position) {
-	float new_x = get_random_float32_in_range(-world->playable_width.x/2 + 40.0f, world->playable_width.y/2 - 40.0f);
-	Vector2 new_position = v2(new_x, 200); 
-
-    return new_position;
-}
 
-Vector2 update_boss_stage_30_velocity(Vector2 velocity, Entity* entity) {
-	float velocity_amplitude = 100.0f;
-    if (entity->third_timer->counter) {
-        // Sinusrörelse i första fasen
-        float new_velocity_x = velocity_amplitude * (sin(now) + 0.5f * sin(2.0f * now)); 
-        return v2(new_velocity_x, 0);  // Returnera x-hastighet för sinusrörelse
-    } else {
-        // I andra fasen ska hastigheten vara noll
-        return v2(0, 0);  // Ingen rörelse, noll hastighet
+    // Movement timer
+    if (timer_finished(get_timedevent(entity->timer))) {
+        if (phase_timer->counter) {
+            // Endast uppdatera velocity och position i första fasen
+            entity->velocity = update_boss_stage_30_velocity(entity->velocity, entity);
+            entity->position = v2_add(entity->position, v2_mulf(entity->velocity, delta_t));
+        } else {
+            // I andra fasen ska bossen bara teleportera sig
+            entity->position = update_boss_stage_30_position(entity->position);
+        }
     }
+	update_boss_position_if_over_limit(entity);
 }
 
 Vector2 update_boss_stage_40_velocity(Vector2 velocity) 
 {
     // Example of modifying the velocity based on a sine wave
     float velocity_amplitude = get_random_float32_in_range(10.0, 15.0); // Amplitude for velocity changes
-    float new_velocity_x = velocity_amplitude * (sin(now) + 0.5f * sin(2.0f * now)); // Modify x velocity
-    float new_velocity_y = velocity_amplitude * (sin(now + 0.5f) + 0.3f * sin(3.0f * now)); // Modify y velocity
+    float new_velocity_x = velocity_amplitude * (sin(simulation_time) + 0.5f * sin(2.0f * simulation_time)); // Modify x velocity
+    float new_velocity_y = velocity_amplitude * (sin(simulation_time + 0.5f) + 0.3f * sin(3.0f * simulation_time)); // Modify y velocity
 
     return v2(new_velocity_x, new_velocity_y); // Return updated velocity
 }
 
 void update_boss_stage_40(Entity* entity) {
-    if (timer_finished(entity->timer)) {
+    if (timer_finished(get_timedevent(entity->timer))) {
         entity->velocity = update_boss_stage_40_velocity(entity->velocity);
     }
 
-    if (timer_finished(entity->second_timer)) {
+    if (timer_finished(get_timedevent(entity->second_timer))) {
         Entity* p1 = create_entity();
         Entity* p2 = create_entity();
         
@@ -1971,24 +2235,30 @@ void update_wave_effect(Entity* entity)
 void update_obstacle_drop(Entity* entity) {
 	int x = entity->grid_position.x;
 	int y = entity->grid_position.y;
-	if (check_clearance_below(world->obstacle_list, obstacle_count, x, y)) {
-		if (entity->child == NULL) entity->child = create_entity();
-		if (timer_finished(entity->timer)) {
-			entity->child->is_visible = true;
-			if (entity->timer->duration_timer <= 0.5f) 
+	if (check_clearance_below(x, y)) {
+		// The drop is re-created if the previous one was destroyed (e.g. it hit the player)
+		Entity* drop = get_entity(entity->child);
+		if (drop == NULL) {
+			drop = create_entity();
+			entity->child = get_entity_handle(drop);
+		}
+		TimedEvent* timer = get_timedevent(entity->timer);
+		if (timer_finished(timer)) {
+			drop->is_visible = true;
+			if (timer->duration_timer <= 0.5f) 
 			{
-				summon_projectile_drop(entity->child, entity);
+				summon_projectile_drop(drop, entity);
 			}
-			if (circle_rect_collision(entity->child, player->entity)) {
-				handle_projectile_collision(entity->child, player->entity);
+			if (circle_rect_collision(drop, player->entity)) {
+				handle_projectile_collision(drop, player->entity);
 			}
 		}
 		else
 		{
-			entity->child->position = entity->position;
-			entity->child->size = v2_mulf(v2(1,1), 10 * entity->timer->progress);
-			entity->child->color = v4_lerp(COLOR_GREEN, COLOR_RED, entity->timer->progress);
-			entity->child->is_visible = false;
+			drop->position = entity->position;
+			drop->size = v2_mulf(v2(1,1), 10 * timer_progress(timer));
+			drop->color = v4_lerp(COLOR_GREEN, COLOR_RED, timer_progress(timer));
+			drop->is_visible = false;
 		}
 	}
 }
@@ -1998,9 +2268,8 @@ void update_obstacle_drop(Entity* entity) {
 // -----------------------------------------------------------------------
 
 void draw_obstacle_block(Entity* entity) {
-	entity->color = rgba(30, 30, 30, 255);
 	Vector4 outline_color = COLOR_WHITE;
-	Vector2 draw_pos = v2_sub(entity->position, v2_mulf(entity->size, 0.5));
+	Vector2 draw_pos = v2_sub(get_render_position(entity), v2_mulf(entity->size, 0.5));
 
 	// Draw the outline with four lines
 	draw_line_in_frame(draw_pos, v2_add(draw_pos, v2(entity->size.x, 0)), 2.0f, outline_color, current_draw_frame);
@@ -2010,58 +2279,16 @@ void draw_obstacle_block(Entity* entity) {
 }
 
 void draw_drop(Entity* entity) {
-	if (entity->child != NULL) {
-		draw_centered_in_frame_circle(entity->child->position, entity->child->size, entity->child->color, current_draw_frame);					
+	Entity* drop = get_entity(entity->child);
+	if (drop != NULL) {
+		draw_centered_in_frame_circle(get_render_position(drop), drop->size, drop->color, current_draw_frame);					
 	}
 }
 
 void draw_beam(Entity* entity) {
-    if (entity->child != NULL) {
-        float max_beam_size = 5.0f;
-
-        if (timer_finished(entity->child->timer)) {
-			if (!entity->child->is_visible) {
-				//play_one_audio_clip(STR("res/sound_effects/laser.wav"), 0.5);
-				camera_shake(0.2);
-			}
-			entity->child->is_visible = true;
-
-            // Draw the real beam (red), centered on the entity
-			float beam_shoot_alpha = powf(min(entity->child->timer->duration_timer, 1.0f), 3);
-
-			entity->child->size = v2_mul(v2(max_beam_size, entity->position.y + window.height / 2), v2(1, beam_shoot_alpha));
-			entity->child->position = v2_sub(entity->position, v2(entity->child->size.x / 2, entity->child->size.y + entity->size.y / 2));
-            draw_rect_in_frame(entity->child->position, entity->child->size, COLOR_WHITE, current_draw_frame);
-        }
-		else
-		{
-			entity->child->is_visible = false;
-		}
-    }
-}
-
-void draw_inverted_beam(Entity* entity) {
-    if (entity->child != NULL) {
-        float max_beam_size = 5.0f;
-
-        if (timer_finished(entity->child->timer)) {
-            if (!entity->child->is_visible) {
-                //play_one_audio_clip(STR("res/sound_effects/laser.wav"), 0.5);
-                camera_shake(0.2);
-            }
-            entity->child->is_visible = true;
-
-            // Draw the real beam (red), centered on the entity
-            float beam_shoot_alpha = powf(min(entity->child->timer->duration_timer, 1.0f), 3);
-
-            entity->child->size = v2_mul(v2(max_beam_size, -(entity->position.y - window.height/2 )), v2(1, beam_shoot_alpha));
-            entity->child->position = v2_sub(entity->position, v2(entity->child->size.x / 2, -(entity->child->size.y + entity->size.y / 2)));
-            draw_rect_in_frame(entity->child->position, entity->child->size, COLOR_WHITE, current_draw_frame);
-        }
-        else
-        {
-            entity->child->is_visible = false;
-        }
+    Entity* beam = get_entity(entity->child);
+    if (beam != NULL && beam->is_visible) {
+        draw_rect_in_frame(get_render_position(beam), beam->size, COLOR_WHITE, current_draw_frame);
     }
 }
 
@@ -2072,7 +2299,7 @@ void draw_playable_area_borders() {
 	draw_line_in_frame(v2(world->playable_width.y / 2, -window.height / 2), v2(world->playable_width.y / 2, window.height / 2), 2, COLOR_WHITE, current_draw_frame);
 }
 
-void draw_death_borders(TimedEvent* timedevent) {
+void update_death_borders(TimedEvent* timedevent) {
 
 	// Use uint32_t instead of s64
 	uint32_t lava_colors[5] = {
@@ -2095,11 +2322,12 @@ void draw_death_borders(TimedEvent* timedevent) {
 	}
 
 	int next_color_index = (timedevent->counter + 1) % 5;
-	Vector4 color = v4_lerp(rgba_colors[timedevent->counter], rgba_colors[next_color_index], timedevent->progress);
+	barrier_color = v4_lerp(rgba_colors[timedevent->counter], rgba_colors[next_color_index], timer_progress(timedevent));
+}
 
+void draw_death_borders() {
 	float wave = 5*(sin(os_get_elapsed_seconds()) + 3);	
 	
-	barrier_color = color;
 	draw_line_in_frame(v2(-window.width / 2,  window.height / 2), v2(window.width / 2,  window.height/2), wave, barrier_color, current_draw_frame);
 	draw_line_in_frame(v2(-window.width / 2, -window.height / 2), v2(window.width / 2, -window.height/2), wave, barrier_color, current_draw_frame);
 
@@ -2174,56 +2402,43 @@ bool draw_button(Gfx_Font* font, u32 font_height, string label, Vector2 pos, Vec
 }
 
 void draw_boss_stage_10(Entity* entity) {
-    // Amplitudes for the movement (lower values for more subtle movement)
-    float amplitude_x = 5.0f; // Reduced amplitude for x-axis
-    float amplitude_y = 10.0f;  // Reduced amplitude for y-axis
-
-    // Size scaling using a sine wave for a 3D effect
-    float size_scale = 1.0f + 0.5f * sin(now); // Scale between 0.5 and 1.5
-    entity->size = v2_mulf(entity->start_size, size_scale); // Use start_size for scaling
+    Vector2 position = get_render_position(entity);
 
     // Draw the boss with the updated position and scaled size
-    draw_centered_in_frame_rect(entity->position, entity->size, entity->color, current_draw_frame);
-    draw_centered_in_frame_rect(v2_add(entity->position, v2(entity->size.x, 0)), v2_mulf(entity->size, 0.3), entity->color, current_draw_frame);
-    draw_centered_in_frame_rect(v2_add(entity->position, v2(-entity->size.x, 0)), v2_mulf(entity->size, 0.3), entity->color, current_draw_frame);
+    draw_centered_in_frame_rect(position, entity->size, entity->color, current_draw_frame);
+    draw_centered_in_frame_rect(v2_add(position, v2(entity->size.x, 0)), v2_mulf(entity->size, 0.3), entity->color, current_draw_frame);
+    draw_centered_in_frame_rect(v2_add(position, v2(-entity->size.x, 0)), v2_mulf(entity->size, 0.3), entity->color, current_draw_frame);
 }
 
 void draw_boss_stage_20(Entity* entity) {  
 
 	draw_beam(entity);
 
+    Vector2 position = get_render_position(entity);
+
     // Draw the boss with the updated position and scaled size
-	draw_centered_in_frame_circle(entity->position, entity->start_size, entity->color, current_draw_frame);
+	draw_centered_in_frame_circle(position, entity->start_size, entity->color, current_draw_frame);
     
     // Justera y-värdet för att rita cirkeln högre upp
-    Vector2 new_position = entity->position;
+    Vector2 new_position = position;
     new_position.y += 10;  
 
     draw_centered_in_frame_circle(new_position, v2(23, 48), entity->color, current_draw_frame);
 
-	Vector2 position_kube = entity->position;
+	Vector2 position_kube = position;
     position_kube.y -= 7;  
 	draw_centered_in_frame_rect(position_kube, v2(18, 18), entity->color, current_draw_frame);
 }	
 
 void draw_boss_stage_30(Entity* entity) {
-    if (timer_finished(entity->timer)) {
-        if (entity->third_timer->counter) {
-            // Endast uppdatera velocity och position i första fasen
-            entity->velocity = update_boss_stage_30_velocity(entity->velocity, entity);
-            entity->position = v2_add(entity->position, v2_mulf(entity->velocity, delta_t));
-        } else {
-            // I andra fasen ska bossen bara teleportera sig
-            entity->position = update_boss_stage_30_position(entity->position);
-        }
-    }
-    draw_centered_in_frame_rect(entity->position, entity->size, entity->color, current_draw_frame);
+    draw_centered_in_frame_rect(get_render_position(entity), entity->size, entity->color, current_draw_frame);
 }
 
 void draw_boss_stage_40(Entity* entity) {
-    draw_centered_in_frame_rect(entity->position, entity->size, entity->color, current_draw_frame);
-    draw_centered_in_frame_rect(v2_add(entity->position, v2(entity->size.x/2, -30)), v2_mulf(entity->size, 0.4), entity->color, current_draw_frame);
-    draw_centered_in_frame_rect(v2_add(entity->position, v2(-entity->size.x/2, -30)), v2_mulf(entity->size, 0.4), entity->color, current_draw_frame);
+    Vector2 position = get_render_position(entity);
+    draw_centered_in_frame_rect(position, entity->size, entity->color, current_draw_frame);
+    draw_centered_in_frame_rect(v2_add(position, v2(entity->size.x/2, -30)), v2_mulf(entity->size, 0.4), entity->color, current_draw_frame);
+    draw_centered_in_frame_rect(v2_add(position, v2(-entity->size.x/2, -30)), v2_mulf(entity->size, 0.4), entity->color, current_draw_frame);
 }
 
 void draw_boss_health_bar() {
@@ -2322,8 +2537,13 @@ void stage_tutorial() {
 
 void draw_timed_events() {
     float y_offset = 0;  // Initialize y_offset to zero
-    for (int i = 0; i < MAX_ENTITY_COUNT; i++) {
-        timed_event_info(&world->timedevents[i], i, &y_offset);
+    TimerScheduler* scheduler = &world->timer_scheduler;
+    // Every live timer is either waiting in the heap or inside its duration
+    for (int i = 0; i < scheduler->heap_count; i++) {
+        timed_event_info(&world->timedevents[scheduler->heap[i]], scheduler->heap[i], &y_offset);
+    }
+    for (int i = 0; i < scheduler->active_count; i++) {
+        timed_event_info(&world->timedevents[scheduler->active[i]], scheduler->active[i], &y_offset);
     }
 }
 
@@ -2387,17 +2607,19 @@ void draw_stage_timers() {
 }
 
 void draw_entity_effect(Entity* entity) {
-	draw_centered_in_frame_circle(entity->position, v2_add(entity->size, v2(2, 2)), COLOR_BLACK, current_draw_frame);
-	draw_centered_in_frame_circle(entity->position, entity->size, entity->color, current_draw_frame);
+	Vector2 position = get_render_position(entity);
+	draw_centered_in_frame_circle(position, v2_add(entity->size, v2(2, 2)), COLOR_BLACK, current_draw_frame);
+	draw_centered_in_frame_circle(position, entity->size, entity->color, current_draw_frame);
 }
 
 void draw_entity_projectile(Entity* entity) {
-	draw_centered_in_frame_circle(entity->position, v2_add(entity->size, v2(2, 2)), COLOR_BLACK, current_draw_frame);
-	draw_centered_in_frame_circle(entity->position, entity->size, entity->color, current_draw_frame);
+	Vector2 position = get_render_position(entity);
+	draw_centered_in_frame_circle(position, v2_add(entity->size, v2(2, 2)), COLOR_BLACK, current_draw_frame);
+	draw_centered_in_frame_circle(position, entity->size, entity->color, current_draw_frame);
 }
 
 void draw_entity_player(Entity* entity) {
-	draw_centered_in_frame_rect(entity->position, entity->size, entity->color, current_draw_frame);
+	draw_centered_in_frame_rect(get_render_position(entity), entity->size, entity->color, current_draw_frame);
 }
 
 void draw_entity_rolling_text(Entity* entity) {
@@ -2412,7 +2634,7 @@ void draw_entity_rolling_text(Entity* entity) {
         font_light,
         temp,
         font_height,
-        entity->position,  // Adjust y-position based on y_offset
+        get_render_position(entity),  // Adjust y-position based on y_offset
         v2(1.0, 1.0),
         entity->color,
         current_draw_frame
@@ -2431,14 +2653,14 @@ void draw_entity_boss(Entity* entity) {
 }
 
 void draw_entity_obstacle(Entity* entity) {
-	draw_centered_in_frame_rect(entity->position, entity->size, entity->color, current_draw_frame);
+	draw_centered_in_frame_rect(get_render_position(entity), entity->size, entity->color, current_draw_frame);
 
 	switch(entity->obstacle_type) 
 	{
 		case(OBSTACLE_DROP):  draw_drop(entity); break;
 		case(OBSTACLE_BEAM):  draw_beam(entity); break;
-		case(OBSTACLE_INVERTED_BEAM):  draw_inverted_beam(entity); break;
-		case(OBSTACLE_HARD):  entity->color = v4(0.5 * sin(now + 3*PI32) + 0.5, 0, 1, 1); break;
+		case(OBSTACLE_INVERTED_BEAM):  draw_beam(entity); break;
+		case(OBSTACLE_HARD):  {}; break;
 		case(OBSTACLE_BLOCK): draw_obstacle_block(entity); break;
 		case(OBSTACLE_BASE): {}; break;
 		default: log("%s obstacle type has not been handled correctly in draw_entity_obstacle()", entity->obstacle_type); break; 
@@ -2463,7 +2685,8 @@ void draw_effect_ui() {
             continue;
         }
 
-		if (effect->timer == NULL || !(effect->timer->is_valid)) {
+		TimedEvent* effect_timer = get_timedevent(effect->timer);
+		if (effect_timer == NULL) {
             continue; // Skip this effect if the timer is not initialized
         }
 		log("There is an effect!");
@@ -2472,13 +2695,22 @@ void draw_effect_ui() {
 		Gfx_Text_Metrics m = measure_text(font_bold, effect_pretty_text(effect->effect_type), font_height, v2(0.4, 0.4));
 
 		draw_centered_rect(v2_add(effect_position, v2(m.visual_size.x / 2, 0.75*m.visual_size.y / 2)), v2(1.25*m.visual_size.x, 1.25*m.visual_size.y), v4(0.5, 0.5, 0.5, 0.5));
-		float a = 1.0f - effect->timer->progress;
+		float a = 1.0f - timer_progress(effect_timer);
 		draw_rect(effect_position, v2(a*1.25*m.visual_size.x, 1.25*m.visual_size.y), COLOR_RED);
 		draw_text(font_bold, sprint(get_temporary_allocator(), effect_pretty_text(effect->effect_type)), font_height, effect_position, v2(0.4, 0.4), COLOR_WHITE);
 		
 		y_diff += 25;
-		if (timer_finished(effect->timer)) {
-			destroy_timedevent(effect->timer);
+	}
+}
+
+void update_effects() {
+	for (int i = 0; i < MAX_ENTITY_COUNT; i++) {
+		Effect* effect = &world->effects[i];
+		if (!effect->is_valid) continue;
+
+		TimedEvent* effect_timer = get_timedevent(effect->timer);
+		if (timer_finished(effect_timer)) {
+			destroy_timedevent(effect_timer);
 			destroy_effect(effect);
 		}
 	}
@@ -2540,14 +2772,14 @@ void draw_main_menu() {
 		
 		// Play Option
 		if (draw_button(font_light, font_height, sprint(get_temporary_allocator(), STR("Play")), v2(-button_size / 2, 0), v2(button_size, 50), true)) {
-			play_one_audio_clip(STR("res/sound_effects/Button_Click.wav"), 0.7);
+			play_one_audio_clip_handle(sfx_button_click, 0.7);
 			is_main_menu_active = false;  // Close menu
         	is_game_paused = false;       // Resume game
 		}
 
 		// Settings Option
 		if (draw_button(font_light, font_height, sprint(get_temporary_allocator(), STR("Settings")), v2(-button_size / 2, -50), v2(button_size, 50), true)) {
-			play_one_audio_clip(STR("res/sound_effects/Button_Click.wav"), 0.7);
+			play_one_audio_clip_handle(sfx_button_click, 0.7);
 			is_main_menu_active = false;      // Close main menu
 			is_settings_menu_active = true;   // Open settings menu
 		}
@@ -2579,19 +2811,19 @@ void draw_settings_menu() {
 
 		// Sound Settings Option
 		if (draw_button(font_light, font_height, sprint(get_temporary_allocator(), STR("Sound")), v2(-button_size.x / 2, y), button_size, true)) {
-			play_one_audio_clip(STR("res/sound_effects/Button_Click.wav"), 0.7);
+			play_one_audio_clip_handle(sfx_button_click, 0.7);
 		}
 		y -= button_size.y;
 		// Graphics Settings Option
 		if (draw_button(font_light, font_height, sprint(get_temporary_allocator(), STR("Graphics")), v2(-button_size.x / 2, y), button_size, true)) {
 			is_settings_menu_active = false;
 			is_graphics_settings_active = true;
-			play_one_audio_clip(STR("res/sound_effects/Button_Click.wav"), 0.7);
+			play_one_audio_clip_handle(sfx_button_click, 0.7);
 		}
 		y -= button_size.y;
 		// Controls Settings Option
 		if (draw_button(font_light, font_height, sprint(get_temporary_allocator(), STR("Controls")), v2(-button_size.x / 2, y), button_size, true)) {
-			play_one_audio_clip(STR("res/sound_effects/Button_Click.wav"), 0.7);
+			play_one_audio_clip_handle(sfx_button_click, 0.7);
 		}
 		y -= button_size.y;
 		// Back Button to return to Main Menu
@@ -2851,25 +3083,17 @@ void draw_game() {
 		}
 	}
 
-	// When a stage is cleared this is runned
-	// TODO: Look at this
-	if (obstacle_count - number_of_block_obstacles <= 0 && !(boss_is_alive(world))) {
-		current_stage_level++;
-		log("New stage!");
-		initialize_new_stage();
-	}
-
-	if (!(is_game_paused)) { particle_update(); }
-	
-	int number_of_particles = particle_render();
+	particle_render();
 
 	draw_playable_area_borders();
 
-	draw_death_borders(color_switch_event);
+	draw_death_borders();
 }
 
 void update_game() {
 	entity_counter = 0;
+
+	rebuild_collision_grid();
 	
 	for (int i = 0; i < MAX_ENTITY_COUNT; i++) {
 		Entity* entity = &world->entities[i];
@@ -2881,53 +3105,24 @@ void update_game() {
 
 		switch (entity->entitytype) {
 			case ENTITY_PROJECTILE: {
-				bool collision = false;
-				for (int j = 0; j < MAX_ENTITY_COUNT; j++) {
-					Entity* other_entity = &world->entities[j];
-					if (!other_entity->is_valid) continue;
-					if (entity == other_entity) continue;
-					if (collision) break;
-
-					switch (other_entity->entitytype) {
-						case ENTITY_PLAYER:
-						case ENTITY_BOSS:
-						case ENTITY_OBSTACLE: {
-							if (circle_rect_collision(entity, other_entity)) {
-								handle_projectile_collision(entity, other_entity);
-								collision = true;
-							}
-						} break;
-
-						case ENTITY_PROJECTILE: {
-							if (circle_circle_collision(entity, other_entity)) {
-								particle_emit(other_entity->position, other_entity->color, 4, PFX_EFFECT);
-								handle_projectile_collision(entity, other_entity);
-								collision = true;
-							}
-						} break;
-
-						case ENTITY_EFFECT: {
-							if (circle_circle_collision(entity, other_entity)) {
-								particle_emit(other_entity->position, other_entity->color, 4, PFX_EFFECT);
-								handle_projectile_collision(entity, other_entity);
-								collision = true;
-							}
-						} break;
-
-						default: break;
+				Entity* other_entity = find_projectile_collision(entity);
+				if (other_entity != NULL) {
+					if (other_entity->entitytype == ENTITY_PROJECTILE || other_entity->entitytype == ENTITY_EFFECT) {
+						particle_emit(other_entity->position, other_entity->color, 4, PFX_EFFECT);
 					}
+					handle_projectile_collision(entity, other_entity);
 				}
 
 				// Check projectile bounds
 				if (entity->position.x <= -world->playable_width.x / 2 || entity->position.x >= world->playable_width.y / 2) {
 					projectile_bounce_world(entity);
-					play_one_audio_clip(STR("res/sound_effects/vägg_thud.wav"), 1.0);
+					play_one_audio_clip_handle(sfx_wall_thud, 1.0);
 				}
 
 				if (entity->position.y <= -window.height / 2 || entity->position.y >= window.height / 2) {
 					number_of_shots_missed++;
 					camera_shake(0.3);
-					play_one_audio_clip(STR("res/sound_effects/Impact_021.wav"), 0.6);
+					play_one_audio_clip_handle(sfx_impact_021, 0.6);
 					destroy_entity(entity);
 				}
 			} break;
@@ -2935,8 +3130,9 @@ void update_game() {
 			case ENTITY_OBSTACLE: {
 				switch (entity->obstacle_type) {
 					case OBSTACLE_DROP: update_obstacle_drop(entity); break;
-					case OBSTACLE_BEAM: handle_beam_collision(entity); break;
-					case OBSTACLE_INVERTED_BEAM: handle_beam_collision(entity); break;
+					case OBSTACLE_BEAM: update_beam(entity); handle_beam_collision(entity); break;
+					case OBSTACLE_INVERTED_BEAM: update_inverted_beam(entity); handle_beam_collision(entity); break;
+					case OBSTACLE_HARD: entity->color = v4(0.5 * sin(simulation_time + 3*PI32) + 0.5, 0, 1, 1); break;
 					default: break;
 				}
 
@@ -2969,7 +3165,7 @@ void update_game() {
 
 	if (game_over) {
 		log("you died!");
-		play_one_audio_clip(STR("res/sound_effects/Impact_038.wav"), 0.5);
+		play_one_audio_clip_handle(sfx_impact_038, 0.5);
 		current_stage_level = 0;
 		number_of_shots_missed = 0;
 		remove_all_particles();
@@ -2979,6 +3175,63 @@ void update_game() {
 	}
 }
 
+// Advances the whole game by one fixed step, nothing in draw_game() mutates state
+void simulate_tick(float64 dt, float max_charge_time) {
+	delta_t = dt;
+	simulation_time += delta_t;
+	if (is_game_running && !is_game_paused) stage_timer += delta_t;
+
+	// The only place timers advance, everything below just reads the ready flags
+	timer_scheduler_tick(&world->timer_scheduler, delta_t, is_game_running && !is_game_paused);
+
+	// Remember where everything was so rendering can interpolate towards the new state
+	for (int i = 0; i < MAX_ENTITY_COUNT; i++) {
+		Entity* entity = &world->entities[i];
+		if (!entity->is_valid) continue;
+		entity->previous_position = entity->position;
+		entity->has_previous_position = true;
+	}
+
+	if (player->entity->is_valid && !game_over && !is_game_paused) {
+		// Track charging time while the right mouse button is held down
+		if (is_key_down(MOUSE_BUTTON_RIGHT)) {
+			charge_time_projectile += delta_t;  // Increase charge time
+		}
+
+		if (!is_key_down(MOUSE_BUTTON_RIGHT) && charge_time_projectile < max_charge_time) {
+			charge_time_projectile = 0;  // Increase charge time
+		}
+
+		// Update player position as usual
+		update_player_position(player);
+		update_player(player);
+	}
+
+	update_game();
+
+	update_effects();
+
+	update_death_borders(get_timedevent(color_switch_event));
+
+	// When a stage is cleared this is runned
+	// TODO: Look at this
+	if (obstacle_count - number_of_block_obstacles <= 0 && !(boss_is_alive(world))) {
+		current_stage_level++;
+		log("New stage!");
+		initialize_new_stage();
+	}
+
+	if (!(is_game_paused)) { particle_update(); }
+}
+
+#if RUN_TESTS
+#include "include/tests.c"
+#endif
+
+#if RUN_GAME_BENCHMARKS
+#include "include/benchmarks.c"
+#endif
+
 int entry(int argc, char **argv) {
 	window_resolution = v2(1920, 1080);
 	window.title = STR("Noel & Gustav - Pong Clone");
@@ -2995,9 +3248,17 @@ int entry(int argc, char **argv) {
 	float64 seconds_counter = 0.0;
 	s32 frame_count = 0;
 	float64 last_time = os_get_elapsed_seconds();
+	float64 simulation_accumulator = 0.0;
 
 	world = alloc(get_heap_allocator(), sizeof(World));
 	memset(world, 0, sizeof(World));
+	initialize_world_pools(world);
+	particle_store_init(&particles, MAX_PARTICLE_COUNT, get_heap_allocator());
+	particle_worker_pool_init(&particle_workers, min((int)os_get_number_of_logical_processors() - 1, MAX_PARTICLE_WORKER_THREADS), get_heap_allocator());
+
+#if RUN_TESTS
+	run_game_tests();
+#endif
 
 	Gfx_Shader_Extension light_shader;
 	Gfx_Shader_Extension bloom_map_shader;
@@ -3031,6 +3292,14 @@ int entry(int argc, char **argv) {
 	background_sprite = load_image_from_disk(STR("res/textures/background.png"), get_heap_allocator());
 	assert(background_sprite, "Failed loading 'res/textures/background.png'");
 
+	load_sound_effects();
+
+#if RUN_GAME_BENCHMARKS
+	// After loading assets since some benchmarks draw the scene
+	run_game_benchmarks();
+	return 0;
+#endif
+
 	player = create_player();
 	float max_charge_time = 3;
 	summon_world(SPAWN_RATE_ALL_OBSTACLES);
@@ -3060,9 +3329,8 @@ int entry(int argc, char **argv) {
 		// Time stuff
 		now = os_get_elapsed_seconds();
 		
-		delta_t = now - last_time;
+		float64 frame_time = now - last_time;
 		last_time = now;
-		if (is_game_running && !is_game_paused) stage_timer += delta_t;
 
 		// Mouse Positions
 		mouse_position = MOUSE_POSITION();
@@ -3074,7 +3342,7 @@ int entry(int argc, char **argv) {
 		window.clear_color = world->world_background;
 		
 		// Camera Stuff
-		camera_trauma -= delta_t;
+		camera_trauma -= frame_time;
 		camera_trauma = fmaxf(camera_trauma, 0);
 
 		float cam_shake = fminf(pow(camera_trauma, 3), 1);
@@ -3150,17 +3418,6 @@ int entry(int argc, char **argv) {
 		}
 
 		if (player->entity->is_valid && !game_over && !is_game_paused) {
-			// Track charging time while the right mouse button is held down
-			
-
-			if (is_key_down(MOUSE_BUTTON_RIGHT)) {
-				charge_time_projectile += delta_t;  // Increase charge time
-			}
-
-			if (!is_key_down(MOUSE_BUTTON_RIGHT) && charge_time_projectile < max_charge_time) {
-				charge_time_projectile = 0;  // Increase charge time
-			}
-
 			// Toggle between enhanced damage and enhanced speed with 'E'
 			if (is_key_just_pressed('E')) {
 				// Toggle the abilities
@@ -3181,17 +3438,17 @@ int entry(int argc, char **argv) {
 			static bool has_played_sound_2 = false;
 
 			if (!has_played_sound_1 && enhanced_projectile_damage && charge_time_projectile >= 1.0f) {
-					play_one_audio_clip(STR("res/sound_effects/menu_button_sound.wav"), 1.0);
+					play_one_audio_clip_handle(sfx_menu_button, 1.0);
 					has_played_sound_1 = true; // Sätt flaggan till true så att ljudet inte spelas igen
 				}
 
 			if (!has_played_sound_2 && enhanced_projectile_damage && charge_time_projectile >= 3.0f) {
-					play_one_audio_clip(STR("res/sound_effects/menu_button_sound.wav"), 1.0);
+					play_one_audio_clip_handle(sfx_menu_button, 1.0);
 					has_played_sound_2 = true; // Sätt flaggan till true så att ljudet inte spelas igen
 				}
 
 			if (!has_played_sound_2 && enhanced_projectile_speed && charge_time_projectile >= 2.0f) {
-					play_one_audio_clip(STR("res/sound_effects/menu_button_sound.wav"), 1.0);
+					play_one_audio_clip_handle(sfx_menu_button, 1.0);
 					has_played_sound_2 = true; // Sätt flaggan till true så att ljudet inte spelas igen
 				}
 			
@@ -3211,13 +3468,17 @@ int entry(int argc, char **argv) {
 				has_played_sound_1 = false; // Återställ flaggan när projektilen laddas om
 				has_played_sound_2 = false;
 			}
-			// Update player position as usual
-			update_player_position(player);
-			update_player(player);
-		
 		}
 
-		update_game();
+		// -----------------------------------------------------------------------
+		//                 FIXED TIMESTEP SIMULATION
+		// -----------------------------------------------------------------------
+		simulation_accumulator += fmin(frame_time, MAX_SIMULATION_TICKS_PER_FRAME * SIMULATION_DT);
+		while (simulation_accumulator >= SIMULATION_DT) {
+			simulate_tick(SIMULATION_DT, max_charge_time);
+			simulation_accumulator -= SIMULATION_DT;
+		}
+		render_alpha = simulation_accumulator / SIMULATION_DT;
 
 		// Set stuff in cbuffer which we need to pass to shaders
 		scene_cbuffer.mouse_pos_screen = v2(input_frame.mouse_x, input_frame.mouse_y);
@@ -3241,15 +3502,16 @@ int entry(int argc, char **argv) {
 				// Use rectangular lights for ENTITY_OBSTACLE
 				if (entity->entitytype == ENTITY_OBSTACLE) {
 					create_circular_light_source(entity->position, entity->color, 0.3f, entity->size.x * 2, &scene_cbuffer);
+					Entity* beam = get_entity(entity->child);
 
 					if (entity->obstacle_type == OBSTACLE_BEAM) {
-						if (entity->child->is_visible) {
-							create_rectangular_light_source(v2_add(entity->child->position, v2_mulf(entity->child->size, 0.5)), COLOR_RED, v2(entity->child->size.y, entity->child->size.x * 5.0f), 0, v2(0, 1), 1.0f, &scene_cbuffer);
+						if (beam != NULL && beam->is_visible) {
+							create_rectangular_light_source(v2_add(beam->position, v2_mulf(beam->size, 0.5)), COLOR_RED, v2(beam->size.y, beam->size.x * 5.0f), 0, v2(0, 1), 1.0f, &scene_cbuffer);
 						}
 					}
 					if (entity->obstacle_type == OBSTACLE_INVERTED_BEAM) {
-						if (entity->child->is_visible) {
-							create_rectangular_light_source(v2_add(entity->child->position, v2_mulf(entity->child->size, 0.5)), COLOR_RED, v2(entity->child->size.y, entity->child->size.x * 5.0f), 0, v2(0, 1), 1.0f, &scene_cbuffer);
+						if (beam != NULL && beam->is_visible) {
+							create_rectangular_light_source(v2_add(beam->position, v2_mulf(beam->size, 0.5)), COLOR_RED, v2(beam->size.y, beam->size.x * 5.0f), 0, v2(0, 1), 1.0f, &scene_cbuffer);
 						}
 					}
 				
@@ -3259,22 +3521,21 @@ int entry(int argc, char **argv) {
 					create_circular_light_source(entity->position, entity->color, 0.3f, entity->size.x * 1.5f, &scene_cbuffer);
 				}
 				else if (entity->entitytype == ENTITY_BOSS) {
-					if (entity->child != NULL) {
-						if (entity->child->is_visible) {
-							create_rectangular_light_source(v2_add(entity->child->position, v2_mulf(entity->child->size, 0.5)), COLOR_RED, v2(entity->child->size.y, entity->child->size.x * 5.0f), 0, v2(0, 1), 1.0f, &scene_cbuffer);
+					Entity* beam = get_entity(entity->child);
+					if (beam != NULL) {
+						if (beam->is_visible) {
+							create_rectangular_light_source(v2_add(beam->position, v2_mulf(beam->size, 0.5)), COLOR_RED, v2(beam->size.y, beam->size.x * 5.0f), 0, v2(0, 1), 1.0f, &scene_cbuffer);
 						}
 					}
 				}
 			}
 
-			for (int i = 0; i < MAX_ENTITY_COUNT; i++) {
-				Particle* p = &particles[i];
+			for (int i = 0; i < particles.count; i++) {
 				if (scene_cbuffer.light_count >= MAX_LIGHTS) break;
-				if (!(p->flags & PARTICLE_FLAGS_valid)) continue;
 
 				// Use point lights for certain particle effects
-				if (p->kind == PFX_EFFECT || p->kind == PFX_BOUNCE) {
-					create_circular_light_source(p->pos, p->col, 0.3f, 10.0f, &scene_cbuffer);
+				if (particles.kind[i] == PFX_EFFECT || particles.kind[i] == PFX_BOUNCE) {
+					create_circular_light_source(particle_position(i), particles.col[i], 0.3f, 10.0f, &scene_cbuffer);
 				}
 			}
 		}
@@ -3296,15 +3557,10 @@ int entry(int argc, char **argv) {
 		gfx_render_draw_frame(&offscreen_draw_frame, game_image);
 		
 		// Draw game with bloom map shader to the bloom map
-		// Reset draw current_draw_frame & clear the image
-		current_draw_frame = &offscreen_draw_frame;
-		draw_frame_reset(&offscreen_draw_frame);
+		// The quads recorded above are replayed, only the per-pass state is cleared
+		draw_frame_reuse(&offscreen_draw_frame);
 		gfx_clear_render_target(bloom_map, COLOR_BLACK);
 		
-		// Draw game things to offscreen Draw_Frame
-		
-		draw_game();
-		
 		// Set the shader & cbuffer before the render call
 		offscreen_draw_frame.shader_extension = bloom_map_shader;
 		offscreen_draw_frame.cbuffer = &scene_cbuffer;
@@ -3344,8 +3600,11 @@ int entry(int argc, char **argv) {
 				draw_text(font_light, sprint(get_temporary_allocator(), STR("obstacles: %i, block: %i"), obstacle_count, number_of_block_obstacles), font_height, v2(-window.width / 2, window.height / 2 - 100), v2(0.4, 0.4), COLOR_GREEN);
 				draw_text(font_light, sprint(get_temporary_allocator(), STR("destroyed: %i"), number_of_destroyed_obstacles), font_height, v2(-window.width / 2, window.height / 2 - 125), v2(0.4, 0.4), COLOR_GREEN);
 				draw_text(font_light, sprint(get_temporary_allocator(), STR("projectiles: %i"), number_of_shots_fired), font_height, v2(-window.width / 2, window.height / 2 - 150), v2(0.4, 0.4), COLOR_GREEN);
-				draw_text(font_light, sprint(get_temporary_allocator(), STR("particles: %i"), number_of_particles), font_height, v2(-window.width / 2, window.height / 2 - 175), v2(0.4, 0.4), COLOR_GREEN);
+				draw_text(font_light, sprint(get_temporary_allocator(), STR("particles: %i (dropped %i)"), number_of_particles, particles.dropped_count), font_height, v2(-window.width / 2, window.height / 2 - 175), v2(0.4, 0.4), COLOR_GREEN);
 				draw_text(font_light, sprint(get_temporary_allocator(), STR("light sources: %i"), scene_cbuffer.light_count), font_height, v2(-window.width / 2, window.height / 2 - 200), v2(0.4, 0.4), COLOR_GREEN);
+				Temporary_Storage_Stats temp_stats = get_temporary_storage_stats();
+				draw_text(font_light, sprint(get_temporary_allocator(), STR("temp: %i KB last frame, %i KB peak, %i allocs, %i blocks"), (int)(temp_stats.last_frame_high_water / 1024), (int)(temp_stats.peak_high_water / 1024), (int)temp_stats.last_frame_allocation_count, (int)temp_stats.block_count), font_height, v2(-window.width / 2, window.height / 2 - 225), v2(0.4, 0.4), COLOR_GREEN);
+				draw_text(font_light, sprint(get_temporary_allocator(), STR("quads: %i last frame, %i peak"), (int)draw_frame.last_frame_quad_count, (int)draw_frame.peak_quad_count), font_height, v2(-window.width / 2, window.height / 2 - 250), v2(0.4, 0.4), COLOR_GREEN);
 				draw_timed_events();
 			}
 
@@ -3374,7 +3633,7 @@ int entry(int argc, char **argv) {
 		os_update();
 		gfx_update();
 
-		seconds_counter += delta_t;
+		seconds_counter += frame_time;
 		frame_count += 1;
 		if (seconds_counter > 1.0) {
 			latest_fps = frame_count;
@@ -14,12 +14,33 @@
 	void play_one_audio_clip_source_config(Audio_Source source, Audio_Playback_Config config);
 	void play_one_audio_clip_config(string path, Audio_Playback_Config config);
 	
+		Playing audio from the clip bank (decoded once, then played from memory):
+		
+	Audio_Clip_Handle audio_clip_bank_add(string path);  // Decoded on first play
+	Audio_Clip_Handle audio_clip_bank_load(string path); // Decoded right away
+	void              audio_clip_bank_load_all();
+	void play_one_audio_clip_handle(Audio_Clip_Handle handle, float volume);
+	void play_one_audio_clip_handle_with_priority(Audio_Clip_Handle handle, float volume, s32 priority);
+	void play_one_audio_clip_handle_with_config(Audio_Clip_Handle handle, Audio_Playback_Config config);
+	void audio_clip_bank_set_limits(Audio_Clip_Handle handle, s32 priority, u32 max_instances);
+	
+	play_one_audio_clip(path) uses the clip bank too, but looks the path up every time.
+	
+		Voice budget:
+		
+	void audio_set_max_voices(u32 max_voices); // AUDIO_DEFAULT_MAX_VOICES by default, 0 for no limit
+	
+	Past the budget, the lowest priority, then quietest, then oldest voices are faded out
+	quickly to make room (see audio_mixer_enforce_voice_budget).
+	
 		Playing audio (with players):
 	
 	Audio_Player * audio_player_get_one();
 	void           audio_player_release(Audio_Player *p);
 
-		BEWARE! Most of these operations are potentially slow because they may need to synchronize with audio thread.
+		These post a command to the audio thread, which applies it at the start of its next callback.
+		Getters return where the player will be once the posted commands are applied.
+		Call all of these from the same thread (normally the main thread).
 		
 	void    audio_player_set_state(Audio_Player *p, Audio_Player_State state);
 	void    audio_player_set_time_stamp(Audio_Player *p, float64 time_in_seconds);
@@ -28,8 +49,10 @@
 	float64 audio_player_get_time_stamp(Audio_Player *p);
 	float64 audio_player_get_current_progression_factor(Audio_Player *p);
 	void    audio_player_set_source(Audio_Player *p, Audio_Source src);
+	void    audio_player_transition_to_source(Audio_Player *p, Audio_Source src, float64 transition_seconds);
 	void    audio_player_clear_source(Audio_Player *p);
 	void    audio_player_set_looping(Audio_Player *p, bool looping);
+	void    audio_player_set_volume(Audio_Player *p, float32 volume);
 	
 		Configuring playback:
 		
@@ -39,6 +62,7 @@
 	player->config.spacial_listener_xform  = m4(...);
 	player->config.volume                = ...; // (1.0 by default)
 	player->config.playback_speed        = ...; // (1.0 by default)
+	player->config.priority              = ...; // (0 by default)
 	
 */
 
@@ -160,8 +184,6 @@ typedef struct Audio_Source {
 	// For memory source
 	void *pcm_frames;
 	
-	Mutex mutex_for_destroy; // This should ONLY be used so a source isnt sampled on audio thread while it's being destroyed
-	
 } Audio_Source;
 
 int 
@@ -606,8 +628,6 @@ audio_open_source_stream_format(Audio_Source *src, string path, Audio_Format for
 	src->uid = next_audio_source_uid;
 	next_audio_source_uid += 1;
 	
-	mutex_init(&src->mutex_for_destroy);
-	
 	src->allocator = allocator;
 	src->kind = AUDIO_SOURCE_FILE_STREAM;
 	
@@ -664,8 +684,6 @@ audio_open_source_load_format(Audio_Source *src, string path, Audio_Format forma
 	src->uid = next_audio_source_uid;
 	next_audio_source_uid += 1;
 	
-	mutex_init(&src->mutex_for_destroy);
-	
 	src->allocator = allocator;
 	src->kind = AUDIO_SOURCE_MEMORY;
 	src->format = format;
@@ -734,10 +752,14 @@ audio_open_source_load(Audio_Source *src, string path, Allocator allocator) {
 	return audio_open_source_load_format(src, path, format, allocator);
 }
 
+void
+audio_mixer_forget_source(u64 source_uid);
+
 void 
 audio_source_destroy(Audio_Source *src) {
 
-	mutex_acquire_or_wait(&src->mutex_for_destroy);
+	// Make sure the audio thread is done with it before we free anything
+	audio_mixer_forget_source(src->uid);
 
 	switch (src->kind) {
 		case AUDIO_SOURCE_FILE_STREAM: {
@@ -761,8 +783,6 @@ audio_source_destroy(Audio_Source *src) {
 			break;
 		}
 	}
-	
-	mutex_release(&src->mutex_for_destroy);
 }
 
 int
@@ -939,31 +959,333 @@ audio_source_sample_next_frames(Audio_Source *src, u64 first_frame_index, u64 nu
 #define S32_MIN -2147483648
 #define S32_MAX 2147483647
 
+///
+// Audio kernels
+// The per-sample loops of mixing, volume and s16<->f32 conversion, on interleaved samples
+// (so count is number_of_frames*channels). Picked at runtime from query_cpu_capabilities(),
+// see audio_get_kernels().
+//
+
+typedef struct Audio_Kernels {
+	// dst += src. s16 saturates, f32 doesn't clamp.
+	void (*mix_f32)(f32 *dst, f32 *src, u64 count);
+	void (*mix_s16)(s16 *dst, s16 *src, u64 count);
+	void (*gain_f32)(f32 *samples, u64 count, f32 gain);
+	void (*gain_s16)(s16 *samples, u64 count, f32 gain);
+	void (*s16_to_f32)(f32 *dst, s16 *src, u64 count);
+	void (*f32_to_s16)(s16 *dst, f32 *src, u64 count);
+	// count mono samples to count*2 interleaved stereo samples
+	void (*mono_to_stereo_f32)(f32 *dst, f32 *src, u64 count);
+	void (*mono_to_stereo_s16)(s16 *dst, s16 *src, u64 count);
+	
+	const char *name;
+	bool initted;
+} Audio_Kernels;
+
+inline s16 
+audio_saturate_s16(f32 x) {
+	// Truncates towards zero like _mm_cvttps_epi32
+	if (x >= (f32)S16_MAX) return S16_MAX;
+	if (x <= (f32)S16_MIN) return S16_MIN;
+	return (s16)x;
+}
+
+void 
+audio_mix_f32_scalar(f32 *dst, f32 *src, u64 count) {
+	for (u64 i = 0; i < count; i++) dst[i] += src[i];
+}
+void 
+audio_mix_s16_scalar(s16 *dst, s16 *src, u64 count) {
+	for (u64 i = 0; i < count; i++) dst[i] = (s16)clamp((s32)dst[i] + (s32)src[i], S16_MIN, S16_MAX);
+}
+void 
+audio_gain_f32_scalar(f32 *samples, u64 count, f32 gain) {
+	for (u64 i = 0; i < count; i++) samples[i] *= gain;
+}
+void 
+audio_gain_s16_scalar(s16 *samples, u64 count, f32 gain) {
+	for (u64 i = 0; i < count; i++) samples[i] = audio_saturate_s16((f32)samples[i] * gain);
+}
+void 
+audio_s16_to_f32_scalar(f32 *dst, s16 *src, u64 count) {
+	for (u64 i = 0; i < count; i++) dst[i] = (f32)src[i] * (1.0f / 32768.0f);
+}
+void 
+audio_f32_to_s16_scalar(s16 *dst, f32 *src, u64 count) {
+	for (u64 i = 0; i < count; i++) dst[i] = audio_saturate_s16(src[i] * 32768.0f);
+}
+void 
+audio_mono_to_stereo_f32_scalar(f32 *dst, f32 *src, u64 count) {
+	for (u64 i = 0; i < count; i++) { dst[i*2] = src[i]; dst[i*2+1] = src[i]; }
+}
+void 
+audio_mono_to_stereo_s16_scalar(s16 *dst, s16 *src, u64 count) {
+	for (u64 i = 0; i < count; i++) { dst[i*2] = src[i]; dst[i*2+1] = src[i]; }
+}
+
+#if ENABLE_SIMD && SIMD_ENABLE_SSE2
+
+// The scalar versions take the tail that doesn't fill a whole register
+
+void 
+audio_mix_f32_sse2(f32 *dst, f32 *src, u64 count) {
+	u64 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		_mm_storeu_ps(dst+i, _mm_add_ps(_mm_loadu_ps(dst+i), _mm_loadu_ps(src+i)));
+	}
+	audio_mix_f32_scalar(dst+i, src+i, count-i);
+}
+void 
+audio_mix_s16_sse2(s16 *dst, s16 *src, u64 count) {
+	u64 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i a = _mm_loadu_si128((__m128i*)(dst+i));
+		__m128i b = _mm_loadu_si128((__m128i*)(src+i));
+		_mm_storeu_si128((__m128i*)(dst+i), _mm_adds_epi16(a, b));
+	}
+	audio_mix_s16_scalar(dst+i, src+i, count-i);
+}
+void 
+audio_gain_f32_sse2(f32 *samples, u64 count, f32 gain) {
+	__m128 g = _mm_set1_ps(gain);
+	u64 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		_mm_storeu_ps(samples+i, _mm_mul_ps(_mm_loadu_ps(samples+i), g));
+	}
+	audio_gain_f32_scalar(samples+i, count-i, gain);
+}
+void 
+audio_gain_s16_sse2(s16 *samples, u64 count, f32 gain) {
+	__m128 g = _mm_set1_ps(gain);
+	__m128 lo_limit = _mm_set1_ps((f32)S16_MIN);
+	__m128 hi_limit = _mm_set1_ps((f32)S16_MAX);
+	u64 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i x = _mm_loadu_si128((__m128i*)(samples+i));
+		// Sign extend to s32 by putting each s16 in the high half and shifting down
+		__m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+		__m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+		lo = _mm_min_ps(_mm_max_ps(_mm_mul_ps(lo, g), lo_limit), hi_limit);
+		hi = _mm_min_ps(_mm_max_ps(_mm_mul_ps(hi, g), lo_limit), hi_limit);
+		_mm_storeu_si128((__m128i*)(samples+i), _mm_packs_epi32(_mm_cvttps_epi32(lo), _mm_cvttps_epi32(hi)));
+	}
+	audio_gain_s16_scalar(samples+i, count-i, gain);
+}
+void 
+audio_s16_to_f32_sse2(f32 *dst, s16 *src, u64 count) {
+	__m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+	u64 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i x = _mm_loadu_si128((__m128i*)(src+i));
+		__m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+		__m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+		_mm_storeu_ps(dst+i,   _mm_mul_ps(lo, scale));
+		_mm_storeu_ps(dst+i+4, _mm_mul_ps(hi, scale));
+	}
+	audio_s16_to_f32_scalar(dst+i, src+i, count-i);
+}
+void 
+audio_f32_to_s16_sse2(s16 *dst, f32 *src, u64 count) {
+	__m128 scale = _mm_set1_ps(32768.0f);
+	// Clamped before converting, cvttps gives 0x80000000 for anything out of range
+	__m128 lo_limit = _mm_set1_ps((f32)S16_MIN);
+	__m128 hi_limit = _mm_set1_ps((f32)S16_MAX);
+	u64 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128 lo = _mm_mul_ps(_mm_loadu_ps(src+i),   scale);
+		__m128 hi = _mm_mul_ps(_mm_loadu_ps(src+i+4), scale);
+		lo = _mm_min_ps(_mm_max_ps(lo, lo_limit), hi_limit);
+		hi = _mm_min_ps(_mm_max_ps(hi, lo_limit), hi_limit);
+		_mm_storeu_si128((__m128i*)(dst+i), _mm_packs_epi32(_mm_cvttps_epi32(lo), _mm_cvttps_epi32(hi)));
+	}
+	audio_f32_to_s16_scalar(dst+i, src+i, count-i);
+}
+void 
+audio_mono_to_stereo_f32_sse2(f32 *dst, f32 *src, u64 count) {
+	u64 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 x = _mm_loadu_ps(src+i);
+		_mm_storeu_ps(dst+i*2,   _mm_unpacklo_ps(x, x));
+		_mm_storeu_ps(dst+i*2+4, _mm_unpackhi_ps(x, x));
+	}
+	audio_mono_to_stereo_f32_scalar(dst+i*2, src+i, count-i);
+}
+void 
+audio_mono_to_stereo_s16_sse2(s16 *dst, s16 *src, u64 count) {
+	u64 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i x = _mm_loadu_si128((__m128i*)(src+i));
+		_mm_storeu_si128((__m128i*)(dst+i*2),   _mm_unpacklo_epi16(x, x));
+		_mm_storeu_si128((__m128i*)(dst+i*2+8), _mm_unpackhi_epi16(x, x));
+	}
+	audio_mono_to_stereo_s16_scalar(dst+i*2, src+i, count-i);
+}
+
+#if COMPILER_CAN_TARGET_AVX2
+
+// Not inline, these can't be inlined into code that isn't compiled for avx2
+
+TARGET_AVX2 void 
+audio_mix_f32_avx2(f32 *dst, f32 *src, u64 count) {
+	u64 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		_mm256_storeu_ps(dst+i, _mm256_add_ps(_mm256_loadu_ps(dst+i), _mm256_loadu_ps(src+i)));
+	}
+	audio_mix_f32_sse2(dst+i, src+i, count-i);
+}
+TARGET_AVX2 void 
+audio_mix_s16_avx2(s16 *dst, s16 *src, u64 count) {
+	u64 i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m256i a = _mm256_loadu_si256((__m256i*)(dst+i));
+		__m256i b = _mm256_loadu_si256((__m256i*)(src+i));
+		_mm256_storeu_si256((__m256i*)(dst+i), _mm256_adds_epi16(a, b));
+	}
+	audio_mix_s16_sse2(dst+i, src+i, count-i);
+}
+TARGET_AVX2 void 
+audio_gain_f32_avx2(f32 *samples, u64 count, f32 gain) {
+	__m256 g = _mm256_set1_ps(gain);
+	u64 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		_mm256_storeu_ps(samples+i, _mm256_mul_ps(_mm256_loadu_ps(samples+i), g));
+	}
+	audio_gain_f32_sse2(samples+i, count-i, gain);
+}
+TARGET_AVX2 void 
+audio_gain_s16_avx2(s16 *samples, u64 count, f32 gain) {
+	__m256 g = _mm256_set1_ps(gain);
+	__m256 lo_limit = _mm256_set1_ps((f32)S16_MIN);
+	__m256 hi_limit = _mm256_set1_ps((f32)S16_MAX);
+	u64 i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i*)(samples+i))));
+		__m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i*)(samples+i+8))));
+		lo = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(lo, g), lo_limit), hi_limit);
+		hi = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(hi, g), lo_limit), hi_limit);
+		// packs works within each 128 bit lane, so the middle two 64 bit blocks come out swapped
+		__m256i packed = _mm256_packs_epi32(_mm256_cvttps_epi32(lo), _mm256_cvttps_epi32(hi));
+		_mm256_storeu_si256((__m256i*)(samples+i), _mm256_permute4x64_epi64(packed, 0xD8));
+	}
+	audio_gain_s16_sse2(samples+i, count-i, gain);
+}
+TARGET_AVX2 void 
+audio_s16_to_f32_avx2(f32 *dst, s16 *src, u64 count) {
+	__m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+	u64 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i*)(src+i)));
+		_mm256_storeu_ps(dst+i, _mm256_mul_ps(_mm256_cvtepi32_ps(x), scale));
+	}
+	audio_s16_to_f32_sse2(dst+i, src+i, count-i);
+}
+TARGET_AVX2 void 
+audio_f32_to_s16_avx2(s16 *dst, f32 *src, u64 count) {
+	__m256 scale = _mm256_set1_ps(32768.0f);
+	__m256 lo_limit = _mm256_set1_ps((f32)S16_MIN);
+	__m256 hi_limit = _mm256_set1_ps((f32)S16_MAX);
+	u64 i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m256 lo = _mm256_mul_ps(_mm256_loadu_ps(src+i),   scale);
+		__m256 hi = _mm256_mul_ps(_mm256_loadu_ps(src+i+8), scale);
+		lo = _mm256_min_ps(_mm256_max_ps(lo, lo_limit), hi_limit);
+		hi = _mm256_min_ps(_mm256_max_ps(hi, lo_limit), hi_limit);
+		__m256i packed = _mm256_packs_epi32(_mm256_cvttps_epi32(lo), _mm256_cvttps_epi32(hi));
+		_mm256_storeu_si256((__m256i*)(dst+i), _mm256_permute4x64_epi64(packed, 0xD8));
+	}
+	audio_f32_to_s16_sse2(dst+i, src+i, count-i);
+}
+
+#endif // COMPILER_CAN_TARGET_AVX2
+
+#endif // ENABLE_SIMD && SIMD_ENABLE_SSE2
+
+// #Global
+ogb_instance Audio_Kernels audio_kernels;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Audio_Kernels audio_kernels = {0};
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+void
+audio_use_scalar_kernels(Audio_Kernels *k) {
+	k->mix_f32            = audio_mix_f32_scalar;
+	k->mix_s16            = audio_mix_s16_scalar;
+	k->gain_f32           = audio_gain_f32_scalar;
+	k->gain_s16           = audio_gain_s16_scalar;
+	k->s16_to_f32         = audio_s16_to_f32_scalar;
+	k->f32_to_s16         = audio_f32_to_s16_scalar;
+	k->mono_to_stereo_f32 = audio_mono_to_stereo_f32_scalar;
+	k->mono_to_stereo_s16 = audio_mono_to_stereo_s16_scalar;
+	k->name = "scalar";
+}
+
+// Fills in the fastest kernels this cpu (and build) can run, falling back to the scalar ones
+void
+audio_select_kernels(Audio_Kernels *k, Cpu_Capabilities cpu) {
+	audio_use_scalar_kernels(k);
+	
+#if ENABLE_SIMD && SIMD_ENABLE_SSE2
+	if (cpu.sse2) {
+		k->mix_f32            = audio_mix_f32_sse2;
+		k->mix_s16            = audio_mix_s16_sse2;
+		k->gain_f32           = audio_gain_f32_sse2;
+		k->gain_s16           = audio_gain_s16_sse2;
+		k->s16_to_f32         = audio_s16_to_f32_sse2;
+		k->f32_to_s16         = audio_f32_to_s16_sse2;
+		k->mono_to_stereo_f32 = audio_mono_to_stereo_f32_sse2;
+		k->mono_to_stereo_s16 = audio_mono_to_stereo_s16_sse2;
+		k->name = "sse2";
+	}
+	
+	#if COMPILER_CAN_TARGET_AVX2
+	if (cpu.sse2 && cpu.avx2) {
+		// mono_to_stereo stays sse2, it's just shuffles
+		k->mix_f32            = audio_mix_f32_avx2;
+		k->mix_s16            = audio_mix_s16_avx2;
+		k->gain_f32           = audio_gain_f32_avx2;
+		k->gain_s16           = audio_gain_s16_avx2;
+		k->s16_to_f32         = audio_s16_to_f32_avx2;
+		k->f32_to_s16         = audio_f32_to_s16_avx2;
+		k->name = "avx2";
+	}
+	#endif
+#endif
+}
+
+// Safe from any thread, if two threads select at the same time they write the same thing
+inline Audio_Kernels *
+audio_get_kernels() {
+	if (!audio_kernels.initted) {
+		Audio_Kernels k = {0};
+		audio_select_kernels(&k, query_cpu_capabilities());
+		audio_kernels = k;
+		MEMORY_BARRIER;
+		audio_kernels.initted = true;
+	}
+	return &audio_kernels;
+}
+
+// Same channel layout, just a different bit width
+void
+audio_convert_samples(void *dst, Audio_Format_Bits dst_bits, void *src, Audio_Format_Bits src_bits, u64 count) {
+	Audio_Kernels *kernels = audio_get_kernels();
+	if (dst_bits == src_bits) {
+		memcpy(dst, src, count*get_audio_bit_width_byte_size(dst_bits));
+	} else if (dst_bits == AUDIO_BITS_32 && src_bits == AUDIO_BITS_16) {
+		kernels->s16_to_f32((f32*)dst, (s16*)src, count);
+	} else if (dst_bits == AUDIO_BITS_16 && src_bits == AUDIO_BITS_32) {
+		kernels->f32_to_s16((s16*)dst, (f32*)src, count);
+	} else panic("Unhandled bits");
+}
+
 void 
 mix_frames(void *dst, void *src, u64 frame_count, Audio_Format format) {
-    u64 comp_size = get_audio_bit_width_byte_size(format.bit_width);
-    u64 frame_size = comp_size * format.channels;
-    u64 output_size = frame_count * frame_size;
-    
-    for (u64 frame = 0; frame < frame_count; frame++) {
-        
-        for (u64 c = 0; c < format.channels; c++) {
-
-            void *src_sample = (u8*)src + frame*frame_size + c*comp_size;
-            void *dst_sample = (u8*)dst + frame*frame_size + c*comp_size;
-
-            switch (format.bit_width) {
-                case AUDIO_BITS_32: {
-                	*((f32*)dst_sample) += *((f32*)src_sample);
-            	}
-                case AUDIO_BITS_16: {
-                    s16 dst_int = *((s16*)dst_sample);
-                    s16 src_int = *((s16*)src_sample);
-                    *((s16*)dst_sample) = (s16)clamp((s64)(dst_int + src_int), S16_MIN, S16_MAX);
-                    break;
-                }
-            }
-        }
+    u64 count = frame_count * format.channels;
+    switch (format.bit_width) {
+        case AUDIO_BITS_32: audio_get_kernels()->mix_f32((f32*)dst, (f32*)src, count); break;
+        case AUDIO_BITS_16: audio_get_kernels()->mix_s16((s16*)dst, (s16*)src, count); break;
+        default: panic("Unhandled bits");
     }
 }
 
@@ -1075,8 +1397,27 @@ convert_frames(void *dst, Audio_Format dst_format,
 	bool need_sample_conversion 
 		= dst_format.channels != src_format.channels 
 	   || dst_format.bit_width != src_format.bit_width;
-	// #Speed #Simd
-	if (need_sample_conversion) {
+	
+	// The common cases go through the audio kernels, anything else is done per component below
+	bool converted = false;
+	if (need_sample_conversion && dst_format.channels == src_format.channels) {
+		audio_convert_samples(dst, dst_format.bit_width, src, src_format.bit_width, src_frame_count*src_format.channels);
+		converted = true;
+	} else if (need_sample_conversion && src_format.channels == 1 && dst_format.channels == 2) {
+		void *mono = src;
+		if (dst_format.bit_width != src_format.bit_width) {
+			// Converted into the second half of dst first. Spreading it out from there is fine
+			// since the stereo samples being written never catch up with the mono samples
+			// that are still to be read.
+			mono = (u8*)dst + src_frame_count*dst_comp_size;
+			audio_convert_samples(mono, dst_format.bit_width, src, src_format.bit_width, src_frame_count);
+		}
+		if (dst_format.bit_width == AUDIO_BITS_32) audio_get_kernels()->mono_to_stereo_f32((f32*)dst, (f32*)mono, src_frame_count);
+		else                                       audio_get_kernels()->mono_to_stereo_s16((s16*)dst, (s16*)mono, src_frame_count);
+		converted = true;
+	}
+	
+	if (need_sample_conversion && !converted) {
 		for (u64 src_frame_index = 0; src_frame_index < src_frame_count; src_frame_index++) {
 	        void *src_frame = ((u8*)src) + src_frame_index*src_frame_size;
 	        void *dst_frame = ((u8*)dst) + src_frame_index*dst_frame_size;
@@ -1180,6 +1521,8 @@ convert_frames(void *dst, Audio_Format dst_format,
 
 
 #define AUDIO_SMOOTH_TRANSITION_TIME_MS 50
+#define AUDIO_VOICE_STEAL_FADE_MS 5
+#define AUDIO_DEFAULT_MAX_VOICES 64
 
 typedef enum Audio_Player_State {
 	AUDIO_PLAYER_STATE_PAUSED,
@@ -1199,15 +1542,26 @@ typedef struct Audio_Playback_Config {
 	float32 spacial_distance_max; // Distance above this will all be the same flat MAX spacialization
 	float32 volume;
 	float32 playback_speed;
+	s32 priority; // Higher priority voices steal lower ones when over the voice budget
 } Audio_Playback_Config;
 
+// What the game thread sees of a player's position, see audio_player_get_position()
+typedef struct Audio_Player_Position {
+	u64 frame_index;
+	u64 number_of_frames;
+	int sample_rate;
+	bool has_source;
+	u64 applied_command_index; // Last command for this player the audio thread applied, +1
+} Audio_Player_Position;
+
 typedef struct Audio_Player {
 	// You shouldn't set these directly.
 	// Set playback state with the player_xxxxx procedures
+	// These are owned by the audio thread. The player_xxxxx procedures post an Audio_Command
+	// which is applied at the start of the next audio callback.
 	Audio_Source source;
 	bool has_source;
-	bool allocated;
-	bool marked_for_release; // We release on audio thread
+	bool allocated; // Set by audio_player_get_one, cleared on the audio thread
 	Audio_Player_State state;
 	u64 frame_index;
 	bool looping;
@@ -1221,9 +1575,23 @@ typedef struct Audio_Player {
 	u64 transition_from_frame;
 	float32 transition_fade_start;
 	bool is_transitioning;
-	// I think we only need to sync when audio thread samples the source, which should be
-	// fairly quick and low contention, hence a spinlock.
-	Spinlock sample_lock; 
+	bool has_been_mixed;
+	bool stolen; // Fading out to make room for other voices, see audio_mixer_enforce_voice_budget()
+	u64 start_order; // Index of the command that started it, for stealing the oldest voice
+	u64 applied_command_index;
+	bool in_active_list;
+	u32 active_index; // In audio_mixer.active_players
+	
+	// Written by the audio thread, read with audio_player_get_position()
+	volatile u32 published_sequence; // Odd while it's being written
+	Audio_Player_Position published;
+	
+	// Owned by the thread posting commands
+	u32 generation; // Bumped in audio_player_get_one so commands for a previous owner are dropped
+	u64 last_command_index; // +1, 0 if nothing was posted since audio_player_get_one
+	Audio_Player_Position requested; // Where the player is once the posted commands are applied
+	
+	struct Audio_Player *next_free; // While it's in audio_mixer.free_players
 	
 	// #Cleanup
 	// Deprecated 3rd of August 2024
@@ -1243,66 +1611,221 @@ typedef struct Audio_Player_Block {
 	struct Audio_Player_Block *next;
 } Audio_Player_Block;
 
+// Audio commands
+// The game never touches player state directly, the audio_player_xxxxx procedures post an
+// Audio_Command to a single-producer/single-consumer ring which do_program_audio_sample
+// drains at the start of each callback. That way the audio thread owns all player state and
+// never waits on a lock.
+// Single producer means all commands must be posted from the same thread (normally the main
+// thread). That's asserted.
+typedef enum Audio_Command_Kind {
+	AUDIO_COMMAND_SET_STATE,
+	AUDIO_COMMAND_SET_SOURCE,
+	AUDIO_COMMAND_TRANSITION_TO_SOURCE,
+	AUDIO_COMMAND_CLEAR_SOURCE,
+	AUDIO_COMMAND_SEEK,
+	AUDIO_COMMAND_SET_LOOPING,
+	AUDIO_COMMAND_SET_VOLUME,
+	AUDIO_COMMAND_PLAY_ONE, // Source, playing, config and release when done, all at once
+	AUDIO_COMMAND_RELEASE,
+	AUDIO_COMMAND_FORGET_SOURCE, // Not for a player, stops every player using source_uid
+} Audio_Command_Kind;
+
+typedef struct Audio_Command {
+	Audio_Command_Kind kind;
+	Audio_Player *player;
+	u32 generation;
+	
+	Audio_Source source;
+	Audio_Playback_Config config;
+	union {
+		Audio_Player_State state;
+		u64 frame_index;
+		bool looping;
+		float32 volume;
+		float64 transition_seconds;
+		u64 source_uid;
+		u32 max_instances; // For PLAY_ONE, 0 for no limit
+	};
+} Audio_Command;
+
+// Must be a power of two
+#define AUDIO_COMMAND_QUEUE_CAPACITY 1024
+// Reserved (virtual memory) for audio_mixer.active_players
+#define AUDIO_MAX_PLAYERS (1024*1024)
+// How long to wait on a full queue before dropping commands (no audio device, probably)
+#define AUDIO_COMMAND_QUEUE_FULL_TIMEOUT_MS 50
+
+typedef struct Audio_Mixer {
+	Audio_Command commands[AUDIO_COMMAND_QUEUE_CAPACITY];
+	volatile u64 write_index; // Only written by the producer
+	volatile u64 read_index;  // Only written by the audio thread
+	u64 producer_thread_id;
+	
+	volatile bool is_sampling; // While do_program_audio_sample runs
+	volatile bool is_held; // See audio_mixer_hold()
+	
+	volatile u32 max_voices; // See audio_set_max_voices()
+	u64 stolen_voice_count; // Written by the audio thread
+	
+	// Players go back on the free list from both threads (mostly the audio thread, when it
+	// releases them), but are only taken off it by the producer in audio_player_get_one.
+	// With a single popper a player can't be popped and pushed back while someone else is
+	// popping it, so the compare and swap has no ABA problem.
+	Audio_Player *volatile free_players;
+	bool player_pool_initted; // Producer thread
+	
+	// Dense list of the players the audio thread knows about (it has applied a command for
+	// them), so it only ever walks those and not every slot in every block. Audio thread only.
+	Audio_Player **active_players;
+} Audio_Mixer;
+
 // #Global
 ogb_instance Audio_Player_Block audio_player_block;
+ogb_instance Audio_Mixer audio_mixer;
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
 Audio_Player_Block audio_player_block = {0};
+Audio_Mixer audio_mixer = { .max_voices = AUDIO_DEFAULT_MAX_VOICES };
 #endif
 
-Audio_Player *
-audio_player_get_one() {
-
-	Audio_Player_Block *block = &audio_player_block;
-	Audio_Player_Block *last = 0;
-	
-	while (block) {
-		
-		for (u64 i = 0; i < AUDIO_PLAYERS_PER_BLOCK; i++) {
-			if (!block->players[i].allocated) {
-			
-				memset(&block->players[i], 0, sizeof(block->players[i]));
-				block->players[i].allocated = true;
-				block->players[i].config.volume = 1.0;
-				block->players[i].config.playback_speed = 1.0;
-				
-				return &block->players[i];
+u64 // Index of the command +1, 0 if it was dropped
+audio_command_post(Audio_Command *command) {
+	Audio_Mixer *m = &audio_mixer;
+	
+	if (m->producer_thread_id == 0) m->producer_thread_id = context.thread_id;
+	assert(m->producer_thread_id == context.thread_id, "Audio players must only be used from one thread");
+	
+	u64 write_index = m->write_index;
+	
+	if (write_index - m->read_index >= AUDIO_COMMAND_QUEUE_CAPACITY) {
+		// The audio thread drains the queue every callback, so this is only a short wait
+		// unless it's not running at all.
+		float64 give_up_time = os_get_elapsed_seconds() + AUDIO_COMMAND_QUEUE_FULL_TIMEOUT_MS/1000.0;
+		while (write_index - m->read_index >= AUDIO_COMMAND_QUEUE_CAPACITY) {
+			if (os_get_elapsed_seconds() > give_up_time) {
+				local_persist bool warned = false;
+				if (!warned) {
+					log_warning("Audio command queue is full, dropping commands. Is the audio thread running?");
+					warned = true;
+				}
+				return 0;
 			}
+			os_yield_thread();
 		}
-		
-		last = block;
-		block = block->next;
 	}
 	
-	// No free player found, make another block
-	// #Volatile can't assign to last->next before this is zero initialized
-	Audio_Player_Block *new_block = alloc(get_heap_allocator(), sizeof(Audio_Player_Block));
+	m->commands[write_index & (AUDIO_COMMAND_QUEUE_CAPACITY-1)] = *command;
 	
-#if !DO_ZERO_INITIALIATION
-	memset(new_block, 0, sizeof(*new_block));
-#endif
+	MEMORY_BARRIER;
+	m->write_index = write_index + 1;
+	
+	return write_index + 1;
+}
+
+void
+audio_player_push_free(Audio_Player *p) {
+	while (true) {
+		Audio_Player *head = audio_mixer.free_players;
+		p->next_free = head;
+		if (compare_and_swap_64((volatile u64*)&audio_mixer.free_players, (u64)p, (u64)head)) break;
+	}
+}
+// Producer thread only. 0 if the free list is empty.
+Audio_Player *
+audio_player_pop_free() {
+	while (true) {
+		Audio_Player *head = audio_mixer.free_players;
+		if (!head) return 0;
+		if (compare_and_swap_64((volatile u64*)&audio_mixer.free_players, (u64)head->next_free, (u64)head)) {
+			return head;
+		}
+	}
+}
+
+// Audio thread only
+void
+audio_mixer_add_active_player(Audio_Player *p) {
+	assert(!p->in_active_list);
+	p->in_active_list = true;
+	p->active_index = growing_array_get_valid_count(audio_mixer.active_players);
+	growing_array_add((void**)&audio_mixer.active_players, &p);
+}
+// Audio thread only. Swaps the last active player into p's place.
+void
+audio_mixer_release_player(Audio_Player *p) {
+	if (p->in_active_list) {
+		Audio_Player **active = audio_mixer.active_players;
+		u32 last_index = growing_array_get_valid_count(active)-1;
+		active[p->active_index] = active[last_index];
+		active[p->active_index]->active_index = p->active_index;
+		growing_array_pop((void**)&audio_mixer.active_players);
+		p->in_active_list = false;
+	}
+	
+	p->allocated = false;
+	audio_player_push_free(p);
+}
 
-	last->next = new_block;
+// Audio thread only
+void
+audio_player_publish(Audio_Player *p) {
+	p->published_sequence += 1;
+	MEMORY_BARRIER;
+	p->published.frame_index      = p->frame_index;
+	p->published.number_of_frames = p->source.number_of_frames;
+	p->published.sample_rate      = p->source.format.sample_rate;
+	p->published.has_source       = p->has_source;
+	p->published.applied_command_index = p->applied_command_index;
+	MEMORY_BARRIER;
+	p->published_sequence += 1;
+}
 
-	new_block->players[0].allocated = true;
-	new_block->players[0].config.volume = 1.0;
-	block->players[0].config.playback_speed = 1.0;
-	return &new_block->players[0];
+// Where the player is once the commands posted so far are applied. So a get right after a
+// set returns what was set, even though the audio thread hasn't gotten to it yet.
+Audio_Player_Position
+audio_player_get_position(Audio_Player *p) {
+	Audio_Player_Position published;
+	u32 sequence;
+	do {
+		sequence = p->published_sequence;
+		MEMORY_BARRIER;
+		published = p->published;
+		MEMORY_BARRIER;
+	} while ((sequence & 1) || sequence != p->published_sequence);
+	
+	if (published.applied_command_index < p->last_command_index) return p->requested;
+	
+	return published;
 }
 
-void 
-audio_player_release(Audio_Player *p) {
-	p->marked_for_release = true;
+Audio_Command
+audio_player_command(Audio_Player *p, Audio_Command_Kind kind) {
+	Audio_Command command = ZERO(Audio_Command);
+	command.kind = kind;
+	command.player = p;
+	command.generation = p->generation;
+	return command;
+}
+bool
+audio_player_post(Audio_Player *p, Audio_Command *command, Audio_Player_Position requested) {
+	u64 command_index = audio_command_post(command);
+	if (command_index == 0) return false;
+	
+	p->last_command_index = command_index;
+	p->requested = requested;
+	return true;
 }
 
+// Audio thread only
 void
-audio_player_set_state(Audio_Player *p, Audio_Player_State state) {
+audio_player_apply_state(Audio_Player *p, Audio_Player_State state) {
 
 	if (p->state == state) return;
 
-	spinlock_acquire_or_wait(&p->sample_lock);
 	assert(p->frame_index <= p->source.number_of_frames);
 	p->state = state;
+	p->stolen = false;
 	
 	float64 full_duration 
 		= (float64)p->source.number_of_frames/(float64)p->source.format.sample_rate;
@@ -1319,88 +1842,10 @@ audio_player_set_state(Audio_Player *p, Audio_Player_State state) {
 	p->fade_in = p->state == AUDIO_PLAYER_STATE_PLAYING;
 	
 	p->fade_start = p->state == AUDIO_PLAYER_STATE_PLAYING ? 0.0 : p->current_fade;
-	
-	
-	spinlock_release(&p->sample_lock);
 }
+// Audio thread only
 void
-audio_player_set_time_stamp(Audio_Player *p, float64 time_in_seconds) {
-	spinlock_acquire_or_wait(&p->sample_lock);
-	assert(p->frame_index <= p->source.number_of_frames);
-	
-	float64 full_duration 
-		= (float64)p->source.number_of_frames/(float64)p->source.format.sample_rate;
-	time_in_seconds = clamp(time_in_seconds, 0, full_duration);
-	float64 progression = time_in_seconds/full_duration;
-	
-	p->frame_index = (u64)round((float64)p->source.number_of_frames*progression);
-	
-	spinlock_release(&p->sample_lock);
-}
-
-bool 
-audio_player_at_source_end(Audio_Player *p) {
-	spinlock_acquire_or_wait(&p->sample_lock);
-	assert(p->frame_index <= p->source.number_of_frames);
-	
-    bool finished = p->frame_index == p->source.number_of_frames;
-	
-	spinlock_release(&p->sample_lock);
-
-    return finished;
-}
-
-void // 0 - 1
-audio_player_set_progression_factor(Audio_Player *p, float64 factor) {
-	spinlock_acquire_or_wait(&p->sample_lock);
-	assert(p->frame_index <= p->source.number_of_frames);
-	
-	p->frame_index = (u64)round((float64)p->source.number_of_frames*factor);
-	
-	spinlock_release(&p->sample_lock);
-}
-float64 // seconds
-audio_player_get_time_stamp(Audio_Player *p) {
-	spinlock_acquire_or_wait(&p->sample_lock);
-	assert(p->frame_index <= p->source.number_of_frames);
-	
-	float64 full_duration 
-		= (float64)p->source.number_of_frames/(float64)p->source.format.sample_rate;
-	float64 progression = (float64)p->frame_index / (float64)p->source.number_of_frames;
-	
-	spinlock_release(&p->sample_lock);
-	
-	return progression*full_duration;
-}
-float64
-audio_player_get_current_progression_factor(Audio_Player *p) {
-	if (!p->has_source) return 0;
-	spinlock_acquire_or_wait(&p->sample_lock);
-	assert(p->frame_index <= p->source.number_of_frames);
-	
-	float64 progression = (float64)p->frame_index / (float64)p->source.number_of_frames;
-	
-	spinlock_release(&p->sample_lock);
-	
-	return progression;
-}
-void 
-audio_player_set_source(Audio_Player *p, Audio_Source src) {
-	
-	spinlock_acquire_or_wait(&p->sample_lock);
-
-	p->source = src;
-	p->has_source = true;
-	
-	p->frame_index = 0;
-	
-	spinlock_release(&p->sample_lock);
-}
-void 
-audio_player_transition_to_source(Audio_Player *p, Audio_Source src, float64 transition_seconds) {
-	
-	spinlock_acquire_or_wait(&p->sample_lock);
-
+audio_player_apply_transition(Audio_Player *p, Audio_Source src, float64 transition_seconds) {
 	float64 full_duration 
 		= (float64)p->source.number_of_frames / (float64)p->source.format.sample_rate;
 	float64 transition_factor = transition_seconds / full_duration;
@@ -1425,116 +1870,611 @@ audio_player_transition_to_source(Audio_Player *p, Audio_Source src, float64 tra
 	p->has_source = true;
 	
 	p->frame_index = 0;
-	
-	spinlock_release(&p->sample_lock);
 }
-void 
-audio_player_clear_source(Audio_Player *p) {
-	spinlock_acquire_or_wait(&p->sample_lock);
-	assert(p->frame_index <= p->source.number_of_frames);
-	
-	p->has_source = false;
-	p->state = AUDIO_PLAYER_STATE_PAUSED;
-	p->source = ZERO(Audio_Source);
-	
-	spinlock_release(&p->sample_lock);
+
+// Voice budget
+// At most audio_mixer.max_voices players are playing at once. Past that the lowest priority
+// (Audio_Playback_Config.priority), then quietest, then oldest voices are stolen: faded out
+// over AUDIO_VOICE_STEAL_FADE_MS, and released if they were play_one_xxx voices. Voices that
+// weren't mixed yet are dropped right away, so the mixer never mixes more than max_voices
+// players, plus the ones still fading out.
+
+// Audio thread only. Whether p counts against the voice budget.
+bool
+audio_player_is_voice(Audio_Player *p) {
+	return p->allocated && p->has_source && !p->stolen && p->state == AUDIO_PLAYER_STATE_PLAYING
+		&& (p->looping || p->frame_index < p->source.number_of_frames);
+}
+
+// Audio thread only. Whether voice a should be stolen before voice b.
+bool
+audio_voice_steal_before(Audio_Player *a, Audio_Player *b) {
+	if (a->config.priority != b->config.priority) return a->config.priority < b->config.priority;
+	if (a->config.volume   != b->config.volume)   return a->config.volume < b->config.volume;
+	return a->start_order < b->start_order;
 }
+
+// Audio thread only
 void
-audio_player_set_looping(Audio_Player *p, bool looping) {
-	spinlock_acquire_or_wait(&p->sample_lock);
+audio_player_steal(Audio_Player *p) {
+	p->stolen = true;
+	p->state = AUDIO_PLAYER_STATE_PAUSED;
+	audio_mixer.stolen_voice_count += 1;
 	
-	if (p->has_source && looping && !p->looping && p->frame_index == p->source.number_of_frames) {
-		p->frame_index = 0;
-	}
+	u64 fade_frames = (u64)p->source.format.sample_rate*AUDIO_VOICE_STEAL_FADE_MS/1000;
+	if (!p->looping) fade_frames = min(fade_frames, p->source.number_of_frames - p->frame_index);
 	
-	p->looping = looping;
+	if (!p->has_been_mixed || fade_frames == 0) {
+		// Nothing to fade from
+		p->fade_frames_remaining = 0;
+	} else {
+		// #Copypaste
+		p->fade_frames_remaining = fade_frames;
+		p->fade_frames_total = fade_frames;
+		p->fade_in = false;
+		p->fade_start = p->current_fade > 0 ? p->current_fade : 1.0;
+		p->is_transitioning = false;
+	}
 	
-	spinlock_release(&p->sample_lock);
+	audio_player_publish(p);
 }
 
-// #Global
-ogb_instance Hash_Table just_audio_clips;
-ogb_instance bool just_audio_clips_initted;
-
-
-#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
-Hash_Table just_audio_clips;
-bool just_audio_clips_initted = false;
-#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
-
-// #Cleanup
-// Deprecated 3rd of August 2024
+// Audio thread only. Steals the oldest voices of source_uid until there are fewer than max_instances.
 void
-DEPRECATED(play_one_audio_clip_source_at_position(Audio_Source source, Vector3 pos), "Use play_one_audio_clip_source_with_config() instead") {
-	Audio_Player *p = audio_player_get_one();
-	audio_player_set_source(p, source);
-	audio_player_set_state(p, AUDIO_PLAYER_STATE_PLAYING);
-	p->config.position = pos;
-	p->config.enable_spacialization = true;
-	p->release_when_done = true;
+audio_mixer_make_room_for_instance(u64 source_uid, u32 max_instances) {
+	while (true) {
+		u64 instance_count = 0;
+		Audio_Player *oldest = 0;
+		for (u64 i = 0; i < growing_array_get_valid_count(audio_mixer.active_players); i++) {
+			Audio_Player *p = audio_mixer.active_players[i];
+			if (!audio_player_is_voice(p) || p->source.uid != source_uid) continue;
+			instance_count += 1;
+			if (!oldest || p->start_order < oldest->start_order) oldest = p;
+		}
+		if (instance_count < max_instances) break;
+		audio_player_steal(oldest);
+	}
 }
 
+// Audio thread only, after the commands are applied
 void
-play_one_audio_clip_source_with_config(Audio_Source source, Audio_Playback_Config config) {
-	Audio_Player *p = audio_player_get_one();
-	audio_player_set_source(p, source);
-	audio_player_set_state(p, AUDIO_PLAYER_STATE_PLAYING);
-	p->config = config;
-	p->release_when_done = true;
+audio_mixer_enforce_voice_budget() {
+	u32 max_voices = audio_mixer.max_voices;
+	if (max_voices == 0) return;
+	
+	Audio_Player **active = audio_mixer.active_players;
+	
+	u64 voice_count = 0;
+	for (u64 i = 0; i < growing_array_get_valid_count(active); i++) {
+		if (audio_player_is_voice(active[i])) voice_count += 1;
+	}
+	
+	while (voice_count > max_voices) {
+		Audio_Player *victim = 0;
+		for (u64 i = 0; i < growing_array_get_valid_count(active); i++) {
+			Audio_Player *p = active[i];
+			if (!audio_player_is_voice(p)) continue;
+			if (!victim || audio_voice_steal_before(p, victim)) victim = p;
+		}
+		audio_player_steal(victim);
+		voice_count -= 1;
+	}
 }
 
-void inline 
-play_one_audio_clip_source(Audio_Source source) {
-	Audio_Playback_Config config = {0};
-	config.volume = 1.0;
-	config.playback_speed = 1.0;
-	play_one_audio_clip_source_with_config(source, config);
+// Audio thread only
+void
+audio_mixer_apply_command(Audio_Command *command, u64 command_index) {
+
+	if (command->kind == AUDIO_COMMAND_FORGET_SOURCE) {
+		for (u64 i = 0; i < growing_array_get_valid_count(audio_mixer.active_players); i++) {
+			Audio_Player *p = audio_mixer.active_players[i];
+			if (p->is_transitioning && p->transition_from_source.uid == command->source_uid) {
+				p->is_transitioning = false;
+			}
+			if (p->has_source && p->source.uid == command->source_uid) {
+				p->has_source = false;
+				p->state = AUDIO_PLAYER_STATE_PAUSED;
+				p->source = ZERO(Audio_Source);
+				p->frame_index = 0;
+				p->fade_frames_remaining = 0;
+				p->is_transitioning = false;
+				audio_player_publish(p);
+			}
+		}
+		return;
+	}
+
+	Audio_Player *p = command->player;
+	
+	// Released, and maybe handed out again since this was posted
+	if (!p->allocated || p->generation != command->generation) return;
+	
+	if (command->kind == AUDIO_COMMAND_RELEASE) {
+		audio_mixer_release_player(p);
+		return;
+	}
+	
+	if (!p->in_active_list) audio_mixer_add_active_player(p);
+	
+	switch (command->kind) {
+		case AUDIO_COMMAND_SET_STATE: {
+			if (command->state == AUDIO_PLAYER_STATE_PLAYING && p->state != command->state) {
+				p->start_order = command_index;
+			}
+			audio_player_apply_state(p, command->state);
+			break;
+		}
+		case AUDIO_COMMAND_SET_SOURCE: {
+			p->source = command->source;
+			p->has_source = true;
+			p->frame_index = 0;
+			break;
+		}
+		case AUDIO_COMMAND_TRANSITION_TO_SOURCE: {
+			audio_player_apply_transition(p, command->source, command->transition_seconds);
+			break;
+		}
+		case AUDIO_COMMAND_CLEAR_SOURCE: {
+			assert(p->frame_index <= p->source.number_of_frames);
+			p->has_source = false;
+			p->state = AUDIO_PLAYER_STATE_PAUSED;
+			p->source = ZERO(Audio_Source);
+			p->frame_index = 0;
+			break;
+		}
+		case AUDIO_COMMAND_SEEK: {
+			p->frame_index = min(command->frame_index, p->source.number_of_frames);
+			break;
+		}
+		case AUDIO_COMMAND_SET_LOOPING: {
+			if (p->has_source && command->looping && !p->looping && p->frame_index == p->source.number_of_frames) {
+				p->frame_index = 0;
+			}
+			p->looping = command->looping;
+			break;
+		}
+		case AUDIO_COMMAND_SET_VOLUME: {
+			p->config.volume = command->volume;
+			break;
+		}
+		case AUDIO_COMMAND_PLAY_ONE: {
+			if (command->max_instances > 0) {
+				audio_mixer_make_room_for_instance(command->source.uid, command->max_instances);
+			}
+			p->source = command->source;
+			p->has_source = true;
+			p->frame_index = 0;
+			audio_player_apply_state(p, AUDIO_PLAYER_STATE_PLAYING);
+			p->config = command->config;
+			p->release_when_done = true;
+			p->start_order = command_index;
+			break;
+		}
+		default: panic("Unhandled audio command");
+	}
+	
+	p->applied_command_index = command_index;
+	audio_player_publish(p);
 }
 
-// #Cleanup
-// Deprecated 3rd of August 2024
+// Audio thread only, at the start of each callback
 void
-DEPRECATED(play_one_audio_clip_at_position(string path, Vector3 pos), "Use play_one_audio_clip_with_config() instead") {
-	if (!just_audio_clips_initted) {
-		just_audio_clips_initted = true;
-		just_audio_clips = make_hash_table(string, Audio_Source, get_heap_allocator());
+audio_mixer_apply_commands() {
+	Audio_Mixer *m = &audio_mixer;
+	
+	if (!m->active_players) {
+		// Virtual so adding on the audio thread never copies
+		growing_array_init_virtual((void**)&m->active_players, sizeof(Audio_Player*), AUDIO_MAX_PLAYERS);
 	}
 	
-	Audio_Source *src_ptr = hash_table_find(&just_audio_clips, path);
-	if (src_ptr) {
-		play_one_audio_clip_source_at_position(*src_ptr, pos);
-	} else {
-		Audio_Source new_src;
-		bool ok = audio_open_source_stream(&new_src, path, get_heap_allocator());
-		if (!ok) {
-			log_error("Could not load audio to play from %s", path);
-			return;
+	u64 write_index = m->write_index;
+	MEMORY_BARRIER;
+	
+	for (u64 i = m->read_index; i < write_index; i++) {
+		audio_mixer_apply_command(&m->commands[i & (AUDIO_COMMAND_QUEUE_CAPACITY-1)], i + 1);
+	}
+	
+	MEMORY_BARRIER;
+	m->read_index = write_index;
+	
+	audio_mixer_enforce_voice_budget();
+}
+
+// 0 for no limit. Applied from the next audio callback.
+void
+audio_set_max_voices(u32 max_voices) {
+	audio_mixer.max_voices = max_voices;
+}
+
+// Tells the audio thread to stop using a source and waits until it has. Either it's past the
+// command, or it's between callbacks, in which case the next callback applies the command
+// before it samples anything.
+void
+audio_mixer_forget_source(u64 source_uid) {
+	Audio_Command command = ZERO(Audio_Command);
+	command.kind = AUDIO_COMMAND_FORGET_SOURCE;
+	command.source_uid = source_uid;
+	u64 command_index = audio_command_post(&command);
+	
+	MEMORY_BARRIER;
+	while (audio_mixer.is_sampling && (command_index == 0 || audio_mixer.read_index < command_index)) {
+		os_yield_thread();
+	}
+}
+
+// Makes the audio thread output silence without touching any player or command until
+// audio_mixer_resume(), so something else can run audio_mix_players() (the benchmarks).
+void
+audio_mixer_hold() {
+	audio_mixer.is_held = true;
+	MEMORY_BARRIER;
+	while (audio_mixer.is_sampling) {
+		os_yield_thread();
+	}
+}
+void
+audio_mixer_resume() {
+	MEMORY_BARRIER;
+	audio_mixer.is_held = false;
+}
+
+// Producer thread only
+void
+audio_player_free_block(Audio_Player_Block *block, u64 first_index) {
+	// Backwards so they're handed out in order
+	for (s64 i = AUDIO_PLAYERS_PER_BLOCK-1; i >= (s64)first_index; i--) {
+		audio_player_push_free(&block->players[i]);
+	}
+}
+
+Audio_Player *
+audio_player_get_one() {
+
+	if (!audio_mixer.player_pool_initted) {
+		audio_mixer.player_pool_initted = true;
+		audio_player_free_block(&audio_player_block, 0);
+	}
+
+	Audio_Player *p = audio_player_pop_free();
+	
+	if (!p) {
+		// No free player, make another block
+		Audio_Player_Block *last = &audio_player_block;
+		u64 block_count = 1;
+		while (last->next) {
+			last = last->next;
+			block_count += 1;
 		}
-		hash_table_add(&just_audio_clips, path, new_src);
-		play_one_audio_clip_source_at_position(new_src, pos);
+		assert((block_count+1)*AUDIO_PLAYERS_PER_BLOCK <= AUDIO_MAX_PLAYERS, "Too many audio players");
+		
+		Audio_Player_Block *new_block = alloc(get_heap_allocator(), sizeof(Audio_Player_Block));
+#if !DO_ZERO_INITIALIATION
+		memset(new_block, 0, sizeof(*new_block));
+#endif
+		last->next = new_block;
+		
+		audio_player_free_block(new_block, 1);
+		p = &new_block->players[0];
 	}
 	
+	u32 generation = p->generation + 1;
+	memset(p, 0, sizeof(*p));
+	p->generation = generation;
+	p->config.volume = 1.0;
+	p->config.playback_speed = 1.0;
+	
+	MEMORY_BARRIER;
+	p->allocated = true;
+	
+	return p;
 }
+
+void 
+audio_player_release(Audio_Player *p) {
+	Audio_Command command = audio_player_command(p, AUDIO_COMMAND_RELEASE);
+	audio_player_post(p, &command, ZERO(Audio_Player_Position));
+}
+
 void
-play_one_audio_clip_with_config(string path, Audio_Playback_Config config) {
-	if (!just_audio_clips_initted) {
-		just_audio_clips_initted = true;
-		just_audio_clips = make_hash_table(string, Audio_Source, get_heap_allocator());
+audio_player_set_state(Audio_Player *p, Audio_Player_State state) {
+	Audio_Command command = audio_player_command(p, AUDIO_COMMAND_SET_STATE);
+	command.state = state;
+	audio_player_post(p, &command, audio_player_get_position(p));
+}
+void
+audio_player_set_time_stamp(Audio_Player *p, float64 time_in_seconds) {
+	Audio_Player_Position position = audio_player_get_position(p);
+	assert(position.frame_index <= position.number_of_frames);
+	
+	if (position.number_of_frames == 0) return;
+	
+	float64 full_duration 
+		= (float64)position.number_of_frames/(float64)position.sample_rate;
+	time_in_seconds = clamp(time_in_seconds, 0, full_duration);
+	float64 progression = time_in_seconds/full_duration;
+	
+	position.frame_index = (u64)round((float64)position.number_of_frames*progression);
+	
+	Audio_Command command = audio_player_command(p, AUDIO_COMMAND_SEEK);
+	command.frame_index = position.frame_index;
+	audio_player_post(p, &command, position);
+}
+
+bool 
+audio_player_at_source_end(Audio_Player *p) {
+	Audio_Player_Position position = audio_player_get_position(p);
+	assert(position.frame_index <= position.number_of_frames);
+	
+    return position.frame_index == position.number_of_frames;
+}
+
+void // 0 - 1
+audio_player_set_progression_factor(Audio_Player *p, float64 factor) {
+	Audio_Player_Position position = audio_player_get_position(p);
+	assert(position.frame_index <= position.number_of_frames);
+	
+	position.frame_index = (u64)round((float64)position.number_of_frames*clamp(factor, 0, 1));
+	
+	Audio_Command command = audio_player_command(p, AUDIO_COMMAND_SEEK);
+	command.frame_index = position.frame_index;
+	audio_player_post(p, &command, position);
+}
+float64 // seconds
+audio_player_get_time_stamp(Audio_Player *p) {
+	Audio_Player_Position position = audio_player_get_position(p);
+	assert(position.frame_index <= position.number_of_frames);
+	
+	if (position.number_of_frames == 0) return 0;
+	
+	float64 full_duration 
+		= (float64)position.number_of_frames/(float64)position.sample_rate;
+	float64 progression = (float64)position.frame_index / (float64)position.number_of_frames;
+	
+	return progression*full_duration;
+}
+float64
+audio_player_get_current_progression_factor(Audio_Player *p) {
+	Audio_Player_Position position = audio_player_get_position(p);
+	if (!position.has_source || position.number_of_frames == 0) return 0;
+	assert(position.frame_index <= position.number_of_frames);
+	
+	return (float64)position.frame_index / (float64)position.number_of_frames;
+}
+void 
+audio_player_set_source(Audio_Player *p, Audio_Source src) {
+	Audio_Command command = audio_player_command(p, AUDIO_COMMAND_SET_SOURCE);
+	command.source = src;
+	
+	Audio_Player_Position position = {0};
+	position.number_of_frames = src.number_of_frames;
+	position.sample_rate = src.format.sample_rate;
+	position.has_source = true;
+	audio_player_post(p, &command, position);
+}
+void 
+audio_player_transition_to_source(Audio_Player *p, Audio_Source src, float64 transition_seconds) {
+	Audio_Command command = audio_player_command(p, AUDIO_COMMAND_TRANSITION_TO_SOURCE);
+	command.source = src;
+	command.transition_seconds = transition_seconds;
+	
+	Audio_Player_Position position = {0};
+	position.number_of_frames = src.number_of_frames;
+	position.sample_rate = src.format.sample_rate;
+	position.has_source = true;
+	audio_player_post(p, &command, position);
+}
+void 
+audio_player_clear_source(Audio_Player *p) {
+	Audio_Command command = audio_player_command(p, AUDIO_COMMAND_CLEAR_SOURCE);
+	audio_player_post(p, &command, ZERO(Audio_Player_Position));
+}
+void
+audio_player_set_looping(Audio_Player *p, bool looping) {
+	Audio_Player_Position position = audio_player_get_position(p);
+	if (position.has_source && looping && position.frame_index == position.number_of_frames) {
+		position.frame_index = 0;
 	}
 	
-	Audio_Source *src_ptr = hash_table_find(&just_audio_clips, path);
-	if (src_ptr) {
-		play_one_audio_clip_source_with_config(*src_ptr, config);
-	} else {
-		Audio_Source new_src;
-		bool ok = audio_open_source_stream(&new_src, path, get_heap_allocator());
-		if (!ok) {
-			log_error("Could not load audio to play from %s", path);
-			return;
+	Audio_Command command = audio_player_command(p, AUDIO_COMMAND_SET_LOOPING);
+	command.looping = looping;
+	audio_player_post(p, &command, position);
+}
+// Same as setting player->config.volume, but applied in order with the other commands
+void
+audio_player_set_volume(Audio_Player *p, float32 volume) {
+	Audio_Command command = audio_player_command(p, AUDIO_COMMAND_SET_VOLUME);
+	command.volume = volume;
+	audio_player_post(p, &command, audio_player_get_position(p));
+}
+
+// Audio clip bank
+// Clips are decoded once (into audio_output_format, with audio_open_source_load) and then
+// kept in memory, so playing one only copies frames on the audio thread, no file I/O or
+// decoding. Clips are addressed by an Audio_Clip_Handle, which is just index+1 into
+// audio_clip_bank.clips, so 0 is never a valid clip.
+// Everything here is meant to be called from the same thread as the play_one_xxx functions.
+// Clips are decoded fully, so for long music use an Audio_Player with a streamed source.
+typedef u32 Audio_Clip_Handle;
+#define AUDIO_CLIP_HANDLE_INVALID 0
+
+typedef struct Audio_Clip_Bank_Entry {
+	string path;
+	Audio_Source source;
+	bool loaded;
+	bool failed; // Logged once, not retried
+	s32 priority; // Used by play_one_audio_clip_handle
+	u32 max_instances; // How many voices of this clip can play at once, 0 for no limit
+} Audio_Clip_Bank_Entry;
+
+typedef struct Audio_Clip_Bank {
+	Audio_Clip_Bank_Entry *clips; // Growing array
+	Hash_Table handles_by_path;
+	bool initted;
+} Audio_Clip_Bank;
+
+// #Global
+ogb_instance Audio_Clip_Bank audio_clip_bank;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Audio_Clip_Bank audio_clip_bank = {0};
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+// Returns the handle for path, registering it if it's new. Decoded on first play.
+Audio_Clip_Handle
+audio_clip_bank_add(string path) {
+	Audio_Clip_Bank *bank = &audio_clip_bank;
+	if (!bank->initted) {
+		bank->initted = true;
+		growing_array_init((void**)&bank->clips, sizeof(Audio_Clip_Bank_Entry), get_heap_allocator());
+		bank->handles_by_path = make_hash_table(string, Audio_Clip_Handle, get_heap_allocator());
+	}
+	
+	Audio_Clip_Handle *existing = hash_table_find(&bank->handles_by_path, path);
+	if (existing) return *existing;
+	
+	Audio_Clip_Bank_Entry entry = ZERO(Audio_Clip_Bank_Entry);
+	entry.path = string_copy(path, get_heap_allocator());
+	growing_array_add((void**)&bank->clips, &entry);
+	
+	Audio_Clip_Handle handle = (Audio_Clip_Handle)growing_array_get_valid_count(bank->clips);
+	hash_table_add(&bank->handles_by_path, entry.path, handle);
+	
+	return handle;
+}
+
+// 0 if the handle isn't valid
+Audio_Clip_Bank_Entry *
+audio_clip_bank_get_entry(Audio_Clip_Handle handle) {
+	Audio_Clip_Bank *bank = &audio_clip_bank;
+	if (handle == AUDIO_CLIP_HANDLE_INVALID || !bank->initted || handle > growing_array_get_valid_count(bank->clips)) {
+		return 0;
+	}
+	return &bank->clips[handle-1];
+}
+
+// Decodes the clip if that hasn't been done yet. 0 if it couldn't be loaded.
+Audio_Source *
+audio_clip_bank_get_source(Audio_Clip_Handle handle) {
+	Audio_Clip_Bank_Entry *entry = audio_clip_bank_get_entry(handle);
+	if (!entry) return 0;
+	
+	if (!entry->loaded && !entry->failed) {
+		bool ok = audio_open_source_load(&entry->source, entry->path, get_heap_allocator());
+		if (ok) {
+			entry->loaded = true;
+		} else {
+			entry->failed = true;
+			log_error("Could not load audio to play from %s", entry->path);
 		}
-		hash_table_add(&just_audio_clips, path, new_src);
-		play_one_audio_clip_source_with_config(new_src, config);
 	}
+	
+	return entry->loaded ? &entry->source : 0;
+}
+
+// Registers and decodes right away, so the first play doesn't hitch
+Audio_Clip_Handle
+audio_clip_bank_load(string path) {
+	Audio_Clip_Handle handle = audio_clip_bank_add(path);
+	audio_clip_bank_get_source(handle);
+	return handle;
+}
+
+// When more than max_instances voices of the clip would play, the oldest one is stolen.
+// priority is only the default, play_one_audio_clip_handle_with_priority/config override it.
+void
+audio_clip_bank_set_limits(Audio_Clip_Handle handle, s32 priority, u32 max_instances) {
+	Audio_Clip_Bank_Entry *entry = audio_clip_bank_get_entry(handle);
+	if (!entry) return;
+	entry->priority = priority;
+	entry->max_instances = max_instances;
+}
+
+void
+audio_clip_bank_load_all() {
+	for (u64 i = 0; i < growing_array_get_valid_count(audio_clip_bank.clips); i++) {
+		audio_clip_bank_get_source((Audio_Clip_Handle)(i+1));
+	}
+}
+
+// Steals the oldest voice of the same source if max_instances (0 for no limit) are playing
+void
+play_one_audio_clip_source_with_limit(Audio_Source source, Audio_Playback_Config config, u32 max_instances) {
+	Audio_Player *p = audio_player_get_one();
+	Audio_Command command = audio_player_command(p, AUDIO_COMMAND_PLAY_ONE);
+	command.source = source;
+	command.config = config;
+	command.max_instances = max_instances;
+	
+	Audio_Player_Position position = {0};
+	position.number_of_frames = source.number_of_frames;
+	position.sample_rate = source.format.sample_rate;
+	position.has_source = true;
+	if (!audio_player_post(p, &command, position)) {
+		// Nothing will ever release it on the audio thread
+		p->allocated = false;
+		audio_player_push_free(p);
+	}
+}
+
+void
+play_one_audio_clip_source_with_config(Audio_Source source, Audio_Playback_Config config) {
+	play_one_audio_clip_source_with_limit(source, config, 0);
+}
+
+// #Cleanup
+// Deprecated 3rd of August 2024
+void
+DEPRECATED(play_one_audio_clip_source_at_position(Audio_Source source, Vector3 pos), "Use play_one_audio_clip_source_with_config() instead") {
+	Audio_Playback_Config config = {0};
+	config.volume = 1.0;
+	config.playback_speed = 1.0;
+	config.position = pos;
+	config.enable_spacialization = true;
+	play_one_audio_clip_source_with_config(source, config);
+}
+
+void inline 
+play_one_audio_clip_source(Audio_Source source) {
+	Audio_Playback_Config config = {0};
+	config.volume = 1.0;
+	config.playback_speed = 1.0;
+	play_one_audio_clip_source_with_config(source, config);
+}
+
+void
+play_one_audio_clip_handle_with_config(Audio_Clip_Handle handle, Audio_Playback_Config config) {
+	Audio_Source *src = audio_clip_bank_get_source(handle);
+	if (!src) return;
+	play_one_audio_clip_source_with_limit(*src, config, audio_clip_bank_get_entry(handle)->max_instances);
+}
+void inline
+play_one_audio_clip_handle_with_priority(Audio_Clip_Handle handle, float volume, s32 priority) {
+	Audio_Playback_Config config = {0};
+	config.volume = volume;
+	config.playback_speed = 1.0;
+	config.priority = priority;
+	play_one_audio_clip_handle_with_config(handle, config);
+}
+void inline
+play_one_audio_clip_handle(Audio_Clip_Handle handle, float volume) {
+	Audio_Clip_Bank_Entry *entry = audio_clip_bank_get_entry(handle);
+	if (!entry) return;
+	play_one_audio_clip_handle_with_priority(handle, volume, entry->priority);
+}
+
+// #Cleanup
+// Deprecated 3rd of August 2024
+void
+DEPRECATED(play_one_audio_clip_at_position(string path, Vector3 pos), "Use play_one_audio_clip_with_config() instead") {
+	Audio_Source *src = audio_clip_bank_get_source(audio_clip_bank_add(path));
+	if (!src) return;
+	play_one_audio_clip_source_at_position(*src, pos);
+}
+// Goes through the clip bank too, but hashes the path each time. Keep the handle from 
+// audio_clip_bank_add/load and use play_one_audio_clip_handle for sounds played often.
+void
+play_one_audio_clip_with_config(string path, Audio_Playback_Config config) {
+	play_one_audio_clip_handle_with_config(audio_clip_bank_add(path), config);
 }
 void inline
 play_one_audio_clip(string path, float volume) {
@@ -1724,45 +2664,35 @@ void apply_audio_spacialization(void* frames, Audio_Format format, u64 number_of
 void apply_audio_volume(void* frames, Audio_Format format, u64 number_of_frames, float32 vol) {
 	
 	// #Speed
-	// This is lazy, also it can be combined with other passes.
+	// This could still be combined with other passes.
 
-	u64 comp_size  = get_audio_bit_width_byte_size(format.bit_width);
-    u64 frame_size = comp_size * format.channels;
+	u64 count = number_of_frames * format.channels;
 	if (vol <= 0.0) {
-		memset(frames, 0, frame_size*number_of_frames);
+		memset(frames, 0, count*get_audio_bit_width_byte_size(format.bit_width));
+		return;
 	}
 	
-	for (u64 i = 0; i < number_of_frames; ++i) {
-        for (u64 c = 0; c < format.channels; ++c) {
-        	float32 sample;
-            convert_one_component(
-            	&sample, 
-            	AUDIO_BITS_32, 
-            	(u8*)frames+i*frame_size+c*comp_size, 
-            	format.bit_width
-        	);
-        	
-        	sample *= vol;
-        	
-			convert_one_component(
-            	(u8*)frames+i*frame_size+c*comp_size, 
-            	format.bit_width,
-            	&sample, 
-            	AUDIO_BITS_32
-        	);
-        }
-    }
+	switch (format.bit_width) {
+		case AUDIO_BITS_32: audio_get_kernels()->gain_f32((f32*)frames, count, vol); break;
+		case AUDIO_BITS_16: audio_get_kernels()->gain_s16((s16*)frames, count, vol); break;
+		default: panic("Unhandled bits");
+	}
 }
 
+// Records are indexed by source uid, so this bounds how many audio sources can be made
+#define AUDIO_MAX_SOURCE_UIDS (1024*1024*16)
+
 // #Global
 float64 *audio_source_start_time_records = 0;
-// This is supposed to be called by OS layer audio thread whenever it wants more audio samples
+// Applies the posted commands, then mixes every playing player into output
 void 
-do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format, 
-							 void *output) {
+audio_mix_players(u64 number_of_output_frames, Audio_Format out_format, 
+				  void *output) {
 							 
 	reset_temporary_storage();
 	
+	audio_mixer_apply_commands();
+	
 	audio_prepare_intermediate_buffers();
 							 
 	u64 out_comp_size  = get_audio_bit_width_byte_size(out_format.bit_width);
@@ -1771,287 +2701,295 @@ do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format,
     
 	memset(output, 0, output_size);
 	
-	Audio_Player_Block *block = &audio_player_block;
-	
 	if (!audio_source_start_time_records) {
-		growing_array_init_reserve((void**)&audio_source_start_time_records, sizeof(float64), next_audio_source_uid, get_heap_allocator());
+		// Virtual so resizing on the audio thread never copies
+		growing_array_init_virtual((void**)&audio_source_start_time_records, sizeof(float64), AUDIO_MAX_SOURCE_UIDS);
 	}
 	
 	if (growing_array_get_valid_count(audio_source_start_time_records) < next_audio_source_uid) {
 		growing_array_resize((void**)&audio_source_start_time_records, next_audio_source_uid);
 	}
 	
-	while (block) {
+	Audio_Player **active = audio_mixer.active_players;
+	
+	u64 active_index = 0;
+	while (active_index < growing_array_get_valid_count(active)) {
+		Audio_Player *p = active[active_index];
+		if (p->release_when_done && (p->frame_index >= p->source.number_of_frames
+									  || !p->has_source
+									  || (p->stolen && p->fade_frames_remaining == 0))) {
+			// Moves the last player into active_index
+			audio_mixer_release_player(p);
+			continue;
+		}
+		active_index += 1;
+	}
+	
+	for (u64 i = 0; i < growing_array_get_valid_count(active); i++) {
+		Audio_Player *p = active[i];
 		
-		for (u64 i = 0; i < AUDIO_PLAYERS_PER_BLOCK; i++) {
-			Audio_Player *p = &block->players[i];
-			if (p->release_when_done && (p->frame_index >= p->source.number_of_frames
-										  || !p->has_source)) {
-				p->allocated = false;
-			}
-			if (!p->allocated) {
-				continue;
-			}
-			
-			if (p->marked_for_release) {
-				p->marked_for_release = false;
-				p->allocated = false;
-				continue;
-			}
-			
-			if (p->state != AUDIO_PLAYER_STATE_PLAYING) {
-				if (p->fade_frames_remaining == 0) continue;
+		if (p->state != AUDIO_PLAYER_STATE_PLAYING) {
+			if (p->fade_frames_remaining == 0) continue;
+		}
+		
+		// #Incomplete Reverse playback ?
+		if (p->config.playback_speed <= 0.0) continue;
+		
+		if (p->frame_index >= p->source.number_of_frames && !p->looping) continue;
+		
+		audio_prepare_intermediate_buffers();
+		
+		Audio_Source src = p->source;
+		
+		Audio_Format sample_format = src.format;
+		sample_format.sample_rate = sample_format.sample_rate*p->config.playback_speed;
+		
+		bool need_convert = !bytes_match(
+			&out_format, 
+			&sample_format, 
+			sizeof(Audio_Format)
+		);
+		
+		u64 in_comp_size 
+			= get_audio_bit_width_byte_size(sample_format.bit_width);
+		
+		u64 in_frame_size = in_comp_size * sample_format.channels;
+		u64 input_size = number_of_output_frames * in_frame_size;
+		
+		void *mix_buffer = audio_get_intermediate_buffer(output_size);
+		memset(mix_buffer, 0, output_size);
+		
+		void *target_buffer = mix_buffer;
+		u64 number_of_sample_frames = number_of_output_frames;
+		
+		void *convert_buffer = 0;
+		u64 convert_buffer_size = 0;
+		
+		if (need_convert) {
+			if (sample_format.sample_rate != out_format.sample_rate) {
+				f64 src_ratio 
+					= (f64)sample_format.sample_rate 
+					  / (f64)out_format.sample_rate;
+					
+				number_of_sample_frames = round(number_of_output_frames * src_ratio);
+				input_size = number_of_sample_frames * in_frame_size;
 			}
 			
-			// #Incomplete Reverse playback ?
-			if (p->config.playback_speed <= 0.0) continue;
-			
-			if (p->frame_index >= p->source.number_of_frames && !p->looping) continue;
+			convert_buffer_size = max(input_size, output_size);
+			convert_buffer = audio_get_intermediate_buffer(convert_buffer_size);
 			
-			spinlock_acquire_or_wait(&p->sample_lock);
-			
-			audio_prepare_intermediate_buffers();
-			
-			Audio_Source src = p->source;
+			target_buffer = convert_buffer;
 			
-			mutex_acquire_or_wait(&src.mutex_for_destroy);
+		}
 
-			Audio_Format sample_format = src.format;
-			sample_format.sample_rate = sample_format.sample_rate*p->config.playback_speed;
-			
-			bool need_convert = !bytes_match(
-				&out_format, 
-				&sample_format, 
-				sizeof(Audio_Format)
-			);
-			
-			u64 in_comp_size 
-				= get_audio_bit_width_byte_size(sample_format.bit_width);
-			
-			u64 in_frame_size = in_comp_size * sample_format.channels;
-			u64 input_size = number_of_output_frames * in_frame_size;
+		// :PhaseCancellation
+		if (p->frame_index == 0) { 
+		
+			float64 start_time = audio_source_start_time_records[src.uid];
+			float64 now = os_get_elapsed_seconds();
+
+			float64 time_since_last_source_started = now - start_time;
 			
-			void *mix_buffer = audio_get_intermediate_buffer(output_size);
-			memset(mix_buffer, 0, output_size);
+			// 60 ms cooldown
+			if (time_since_last_source_started < 60.0/1000.0) {
+				// #Bug ? Loopy loopers will just loop around. Not sure how we would deal with loopy loopers here
+				p->frame_index = src.number_of_frames;
+				audio_player_publish(p);
+				continue;
+			}
 			
-			void *target_buffer = mix_buffer;
-			u64 number_of_sample_frames = number_of_output_frames;
+			audio_source_start_time_records[src.uid] = now;
+		}
+
+		u64 last_frame_index = p->frame_index;
+		p->frame_index = audio_source_sample_next_frames(
+			&src,
+			p->frame_index, 
+			number_of_sample_frames,
+			target_buffer,
+			p->looping
+		);
+		if (p->frame_index > last_frame_index && (p->looping || p->frame_index != src.number_of_frames)) {
+			assert(p->frame_index - last_frame_index == number_of_sample_frames);
+		}
+		
+		if (p->fade_frames_remaining > 0) {
+			u64 frames_to_fade = min(p->fade_frames_remaining, number_of_sample_frames);
 			
-			void *convert_buffer = 0;
-			u64 convert_buffer_size = 0;
+			u64 frames_faded_so_far = (p->fade_frames_total-p->fade_frames_remaining);
 			
-			if (need_convert) {
-				if (sample_format.sample_rate != out_format.sample_rate) {
-					f64 src_ratio 
-						= (f64)sample_format.sample_rate 
-						  / (f64)out_format.sample_rate;
-						
-					number_of_sample_frames = round(number_of_output_frames * src_ratio);
-					input_size = number_of_sample_frames * in_frame_size;
-				}
-				
-				convert_buffer_size = max(input_size, output_size);
-				convert_buffer = audio_get_intermediate_buffer(convert_buffer_size);
+			float64 fade_prog = (f64)frames_faded_so_far / (f64)p->fade_frames_total;
+			if (p->fade_in) {
 				
-				target_buffer = convert_buffer;
-				
-			}
-	
-			// :PhaseCancellation
-			if (p->frame_index == 0) { 
-			
-				float64 start_time = audio_source_start_time_records[src.uid];
-				float64 now = os_get_elapsed_seconds();
-
-				float64 time_since_last_source_started = now - start_time;
+				float64 fade_from = p->fade_start + fade_prog*(1.0-p->fade_start);
+					
+				float64 fade_to = fade_from + frames_to_fade / (f64)p->fade_frames_total;
 				
-				// 60 ms cooldown
-				if (time_since_last_source_started < 60.0/1000.0) {
-					spinlock_release(&p->sample_lock);
-					// #Bug ? Loopy loopers will just loop around. Not sure how we would deal with loopy loopers here
-					p->frame_index = src.number_of_frames;
-					continue;
-				}
+				audio_apply_fade_in(
+					target_buffer, 
+					frames_to_fade, 
+					p->source.format, 
+					fade_from,
+					fade_to
+				);
+				p->current_fade = fade_to;
 				
-				audio_source_start_time_records[src.uid] = now;
-			}
-	
-			u64 last_frame_index = p->frame_index;
-			p->frame_index = audio_source_sample_next_frames(
-				&src,
-				p->frame_index, 
-				number_of_sample_frames,
-				target_buffer,
-				p->looping
-			);
-			if (p->frame_index > last_frame_index && (p->looping || p->frame_index != src.number_of_frames)) {
-				assert(p->frame_index - last_frame_index == number_of_sample_frames);
-			}
-			
-			if (p->fade_frames_remaining > 0) {
-				u64 frames_to_fade = min(p->fade_frames_remaining, number_of_sample_frames);
+				if (p->is_transitioning) {
 				
-				u64 frames_faded_so_far = (p->fade_frames_total-p->fade_frames_remaining);
+					Audio_Format transition_format = p->transition_from_source.format;
 				
-				float64 fade_prog = (f64)frames_faded_so_far / (f64)p->fade_frames_total;
-				if (p->fade_in) {
-					
-					float64 fade_from = p->fade_start + fade_prog*(1.0-p->fade_start);
-						
-					float64 fade_to = fade_from + frames_to_fade / (f64)p->fade_frames_total;
-					
-					audio_apply_fade_in(
-						target_buffer, 
-						frames_to_fade, 
-						p->source.format, 
-						fade_from,
-						fade_to
-					);
-					p->current_fade = fade_to;
+					u64 number_of_transition_frames = number_of_sample_frames;
 					
-					if (p->is_transitioning) {
+					u64 tran_comp_size
+						= get_audio_bit_width_byte_size(transition_format.bit_width);
+					u64 tran_frame_size = tran_comp_size * transition_format.channels;
+					u64 transition_size = number_of_transition_frames * tran_frame_size;
 					
-						Audio_Format transition_format = p->transition_from_source.format;
+					void *tran_target_buffer = 0;
 					
-						u64 number_of_transition_frames = number_of_sample_frames;
-						
-						u64 tran_comp_size
-							= get_audio_bit_width_byte_size(transition_format.bit_width);
-						u64 tran_frame_size = tran_comp_size * transition_format.channels;
-						u64 transition_size = number_of_transition_frames * tran_frame_size;
-						
-						void *tran_target_buffer = 0;
-						
-						void *transition_convert_buffer = 0;
-						if (p->source.format.sample_rate != transition_format.sample_rate) {
-							f64 src_ratio 
-								= (f64)transition_format.sample_rate 
-								  / (f64)p->source.format.sample_rate;
-								
-							number_of_transition_frames = round(number_of_transition_frames * src_ratio);
-							transition_size = number_of_transition_frames * tran_frame_size;
+					void *transition_convert_buffer = 0;
+					if (p->source.format.sample_rate != transition_format.sample_rate) {
+						f64 src_ratio 
+							= (f64)transition_format.sample_rate 
+							  / (f64)p->source.format.sample_rate;
 							
-							void *transition_convert_buffer 
-								= audio_get_intermediate_buffer(max(transition_size, input_size));
-								
-							tran_target_buffer = transition_convert_buffer;
-						}
-						
-						void *transition_buffer = audio_get_intermediate_buffer(transition_size);
-						if (!tran_target_buffer) tran_target_buffer = transition_buffer;
+						number_of_transition_frames = round(number_of_transition_frames * src_ratio);
+						transition_size = number_of_transition_frames * tran_frame_size;
 						
-						p->transition_from_frame = audio_source_sample_next_frames(
-							&p->transition_from_source,
-							p->transition_from_frame, 
-							frames_to_fade,
-							tran_target_buffer,
-							p->looping
-						);
-						
-						if (memcmp(&transition_format, &sample_format, sizeof(Audio_Format)) != 0) {
-							int converted = convert_frames(
-								transition_buffer, 
-								sample_format, 
-								transition_convert_buffer, 
-								transition_format,
-								number_of_sample_frames
-							);
-							assert(converted == number_of_sample_frames);
-						}
-						
-						
-						
-						audio_apply_fade_out(
-							transition_buffer, 
-							frames_to_fade, 
-							transition_format, 
-							p->transition_fade_start - (fade_from)*p->transition_fade_start,
-							p->transition_fade_start - (fade_from)*p->transition_fade_start + (fade_to-fade_from)
-						);
-						
-						mix_frames(target_buffer, transition_buffer, number_of_sample_frames, sample_format);
-						
-						if (frames_faded_so_far+frames_to_fade == p->fade_frames_total) {
-							p->is_transitioning = false;
-						}
+						void *transition_convert_buffer 
+							= audio_get_intermediate_buffer(max(transition_size, input_size));
+							
+						tran_target_buffer = transition_convert_buffer;
 					}
 					
-				} else {
+					void *transition_buffer = audio_get_intermediate_buffer(transition_size);
+					if (!tran_target_buffer) tran_target_buffer = transition_buffer;
 					
-					p->is_transitioning = false;
+					p->transition_from_frame = audio_source_sample_next_frames(
+						&p->transition_from_source,
+						p->transition_from_frame, 
+						frames_to_fade,
+						tran_target_buffer,
+						p->looping
+					);
+					
+					if (memcmp(&transition_format, &sample_format, sizeof(Audio_Format)) != 0) {
+						int converted = convert_frames(
+							transition_buffer, 
+							sample_format, 
+							transition_convert_buffer, 
+							transition_format,
+							number_of_sample_frames
+						);
+						assert(converted == number_of_sample_frames);
+					}
 					
-					float64 fade_from = p->fade_start - fade_prog*(p->fade_start);
 					
-					float64 fade_to = fade_from - (frames_to_fade / (f64)p->fade_frames_total)*fade_from;
 					
 					audio_apply_fade_out(
-						target_buffer, 
+						transition_buffer, 
 						frames_to_fade, 
-						p->source.format, 
-						fade_from,
-						fade_to
+						transition_format, 
+						p->transition_fade_start - (fade_from)*p->transition_fade_start,
+						p->transition_fade_start - (fade_from)*p->transition_fade_start + (fade_to-fade_from)
 					);
-					p->current_fade = fade_to;
 					
-					if (frames_to_fade < number_of_sample_frames) {
-						memset(
-							(u8*)target_buffer+(frames_to_fade*out_frame_size), 
-							0, 
-							(number_of_sample_frames-frames_to_fade)*out_frame_size
-						);
+					mix_frames(target_buffer, transition_buffer, number_of_sample_frames, sample_format);
+					
+					if (frames_faded_so_far+frames_to_fade == p->fade_frames_total) {
+						p->is_transitioning = false;
 					}
 				}
 				
-				p->fade_frames_remaining -= frames_to_fade;
 			} else {
+				
 				p->is_transitioning = false;
-			}
-			
-			spinlock_release(&p->sample_lock);
-						
-			if (need_convert) {
-				int converted = convert_frames(
-					mix_buffer, 
-					out_format, 
-					convert_buffer, 
-					sample_format,
-					number_of_output_frames
-				);
-				assert(converted == number_of_output_frames);
-			}
-
-			if (p->config.enable_spacialization) {
-				Matrix4 view = m4_inverse(p->config.spacial_listener_xform);
 				
-				Matrix4 world_to_clip = m4_mul(view, p->config.spacial_projection);
+				float64 fade_from = p->fade_start - fade_prog*(p->fade_start);
 				
-				Vector3 ndc = m4_transform(world_to_clip, v4(v3_expand(p->config.position), 0.0)).xyz;
+				float64 fade_to = fade_from - (frames_to_fade / (f64)p->fade_frames_total)*fade_from;
 				
-				if (p->config.spacial_distance_max > p->config.spacial_distance_min) {
-		
-					Vector3 pos_in_view = m4_transform(view, v4(v3_expand(p->config.position), 1.0)).xyz;
-					
-					float32 distance = fabsf(v3_length(pos_in_view));
-					float32 distance_min = p->config.spacial_distance_min;
-					float32 distance_max = p->config.spacial_distance_max;
-					
-					float32 distance_scale_factor 
-							= clamp((distance-distance_min)/(distance_max-distance_min), 0, 1);
-					ndc = v3_mulf(v3_normalize(ndc), distance_scale_factor);
-				}
+				audio_apply_fade_out(
+					target_buffer, 
+					frames_to_fade, 
+					p->source.format, 
+					fade_from,
+					fade_to
+				);
+				p->current_fade = fade_to;
 				
-				apply_audio_spacialization(mix_buffer, out_format, number_of_output_frames, ndc);
-			}
-			if (p->config.volume != 0.0) {
-				apply_audio_volume(mix_buffer, out_format, number_of_output_frames, p->config.volume);
+				if (frames_to_fade < number_of_sample_frames) {
+					memset(
+						(u8*)target_buffer+(frames_to_fade*out_frame_size), 
+						0, 
+						(number_of_sample_frames-frames_to_fade)*out_frame_size
+					);
+				}
 			}
 			
-			mix_frames(output, mix_buffer, number_of_output_frames, out_format);
+			p->fade_frames_remaining -= frames_to_fade;
+		} else {
+			p->is_transitioning = false;
+		}
+		
+		p->has_been_mixed = true;
+		audio_player_publish(p);
+					
+		if (need_convert) {
+			int converted = convert_frames(
+				mix_buffer, 
+				out_format, 
+				convert_buffer, 
+				sample_format,
+				number_of_output_frames
+			);
+			assert(converted == number_of_output_frames);
+		}
+
+		if (p->config.enable_spacialization) {
+			Matrix4 view = m4_inverse(p->config.spacial_listener_xform);
+			
+			Matrix4 world_to_clip = m4_mul(view, p->config.spacial_projection);
 			
+			Vector3 ndc = m4_transform(world_to_clip, v4(v3_expand(p->config.position), 0.0)).xyz;
+			
+			if (p->config.spacial_distance_max > p->config.spacial_distance_min) {
+	
+				Vector3 pos_in_view = m4_transform(view, v4(v3_expand(p->config.position), 1.0)).xyz;
+				
+				float32 distance = fabsf(v3_length(pos_in_view));
+				float32 distance_min = p->config.spacial_distance_min;
+				float32 distance_max = p->config.spacial_distance_max;
+				
+				float32 distance_scale_factor 
+						= clamp((distance-distance_min)/(distance_max-distance_min), 0, 1);
+				ndc = v3_mulf(v3_normalize(ndc), distance_scale_factor);
+			}
 			
-			mutex_release(&src.mutex_for_destroy);
+			apply_audio_spacialization(mix_buffer, out_format, number_of_output_frames, ndc);
+		}
+		if (p->config.volume != 0.0) {
+			apply_audio_volume(mix_buffer, out_format, number_of_output_frames, p->config.volume);
 		}
 		
-		block = block->next;
+		mix_frames(output, mix_buffer, number_of_output_frames, out_format);
 	}
 }
+
+// This is supposed to be called by OS layer audio thread whenever it wants more audio samples
+void 
+do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format, 
+							 void *output) {
+	audio_mixer.is_sampling = true;
+	MEMORY_BARRIER;
+	
+	if (audio_mixer.is_held) {
+		u64 frame_size = get_audio_bit_width_byte_size(out_format.bit_width)*out_format.channels;
+		memset(output, 0, number_of_output_frames*frame_size);
+	} else {
+		audio_mix_players(number_of_output_frames, out_format, output);
+	}
+	
+	MEMORY_BARRIER;
+	audio_mixer.is_sampling = false;
+}
@@ -62,6 +62,8 @@ typedef enum Allocator_Message {
 	ALLOCATOR_ALLOCATE,
 	ALLOCATOR_DEALLOCATE,
 	ALLOCATOR_REALLOCATE,
+	// Grow the allocation at p to size without moving it. Returns p, or 0 if the allocator can't.
+	ALLOCATOR_REALLOCATE_IN_PLACE,
 } Allocator_Message;
 typedef void*(*Allocator_Proc)(u64, void*, Allocator_Message, void*);
 
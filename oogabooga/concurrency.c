@@ -131,4 +131,192 @@ void mutex_release(Mutex *m) {
 	}
 }
 
-#endif
\ No newline at end of file
+#endif
+
+///
+// Parallel radix sort
+// Same result as radix_sort_key_index_pairs (utility.c), but every pass is counted and then
+// scattered by thread_count threads (the calling thread is one of them). Each thread keeps
+// its own histogram over its slice, and these are merged with a digit-major prefix sum so
+// each thread knows where to scatter its slice and the sort stays stable.
+// Below PARALLEL_RADIX_SORT_MIN_COUNT pairs, with one thread, or while another parallel sort
+// is already running, it sorts serially on the calling thread.
+// The worker threads run at normal priority. They are started on first use and then kept
+// around waiting for more work until parallel_radix_sort_deinit (called on program exit).
+#define PARALLEL_RADIX_SORT_MAX_THREADS 32
+#define PARALLEL_RADIX_SORT_MIN_COUNT (1024*64)
+
+ogb_instance u64*
+radix_sort_key_index_pairs_parallel(u64 *pairs, u64 *help_pairs, u64 count, u64 number_of_bits, u64 thread_count);
+
+// Stops and joins the worker threads. Sorting again afterwards starts them again.
+ogb_instance void
+parallel_radix_sort_deinit();
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+typedef enum Parallel_Radix_Sort_Job {
+	PARALLEL_RADIX_SORT_JOB_COUNT,
+	PARALLEL_RADIX_SORT_JOB_SCATTER,
+	PARALLEL_RADIX_SORT_JOB_QUIT,
+} Parallel_Radix_Sort_Job;
+
+typedef struct Parallel_Radix_Sort_Worker {
+	Thread thread;
+	Binary_Semaphore start_sem;
+	Binary_Semaphore done_sem;
+	u64 index;
+} Parallel_Radix_Sort_Worker;
+
+typedef struct Parallel_Radix_Sort {
+	// Worker 0 is the calling thread, so that one is never started
+	Parallel_Radix_Sort_Worker workers[PARALLEL_RADIX_SORT_MAX_THREADS];
+	u64 started_worker_count;
+	volatile bool busy;
+	
+	Parallel_Radix_Sort_Job job;
+	u64 *src;
+	u64 *dst;
+	u64 count;
+	u64 thread_count;
+	u32 shift;
+	// Histogram per thread for the COUNT job, turned into scatter offsets for the SCATTER job
+	u64 counts[PARALLEL_RADIX_SORT_MAX_THREADS][256];
+} Parallel_Radix_Sort;
+
+// #Global
+Parallel_Radix_Sort parallel_radix_sort = {0};
+
+void parallel_radix_sort_run(u64 worker_index) {
+	Parallel_Radix_Sort *s = &parallel_radix_sort;
+	
+	u64 begin = (s->count*worker_index)/s->thread_count;
+	u64 end   = (s->count*(worker_index+1))/s->thread_count;
+	u64 *src = s->src;
+	u64 *counts = s->counts[worker_index];
+	u32 shift = s->shift;
+	
+	switch (s->job) {
+		case PARALLEL_RADIX_SORT_JOB_COUNT: {
+			memset(counts, 0, sizeof(s->counts[0]));
+			for (u64 i = begin; i < end; i++) {
+				counts[(src[i] >> shift) & 0xFF] += 1;
+			}
+			break;
+		}
+		case PARALLEL_RADIX_SORT_JOB_SCATTER: {
+			u64 *dst = s->dst;
+			for (u64 i = begin; i < end; i++) {
+				u32 digit = (src[i] >> shift) & 0xFF;
+				dst[counts[digit]++] = src[i];
+			}
+			break;
+		}
+		default: break;
+	}
+}
+
+void parallel_radix_sort_worker_proc(Thread *t) {
+	Parallel_Radix_Sort_Worker *worker = (Parallel_Radix_Sort_Worker*)t->data;
+	while (true) {
+		os_binary_semaphore_wait(&worker->start_sem);
+		if (parallel_radix_sort.job == PARALLEL_RADIX_SORT_JOB_QUIT) break;
+		parallel_radix_sort_run(worker->index);
+		os_binary_semaphore_signal(&worker->done_sem);
+	}
+}
+
+void parallel_radix_sort_dispatch(Parallel_Radix_Sort_Job job) {
+	Parallel_Radix_Sort *s = &parallel_radix_sort;
+	s->job = job;
+	for (u64 i = 1; i < s->thread_count; i++) {
+		os_binary_semaphore_signal(&s->workers[i].start_sem);
+	}
+	parallel_radix_sort_run(0);
+	for (u64 i = 1; i < s->thread_count; i++) {
+		os_binary_semaphore_wait(&s->workers[i].done_sem);
+	}
+}
+
+u64 *radix_sort_key_index_pairs_parallel(u64 *pairs, u64 *help_pairs, u64 count, u64 number_of_bits, u64 thread_count) {
+	Parallel_Radix_Sort *s = &parallel_radix_sort;
+	
+	thread_count = min(thread_count, PARALLEL_RADIX_SORT_MAX_THREADS);
+	if (thread_count <= 1 || count < PARALLEL_RADIX_SORT_MIN_COUNT || !compare_and_swap_bool(&s->busy, true, false)) {
+		return radix_sort_key_index_pairs(pairs, help_pairs, count, number_of_bits);
+	}
+	assert(number_of_bits <= 32, "Keys are 32 bits at most");
+	
+	while (s->started_worker_count < thread_count-1) {
+		Parallel_Radix_Sort_Worker *worker = &s->workers[s->started_worker_count+1];
+		worker->index = s->started_worker_count+1;
+		os_binary_semaphore_init(&worker->start_sem, false);
+		os_binary_semaphore_init(&worker->done_sem, false);
+		os_thread_init(&worker->thread, parallel_radix_sort_worker_proc);
+		worker->thread.data = worker;
+		worker->thread.normal_priority = true;
+		os_thread_start(&worker->thread);
+		s->started_worker_count += 1;
+	}
+	
+	s->count = count;
+	s->thread_count = thread_count;
+	
+	u64 *src = pairs;
+	u64 *dst = help_pairs;
+	u32 pass_count = (u32)((number_of_bits + 7) / 8);
+	for (u32 pass = 0; pass < pass_count; pass++) {
+		s->src = src;
+		s->dst = dst;
+		s->shift = 32 + pass*8;
+		parallel_radix_sort_dispatch(PARALLEL_RADIX_SORT_JOB_COUNT);
+		
+		// Digit-major, thread-minor: equal digits keep the order of the slices they came from
+		bool single_bucket = false;
+		u64 sum = 0;
+		for (u32 digit = 0; digit < 256; digit++) {
+			u64 digit_total = 0;
+			for (u64 t = 0; t < thread_count; t++) {
+				u64 c = s->counts[t][digit];
+				s->counts[t][digit] = sum;
+				sum += c;
+				digit_total += c;
+			}
+			if (digit_total == count) single_bucket = true;
+		}
+		if (single_bucket) continue;
+		
+		parallel_radix_sort_dispatch(PARALLEL_RADIX_SORT_JOB_SCATTER);
+		
+		u64 *t = src;
+		src = dst;
+		dst = t;
+	}
+	
+	MEMORY_BARRIER;
+	s->busy = false;
+	
+	return src;
+}
+
+void parallel_radix_sort_deinit() {
+	Parallel_Radix_Sort *s = &parallel_radix_sort;
+	
+	bool ok = compare_and_swap_bool(&s->busy, true, false);
+	assert(ok, "parallel_radix_sort_deinit was called while a parallel sort is running");
+	
+	s->job = PARALLEL_RADIX_SORT_JOB_QUIT;
+	for (u64 i = 1; i <= s->started_worker_count; i++) {
+		Parallel_Radix_Sort_Worker *worker = &s->workers[i];
+		os_binary_semaphore_signal(&worker->start_sem);
+		os_thread_destroy(&worker->thread);
+		os_binary_semaphore_destroy(&worker->start_sem);
+		os_binary_semaphore_destroy(&worker->done_sem);
+	}
+	s->started_worker_count = 0;
+	
+	MEMORY_BARRIER;
+	s->busy = false;
+}
+
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
@@ -75,6 +75,10 @@ typedef struct Cpu_Capabilities {
 	
 	#define DEPRECATED(proc, msg) __declspec(deprecated(msg)) func
 	
+	// MSVC lets any function use any instruction set
+	#define TARGET_AVX2
+	#define COMPILER_CAN_TARGET_AVX2 1
+	
 	#pragma intrinsic(_InterlockedCompareExchange8)
 	#pragma intrinsic(_InterlockedCompareExchange16)
 	#pragma intrinsic(_InterlockedCompareExchange)
@@ -172,6 +176,11 @@ typedef struct Cpu_Capabilities {
 	
 	#define DEPRECATED(proc, msg) __attribute__((deprecated(msg))) proc 
 	
+	// For procedures that are only called if query_cpu_capabilities() says the cpu can run them,
+	// so they can use instructions the rest of the program isn't compiled for.
+	#define TARGET_AVX2 __attribute__((target("avx2")))
+	#define COMPILER_CAN_TARGET_AVX2 1
+	
 	inline bool 
 	compare_and_swap_8(volatile uint8_t *a, uint8_t b, uint8_t old) {
 	    unsigned char result;
@@ -251,6 +260,9 @@ typedef struct Cpu_Capabilities {
     
     #define DEPRECATED(proc, msg) 
     
+    #define TARGET_AVX2
+    #define COMPILER_CAN_TARGET_AVX2 0
+    
     #define MEMORY_BARRIER
     
     #warning "Compiler is not explicitly supported, some things will probably not work as expected"
@@ -64,7 +64,8 @@
 			- See struct Draw_Quad. 
 			- If you need to customize a quad more, such as setting the UV or image filtering, then most other 
 				draw_xxx functions will return a Draw_Quad* which you can modify Retroactively. Keep in mind 
-				that the returned pointer is only guaranteed to be valid BEFORE you call other draw functions.
+				that the returned pointer is only valid BEFORE you call other draw functions, after that
+				it points at the next quad drawn instead.
 				See "- Retroactively modifying quads" for more info about Draw_Quad
 				
 		- Layer sorting, scissor boxing/cropping:
@@ -93,6 +94,9 @@
 			The projection and xform gets applied directly in each draw_xxx call. So, you need to set
 			the camera stuff just before drawing stuff to a specific camera.
 			
+			projection * inverse(camera_xform) is only recomputed when either of them changed since
+			the last draw, and 2D xforms are applied as an Affine2 (2x3) instead of a full Matrix4.
+			
 			The cbuffer is for passing a constant buffer to the custom shader. For more info on custom
 			shading, see examples/custom_shader.c.
 				
@@ -108,19 +112,50 @@
 			void draw_frame_init(Draw_Frame *frame);
 			void draw_frame_init_reserve(Draw_Frame *frame, u64 number_of_quads_to_reserve);
 			void draw_frame_reset(Draw_Frame *frame);
+			void draw_frame_deinit(Draw_Frame *frame);
 			
 			- draw_frame_init needs to be called once to set up some initial stuff. I don't like this so it
 				might change.
 			- draw_frame_init_reserve does the same as draw_frame_init, but you can pre-allocate for a certain
 				amount of quads.
 			- draw_frame_reset will, in short, clear the array of computed Draw_Quad's and zero everything
-				out.	
+				out. It also updates Draw_Frame.last_frame_quad_count & Draw_Frame.peak_quad_count.
+			- draw_frame_deinit frees the quad buffer.
+			
+			The quad buffer lives in its own virtual memory reservation of DRAW_FRAME_MAX_QUADS quads
+			(#define it before including oogabooga to change it), so it never moves or copies when it grows.
+			
+			Quads are stored as Draw_Quad_Packed: an axis aligned rect with a packed color and flags. The
+			rare things that don't fit (rotated corners, HDR colors, uv's, scissors, userdata) go in
+			Draw_Frame.quad_extras. They are only expanded back to full Draw_Quad's when the frame is rendered.
+			
+			void draw_frame_flush(Draw_Frame *frame);
+			u64  draw_frame_get_quad_count(Draw_Frame *frame);
+			void draw_frame_unpack_quad(Draw_Frame *frame, Draw_Quad_Packed *packed, Draw_Quad *quad);
+			void draw_frame_append(Draw_Frame *dst, Draw_Frame *src);
+			
+			- draw_frame_flush packs the last drawn quad into the quad buffer. Call it before reading
+				Draw_Frame.quad_buffer yourself (the other draw_frame_ functions do it for you).
+			- draw_frame_append adds all quads in src to dst.
+				
+		Recorded Draw_Frame's can be rendered more than once, for example with a different shader per pass:
+		
+			void draw_frame_reuse(Draw_Frame *frame);
+			void draw_frame_clone(Draw_Frame *dst, Draw_Frame *src);
+			
+			- draw_frame_reuse keeps the recorded quads, projection and camera_xform but clears the
+				per-pass state (shader_extension, cbuffer, bound images) so the frame can be passed to
+				gfx_render_draw_frame again without re-drawing anything. Renderers never modify the quads
+				of the frame they submit, so every pass sees them exactly as recorded.
+			- draw_frame_clone copies all quads and state from src into dst. dst must have been initialized
+				and keeps its own quad buffer, so src can be reset afterwards.
 				
 			- A practical example for using Draw_Frame's can be found in examples/threaded_drawing.c	
 		
 		- The rest of the advanced API, similar to EZ mode:
 		
 			Draw_Quad *draw_quad_projected_in_frame(Draw_Quad quad, Matrix4 world_to_clip, Draw_Frame *frame);
+			Draw_Quad *draw_quad_affine_in_frame(Draw_Quad quad, Affine2 world_to_clip, Draw_Frame *frame);
 			Draw_Quad *draw_quad_in_frame(Draw_Quad quad, Draw_Frame *frame);
 			Draw_Quad *draw_quad_xform_in_frame(Draw_Quad quad, Matrix4 xform, Draw_Frame *frame);
 			
@@ -155,8 +190,17 @@
 											sampled.
 			- s32             Draw_Quad.z: A value used for sorting. To enable this you must set 
 										   draw_frame.enable_z_sorting to true each frame.
+										   Also setting draw_frame.enable_z_sorting_image_batching groups quads on
+										   the same z by image, for fewer draw calls.
 			- Gfx_Filter_Mode Draw_Quad.image_min_filter
 			- Gfx_Filter_Mode Draw_Quad.image_mag_filter
+			
+		The returned Draw_Quad* is only valid until the next thing drawn to the same Draw_Frame.
+		It points at the frame's pending quad (Draw_Frame.pending_quad), which is packed into the quad
+		buffer and then reused for the next quad. So a pointer kept past that does not point at the
+		old quad anymore: writing through it changes whatever was drawn next, and reading it gives
+		that quad back. draw_frame_flush and rendering the frame pack the pending quad and
+		draw_frame_reset drops it, so those end it too. Copy the Draw_Quad if you need it for longer.
 				
 */
 
@@ -167,6 +211,16 @@
 #define SCISSOR_STACK_MAX 4096
 #define MAX_BOUND_IMAGES 16
 
+// Upper bound of quads in one Draw_Frame. Only address space is reserved for this up front,
+// memory is committed as the quad buffer grows.
+#ifndef DRAW_FRAME_MAX_QUADS
+	#define DRAW_FRAME_MAX_QUADS (1024*1024*4)
+#endif
+// In Vector4's. Rotated quads take 2, other extras 1 each.
+#ifndef DRAW_FRAME_MAX_QUAD_EXTRAS
+	#define DRAW_FRAME_MAX_QUAD_EXTRAS (DRAW_FRAME_MAX_QUADS*2)
+#endif
+
 typedef struct Draw_Quad {
 	// BEWARE !! These are in ndc
 	Vector2 bottom_left, top_left, top_right, bottom_right;
@@ -186,6 +240,32 @@ typedef struct Draw_Quad {
 	
 } Draw_Quad;
 
+// Draw_Quad_Packed.flags, telling which extras the quad has in Draw_Frame.quad_extras.
+// #Volatile extras are laid out in this order.
+#define PACKED_QUAD_CORNERS  (1 << 0) // 2 Vector4's, not an axis aligned rect
+#define PACKED_QUAD_COLOR    (1 << 1) // 1 Vector4, color outside of 0.0-1.0
+#define PACKED_QUAD_UV       (1 << 2) // 1 Vector4, uv other than 0, 0, 1, 1
+#define PACKED_QUAD_SCISSOR  (1 << 3) // 1 Vector4
+#define PACKED_QUAD_USERDATA (1 << 4) // VERTEX_USER_DATA_COUNT Vector4's
+
+// What Draw_Frame.quad_buffer actually stores
+typedef struct Draw_Quad_Packed {
+	// In ndc. Ignored if PACKED_QUAD_CORNERS
+	Vector2 bottom_left;
+	Vector2 top_right;
+	Gfx_Image *image;
+	s32 z;
+	// rgba8, r in the lowest byte
+	u32 color;
+	// Index of the first extra in Draw_Frame.quad_extras
+	u32 extras;
+	u8 type;
+	u8 flags;
+	// min | mag << 4
+	u8 image_filters;
+	u8 padding;
+} Draw_Quad_Packed;
+
 typedef struct Draw_Frame {
 	Matrix4 projection;
 	// #Cleanup
@@ -196,14 +276,36 @@ typedef struct Draw_Frame {
 	
 	void *cbuffer;
 	
+	// projection * inverse(camera_xform), see draw_frame_update_world_to_clip
+	Matrix4 world_to_clip;
+	Affine2 world_to_clip_affine;
+	// x and y in clip space don't depend on z, so 2D xforms can be combined as Affine2's
+	bool world_to_clip_is_planar;
+	bool has_world_to_clip;
+	Matrix4 world_to_clip_projection;
+	Matrix4 world_to_clip_camera_xform;
+	
 	u64 scissor_count;
 	Vector4 scissor_stack[SCISSOR_STACK_MAX];
 	
-	Draw_Quad *quad_buffer;
+	// Virtual growing arrays, each owns its reservation and releases it in growing_array_deinit
+	Draw_Quad_Packed *quad_buffer;
+	Vector4 *quad_extras;
+	
+	// The last drawn quad, which the caller may still be modifying. Packed on the next draw or flush.
+	Draw_Quad pending_quad;
+	bool has_pending_quad;
+	
+	// Updated in draw_frame_reset
+	u64 last_frame_quad_count;
+	u64 peak_quad_count;
 	
 	u64 z_count;
 	s32 z_stack[Z_STACK_MAX];
 	bool enable_z_sorting;
+	// With enable_z_sorting, quads on the same z are grouped by image so they batch better.
+	// This changes which of them are drawn on top of each other.
+	bool enable_z_sorting_image_batching;
 	
 	Gfx_Shader_Extension shader_extension;
 	
@@ -212,31 +314,248 @@ typedef struct Draw_Frame {
 	
 } Draw_Frame;
 
-void draw_frame_init(Draw_Frame *frame) {
+void draw_frame_init_reserve(Draw_Frame *frame, u64 number_of_quads_to_reserve) {
 	*frame = ZERO(Draw_Frame);
 	
-	growing_array_init((void**)&frame->quad_buffer, sizeof(Draw_Quad), get_heap_allocator());
+	// The quad buffer never moves or copies when it grows. Committed pages stay around,
+	// so after the first few frames pushing quads doesn't touch the allocator at all.
+	growing_array_init_virtual((void**)&frame->quad_buffer, sizeof(Draw_Quad_Packed), DRAW_FRAME_MAX_QUADS);
+	growing_array_init_virtual((void**)&frame->quad_extras, sizeof(Vector4), DRAW_FRAME_MAX_QUAD_EXTRAS);
+	growing_array_reserve((void**)&frame->quad_buffer, number_of_quads_to_reserve);
 }
-void draw_frame_init_reserve(Draw_Frame *frame, u64 number_of_quads_to_reserve) {
+void draw_frame_init(Draw_Frame *frame) {
+	draw_frame_init_reserve(frame, 8);
+}
+void draw_frame_deinit(Draw_Frame *frame) {
+	if (frame->quad_buffer) growing_array_deinit((void**)&frame->quad_buffer);
+	if (frame->quad_extras) growing_array_deinit((void**)&frame->quad_extras);
 	*frame = ZERO(Draw_Frame);
+}
+
+u64 draw_frame_get_quad_count(Draw_Frame *frame) {
+	u64 count = frame->has_pending_quad ? 1 : 0;
+	if (frame->quad_buffer) count += growing_array_get_valid_count(frame->quad_buffer);
+	return count;
+}
+
+void draw_frame_clear_quads(Draw_Frame *frame) {
+	if (frame->quad_buffer) growing_array_clear((void**)&frame->quad_buffer);
+	if (frame->quad_extras) growing_array_clear((void**)&frame->quad_extras);
+	frame->has_pending_quad = false;
+}
+
+inline bool pack_unorm_color(Vector4 c, u32 *packed) {
+	// Written so NaN's don't pack
+	if (!(c.r >= 0 && c.r <= 1 && c.g >= 0 && c.g <= 1 && c.b >= 0 && c.b <= 1 && c.a >= 0 && c.a <= 1)) {
+		return false;
+	}
+	*packed = ((u32)(c.r*255.0f + 0.5f))
+	        | ((u32)(c.g*255.0f + 0.5f) << 8)
+	        | ((u32)(c.b*255.0f + 0.5f) << 16)
+	        | ((u32)(c.a*255.0f + 0.5f) << 24);
+	return true;
+}
+inline Vector4 unpack_unorm_color(u32 c) {
+	return v4(
+		(float32)((c >>  0) & 0xFF) / 255.0f,
+		(float32)((c >>  8) & 0xFF) / 255.0f,
+		(float32)((c >> 16) & 0xFF) / 255.0f,
+		(float32)((c >> 24) & 0xFF) / 255.0f
+	);
+}
+
+void draw_frame_flush(Draw_Frame *frame) {
+	if (!frame->has_pending_quad) return;
+	frame->has_pending_quad = false;
+	
+	Draw_Quad *q = &frame->pending_quad;
+	Draw_Quad_Packed *p = (Draw_Quad_Packed*)growing_array_add_empty((void**)&frame->quad_buffer);
+	
+	p->bottom_left = q->bottom_left;
+	p->top_right   = q->top_right;
+	p->image       = q->image;
+	p->z           = q->z;
+	p->extras      = growing_array_get_valid_count(frame->quad_extras);
+	p->type        = q->type;
+	p->flags       = 0;
+	p->image_filters = (u8)(q->image_min_filter | (q->image_mag_filter << 4));
+	p->padding     = 0;
+	
+	Vector4 **extras = &frame->quad_extras;
+	
+	bool is_axis_aligned 
+		=  q->bottom_left.x == q->top_left.x     && q->top_right.x == q->bottom_right.x
+		&& q->bottom_left.y == q->bottom_right.y && q->top_left.y  == q->top_right.y;
+	if (!is_axis_aligned) {
+		p->flags |= PACKED_QUAD_CORNERS;
+		Vector4 *corners = (Vector4*)growing_array_add_multiple_empty((void**)extras, 2);
+		corners[0] = v4(q->bottom_left.x, q->bottom_left.y, q->top_left.x,     q->top_left.y);
+		corners[1] = v4(q->top_right.x,   q->top_right.y,   q->bottom_right.x, q->bottom_right.y);
+	}
+	if (!pack_unorm_color(q->color, &p->color)) {
+		p->flags |= PACKED_QUAD_COLOR;
+		p->color = 0;
+		growing_array_add((void**)extras, &q->color);
+	}
+	// uv & filters are only used for images
+	if (q->image && !(q->uv.x1 == 0 && q->uv.y1 == 0 && q->uv.x2 == 1 && q->uv.y2 == 1)) {
+		p->flags |= PACKED_QUAD_UV;
+		growing_array_add((void**)extras, &q->uv);
+	}
+	if (q->has_scissor) {
+		p->flags |= PACKED_QUAD_SCISSOR;
+		growing_array_add((void**)extras, &q->scissor);
+	}
+	for (u64 i = 0; i < VERTEX_USER_DATA_COUNT*4; i++) {
+		if (((float32*)q->userdata)[i] != 0) {
+			p->flags |= PACKED_QUAD_USERDATA;
+			growing_array_add_multiple((void**)extras, q->userdata, VERTEX_USER_DATA_COUNT);
+			break;
+		}
+	}
 	
-	growing_array_init_reserve((void**)&frame->quad_buffer, sizeof(Draw_Quad), number_of_quads_to_reserve, get_heap_allocator());
+	if (!p->flags) p->extras = 0;
 }
 
-void draw_frame_reset(Draw_Frame *frame) {
+void draw_frame_unpack_quad(Draw_Frame *frame, Draw_Quad_Packed *p, Draw_Quad *q) {
+	Vector4 *extra = frame->quad_extras + p->extras;
+	
+	if (p->flags & PACKED_QUAD_CORNERS) {
+		q->bottom_left  = extra[0].xy;
+		q->top_left     = extra[0].zw;
+		q->top_right    = extra[1].xy;
+		q->bottom_right = extra[1].zw;
+		extra += 2;
+	} else {
+		q->bottom_left  = p->bottom_left;
+		q->top_left     = v2(p->bottom_left.x, p->top_right.y);
+		q->top_right    = p->top_right;
+		q->bottom_right = v2(p->top_right.x, p->bottom_left.y);
+	}
+	if (p->flags & PACKED_QUAD_COLOR) {
+		q->color = *extra;
+		extra += 1;
+	} else {
+		q->color = unpack_unorm_color(p->color);
+	}
+	if (p->flags & PACKED_QUAD_UV) {
+		q->uv = *extra;
+		extra += 1;
+	} else {
+		q->uv = v4(0, 0, 1, 1);
+	}
+	q->has_scissor = (p->flags & PACKED_QUAD_SCISSOR) != 0;
+	if (q->has_scissor) {
+		q->scissor = *extra;
+		extra += 1;
+	} else {
+		q->scissor = v4(0, 0, 0, 0);
+	}
+	if (p->flags & PACKED_QUAD_USERDATA) {
+		memcpy(q->userdata, extra, sizeof(q->userdata));
+	} else {
+		memset(q->userdata, 0, sizeof(q->userdata));
+	}
+	
+	q->image = p->image;
+	q->image_min_filter = (Gfx_Filter_Mode)(p->image_filters & 0xF);
+	q->image_mag_filter = (Gfx_Filter_Mode)(p->image_filters >> 4);
+	q->z = p->z;
+	q->type = p->type;
+}
 
-	// #Memory
-	// I would like to try to have the quad buffer to be allocated in a growing arena
-	// which is reset every frames, like temp allocator but large enough to fit the
-	// highest number of quads the program submits in a frame.
-	// For now, we just reset the count in the heap allocated buffer
+void draw_frame_append(Draw_Frame *dst, Draw_Frame *src) {
+	draw_frame_flush(dst);
+	draw_frame_flush(src);
+	if (!src->quad_buffer) return;
+	
+	u64 number_of_quads  = growing_array_get_valid_count(src->quad_buffer);
+	u64 number_of_extras = growing_array_get_valid_count(src->quad_extras);
+	u32 extras_offset    = growing_array_get_valid_count(dst->quad_extras);
+	
+	Draw_Quad_Packed *quads = (Draw_Quad_Packed*)growing_array_add_multiple_empty((void**)&dst->quad_buffer, number_of_quads);
+	memcpy(quads, src->quad_buffer, number_of_quads*sizeof(Draw_Quad_Packed));
+	
+	if (number_of_extras > 0) {
+		growing_array_add_multiple((void**)&dst->quad_extras, src->quad_extras, number_of_extras);
+		for (u64 i = 0; i < number_of_quads; i++) {
+			if (quads[i].flags) quads[i].extras += extras_offset;
+		}
+	}
+}
+
+#define DRAW_FRAME_SORT_IMAGE_BITS 8
 
-	Draw_Quad *quad_buffer = frame->quad_buffer;
-	if (quad_buffer) growing_array_clear((void**)&quad_buffer);
+// Sorts quad indices by z (and image if enable_z_sorting_image_batching) without moving the quads.
+// pairs and help_pairs need room for one u64 per quad. Returns the sorted (key << 32 | index) pairs.
+u64 *draw_frame_sort_quads(Draw_Frame *frame, u64 *pairs, u64 *help_pairs) {
+	draw_frame_flush(frame);
+	u64 number_of_quads = growing_array_get_valid_count(frame->quad_buffer);
+	// Big frames are sorted on multiple threads, small ones serially (see radix_sort_key_index_pairs_parallel)
+	u64 thread_count = os_get_number_of_logical_processors();
+	
+	for (u64 i = 0; i < number_of_quads; i++) {
+		Draw_Quad_Packed *q = &frame->quad_buffer[i];
+		assert(q->z <= MAX_Z, "Z is too high. Z is %d, Max is %d.", q->z, MAX_Z);
+		assert(q->z >= (-MAX_Z+1), "Z is too low. Z is %d, Min is %d.", q->z, -MAX_Z+1);
+		u32 z_key = (u32)(q->z + MAX_Z - 1);
+		pairs[i] = ((u64)z_key << 32) | i;
+	}
+	
+	if (!frame->enable_z_sorting_image_batching) {
+		return radix_sort_key_index_pairs_parallel(pairs, help_pairs, number_of_quads, MAX_Z_BITS, thread_count);
+	}
+	
+	// Images are keyed in the order they first show up, below z. Untextured quads are 0.
+	Gfx_Image *images[1 << DRAW_FRAME_SORT_IMAGE_BITS];
+	u32 image_count = 0;
+	Gfx_Image *last_image = 0;
+	u64 last_image_key = 0;
+	
+	for (u64 i = 0; i < number_of_quads; i++) {
+		Gfx_Image *image = frame->quad_buffer[i].image;
+		if (image != last_image) {
+			u64 image_key = 0;
+			if (image) {
+				u32 j = 0;
+				while (j < image_count && images[j] != image) j++;
+				if (j == image_count) {
+					if (image_count == (1 << DRAW_FRAME_SORT_IMAGE_BITS) - 1) {
+						// Too many images to key them, strip the image keys again and sort by z only
+						for (u64 k = 0; k < i; k++) {
+							pairs[k] = (((pairs[k] >> 32) >> DRAW_FRAME_SORT_IMAGE_BITS) << 32) | k;
+						}
+						return radix_sort_key_index_pairs_parallel(pairs, help_pairs, number_of_quads, MAX_Z_BITS, thread_count);
+					}
+					images[image_count++] = image;
+				}
+				image_key = j + 1;
+			}
+			last_image = image;
+			last_image_key = image_key;
+		}
+		u64 z_key = pairs[i] >> 32;
+		pairs[i] = (((z_key << DRAW_FRAME_SORT_IMAGE_BITS) | last_image_key) << 32) | i;
+	}
+	
+	return radix_sort_key_index_pairs_parallel(pairs, help_pairs, number_of_quads, MAX_Z_BITS + DRAW_FRAME_SORT_IMAGE_BITS, thread_count);
+}
+
+void draw_frame_reset(Draw_Frame *frame) {
+
+	u64 last_frame_quad_count = draw_frame_get_quad_count(frame);
+	u64 peak_quad_count = max(frame->peak_quad_count, last_frame_quad_count);
+	
+	draw_frame_clear_quads(frame);
+	Draw_Quad_Packed *quad_buffer = frame->quad_buffer;
+	Vector4 *quad_extras = frame->quad_extras;
 
 	*frame = (Draw_Frame){0};
 	
 	frame->quad_buffer = quad_buffer;
+	frame->quad_extras = quad_extras;
+	frame->last_frame_quad_count = last_frame_quad_count;
+	frame->peak_quad_count = peak_quad_count;
 	
 	frame->projection 
 		= m4_make_orthographic_projection(-window.width/2, window.width/2, -window.height/2, window.height/2, -1, 10);
@@ -245,6 +564,34 @@ void draw_frame_reset(Draw_Frame *frame) {
 	frame->highest_bound_slot_index = -1;
 }
 
+void draw_frame_reuse(Draw_Frame *frame) {
+	draw_frame_flush(frame);
+	// Quads are already in ndc, so only the state used at render time needs to go
+	frame->cbuffer = 0;
+	frame->shader_extension = ZERO(Gfx_Shader_Extension);
+	memset(frame->bound_images, 0, sizeof(frame->bound_images));
+	frame->highest_bound_slot_index = -1;
+}
+
+void draw_frame_clone(Draw_Frame *dst, Draw_Frame *src) {
+	assert(dst->quad_buffer, "Destination Draw_Frame must be initialized with draw_frame_init before cloning into it");
+
+	draw_frame_flush(src);
+
+	Draw_Quad_Packed *quad_buffer = dst->quad_buffer;
+	Vector4 *quad_extras = dst->quad_extras;
+	u64 last_frame_quad_count = dst->last_frame_quad_count;
+	u64 peak_quad_count = dst->peak_quad_count;
+	*dst = *src;
+	dst->quad_buffer = quad_buffer;
+	dst->quad_extras = quad_extras;
+	dst->last_frame_quad_count = last_frame_quad_count;
+	dst->peak_quad_count = peak_quad_count;
+
+	draw_frame_clear_quads(dst);
+	draw_frame_append(dst, src);
+}
+
 void draw_frame_bind_image_to_shader(Draw_Frame *frame, Gfx_Image *image, int slot_index) {
 	if (slot_index >= MAX_BOUND_IMAGES) {
 		log_error("The highest bind image slot is %i, you tried to bind to %i", MAX_BOUND_IMAGES-1, slot_index);
@@ -263,22 +610,9 @@ Draw_Frame draw_frame;
 #endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
 
 Draw_Quad _nil_quad = {0};
-Draw_Quad *draw_quad_projected_in_frame(Draw_Quad quad, Matrix4 world_to_clip, Draw_Frame *frame) {
-	quad.bottom_left  = m4_transform(world_to_clip, v4(v2_expand(quad.bottom_left), 0, 1)).xy;
-	quad.top_left     = m4_transform(world_to_clip, v4(v2_expand(quad.top_left), 0, 1)).xy;
-	quad.top_right    = m4_transform(world_to_clip, v4(v2_expand(quad.top_right), 0, 1)).xy;
-	quad.bottom_right = m4_transform(world_to_clip, v4(v2_expand(quad.bottom_right), 0, 1)).xy;
-	
-	bool should_cull = 
-	    (quad.bottom_left.x < -1 && quad.top_left.x < -1 && quad.top_right.x < -1 && quad.bottom_right.x < -1) ||
-	    (quad.bottom_left.x > 1 && quad.top_left.x > 1 && quad.top_right.x > 1 && quad.bottom_right.x > 1) ||
-	    (quad.bottom_left.y < -1 && quad.top_left.y < -1 && quad.top_right.y < -1 && quad.bottom_right.y < -1) ||
-	    (quad.bottom_left.y > 1 && quad.top_left.y > 1 && quad.top_right.y > 1 && quad.bottom_right.y > 1);
 
-	if (should_cull) {
-		return &_nil_quad;
-	}
-	
+// Everything after the corners are in clip space and the quad wasn't culled
+Draw_Quad *draw_frame_push_clip_space_quad(Draw_Quad quad, bool corners_are_snapped, Draw_Frame *frame) {
 	quad.image_min_filter = GFX_FILTER_MODE_NEAREST;
 	quad.image_mag_filter = GFX_FILTER_MODE_NEAREST;
 	
@@ -294,11 +628,14 @@ Draw_Quad *draw_quad_projected_in_frame(Draw_Quad quad, Matrix4 world_to_clip, D
 	
 	memset(quad.userdata, 0, sizeof(quad.userdata));
 	
-	Draw_Quad **target_buffer = &frame->quad_buffer;
+	// The previous quad can't be changed anymore so now it can be packed
+	draw_frame_flush(frame);
 	
-	growing_array_add((void**)target_buffer, &quad);
+	frame->pending_quad = quad;
+	frame->has_pending_quad = true;
+	Draw_Quad *q = &frame->pending_quad;
 	
-	Draw_Quad *q = &(*target_buffer)[growing_array_get_valid_count(*target_buffer)-1];
+	if (corners_are_snapped) return q;
 	
 	// This is meant to fix the annoying artifacts that shows up when sampling from a large atlas
     // presumably for floating point precision issues or something.
@@ -321,16 +658,104 @@ Draw_Quad *draw_quad_projected_in_frame(Draw_Quad quad, Matrix4 world_to_clip, D
 	
 	return q;
 }
+
+Draw_Quad *draw_quad_affine_in_frame(Draw_Quad quad, Affine2 world_to_clip, Draw_Frame *frame) {
+	
+	bool quad_is_axis_aligned 
+		=  quad.bottom_left.x  == quad.top_left.x  && quad.bottom_right.x == quad.top_right.x
+		&& quad.bottom_left.y  == quad.bottom_right.y && quad.top_left.y == quad.top_right.y;
+	
+	if (quad_is_axis_aligned && affine2_is_axis_aligned(world_to_clip)) {
+		// Rects through a translate+scale transform (so most of everything in 2D) stay rects, so
+		// it's a single multiply-add per edge, and culling happens before any corner is made.
+		Affine2 m = world_to_clip;
+		float32 left   = m.m[0][0] * quad.bottom_left.x  + m.m[0][2];
+		float32 right  = m.m[0][0] * quad.bottom_right.x + m.m[0][2];
+		float32 bottom = m.m[1][1] * quad.bottom_left.y  + m.m[1][2];
+		float32 top    = m.m[1][1] * quad.top_left.y     + m.m[1][2];
+		
+		bool should_cull 
+			=  (left   < -1 && right < -1) || (left   > 1 && right > 1)
+			|| (bottom < -1 && top   < -1) || (bottom > 1 && top   > 1);
+		if (should_cull) {
+			return &_nil_quad;
+		}
+		
+		// Same pixel snapping as draw_frame_push_clip_space_quad, but 4 edges instead of 8 coordinates
+		float pixel_width = 2.0/(float)window.width;
+		float pixel_height = 2.0/(float)window.height;
+		left   = round(left   / pixel_width)  * pixel_width;
+		right  = round(right  / pixel_width)  * pixel_width;
+		bottom = round(bottom / pixel_height) * pixel_height;
+		top    = round(top    / pixel_height) * pixel_height;
+		
+		quad.bottom_left  = v2(left,  bottom);
+		quad.top_left     = v2(left,  top);
+		quad.top_right    = v2(right, top);
+		quad.bottom_right = v2(right, bottom);
+		
+		return draw_frame_push_clip_space_quad(quad, true, frame);
+	}
+	
+	quad.bottom_left  = affine2_transform(world_to_clip, quad.bottom_left);
+	quad.top_left     = affine2_transform(world_to_clip, quad.top_left);
+	quad.top_right    = affine2_transform(world_to_clip, quad.top_right);
+	quad.bottom_right = affine2_transform(world_to_clip, quad.bottom_right);
+	
+	bool should_cull = 
+	    (quad.bottom_left.x < -1 && quad.top_left.x < -1 && quad.top_right.x < -1 && quad.bottom_right.x < -1) ||
+	    (quad.bottom_left.x > 1 && quad.top_left.x > 1 && quad.top_right.x > 1 && quad.bottom_right.x > 1) ||
+	    (quad.bottom_left.y < -1 && quad.top_left.y < -1 && quad.top_right.y < -1 && quad.bottom_right.y < -1) ||
+	    (quad.bottom_left.y > 1 && quad.top_left.y > 1 && quad.top_right.y > 1 && quad.bottom_right.y > 1);
+
+	if (should_cull) {
+		return &_nil_quad;
+	}
+	
+	return draw_frame_push_clip_space_quad(quad, false, frame);
+}
+
+Draw_Quad *draw_quad_projected_in_frame(Draw_Quad quad, Matrix4 world_to_clip, Draw_Frame *frame) {
+	// Quads are on the z=0 plane and only x and y are kept, so that's all the matrix can do to them
+	return draw_quad_affine_in_frame(quad, m4_to_affine2(world_to_clip), frame);
+}
+
+// projection and camera_xform are set directly by the user at any point, so instead of
+// inverting and multiplying them for every quad we remember what they were last time.
+void draw_frame_update_world_to_clip(Draw_Frame *frame) {
+	if (frame->has_world_to_clip
+	 && bytes_match(&frame->world_to_clip_projection,  &frame->projection,   sizeof(Matrix4))
+	 && bytes_match(&frame->world_to_clip_camera_xform, &frame->camera_xform, sizeof(Matrix4))) {
+		return;
+	}
+	
+	frame->world_to_clip_projection   = frame->projection;
+	frame->world_to_clip_camera_xform = frame->camera_xform;
+	frame->world_to_clip = m4_mul(frame->projection, m4_inverse(frame->camera_xform));
+	frame->world_to_clip_affine = m4_to_affine2(frame->world_to_clip);
+	frame->world_to_clip_is_planar = frame->world_to_clip.m[0][2] == 0 && frame->world_to_clip.m[1][2] == 0;
+	frame->has_world_to_clip = true;
+}
+
+// world_to_clip * xform, without any Matrix4 math if both are 2D
+Affine2 draw_frame_get_xform_to_clip(Draw_Frame *frame, Matrix4 xform) {
+	draw_frame_update_world_to_clip(frame);
+	
+	bool xform_is_2d = xform.m[3][0] == 0 && xform.m[3][1] == 0 && xform.m[3][3] == 1;
+	if (frame->world_to_clip_is_planar && xform_is_2d) {
+		return affine2_mul(frame->world_to_clip_affine, m4_to_affine2(xform));
+	}
+	
+	return m4_to_affine2(m4_mul(frame->world_to_clip, xform));
+}
+
 Draw_Quad *draw_quad_in_frame(Draw_Quad quad, Draw_Frame *frame) {
-	return draw_quad_projected_in_frame(quad, m4_mul(frame->projection, m4_inverse(frame->camera_xform)), frame);
+	draw_frame_update_world_to_clip(frame);
+	return draw_quad_affine_in_frame(quad, frame->world_to_clip_affine, frame);
 }
 
 Draw_Quad *draw_quad_xform_in_frame(Draw_Quad quad, Matrix4 xform, Draw_Frame *frame) {
-	Matrix4 world_to_clip = m4_scalar(1.0);
-	world_to_clip         = m4_mul(world_to_clip, frame->projection);
-	world_to_clip         = m4_mul(world_to_clip, m4_inverse(frame->camera_xform));
-	world_to_clip         = m4_mul(world_to_clip, xform);
-	return draw_quad_projected_in_frame(quad, world_to_clip, frame);
+	return draw_quad_affine_in_frame(quad, draw_frame_get_xform_to_clip(frame, xform), frame);
 }
 
 Draw_Quad *draw_rect_in_frame(Vector2 position, Vector2 size, Vector4 color, Draw_Frame *frame) {
@@ -417,6 +842,8 @@ typedef struct {
 	string text;
 	u32 raster_height;
 	Matrix4 xform;
+	// xform to clip space, so each glyph is just a rect through it
+	Affine2 text_to_clip;
 	Vector2 scale;
 	Vector4 color;
 	Draw_Frame *frame;
@@ -429,9 +856,16 @@ bool draw_text_callback(Gfx_Glyph glyph, Gfx_Font_Atlas *atlas, float glyph_x, f
 	
 	Vector2 size = v2(glyph.width*params->scale.x, glyph.height*params->scale.y);
 	
-	Matrix4 glyph_xform = m4_translate(params->xform, v3(glyph_x, glyph_y, 0));
+	// #Copypaste #Volatile
+	Draw_Quad glyph_quad = ZERO(Draw_Quad);
+	glyph_quad.bottom_left  = v2(glyph_x,          glyph_y);
+	glyph_quad.top_left     = v2(glyph_x,          glyph_y+size.y);
+	glyph_quad.top_right    = v2(glyph_x+size.x,   glyph_y+size.y);
+	glyph_quad.bottom_right = v2(glyph_x+size.x,   glyph_y);
+	glyph_quad.color = params->color;
+	glyph_quad.image = atlas->image;
 	
-	Draw_Quad *q = draw_image_xform_in_frame(atlas->image, glyph_xform, size, params->color, params->frame);
+	Draw_Quad *q = draw_quad_affine_in_frame(glyph_quad, params->text_to_clip, params->frame);
 	q->uv = glyph.uv;
 	q->type = QUAD_TYPE_TEXT;
 	q->image_min_filter = GFX_FILTER_MODE_LINEAR;
@@ -447,6 +881,7 @@ void draw_text_xform_in_frame(Gfx_Font *font, string text, u32 raster_height, Ma
 	p.text = text;
 	p.raster_height = raster_height;
 	p.xform = xform;
+	p.text_to_clip = draw_frame_get_xform_to_clip(frame, xform);
 	p.scale = scale;
 	p.color = color;
 	p.frame = frame;
@@ -52,6 +52,7 @@
 
 #define PARTICLE_KIND_POOL_MAX 128
 #define PARTICLE_IMAGE_POOL_MAX 128
+#define PARTICLE_EMISSION_MAX (1024*64)
 
 #define PARTICLES_MEM_PER_BLOCK MB(1)
 #define PARTICLES_PER_BLOCK (PARTICLES_MEM_PER_BLOCK / sizeof(Particle))
@@ -325,7 +326,7 @@ void emission_release(Emission_Handle h) {
 }
 
 void particles_init() {
-	growing_array_init_reserve((void**)&emissions, sizeof(Emission_Instance), 16, get_heap_allocator());
+	growing_array_init_virtual((void**)&emissions, sizeof(Emission_Instance), PARTICLE_EMISSION_MAX);
 }
 
 void particles_update() {
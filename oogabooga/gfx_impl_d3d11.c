@@ -58,8 +58,8 @@ ID3D11Buffer *d3d11_quad_ibo = 0;
 u32 d3d11_quad_vbo_size = 0;
 void *d3d11_staging_quad_buffer = 0;
 
-Draw_Quad *d3d11_sort_quad_buffer = 0;
-u64 d3d11_sort_quad_buffer_size = 0;
+u64 *d3d11_sort_pairs = 0;
+u64 d3d11_sort_pairs_count = 0;
 
 u64 d3d11_thread_id = 0;
 
@@ -649,6 +649,8 @@ void gfx_render_draw_frame(Draw_Frame *frame, Gfx_Image *render_target) {
 	
 	
 	if (!frame->quad_buffer) return;
+	
+	draw_frame_flush(frame);
 
 	u64 number_of_quads = growing_array_get_valid_count(frame->quad_buffer);
 	
@@ -729,19 +731,26 @@ void gfx_render_draw_frame(Draw_Frame *frame, Gfx_Image *render_target) {
 		// here on the main thread.
 		//
 		{
+			// Only (z, index) pairs are sorted, the quads are read in sorted order below
+			u64 *sorted_pairs = 0;
 			if (frame->enable_z_sorting) {
-				if (!d3d11_sort_quad_buffer || (d3d11_sort_quad_buffer_size < number_of_quads*sizeof(Draw_Quad))) {
+				if (d3d11_sort_pairs_count < number_of_quads) {
 					// #Memory #Heapalloc
-					if (d3d11_sort_quad_buffer) dealloc(get_heap_allocator(), d3d11_sort_quad_buffer);
-					d3d11_sort_quad_buffer = alloc(get_heap_allocator(), number_of_quads*sizeof(Draw_Quad));
-					d3d11_sort_quad_buffer_size = number_of_quads*sizeof(Draw_Quad);
+					if (d3d11_sort_pairs) dealloc(get_heap_allocator(), d3d11_sort_pairs);
+					d3d11_sort_pairs_count = get_next_power_of_two(number_of_quads);
+					d3d11_sort_pairs = alloc(get_heap_allocator(), d3d11_sort_pairs_count*sizeof(u64)*2);
 				}
-				radix_sort(frame->quad_buffer, d3d11_sort_quad_buffer, number_of_quads, sizeof(Draw_Quad), offsetof(Draw_Quad, z), MAX_Z_BITS);
+				sorted_pairs = draw_frame_sort_quads(frame, d3d11_sort_pairs, d3d11_sort_pairs + d3d11_sort_pairs_count);
 			}
 		
 			for (u64 i = 0; i < number_of_quads; i++)  {
 				
-				Draw_Quad *q = &frame->quad_buffer[i];
+				u64 quad_index = sorted_pairs ? (sorted_pairs[i] & 0xFFFFFFFF) : i;
+				
+				// Quads are packed until now, this is where they are expanded
+				Draw_Quad unpacked_quad;
+				draw_frame_unpack_quad(frame, &frame->quad_buffer[quad_index], &unpacked_quad);
+				Draw_Quad *q = &unpacked_quad;
 				
 				assert(q->z <= MAX_Z, "Z is too high. Z is %d, Max is %d.", q->z, MAX_Z);
 				assert(q->z >= (-MAX_Z+1), "Z is too low. Z is %d, Min is %d.", q->z, -MAX_Z+1);
@@ -863,15 +872,14 @@ void gfx_render_draw_frame(Draw_Frame *frame, Gfx_Image *render_target) {
 					
 					BL->type=TL->type=TR->type=BR->type = (u8)q->type;
 					
-					float t = q->scissor.y1;
-					q->scissor.y1 = q->scissor.y2;
-					q->scissor.y2 = t;
-					
-					q->scissor.y1 = window.pixel_height - q->scissor.y1;
-					q->scissor.y2 = window.pixel_height - q->scissor.y2;
+					// Flipped into a local, the frame's quads must stay as recorded so draw_frame_reuse can
+					// submit them again
+					Vector4 scissor = q->scissor;
+					scissor.y1 = window.pixel_height - q->scissor.y2;
+					scissor.y2 = window.pixel_height - q->scissor.y1;
 					
 					BL->has_scissor=TL->has_scissor=TR->has_scissor=BR->has_scissor = q->has_scissor;
-					BL->scissor=TL->scissor=TR->scissor=BR->scissor = q->scissor;
+					BL->scissor=TL->scissor=TR->scissor=BR->scissor = scissor;
 					
 					number_of_rendered_quads += 1;
 				}
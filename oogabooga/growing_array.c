@@ -5,6 +5,7 @@
 	
 		void growing_array_init_reserve(void **array, u64 block_size_in_bytes, u64 count_to_reserve, Allocator allocator);
 		void growing_array_init(void **array, u64 block_size_in_bytes, Allocator allocator);
+		void growing_array_init_virtual(void **array, u64 block_size_in_bytes, u64 max_count);
 		void growing_array_deinit(void **array);
 		
 		void *growing_array_add_empty(void **array);
@@ -38,6 +39,11 @@
 	    
 	    growing_array_deinit(&things);
 	    
+	    // Reserves address space for max_count things up front and commits it as the array grows.
+	    // The array never moves, so pointers to things stay valid and growing never copies.
+	    // Going past max_count is an error.
+	    growing_array_init_virtual(&things, sizeof(Thing), 1000000);
+	    
 	    Thing new_thing;
 	    growing_array_add(&things, &new_thing); // 'thing' is copied
 	    
@@ -68,6 +74,9 @@
 
 #define GROWING_ARRAY_SIGNATURE 2224364215
 
+// memory.c
+Allocator make_virtual_arena_allocator(u64 size_to_reserve);
+
 typedef struct Growing_Array_Header {
 	u32 signature;
     u32 valid_count;
@@ -104,6 +113,14 @@ growing_array_init(void **array, u64 block_size_in_bytes, Allocator allocator) {
     growing_array_init_reserve(array, block_size_in_bytes, 8, allocator);
 }
 void
+growing_array_init_virtual(void **array, u64 block_size_in_bytes, u64 max_count) {
+	// The array is the only allocation in the arena so it can always grow in place,
+	// and the reservation is released when the array is deinitted.
+	max_count = get_next_power_of_two(max_count);
+	Allocator allocator = make_virtual_arena_allocator(max_count*block_size_in_bytes + sizeof(Growing_Array_Header));
+	growing_array_init_reserve(array, block_size_in_bytes, 8, allocator);
+}
+void
 growing_array_deinit(void **array) {
 	assert(check_growing_array_signature(array), "Not a valid growing array");
     Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
@@ -120,6 +137,14 @@ growing_array_reserve(void **array, u64 count_to_reserve) {
     u64 old_allocated_bytes = header->allocated_count*header->block_size_in_bytes+sizeof(Growing_Array_Header);
     count_to_reserve = get_next_power_of_two(count_to_reserve);
     u64 bytes_to_allocate = count_to_reserve*header->block_size_in_bytes+sizeof(Growing_Array_Header);
+    
+    // Allocators that can grow the block where it is (i.e. Virtual_Arena) save us the copy
+    void *grown = header->allocator.proc(bytes_to_allocate, header, ALLOCATOR_REALLOCATE_IN_PLACE, header->allocator.data);
+    if (grown == header) {
+    	header->allocated_count = count_to_reserve;
+    	return;
+    }
+    
     Growing_Array_Header *new_header = (Growing_Array_Header*)alloc(header->allocator, bytes_to_allocate);
     
     memcpy(new_header, header, old_allocated_bytes);
@@ -1,6 +1,9 @@
 
-// Very naive implementation but it should be very cache efficient so it's alright
-// for non-excessive use for now.
+// Open addressing hash table.
+// Entries (hash, key, value) are kept dense in insertion order, so iterating with
+// hash_table_get_nth_value is a linear walk. Lookups go through a power-of-two index of
+// control bytes + entry indices, probed linearly 16 control bytes at a time (one SSE2 compare).
+// Removing shifts the following probe run back instead of leaving tombstones.
 
 /*
 
@@ -30,6 +33,10 @@
 		
 	}
 	
+	// Remove key, returns whether or not it existed.
+	// NOTE: this moves the last entry into the removed one's place, so hash_table_get_nth_value order changes
+	bool removed = hash_table_remove(&table, key);
+	
 	// Reset all entries (but keep allocated memory)
 	hash_table_reset(&table);
 	
@@ -38,12 +45,15 @@
 	
 	
 	Limitations:
-		- Key can only be a base type or pointer
+		- Key can only be a base type, pointer or string
+		- String keys are stored as the string itself (count + data pointer), the characters are NOT copied.
+		  They need to stay alive for as long as the entry is in the table.
 		- Key and value passed to the following function needs to be lvalues (we need to be able to take their addresses with '&'):
 			- hash_table_add
 			- hash_table_find
 			- hash_table_contains
 			- hash_table_set
+			- hash_table_remove
 			
 			Example:
 			
@@ -58,89 +68,234 @@
 
 typedef struct Hash_Table Hash_Table;
 
+typedef bool(*Hash_Table_Key_Equals_Proc)(void *a, void *b, u64 key_size);
+
+bool hash_table_key_bytes_equal(void *a, void *b, u64 key_size) {
+	return memcmp(a, b, key_size) == 0;
+}
+bool hash_table_key_strings_equal(void *a, void *b, u64 key_size) {
+	return strings_match(*(string*)a, *(string*)b);
+}
+
+// Keys are compared the same way they are hashed, strings by their characters
+#define get_hash_table_key_equals_proc(x) _Generic((x), \
+		    string: hash_table_key_strings_equal, \
+		    default: hash_table_key_bytes_equal \
+		    )
+
 // API:
 #define make_hash_table_reserve(Key_Type, Value_Type, capacity_count, allocator) \
-	make_hash_table_reserve(sizeof(Key_Type), sizeof(Value_Type), capacity_count, allocator)
+	make_hash_table_reserve_raw(sizeof(Key_Type), sizeof(Value_Type), get_hash_table_key_equals_proc((Key_Type){0}), capacity_count, allocator)
 	
 #define make_hash_table(Key_Type, Value_Type, allocator) \
-	make_hash_table_raw(sizeof(Key_Type), sizeof(Value_Type), allocator)
+	make_hash_table_raw(sizeof(Key_Type), sizeof(Value_Type), get_hash_table_key_equals_proc((Key_Type){0}), allocator)
 
 #define hash_table_add(table_ptr, key, value) \
 	hash_table_add_raw((table_ptr), get_hash(key), &(key), &(value), sizeof(key), sizeof(value))
 
 #define hash_table_find(table_ptr, key) \
-	hash_table_find_raw((table_ptr), get_hash(key))
+	hash_table_find_raw((table_ptr), get_hash(key), &(key), sizeof(key))
 	
 #define hash_table_contains(table_ptr, key) \
-	hash_table_contains_raw((table_ptr), get_hash(key))
+	hash_table_contains_raw((table_ptr), get_hash(key), &(key), sizeof(key))
 	
 #define hash_table_set(table_ptr, key, value) \
 	hash_table_set_raw((table_ptr), get_hash(key), &key, &value, sizeof(key), sizeof(value))
 
+#define hash_table_remove(table_ptr, key) \
+	hash_table_remove_raw((table_ptr), get_hash(key), &(key), sizeof(key))
+
 void hash_table_reserve(Hash_Table *t, u64 required_count);
 
+#define HASH_TABLE_GROUP_SIZE 16
+#define HASH_TABLE_CONTROL_EMPTY 0x80 // Full slots store 7 bits of the hash, so the high bit is never set
+#define HASH_TABLE_MIN_SLOT_COUNT 16
+// Max load factor is 3/4, linear probing gets long runs above that
 
 typedef struct Hash_Table {
 	
 	// Each entry is hash-key-value
-	// Hash is sizeof(u64) bytes, key is _key_size bytes and value is _value_size bytes
+	// Hash is sizeof(u64) bytes, key is _key_size bytes and value is _value_size bytes (each 8 byte aligned)
 	void *entries; 
 	
 	u64 count; // Number of valid entries
 	u64 capacity_count; // Number of allocated entries
 	
+	// Index into entries. control[i] is HASH_TABLE_CONTROL_EMPTY or 7 bits of the hash of
+	// entries[slots[i]]. The last HASH_TABLE_GROUP_SIZE control bytes mirror the first ones
+	// so a group can be loaded from any slot without wrapping.
+	u8 *control;
+	u32 *slots;
+	u64 slot_count; // Power of two
+	u64 _slot_shift; // 64 - log2(slot_count)
+	
 	u64 _key_size;
 	u64 _value_size;
+	u64 _value_offset;
+	u64 _entry_size;
+	Hash_Table_Key_Equals_Proc _key_equals;
 	
 	Allocator allocator;
 } Hash_Table;
 
-Hash_Table make_hash_table_reserve_raw(u64 key_size, u64 value_size, u64 capacity_count, Allocator allocator) {
+// Fibonacci hashing, so tables also work with weak hashes (like djb2 for long strings)
+inline u64 hash_table_mix(u64 hash) {
+	return hash * 0x9E3779B97F4A7C15ULL;
+}
+inline u64 hash_table_home_slot(Hash_Table *t, u64 hash) {
+	return hash_table_mix(hash) >> t->_slot_shift;
+}
+inline u8 hash_table_control_byte(u64 hash) {
+	return (u8)(hash_table_mix(hash) & 0x7F);
+}
+
+inline void *hash_table_entry(Hash_Table *t, u64 index) {
+	return (u8*)t->entries + index*t->_entry_size;
+}
+
+// Bit i is set if control[i] == byte
+inline u32 hash_table_match_group(u8 *control, u8 byte) {
+#if ENABLE_SIMD && SIMD_ENABLE_SSE2
+	__m128i group = _mm_loadu_si128((__m128i*)control);
+	return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)byte)));
+#else
+	u32 mask = 0;
+	for (u32 i = 0; i < HASH_TABLE_GROUP_SIZE; i += 1) {
+		if (control[i] == byte) mask |= 1u << i;
+	}
+	return mask;
+#endif
+}
+
+inline u32 hash_table_lowest_bit_index(u32 mask) {
+#if COMPILER_MSVC
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (u32)index;
+#else
+	return (u32)__builtin_ctz(mask);
+#endif
+}
+
+inline void hash_table_set_control(Hash_Table *t, u64 slot, u8 byte) {
+	t->control[slot] = byte;
+	if (slot < HASH_TABLE_GROUP_SIZE) t->control[t->slot_count + slot] = byte;
+}
+
+// Puts entry index into the first free slot of its probe run, the key must not be in the index already
+void hash_table_insert_slot(Hash_Table *t, u64 hash, u32 entry_index) {
+	u64 mask = t->slot_count-1;
+	u64 pos = hash_table_home_slot(t, hash);
+	while (true) {
+		u32 empty = hash_table_match_group(t->control + pos, HASH_TABLE_CONTROL_EMPTY);
+		if (empty) {
+			u64 slot = (pos + hash_table_lowest_bit_index(empty)) & mask;
+			hash_table_set_control(t, slot, hash_table_control_byte(hash));
+			t->slots[slot] = entry_index;
+			return;
+		}
+		pos = (pos + HASH_TABLE_GROUP_SIZE) & mask;
+	}
+}
+
+// Returns the slot holding key, or -1
+s64 hash_table_find_slot(Hash_Table *t, u64 hash, void *k) {
+	u64 mask = t->slot_count-1;
+	u64 pos = hash_table_home_slot(t, hash);
+	u8 control_byte = hash_table_control_byte(hash);
+	while (true) {
+		u32 match = hash_table_match_group(t->control + pos, control_byte);
+		u32 empty = hash_table_match_group(t->control + pos, HASH_TABLE_CONTROL_EMPTY);
+		
+		// The probe run ends at the first empty slot
+		if (empty) match &= (empty & (~empty + 1)) - 1;
+		
+		while (match) {
+			u64 slot = (pos + hash_table_lowest_bit_index(match)) & mask;
+			u8 *entry = (u8*)hash_table_entry(t, t->slots[slot]);
+			if (*(u64*)entry == hash && t->_key_equals(entry+sizeof(u64), k, t->_key_size)) {
+				return (s64)slot;
+			}
+			match &= match-1;
+		}
+		
+		if (empty) return -1;
+		pos = (pos + HASH_TABLE_GROUP_SIZE) & mask;
+	}
+}
+
+void hash_table_rehash(Hash_Table *t, u64 slot_count) {
+	if (t->control) dealloc(t->allocator, t->control);
+	if (t->slots)   dealloc(t->allocator, t->slots);
+	
+	t->slot_count = slot_count;
+	t->_slot_shift = 64;
+	for (u64 n = slot_count; n > 1; n >>= 1) t->_slot_shift -= 1;
+	t->control = alloc(t->allocator, slot_count + HASH_TABLE_GROUP_SIZE);
+	t->slots   = alloc(t->allocator, slot_count*sizeof(u32));
+	memset(t->control, HASH_TABLE_CONTROL_EMPTY, slot_count + HASH_TABLE_GROUP_SIZE);
+	
+	for (u64 i = 0; i < t->count; i += 1) {
+		hash_table_insert_slot(t, *(u64*)hash_table_entry(t, i), (u32)i);
+	}
+}
+
+Hash_Table make_hash_table_reserve_raw(u64 key_size, u64 value_size, Hash_Table_Key_Equals_Proc key_equals, u64 capacity_count, Allocator allocator) {
 
-	capacity_count = min(capacity_count, 8);
+	capacity_count = max(capacity_count, 8);
 
 	Hash_Table t = ZERO(Hash_Table);
 	
 	t._key_size = key_size;
 	t._value_size = value_size;
+	t._value_offset = sizeof(u64) + align_next(key_size, 8);
+	t._entry_size = align_next(t._value_offset + value_size, 8);
+	t._key_equals = key_equals;
 	t.allocator = allocator;
 	
-	u64 entry_size = value_size+sizeof(u64);
-	t.entries = alloc(t.allocator, entry_size*capacity_count);
-	memset(t.entries, 0, entry_size*capacity_count);
+	t.entries = alloc(t.allocator, t._entry_size*capacity_count);
+	memset(t.entries, 0, t._entry_size*capacity_count);
 	t.capacity_count = capacity_count;
 	
+	hash_table_rehash(&t, max(get_next_power_of_two(capacity_count + capacity_count/3 + 1), HASH_TABLE_MIN_SLOT_COUNT));
+	
 	return t;
 }
-inline Hash_Table make_hash_table_raw(u64 key_size, u64 value_size, Allocator allocator) {
-	return make_hash_table_reserve_raw(key_size, value_size, 128, allocator);
+inline Hash_Table make_hash_table_raw(u64 key_size, u64 value_size, Hash_Table_Key_Equals_Proc key_equals, Allocator allocator) {
+	return make_hash_table_reserve_raw(key_size, value_size, key_equals, 128, allocator);
 }
 
 void hash_table_reset(Hash_Table *t) {
 	t->count = 0;
+	if (t->control) memset(t->control, HASH_TABLE_CONTROL_EMPTY, t->slot_count + HASH_TABLE_GROUP_SIZE);
 }
 void hash_table_destroy(Hash_Table *t) {
 	dealloc(t->allocator, t->entries);
+	if (t->control) dealloc(t->allocator, t->control);
+	if (t->slots)   dealloc(t->allocator, t->slots);
 	
 	t->entries = 0;
+	t->control = 0;
+	t->slots = 0;
 	t->count = 0;
 	t->capacity_count = 0;
+	t->slot_count = 0;
 }
 
 void hash_table_reserve(Hash_Table *t, u64 required_count) {
-	u64 entry_size = t->_value_size+sizeof(u64);
-	
-	u64 required_size = required_count*entry_size;
-	
-	u64 current_size = t->capacity_count*entry_size;
+	assert(required_count <= 0xFFFFFFFF, "Hash table can't hold more than U32_MAX entries");
+
+	// Keep the index at most 3/4 full
+	if (required_count*4 > t->slot_count*3) {
+		hash_table_rehash(t, max(get_next_power_of_two(required_count + required_count/3 + 1), HASH_TABLE_MIN_SLOT_COUNT));
+	}
 	
-	if (current_size >= required_size) return;
+	if (t->capacity_count >= required_count) return;
 	
 	u64 new_count = get_next_power_of_two(required_count);
-	u64 new_size = new_count*entry_size;
 	
-	void *new_entries = alloc(t->allocator, new_size);
-	memcpy(new_entries, t->entries, current_size);
+	void *new_entries = alloc(t->allocator, new_count*t->_entry_size);
+	memcpy(new_entries, t->entries, t->count*t->_entry_size);
 	
 	dealloc(t->allocator, t->entries);
 	
@@ -148,7 +303,7 @@ void hash_table_reserve(Hash_Table *t, u64 required_count) {
 	t->capacity_count = new_count;
 }
 
-// This can add multiple entries of same hash, beware!
+// This can add multiple entries of same key, beware!
 void hash_table_add_raw(Hash_Table *t, u64 hash, void *k, void *v, u64 key_size, u64 value_size) {
 
 	assert(t->_key_size == key_size, "Key type size does not match hash table initted key type size");
@@ -156,63 +311,86 @@ void hash_table_add_raw(Hash_Table *t, u64 hash, void *k, void *v, u64 key_size,
 
 	hash_table_reserve(t, t->count+1);
 	
-	u64 entry_size = t->_value_size+sizeof(u64);
-	
-	u64 index = entry_size*t->count;
+	u64 index = t->count;
 	t->count += 1;
 	
-	u64 hash_offset = 0;
-	u64 value_offset = hash_offset + sizeof(u64);
+	u8 *entry = (u8*)hash_table_entry(t, index);
+	memcpy(entry,                  &hash, sizeof(u64));
+	memcpy(entry+sizeof(u64),      k,     key_size);
+	memcpy(entry+t->_value_offset, v,     value_size);
 	
-	memcpy((u8*)t->entries+index+hash_offset,  &hash, sizeof(u64));
-	memcpy((u8*)t->entries+index+value_offset, v,     value_size);
+	hash_table_insert_slot(t, hash, (u32)index);
 }
 
-void *hash_table_find_raw(Hash_Table *t, u64 hash) {
-
-	// #Speed #Incomplete
-	// Do quadratic probe 'triangular numbers'
-
-	u64 entry_size = t->_value_size+sizeof(u64);
-	u64 hash_offset = 0;
-	u64 value_offset = hash_offset + sizeof(u64);
+void *hash_table_find_raw(Hash_Table *t, u64 hash, void *k, u64 key_size) {
+	assert(t->_key_size == key_size, "Key type size does not match hash table initted key type size");
 	
-	for (u64 i = 0; i < t->count; i += 1) {
-		u64 existing_hash = *(u64*)((u8*)t->entries+i*entry_size+hash_offset);
-		if (existing_hash == hash) {
-			void *value = ((u8*)t->entries+i*entry_size+value_offset);
-			return value;
-		}
-	}
-	return 0;
+	s64 slot = hash_table_find_slot(t, hash, k);
+	if (slot < 0) return 0;
+	
+	return (u8*)hash_table_entry(t, t->slots[slot]) + t->_value_offset;
 }
 
 void *hash_table_get_nth_value(Hash_Table *t, u64 n) {
 	assert(n < t->count, "Hash table n is out of range");
 	
-	u64 entry_size = t->_value_size+sizeof(u64);
-	u64 hash_offset = 0;
-	u64 value_offset = hash_offset + sizeof(u64);
-	
-	return (u8*)t->entries+entry_size*n+value_offset;
+	return (u8*)hash_table_entry(t, n) + t->_value_offset;
 }
 
-bool hash_table_contains_raw(Hash_Table *t, u64 hash) {
-	return hash_table_find_raw(t, hash) != 0;
+bool hash_table_contains_raw(Hash_Table *t, u64 hash, void *k, u64 key_size) {
+	return hash_table_find_raw(t, hash, k, key_size) != 0;
 }
 
 // Returns true if key was newly added or false if it already existed
 bool hash_table_set_raw(Hash_Table *t, u64 hash, void *k, void *v, u64 key_size, u64 value_size) {
-	bool newly_added = true;
-	
-	if (hash_table_contains_raw(t, hash)) newly_added = false;
+	void *existing = hash_table_find_raw(t, hash, k, key_size);
 	
-	if (newly_added) {
-		hash_table_add_raw(t, hash, k, v, key_size, value_size);
-	} else {
-		memcpy(hash_table_find_raw(t, hash), v, value_size);
+	if (existing) {
+		memcpy(existing, v, value_size);
+		return false;
 	}
 	
-	return newly_added;
+	hash_table_add_raw(t, hash, k, v, key_size, value_size);
+	return true;
 }
 
+// Returns true if key existed
+bool hash_table_remove_raw(Hash_Table *t, u64 hash, void *k, u64 key_size) {
+	assert(t->_key_size == key_size, "Key type size does not match hash table initted key type size");
+	
+	s64 found = hash_table_find_slot(t, hash, k);
+	if (found < 0) return false;
+	
+	u64 mask = t->slot_count-1;
+	u64 hole = (u64)found;
+	u32 removed_index = t->slots[hole];
+	
+	// Backward shift: pull every entry after the hole that is allowed to sit in it (its home slot is
+	// not between the hole and where it is now) back, until the probe run ends.
+	u64 next = (hole+1) & mask;
+	while (t->control[next] != HASH_TABLE_CONTROL_EMPTY) {
+		u64 home = hash_table_home_slot(t, *(u64*)hash_table_entry(t, t->slots[next]));
+		if (((next - home) & mask) >= ((next - hole) & mask)) {
+			hash_table_set_control(t, hole, t->control[next]);
+			t->slots[hole] = t->slots[next];
+			hole = next;
+		}
+		next = (next+1) & mask;
+	}
+	hash_table_set_control(t, hole, HASH_TABLE_CONTROL_EMPTY);
+	
+	// Keep entries dense, the last one moves into the removed one's place
+	u64 last = t->count-1;
+	if (removed_index != last) {
+		u64 last_hash = *(u64*)hash_table_entry(t, last);
+		u64 slot = hash_table_home_slot(t, last_hash);
+		while (t->slots[slot] != last || t->control[slot] == HASH_TABLE_CONTROL_EMPTY) {
+			slot = (slot+1) & mask;
+		}
+		t->slots[slot] = removed_index;
+		memcpy(hash_table_entry(t, removed_index), hash_table_entry(t, last), t->_entry_size);
+	}
+	t->count -= 1;
+	
+	return true;
+}
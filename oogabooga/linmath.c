@@ -997,3 +997,43 @@ Vector3f32 m3_transform(Matrix3 m, Vector3f32 v) {
     result.z = m.m[2][0] * v.x + m.m[2][1] * v.y + m.m[2][2] * v.z;
     return result;
 }
+
+//
+// Affine2
+//
+
+// The 2D affine part of a transform: x' = m[0][0]*x + m[0][1]*y + m[0][2], and the same for y' with row 1.
+// That's all that's left of a Matrix4 when it only transforms points on the z=0 plane and
+// you only look at the resulting x and y (like when drawing quads).
+typedef struct Affine2 {
+    union {float32 m[2][3]; float32 data[6]; };
+} Affine2;
+
+inline Affine2 affine2_identity() { return (Affine2){ .m = {{1, 0, 0}, {0, 1, 0}} }; }
+
+// Same x and y as m4_transform(m, v4(x, y, 0, 1))
+Affine2 m4_to_affine2(Matrix4 m) {
+    Affine2 a;
+    a.m[0][0] = m.m[0][0]; a.m[0][1] = m.m[0][1]; a.m[0][2] = m.m[0][3];
+    a.m[1][0] = m.m[1][0]; a.m[1][1] = m.m[1][1]; a.m[1][2] = m.m[1][3];
+    return a;
+}
+
+// a applied after b
+Affine2 affine2_mul(Affine2 a, Affine2 b) {
+    Affine2 result;
+    for (int i = 0; i < 2; ++i) {
+        result.m[i][0] = a.m[i][0] * b.m[0][0] + a.m[i][1] * b.m[1][0];
+        result.m[i][1] = a.m[i][0] * b.m[0][1] + a.m[i][1] * b.m[1][1];
+        result.m[i][2] = a.m[i][0] * b.m[0][2] + a.m[i][1] * b.m[1][2] + a.m[i][2];
+    }
+    return result;
+}
+
+inline Vector2f32 affine2_transform(Affine2 a, Vector2f32 v) {
+    return v2f32(a.m[0][0] * v.x + a.m[0][1] * v.y + a.m[0][2], 
+                 a.m[1][0] * v.x + a.m[1][1] * v.y + a.m[1][2]);
+}
+
+// Only translates and scales, so x' only depends on x and y' only on y
+inline bool affine2_is_axis_aligned(Affine2 a) { return a.m[0][1] == 0 && a.m[1][0] == 0; }
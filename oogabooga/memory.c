@@ -43,55 +43,111 @@ Allocator get_initialization_allocator() {
 
 ///
 ///
-// Basic general heap allocator, free list
+// Basic general heap allocator, two-level segregated fit (TLSF)
 ///
-// Technically thread safe but synchronization is horrible.
-// Fragmentation is catastrophic.
-// We could fix it by merging free nodes every now and then
-// BUT: We aren't really supposed to allocate/deallocate directly on the heap too much anyways...
+// Free chunks are kept in size class lists. The first level is the power of two of the size,
+// the second level splits each power of two into HEAP_SECOND_LEVEL_COUNT linear classes.
+// Two bitmaps tell which lists are non-empty so both alloc and dealloc are O(1): no walking
+// blocks or free lists. Chunks know their physical neighbours so freed chunks are merged
+// right away.
+// The TLSF lists are behind one global lock, but small allocations are served from per-thread
+// caches that don't take it (see Heap_Thread_Cache).
 
 #define MAX_HEAP_BLOCK_SIZE align_next(MB(500), os.page_size)
 #define DEFAULT_HEAP_BLOCK_SIZE (min(MAX_HEAP_BLOCK_SIZE, program_memory_capacity))
-#define HEAP_ALIGNMENT (sizeof(Heap_Free_Node))
+#define HEAP_ALIGNMENT 16
+#define HEAP_ALIGNMENT_LOG2 4
+#define HEAP_SECOND_LEVEL_LOG2 4
+#define HEAP_SECOND_LEVEL_COUNT (1 << HEAP_SECOND_LEVEL_LOG2)
+// Sizes below this all go in first level 0 with one class per HEAP_ALIGNMENT
+#define HEAP_SMALL_SIZE (1ull << (HEAP_SECOND_LEVEL_LOG2+HEAP_ALIGNMENT_LOG2))
+#define HEAP_FIRST_LEVEL_COUNT 32 // Up to 2^39 bytes, way more than MAX_HEAP_BLOCK_SIZE
+#define HEAP_CHUNK_FREE_BIT 1ull
 typedef struct Heap_Free_Node Heap_Free_Node;
 typedef struct Heap_Block Heap_Block;
+typedef struct Heap_Allocation_Metadata Heap_Allocation_Metadata;
+typedef struct Heap_Thread_Cache Heap_Thread_Cache;
 
-typedef struct Heap_Free_Node {
-	u64 size;
-	Heap_Free_Node *next;
-} Heap_Free_Node;
-
-typedef struct Heap_Block {
+typedef struct alignat(16) Heap_Block {
 	u64 size;
-	Heap_Free_Node *free_head;
 	void* start;
 	Heap_Block *next;
-	// 32 bytes !!
 #if CONFIGURATION == DEBUG
 	u64 total_allocated;
-	u64 padding;
 #endif
 } Heap_Block;
 
 #define HEAP_META_SIGNATURE 6969694206942069ull
-typedef alignat(16) struct Heap_Allocation_Metadata {
-	u64 size;
+#define HEAP_FREE_SIGNATURE 4206942069696969ull
+#define HEAP_CACHED_SIGNATURE 2069694206969420ull
+// Every chunk in a heap block, allocated or free, starts with this
+typedef struct alignat(16) Heap_Allocation_Metadata {
+	u64 size; // Including metadata. HEAP_CHUNK_FREE_BIT is set if the chunk is free.
 	Heap_Block *block;
+	Heap_Allocation_Metadata *previous; // Physically previous chunk in the block, 0 if first
+	Heap_Thread_Cache *owner; // Thread cache this chunk goes back to when freed, 0 if straight back to the heap
 #if CONFIGURATION == DEBUG
 	u64 signature;
-	u64 padding;
 #endif
 } Heap_Allocation_Metadata;
 
+typedef struct Heap_Free_Node {
+	Heap_Allocation_Metadata meta;
+	Heap_Free_Node *next;
+	Heap_Free_Node *previous;
+} Heap_Free_Node;
+
+typedef struct Heap_Free_Lists {
+	u64 first_level_map; // Bit n is set if second_level_maps[n] != 0
+	u32 second_level_maps[HEAP_FIRST_LEVEL_COUNT]; // Bit n is set if heads[first][n] != 0
+	Heap_Free_Node *heads[HEAP_FIRST_LEVEL_COUNT][HEAP_SECOND_LEVEL_COUNT];
+} Heap_Free_Lists;
+
+// Per-thread cache of small chunks, one list per chunk size.
+// Cached chunks are allocated as far as the TLSF lists know, and remember their owner cache.
+// - Alloc and free on the owning thread just pop/push the local lists, no lock.
+// - Free on another thread pushes to the owner's lock-free remote_frees list, which the owner
+//   takes back the next time one of its lists runs empty.
+// - Misses refill a batch, and lists that grow past HEAP_THREAD_CACHE_MAX_BYTES_PER_CLASS give
+//   half back, so heap_lock is taken once per batch.
+// Caches are never freed. When a thread exits its cache is flushed and reused by the next thread.
+// That happens for threads started with os_thread_start and for the main thread when the entry
+// proc returns. Any other thread that allocates (one made directly with the OS API for example)
+// holds on to its cached chunks until it calls heap_release_thread_cache itself, or until the
+// process exits.
+#define HEAP_THREAD_CACHE_MAX_CHUNK_SIZE 1024
+#define HEAP_THREAD_CACHE_CLASS_COUNT (HEAP_THREAD_CACHE_MAX_CHUNK_SIZE/HEAP_ALIGNMENT)
+#define HEAP_THREAD_CACHE_BATCH_BYTES KB(4)
+#define HEAP_THREAD_CACHE_MAX_BYTES_PER_CLASS KB(32)
+
+typedef struct Heap_Cached_Chunk Heap_Cached_Chunk;
+typedef struct Heap_Cached_Chunk {
+	// Lives in the user memory of the chunk, right after its metadata
+	Heap_Cached_Chunk *next;
+} Heap_Cached_Chunk;
+
+typedef struct Heap_Thread_Cache {
+	Heap_Cached_Chunk *lists[HEAP_THREAD_CACHE_CLASS_COUNT];
+	u64 counts[HEAP_THREAD_CACHE_CLASS_COUNT];
+	volatile u64 remote_frees; // Heap_Cached_Chunk*, pushed to by other threads
+	bool in_use;
+	Heap_Thread_Cache *next; // In heap_thread_caches
+} Heap_Thread_Cache;
+
 // #Global
 ogb_instance Heap_Block *heap_head;
 ogb_instance bool heap_initted;
 ogb_instance Spinlock heap_lock;
+ogb_instance Heap_Free_Lists heap_free_lists;
+ogb_instance Heap_Thread_Cache *heap_thread_caches;
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
 Heap_Block *heap_head;
 bool heap_initted = false;
 Spinlock heap_lock;
+Heap_Free_Lists heap_free_lists;
+Heap_Thread_Cache *heap_thread_caches = 0;
+thread_local Heap_Thread_Cache *heap_thread_cache = 0;
 #endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
 	
 
@@ -117,6 +173,118 @@ bool is_pointer_valid(void *p) {
 	return is_pointer_in_program_memory(p) || is_pointer_in_stack(p) || is_pointer_in_static_memory(p);
 }
 
+inline u64 heap_highest_bit_index(u64 x) {
+#if COMPILER_MSVC
+	unsigned long index;
+	_BitScanReverse64(&index, x);
+	return (u64)index;
+#else
+	return 63 - (u64)__builtin_clzll(x);
+#endif
+}
+inline u64 heap_lowest_bit_index(u64 x) {
+#if COMPILER_MSVC
+	unsigned long index;
+	_BitScanForward64(&index, x);
+	return (u64)index;
+#else
+	return (u64)__builtin_ctzll(x);
+#endif
+}
+
+inline u64 heap_chunk_size(Heap_Allocation_Metadata *chunk) {
+	return chunk->size & ~HEAP_CHUNK_FREE_BIT;
+}
+inline bool heap_chunk_is_free(Heap_Allocation_Metadata *chunk) {
+	return (chunk->size & HEAP_CHUNK_FREE_BIT) != 0;
+}
+// Physically next chunk in the block, 0 if last
+inline Heap_Allocation_Metadata *heap_chunk_next(Heap_Allocation_Metadata *chunk) {
+	u8 *next = (u8*)chunk + heap_chunk_size(chunk);
+	u8 *block_end = (u8*)chunk->block + chunk->block->size;
+	return next < block_end ? (Heap_Allocation_Metadata*)next : 0;
+}
+
+inline void heap_size_to_class(u64 size, u64 *first_level, u64 *second_level) {
+	if (size < HEAP_SMALL_SIZE) {
+		*first_level = 0;
+		*second_level = size >> HEAP_ALIGNMENT_LOG2;
+	} else {
+		u64 highest_bit = heap_highest_bit_index(size);
+		*first_level = highest_bit - (HEAP_SECOND_LEVEL_LOG2+HEAP_ALIGNMENT_LOG2) + 1;
+		*second_level = (size >> (highest_bit - HEAP_SECOND_LEVEL_LOG2)) ^ HEAP_SECOND_LEVEL_COUNT;
+	}
+	assert(*first_level < HEAP_FIRST_LEVEL_COUNT, "Internal heap error: size %llu is too large for the size classes", size);
+}
+
+void heap_insert_free_node(Heap_Free_Node *node) {
+	u64 first, second;
+	heap_size_to_class(heap_chunk_size(&node->meta), &first, &second);
+	
+	Heap_Free_Node **head = &heap_free_lists.heads[first][second];
+	node->previous = 0;
+	node->next = *head;
+	if (*head) (*head)->previous = node;
+	*head = node;
+	
+	heap_free_lists.first_level_map |= 1ull << first;
+	heap_free_lists.second_level_maps[first] |= 1u << second;
+}
+void heap_remove_free_node(Heap_Free_Node *node) {
+	u64 first, second;
+	heap_size_to_class(heap_chunk_size(&node->meta), &first, &second);
+	
+	if (node->next) node->next->previous = node->previous;
+	if (node->previous) node->previous->next = node->next;
+	else {
+		assert(heap_free_lists.heads[first][second] == node, "Internal heap error: free node is not in its size class list");
+		heap_free_lists.heads[first][second] = node->next;
+		if (!node->next) {
+			heap_free_lists.second_level_maps[first] &= ~(1u << second);
+			if (!heap_free_lists.second_level_maps[first]) heap_free_lists.first_level_map &= ~(1ull << first);
+		}
+	}
+}
+
+// Good-fit: rounds the size up to the next class so any node in the found class is large enough
+Heap_Free_Node *heap_find_free_node(u64 size) {
+	if (size >= HEAP_SMALL_SIZE) {
+		size += (1ull << (heap_highest_bit_index(size) - HEAP_SECOND_LEVEL_LOG2)) - 1;
+	}
+	u64 first, second;
+	heap_size_to_class(size, &first, &second);
+	
+	u32 second_map = heap_free_lists.second_level_maps[first] & (~0u << second);
+	if (!second_map) {
+		u64 first_map = first+1 < 64 ? heap_free_lists.first_level_map & (~0ull << (first+1)) : 0;
+		if (!first_map) return 0;
+		first = heap_lowest_bit_index(first_map);
+		second_map = heap_free_lists.second_level_maps[first];
+	}
+	second = heap_lowest_bit_index(second_map);
+	
+	return heap_free_lists.heads[first][second];
+}
+
+// In debug, the pages fully inside free chunks are locked so use-after-free crashes.
+// The free node header is never locked.
+inline u8 *heap_free_node_first_lockable_page(Heap_Free_Node *node) {
+	return (u8*)align_next((u8*)node + sizeof(Heap_Free_Node), os.page_size);
+}
+inline u8 *heap_free_node_lockable_end(Heap_Free_Node *node) {
+	return (u8*)align_previous((u8*)node + heap_chunk_size(&node->meta), os.page_size);
+}
+inline void heap_lock_pages(u8 *first_page, u8 *end) {
+#if CONFIGURATION == DEBUG
+	if (end > first_page) os_lock_program_memory_pages(first_page, (u64)(end-first_page));
+#endif
+}
+inline void heap_unlock_pages(u8 *first_page, u8 *end) {
+#if CONFIGURATION == DEBUG
+	if (end > first_page) os_unlock_program_memory_pages(first_page, (u64)(end-first_page));
+#endif
+}
+
 // Meant for debug
 void sanity_check_block(Heap_Block *block) {
 #if CONFIGURATION == DEBUG
@@ -127,92 +295,77 @@ void sanity_check_block(Heap_Block *block) {
 	assert(block->size >= INITIAL_PROGRAM_MEMORY_SIZE, "A heap block is corrupt.");
 	assert((u64)block->start == (u64)block + sizeof(Heap_Block), "A heap block is corrupt.");
 	
-
-	Heap_Free_Node *node = block->free_head;	
+	Heap_Allocation_Metadata *chunk = (Heap_Allocation_Metadata*)block->start;
+	Heap_Allocation_Metadata *previous = 0;
 	
 	u64 total_free = 0;
-	while (node != 0) {
-		Heap_Free_Node *other_node = node->next;
+	u64 total_allocated = 0;
+	while (chunk != 0) {
+		u64 size = heap_chunk_size(chunk);
 		
-		assert(node->size < GB(256), "Heap is corrupt");
-		assert(is_pointer_in_program_memory(node), "Heap is corrupt");
+		assert(is_pointer_in_program_memory(chunk), "Heap is corrupt");
+		assert(chunk->block == block, "Heap is corrupt: chunk does not point to its block");
+		assert(chunk->previous == previous, "Heap is corrupt: chunk does not point to its physically previous chunk");
+		assert(size >= sizeof(Heap_Free_Node) && size % HEAP_ALIGNMENT == 0, "Heap is corrupt: bad chunk size");
 		
-		while (other_node != 0) {
-			assert(is_pointer_in_program_memory(other_node), "Heap is corrupt");
-			assert(other_node != node, "Circular reference in heap free node tree. This is probably an internal error, or an extremely unlucky result from heap corruption.");
-			other_node = other_node->next;
+		if (heap_chunk_is_free(chunk)) {
+			assert(chunk->signature == HEAP_FREE_SIGNATURE, "Heap is corrupt: bad free chunk signature");
+			assert(!previous || !heap_chunk_is_free(previous), "Internal heap error: two free chunks next to each other were not merged");
+			total_free += size;
+		} else {
+			assert(chunk->signature == HEAP_META_SIGNATURE || chunk->signature == HEAP_CACHED_SIGNATURE, "Heap is corrupt: bad allocation signature");
+			total_allocated += size;
 		}
-		total_free += node->size;
-		assert(total_free <= block->size, "Free nodes are fucky wucky. This might be heap corruption, or possibly an internal error.");
-		node = node->next;
+		assert(total_free+total_allocated <= block->size, "Chunks are fucky wucky. This might be heap corruption, or possibly an internal error.");
+		
+		previous = chunk;
+		chunk = heap_chunk_next(chunk);
 	}
 	
 	u64 expected_size = get_heap_block_size_excluding_metadata(block);
-	assert(block->total_allocated+total_free == expected_size, "Heap is corrupt.")
+	assert(total_allocated == block->total_allocated, "Heap is corrupt.");
+	assert(block->total_allocated+total_free == expected_size, "Heap is corrupt.");
+#endif
+}
+// Meant for debug
+void sanity_check_free_lists() {
+#if CONFIGURATION == DEBUG
+	for (u64 first = 0; first < HEAP_FIRST_LEVEL_COUNT; first += 1) {
+		bool first_set = (heap_free_lists.first_level_map & (1ull << first)) != 0;
+		assert(first_set == (heap_free_lists.second_level_maps[first] != 0), "Internal heap error: first level map is out of sync");
+		
+		for (u64 second = 0; second < HEAP_SECOND_LEVEL_COUNT; second += 1) {
+			Heap_Free_Node *node = heap_free_lists.heads[first][second];
+			bool second_set = (heap_free_lists.second_level_maps[first] & (1u << second)) != 0;
+			assert(second_set == (node != 0), "Internal heap error: second level map is out of sync");
+			
+			Heap_Free_Node *previous = 0;
+			while (node) {
+				assert(is_pointer_in_program_memory(node), "Heap is corrupt");
+				assert(heap_chunk_is_free(&node->meta), "Heap is corrupt: allocated chunk in a free list");
+				assert(node->previous == previous, "Heap is corrupt: free list links are broken");
+				u64 node_first, node_second;
+				heap_size_to_class(heap_chunk_size(&node->meta), &node_first, &node_second);
+				assert(node_first == first && node_second == second, "Internal heap error: free node is in the wrong size class");
+				previous = node;
+				node = node->next;
+			}
+		}
+	}
 #endif
 }
 inline void check_meta(Heap_Allocation_Metadata *meta) {
 #if CONFIGURATION == DEBUG
-	assert(meta->signature == HEAP_META_SIGNATURE, "Heap error. Either 1) You passed a bad pointer to dealloc or 2) You corrupted the heap.");
+	assert(meta->signature == HEAP_META_SIGNATURE, "Heap error. Either 1) You passed a bad pointer to dealloc, 2) You freed it twice or 3) You corrupted the heap.");
 #endif
 // If > 256GB then prolly not legit lol
 	assert(meta->size < 1024ULL*1024ULL*1024ULL*256ULL, "Heap error. Either 1) You passed a bad pointer to dealloc or 2) You corrupted the heap.");	
+	assert(!heap_chunk_is_free(meta), "Heap error. Either 1) You freed a pointer twice or 2) You corrupted the heap.");	
 	assert(is_pointer_in_program_memory(meta->block), "Heap error. Either 1) You passed a bad pointer to dealloc or 2) You corrupted the heap."); 
 
 	assert((u64)meta >= (u64)meta->block->start && (u64)meta < (u64)meta->block->start+meta->block->size, "Heap error: Pointer is not in it's metadata block. This could be heap corruption but it's more likely an internal error. That's not good.");
 }
 
-typedef struct {
-	Heap_Free_Node *best_fit;
-	Heap_Free_Node *previous;
-	u64 delta;
-} Heap_Search_Result;
-Heap_Search_Result search_heap_block(Heap_Block *block, u64 size) {
-	
-	if (block->free_head == 0)  return (Heap_Search_Result){0, 0, 0};
-		
-	Heap_Free_Node *node = block->free_head;
-	Heap_Free_Node *previous = 0;
-	
-	Heap_Free_Node *best_fit = 0;
-	Heap_Free_Node *before_best_fit = 0;
-	u64 best_fit_delta = 0;
-	
-	while (node != 0) {
-		
-		if (node->size == size) {
-			Heap_Search_Result result;
-			result.best_fit = node;
-			result.previous = previous;
-			result.delta = 0;
-			assert(result.previous != result.best_fit, "Internal goof");
-			return result;
-		}
-		
-		if (node->size >= size) {
-			u64 delta = node->size - size;
-			
-			if (delta < best_fit_delta || !best_fit) {
-				before_best_fit = previous;
-				best_fit = node;
-				best_fit_delta = delta;
-			}
-		}
-		
-		if (node->next) previous = node;
-		node = node->next;
-	}
-	
-	if (!best_fit)  return (Heap_Search_Result){0, 0, 0};
-
-	Heap_Search_Result result;
-	result.best_fit = best_fit;
-	result.previous = before_best_fit;
-	result.delta = best_fit_delta;
-	assert(result.previous != result.best_fit, "Internal goof");
-	return result;
-}
-
 Heap_Block *make_heap_block(Heap_Block *parent, u64 size) {
 
 	size += sizeof(Heap_Block);
@@ -233,9 +386,17 @@ Heap_Block *make_heap_block(Heap_Block *parent, u64 size) {
 	block->start = ((u8*)block)+sizeof(Heap_Block);
 	block->size = size;
 	block->next = 0;
-	block->free_head = (Heap_Free_Node*)block->start;
-	block->free_head->size = get_heap_block_size_excluding_metadata(block);
-	block->free_head->next = 0;
+	
+	// The whole block starts out as one free chunk
+	Heap_Free_Node *node = (Heap_Free_Node*)block->start;
+	node->meta.size = get_heap_block_size_excluding_metadata(block) | HEAP_CHUNK_FREE_BIT;
+	node->meta.block = block;
+	node->meta.previous = 0;
+#if CONFIGURATION == DEBUG
+	node->meta.signature = HEAP_FREE_SIGNATURE;
+#endif
+	heap_insert_free_node(node);
+	heap_lock_pages(heap_free_node_first_lockable_page(node), heap_free_node_lockable_end(node));
 	
 	return block;
 }
@@ -244,28 +405,16 @@ void heap_init() {
 	if (heap_initted) return;
 	assert(HEAP_ALIGNMENT == 16);
 	assert(sizeof(Heap_Allocation_Metadata) % HEAP_ALIGNMENT == 0);
+	assert(sizeof(Heap_Free_Node) % HEAP_ALIGNMENT == 0);
+	assert(sizeof(Heap_Block) % HEAP_ALIGNMENT == 0);
 	heap_initted = true;
+	memset(&heap_free_lists, 0, sizeof(heap_free_lists));
 	heap_head = make_heap_block(0, DEFAULT_HEAP_BLOCK_SIZE);
 	spinlock_init(&heap_lock);
 }
 
-void *heap_alloc(u64 size) {
-
-	if (!heap_initted) heap_init();
-
-	// #Sync #Speed oof
-	spinlock_acquire_or_wait(&heap_lock);
-	
-
-
-
-	
-	size += sizeof(Heap_Allocation_Metadata);
-	
-	size = (size+HEAP_ALIGNMENT) & ~(HEAP_ALIGNMENT-1);
-	
-	assert(size < MAX_HEAP_BLOCK_SIZE, "Past Charlie has been lazy and did not handle large allocations like this. I apologize on behalf of past Charlie. A quick fix could be to increase the heap block size for now. #Incomplete #Limitation");
-	
+// heap_lock needs to be held. Size includes metadata.
+Heap_Allocation_Metadata *heap_alloc_chunk_locked(u64 size) {
 	
 #if VERY_DEBUG
 	{
@@ -275,145 +424,77 @@ void *heap_alloc(u64 size) {
 			sanity_check_block(block);
 			block = block->next;
 		}
+		sanity_check_free_lists();
 	}
 #endif
 	
-	Heap_Block *block = heap_head;
-	Heap_Block *last_block = 0;
-	Heap_Free_Node *best_fit = 0;
-	Heap_Block *best_fit_block = 0;
-	Heap_Free_Node *previous = 0;
-	u64 best_fit_delta = 0;
-	// #Speed
-	// Maybe instead of going through EVERY free node to find best fit we do a good-enough fit
-	while (block != 0) {
-
-		if (get_heap_block_size_excluding_metadata(block) < size) {
-			last_block = block;
-			block = block->next;
-			continue;
-		}
+	Heap_Free_Node *node = heap_find_free_node(size);
 	
-		Heap_Search_Result result = search_heap_block(block, size);
-		Heap_Free_Node *node = result.best_fit;
-		if (node) {
-			if (node->size < size) continue;
-			if (node->size == size) {
-				best_fit = node;
-				best_fit_block = block;
-				previous = result.previous;
-				best_fit_delta = 0;
-				break;
-			}
-			
-			u64 delta = node->size-size;
-			if (delta < best_fit_delta || !best_fit) {
-				best_fit = node;
-				best_fit_block = block;
-				previous = result.previous;
-				best_fit_delta = delta;
-			}
-		}
+	if (!node) {
+		Heap_Block *last_block = heap_head;
+		while (last_block->next) last_block = last_block->next;
 		
-		last_block = block;
-		block = block->next;
+		Heap_Block *block = make_heap_block(last_block, max(DEFAULT_HEAP_BLOCK_SIZE, size));
+		node = (Heap_Free_Node*)block->start;
 	}
 	
-	if (!best_fit) {
-		block = make_heap_block(last_block, max(DEFAULT_HEAP_BLOCK_SIZE, size));
-		previous = 0;
-		best_fit = block->free_head;
-		best_fit_block = block;
-	}
-		
+	assert(node != 0, "Internal heap error");
+	assert(heap_chunk_size(&node->meta) >= size, "Internal heap error: free node from size class is too small");
 	
-	assert(best_fit != 0, "Internal heap error");
+	heap_remove_free_node(node);
 	
-	// Unlock best fit
+	u64 chunk_size = heap_chunk_size(&node->meta);
+	bool split = chunk_size - size >= sizeof(Heap_Free_Node);
+	Heap_Free_Node *remainder = (Heap_Free_Node*)((u8*)node + size);
 	
-	// #Copypaste
-	void *free_tail = (u8*)best_fit + best_fit->size;
-	void *first_page = (void*)align_previous(best_fit, os.page_size);
-	void *last_page_end = (void*)align_previous(free_tail, os.page_size);
-	if ((u8*)last_page_end > (u8*)first_page) {
-		os_unlock_program_memory_pages(first_page, (u64)last_page_end-(u64)first_page);
-	}
+	// If we split, the remainder keeps the end of the locked pages
+	u8 *unlock_end = heap_free_node_lockable_end(node);
+	if (split) unlock_end = min(unlock_end, heap_free_node_first_lockable_page(remainder));
+	heap_unlock_pages(heap_free_node_first_lockable_page(node), unlock_end);
 	
-	Heap_Free_Node *new_free_node = 0;
-	if (size != best_fit->size) {
-		u64 remainder = best_fit->size - size;
-		new_free_node = (Heap_Free_Node*)(((u8*)best_fit)+size);
-		new_free_node->size = remainder;
-		new_free_node->next = best_fit->next;
+	if (split) {
+		// The remainder goes back in the free lists
+		remainder->meta.size = (chunk_size - size) | HEAP_CHUNK_FREE_BIT;
+		remainder->meta.block = node->meta.block;
+		remainder->meta.previous = &node->meta;
+#if CONFIGURATION == DEBUG
+		remainder->meta.signature = HEAP_FREE_SIGNATURE;
+#endif
+		Heap_Allocation_Metadata *after = heap_chunk_next(&remainder->meta);
+		if (after) after->previous = &remainder->meta;
 		
-		// Lock remaining free node
-		// #Copypaste
-		void *free_tail = (u8*)new_free_node + new_free_node->size;
-		void *next_page = (void*)align_next(new_free_node, os.page_size);
-		void *last_page_end = (void*)align_previous(free_tail, os.page_size);
-		if ((u8*)last_page_end > (u8*)next_page) {
-			os_lock_program_memory_pages(next_page, (u64)last_page_end-(u64)next_page);
-		}
-	}
-	
-	
-	if (previous && new_free_node) {
-		assert(previous->next == best_fit, "Internal heap error");
-		previous->next = new_free_node;
-	} else if (previous) {
-		assert(previous->next == best_fit, "Internal heap error");
-		previous->next = best_fit->next;
-	}
-	
-	if (best_fit_block->free_head == best_fit) {
-		// If we allocated the first free node then replace with new free node or just
-		// remove it if perfect fit.
-		if (new_free_node) {
-			new_free_node->next = best_fit_block->free_head->next;
-			best_fit_block->free_head = new_free_node;
-		} else best_fit_block->free_head = best_fit_block->free_head->next;
+		heap_insert_free_node(remainder);
+		
+		chunk_size = size;
 	}
 	
-	Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)best_fit;
-	meta->size = size;
-	meta->block = best_fit_block;
+	Heap_Allocation_Metadata *meta = &node->meta;
+	meta->size = chunk_size;
+	meta->owner = 0;
 #if CONFIGURATION == DEBUG
 	meta->signature = HEAP_META_SIGNATURE;
-	meta->block->total_allocated += size;
+	meta->block->total_allocated += chunk_size;
 #endif
 
 	check_meta(meta);
 
 #if VERY_DEBUG
 	sanity_check_block(meta->block);
+	sanity_check_free_lists();
 #endif
 	
-	// #Sync #Speed oof
-	spinlock_release(&heap_lock);
-	
-	
-	void *p = ((u8*)meta)+sizeof(Heap_Allocation_Metadata);
-	assert((u64)p % HEAP_ALIGNMENT == 0, "Internal heap error. Result pointer is not aligned to HEAP_ALIGNMENT");
-	return p;
+	return meta;
 }
-void heap_dealloc(void *p) {
-	// #Sync #Speed oof
-	
-	if (!heap_initted) heap_init();
-
-	spinlock_acquire_or_wait(&heap_lock);
-	
-	assert(is_pointer_in_program_memory(p), "A bad pointer was passed tp heap_dealloc: it is out of program memory bounds!"); 
-	p = (u8*)p-sizeof(Heap_Allocation_Metadata);
-	Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)(p);
-	check_meta(meta);
+// heap_lock needs to be held
+void heap_free_chunk_locked(Heap_Allocation_Metadata *meta) {
+	void *p = meta;
 	
-	// Yoink meta data before we start overwriting it
 	Heap_Block *block = meta->block;
 	u64 size = meta->size;
+	u64 allocated_size = meta->size;
 	
 #if CONFIGURATION == DEBUG
-	memset(p, 0x69696969, size);
+	memset((u8*)p+sizeof(Heap_Allocation_Metadata), 0x69696969, size-sizeof(Heap_Allocation_Metadata));
 #endif
 	
 	#if VERY_DEBUG
@@ -421,113 +502,253 @@ void heap_dealloc(void *p) {
 	#endif
 	
 	Heap_Free_Node *new_node = cast(Heap_Free_Node*)p;
-	new_node->size = size;
-	
-	if (new_node < block->free_head) {
-		// #Copypaste
-		void *free_tail = (u8*)new_node + new_node->size;
-		void *next_page = (void*)align_next(new_node, os.page_size);
-		void *last_page_end = (void*)align_previous(free_tail, os.page_size);
-		if ((u8*)last_page_end > (u8*)next_page) {
-			os_lock_program_memory_pages(next_page, (u64)last_page_end-(u64)next_page);
-		}
+	Heap_Allocation_Metadata *previous = meta->previous;
+	Heap_Allocation_Metadata *next = heap_chunk_next(meta);
+	
+	// Pages that are already locked by the neighbours we merge with
+	u8 *lock_first_page = heap_free_node_first_lockable_page(new_node);
+	u8 *lock_end = (u8*)align_previous((u8*)p + size, os.page_size);
+	
+	// Merge with free neighbours
+	if (previous && heap_chunk_is_free(previous)) {
+		Heap_Free_Node *previous_node = (Heap_Free_Node*)previous;
+		heap_remove_free_node(previous_node);
+		lock_first_page = max(heap_free_node_first_lockable_page(previous_node), heap_free_node_lockable_end(previous_node));
+		size += heap_chunk_size(previous);
+		new_node = previous_node;
+		previous = previous->previous;
+	}
+	if (next && heap_chunk_is_free(next)) {
+		Heap_Free_Node *next_node = (Heap_Free_Node*)next;
+		heap_remove_free_node(next_node);
+		lock_end = min((u8*)align_previous((u8*)next + heap_chunk_size(next), os.page_size), heap_free_node_first_lockable_page(next_node));
+		size += heap_chunk_size(next);
+	}
+	
+	new_node->meta.size = size | HEAP_CHUNK_FREE_BIT;
+	new_node->meta.block = block;
+	new_node->meta.previous = previous;
+#if CONFIGURATION == DEBUG
+	new_node->meta.signature = HEAP_FREE_SIGNATURE;
+#endif
+	Heap_Allocation_Metadata *after = heap_chunk_next(&new_node->meta);
+	if (after) after->previous = &new_node->meta;
+	
+	heap_insert_free_node(new_node);
+	
+	lock_first_page = max(lock_first_page, heap_free_node_first_lockable_page(new_node));
+	lock_end = min(lock_end, heap_free_node_lockable_end(new_node));
+	heap_lock_pages(lock_first_page, lock_end);
+
+#if CONFIGURATION == DEBUG
+	block->total_allocated -= allocated_size;
+#endif
+
+#if VERY_DEBUG
+	sanity_check_block(block);
+	sanity_check_free_lists();
+#endif
+}
+
+inline u64 heap_thread_cache_class(u64 chunk_size) {
+	return chunk_size/HEAP_ALIGNMENT - 1;
+}
+
+inline void heap_thread_cache_push(Heap_Thread_Cache *cache, Heap_Allocation_Metadata *meta) {
+	Heap_Cached_Chunk *chunk = (Heap_Cached_Chunk*)((u8*)meta + sizeof(Heap_Allocation_Metadata));
+	u64 class = heap_thread_cache_class(meta->size);
+	chunk->next = cache->lists[class];
+	cache->lists[class] = chunk;
+	cache->counts[class] += 1;
+}
+
+// Moves everything other threads freed into the local lists
+void heap_thread_cache_take_remote_frees(Heap_Thread_Cache *cache) {
+	u64 remote;
+	while (true) {
+		remote = cache->remote_frees;
+		if (!remote) return;
+		if (compare_and_swap_64(&cache->remote_frees, 0, remote)) break;
+	}
+	
+	Heap_Cached_Chunk *chunk = (Heap_Cached_Chunk*)remote;
+	while (chunk) {
+		Heap_Cached_Chunk *next = chunk->next;
+		heap_thread_cache_push(cache, (Heap_Allocation_Metadata*)((u8*)chunk - sizeof(Heap_Allocation_Metadata)));
+		chunk = next;
+	}
+}
+
+void heap_thread_cache_push_remote(Heap_Thread_Cache *owner, Heap_Allocation_Metadata *meta) {
+	Heap_Cached_Chunk *chunk = (Heap_Cached_Chunk*)((u8*)meta + sizeof(Heap_Allocation_Metadata));
+	while (true) {
+		u64 head = owner->remote_frees;
+		chunk->next = (Heap_Cached_Chunk*)head;
+		if (compare_and_swap_64(&owner->remote_frees, (u64)chunk, head)) break;
+	}
+}
+
+// Gives back up to count chunks of a class to the heap under one lock
+void heap_thread_cache_flush_class(Heap_Thread_Cache *cache, u64 class, u64 count) {
+	if (!cache->lists[class]) return;
+	
+	// #Sync
+	spinlock_acquire_or_wait(&heap_lock);
+	for (u64 i = 0; i < count && cache->lists[class]; i += 1) {
+		Heap_Cached_Chunk *chunk = cache->lists[class];
+		cache->lists[class] = chunk->next;
+		cache->counts[class] -= 1;
 		
-		if ((u8*)new_node+size == (u8*)block->free_head) {
-			new_node->size = size + block->free_head->size;
-			new_node->next = block->free_head->next;
-			block->free_head = new_node;
-		} else {
-			new_node->next = block->free_head;
-			block->free_head = new_node;
+		heap_free_chunk_locked((Heap_Allocation_Metadata*)((u8*)chunk - sizeof(Heap_Allocation_Metadata)));
+	}
+	spinlock_release(&heap_lock);
+}
+
+// Allocates a batch of chunks of size into the cache under one lock
+void heap_thread_cache_refill(Heap_Thread_Cache *cache, u64 size) {
+	u64 count = max(HEAP_THREAD_CACHE_BATCH_BYTES/size, 1);
+	
+	// #Sync
+	spinlock_acquire_or_wait(&heap_lock);
+	for (u64 i = 0; i < count; i += 1) {
+		Heap_Allocation_Metadata *meta = heap_alloc_chunk_locked(size);
+		
+		// The heap may hand out a few bytes more if the rest was too small to split off
+		if (meta->size > HEAP_THREAD_CACHE_MAX_CHUNK_SIZE) {
+			heap_free_chunk_locked(meta);
+			break;
 		}
 		
-	} else {
+		meta->owner = cache;
+#if CONFIGURATION == DEBUG
+		meta->signature = HEAP_CACHED_SIGNATURE;
+#endif
+		heap_thread_cache_push(cache, meta);
+	}
+	spinlock_release(&heap_lock);
+}
+
+Heap_Thread_Cache *heap_get_thread_cache() {
+	if (heap_thread_cache) return heap_thread_cache;
 	
-		if (!block->free_head) {
-			block->free_head = new_node;
-			new_node->next = 0;
-			
-			// #Copypaste
-			void *free_tail = (u8*)new_node + new_node->size;
-			void *next_page = (void*)align_next(new_node, os.page_size);
-			void *last_page_end = (void*)align_previous(free_tail, os.page_size);
-			if ((u8*)last_page_end > (u8*)next_page) {
-				os_lock_program_memory_pages(next_page, (u64)last_page_end-(u64)next_page);
-			}
-			
-		} else {
-			Heap_Free_Node *node = block->free_head;
+	// #Sync
+	spinlock_acquire_or_wait(&heap_lock);
+	
+	Heap_Thread_Cache *cache = heap_thread_caches;
+	while (cache && cache->in_use) cache = cache->next;
+	
+	if (!cache) {
+		Heap_Allocation_Metadata *meta = heap_alloc_chunk_locked(align_next(sizeof(Heap_Allocation_Metadata)+sizeof(Heap_Thread_Cache), HEAP_ALIGNMENT));
+		cache = (Heap_Thread_Cache*)((u8*)meta + sizeof(Heap_Allocation_Metadata));
+		memset(cache, 0, sizeof(Heap_Thread_Cache));
+		cache->next = heap_thread_caches;
+		heap_thread_caches = cache;
+	}
+	cache->in_use = true;
+	
+	spinlock_release(&heap_lock);
+	
+	heap_thread_cache = cache;
+	return cache;
+}
+
+// Called when a thread exits (see the Heap_Thread_Cache comment for which threads do this).
+// Gives everything in its cache back to the heap and lets the next thread reuse the cache.
+// Chunks freed to it from other threads after this wait for that.
+void heap_release_thread_cache() {
+	Heap_Thread_Cache *cache = heap_thread_cache;
+	if (!cache) return;
+	
+	heap_thread_cache_take_remote_frees(cache);
+	for (u64 class = 0; class < HEAP_THREAD_CACHE_CLASS_COUNT; class += 1) {
+		heap_thread_cache_flush_class(cache, class, cache->counts[class]);
+	}
+	
+	MEMORY_BARRIER;
+	cache->in_use = false;
+	heap_thread_cache = 0;
+}
+
+void *heap_alloc(u64 size) {
+
+	if (!heap_initted) heap_init();
+	
+	size += sizeof(Heap_Allocation_Metadata);
+	
+	size = align_next(size, HEAP_ALIGNMENT);
+	
+	// Needs to be able to hold a free node once it's freed
+	size = max(size, sizeof(Heap_Free_Node));
+	
+	assert(size < MAX_HEAP_BLOCK_SIZE, "Past Charlie has been lazy and did not handle large allocations like this. I apologize on behalf of past Charlie. A quick fix could be to increase the heap block size for now. #Incomplete #Limitation");
+	
+	Heap_Allocation_Metadata *meta = 0;
+	
+	if (size <= HEAP_THREAD_CACHE_MAX_CHUNK_SIZE) {
+		Heap_Thread_Cache *cache = heap_get_thread_cache();
+		u64 class = heap_thread_cache_class(size);
 		
-			while (true) {
+		if (!cache->lists[class]) heap_thread_cache_take_remote_frees(cache);
+		if (!cache->lists[class]) heap_thread_cache_refill(cache, size);
+		
+		Heap_Cached_Chunk *chunk = cache->lists[class];
+		if (chunk) {
+			cache->lists[class] = chunk->next;
+			cache->counts[class] -= 1;
 			
-				assert(node != 0, "We didn't find where the free node should be! This is likely heap corruption (or, hopefully not, an internal error)");
-				
-				// In retrospect, I don't remember a good reason to care about where the
-				// free nodes are... maybe I'm just dumb right now? #Speed #Memory
-				// ... ACtually, it's probably to easily know when to merge free nodes.
-				// BUT. Maybe it's not worth the performance hit? Then again, if the heap
-				// allocator slows down your program you should rethink your memory management
-				// anyways...
-				
-				if (new_node >= node) {
-					u8* node_tail = (u8*)node + node->size;
-					if (cast(u8*)new_node == node_tail) {
-						
-						// We need to account for the cases where we coalesce free blocks with start/end in the middle
-						// of a page.
-						
-						u64 new_node_size = new_node->size;
-						
-						// #Copypaste
-						void *free_tail = (u8*)new_node + new_node->size;
-						void *next_page = (void*)align_previous(node_tail, os.page_size);
-						void *last_page_end = (void*)align_previous(free_tail, os.page_size);
-
-						if ((u8*)next_page < (u8*)node) next_page = (u8*)next_page + os.page_size;
-						
-						if ((u8*)last_page_end > (u8*)next_page) {
-							os_lock_program_memory_pages(next_page, (u64)last_page_end-(u64)next_page);
-						}
-						
-						node->size += new_node_size;
-						
-						break;
-					} else {
-						new_node->next = node->next;
-						node->next = new_node;
-						
-						u8* new_node_tail = (u8*)new_node + new_node->size;
-						if (new_node->next && (u8*)new_node->next == new_node_tail) {
-							new_node->size += new_node->next->size;
-							new_node->next = new_node->next->next;
-						}
-						
-						// #Copypaste
-						void *free_tail = (u8*)new_node + new_node->size;
-						void *next_page = (void*)align_next(new_node, os.page_size);
-						void *last_page_end = (void*)align_previous(free_tail, os.page_size);
-						if ((u8*)last_page_end > (u8*)next_page) {
-							os_lock_program_memory_pages(next_page, (u64)last_page_end-(u64)next_page);
-						}
-						
-						break;
-					}
-				}
-				
-				node = node->next;
-			}
+			meta = (Heap_Allocation_Metadata*)((u8*)chunk - sizeof(Heap_Allocation_Metadata));
+#if CONFIGURATION == DEBUG
+			assert(meta->signature == HEAP_CACHED_SIGNATURE, "Heap error: a cached chunk was written to after it was freed, or the heap is corrupt.");
+			meta->signature = HEAP_META_SIGNATURE;
+#endif
+			assert(meta->owner == cache, "Internal heap error: chunk is in the wrong thread cache");
 		}
 	}
 	
+	if (!meta) {
+		// #Sync #Speed
+		spinlock_acquire_or_wait(&heap_lock);
+		meta = heap_alloc_chunk_locked(size);
+		spinlock_release(&heap_lock);
+	}
 
+	check_meta(meta);
+	
+	void *p = ((u8*)meta)+sizeof(Heap_Allocation_Metadata);
+	assert((u64)p % HEAP_ALIGNMENT == 0, "Internal heap error. Result pointer is not aligned to HEAP_ALIGNMENT");
+	return p;
+}
+void heap_dealloc(void *p) {
+	
+	if (!heap_initted) heap_init();
+	
+	assert(is_pointer_in_program_memory(p), "A bad pointer was passed tp heap_dealloc: it is out of program memory bounds!"); 
+	Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)((u8*)p-sizeof(Heap_Allocation_Metadata));
+	check_meta(meta);
+	
+	Heap_Thread_Cache *owner = meta->owner;
+	if (owner) {
 #if CONFIGURATION == DEBUG
-	block->total_allocated -= size;
+		memset((u8*)p+sizeof(Heap_Cached_Chunk), 0x69696969, meta->size-sizeof(Heap_Allocation_Metadata)-sizeof(Heap_Cached_Chunk));
+		meta->signature = HEAP_CACHED_SIGNATURE;
 #endif
-
-#if VERY_DEBUG
-	sanity_check_block(block);
-#endif
-	// #Sync #Speed oof
+		if (owner != heap_thread_cache) {
+			heap_thread_cache_push_remote(owner, meta);
+			return;
+		}
+		
+		heap_thread_cache_push(owner, meta);
+		
+		u64 class = heap_thread_cache_class(meta->size);
+		if (owner->counts[class]*meta->size > HEAP_THREAD_CACHE_MAX_BYTES_PER_CLASS) {
+			heap_thread_cache_flush_class(owner, class, owner->counts[class]/2);
+		}
+		return;
+	}
+	
+	// #Sync #Speed
+	spinlock_acquire_or_wait(&heap_lock);
+	heap_free_chunk_locked(meta);
 	spinlock_release(&heap_lock);
 }
 
@@ -549,7 +770,7 @@ void* heap_allocator_proc(u64 size, void *p, Allocator_Message message, void* da
 			Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)(((u64)p)-sizeof(Heap_Allocation_Metadata));
 			check_meta(meta);
 			void *new = heap_alloc(size);
-			memcpy(new, p, min(size, meta->size));
+			memcpy(new, p, min(size, meta->size-sizeof(Heap_Allocation_Metadata)));
 			heap_dealloc(p);
 			return new;
 		}
@@ -570,10 +791,49 @@ Allocator get_heap_allocator() {
 ///
 // Temporary storage
 ///
+// Thread local chain of blocks that talloc bumps through, reset with reset_temporary_storage()
+// every frame. When the current block runs out another one (at least twice as big) is chained
+// from the heap instead of wrapping around over memory handed out earlier in the frame.
+// Extra blocks are given back after TEMPORARY_STORAGE_SHRINK_FRAMES resets in a row that fit
+// in the first block.
+// temporary_storage_stats tracks per-frame high-water marks so TEMPORARY_STORAGE_SIZE can be
+// sized from what is actually used.
 
 #ifndef TEMPORARY_STORAGE_SIZE
 	#define TEMPORARY_STORAGE_SIZE (1024ULL*1024ULL*2ULL) // 2mb
 #endif
+#ifndef TEMPORARY_STORAGE_SHRINK_FRAMES
+	#define TEMPORARY_STORAGE_SHRINK_FRAMES 120
+#endif
+
+typedef struct Temporary_Storage_Block Temporary_Storage_Block;
+typedef struct Temporary_Storage_Block {
+	Temporary_Storage_Block *next;
+	u64 size; // Excluding this header
+	u64 offset; // Sum of the sizes of the blocks before this one in the chain
+	u64 padding;
+} Temporary_Storage_Block;
+
+// Lets nested code give back what it talloc'd before the frame ends:
+//     Temporary_Storage_Mark mark = push_temporary_storage_mark();
+//     ... talloc ...
+//     pop_temporary_storage_mark(mark);
+typedef struct Temporary_Storage_Mark {
+	Temporary_Storage_Block *block;
+	u8 *pointer;
+} Temporary_Storage_Mark;
+
+typedef struct Temporary_Storage_Stats {
+	u64 allocation_count; // Since last reset_temporary_storage()
+	u64 high_water; // Most bytes in use since last reset, including unused tails of full blocks
+	u64 last_frame_allocation_count;
+	u64 last_frame_high_water;
+	u64 peak_high_water; // Highest high-water of any frame
+	u64 capacity; // Bytes in all blocks
+	u64 block_count;
+	u64 grow_count; // Number of times a block had to be added
+	u64 quiet_frame_count; // Resets in a row where the frame fit in the first block
+} Temporary_Storage_Stats;
 
 ogb_instance void* talloc(u64);
 ogb_instance void* temp_allocator_proc(u64 size, void *p, Allocator_Message message, void*);
@@ -583,9 +843,11 @@ ogb_instance Allocator
 get_temporary_allocator();
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
-thread_local void * temporary_storage = 0;
-thread_local void * temporary_storage_pointer = 0;
-thread_local bool   has_warned_temporary_storage_overflow = false;
+thread_local Temporary_Storage_Block * temporary_storage = 0; // First block
+thread_local Temporary_Storage_Block * temporary_storage_block = 0; // Current block
+thread_local u8 * temporary_storage_pointer = 0;
+thread_local u8 * temporary_storage_end = 0;
+thread_local Temporary_Storage_Stats temporary_storage_stats;
 thread_local Allocator temp_allocator;
 
 ogb_instance Allocator 
@@ -601,12 +863,24 @@ temp_allocator_proc(u64 size, void *p, Allocator_Message message, void* data);
 ogb_instance void 
 temporary_storage_init(u64 arena_size);
 
+ogb_instance void 
+temporary_storage_deinit();
+
 ogb_instance void* 
 talloc(u64 size);
 
 ogb_instance void 
 reset_temporary_storage();
 
+ogb_instance Temporary_Storage_Mark 
+push_temporary_storage_mark();
+
+ogb_instance void 
+pop_temporary_storage_mark(Temporary_Storage_Mark mark);
+
+ogb_instance Temporary_Storage_Stats 
+get_temporary_storage_stats();
+
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
 void* temp_allocator_proc(u64 size, void *p, Allocator_Message message, void* data) {
@@ -626,41 +900,130 @@ void* temp_allocator_proc(u64 size, void *p, Allocator_Message message, void* da
 	return 0;
 }
 
+inline u8 *temporary_storage_block_data(Temporary_Storage_Block *block) {
+	return (u8*)block + sizeof(Temporary_Storage_Block);
+}
+
+Temporary_Storage_Block *make_temporary_storage_block(u64 size, u64 offset) {
+	Temporary_Storage_Block *block = (Temporary_Storage_Block*)heap_alloc(sizeof(Temporary_Storage_Block) + size);
+	assert(block, "Failed allocating temporary storage");
+	block->next = 0;
+	block->size = size;
+	block->offset = offset;
+	
+	temporary_storage_stats.capacity += size;
+	temporary_storage_stats.block_count += 1;
+	
+	return block;
+}
+void free_temporary_storage_blocks(Temporary_Storage_Block *block) {
+	while (block) {
+		Temporary_Storage_Block *next = block->next;
+		temporary_storage_stats.capacity -= block->size;
+		temporary_storage_stats.block_count -= 1;
+		heap_dealloc(block);
+		block = next;
+	}
+}
+
+inline void temporary_storage_use_block(Temporary_Storage_Block *block, u8 *pointer) {
+	temporary_storage_block = block;
+	temporary_storage_pointer = pointer;
+	temporary_storage_end = temporary_storage_block_data(block) + block->size;
+}
+
 void temporary_storage_init(u64 arena_size) {
 	
-	temporary_storage = heap_alloc(arena_size);
-	assert(temporary_storage, "Failed allocating temporary storage");
-	temporary_storage_pointer = temporary_storage;
+	memset(&temporary_storage_stats, 0, sizeof(temporary_storage_stats));
+	
+	temporary_storage = make_temporary_storage_block(align_next(arena_size, 8), 0);
+	temporary_storage_use_block(temporary_storage, temporary_storage_block_data(temporary_storage));
 
 	temp_allocator.proc = temp_allocator_proc;
 	temp_allocator.data = 0;
+}
+void temporary_storage_deinit() {
+	free_temporary_storage_blocks(temporary_storage);
+	temporary_storage = 0;
+	temporary_storage_block = 0;
+	temporary_storage_pointer = 0;
+	temporary_storage_end = 0;
+}
+
+// Moves on to the next block in the chain, or chains a new one if there is none that fits
+void temporary_storage_grow(u64 size) {
+	Temporary_Storage_Block *current = temporary_storage_block;
+	Temporary_Storage_Block *next = current->next;
 	
-	temp_allocator.proc = temp_allocator_proc;
+	if (!next || next->size < size) {
+		// Nothing after the current block is in use
+		free_temporary_storage_blocks(current->next);
+		next = make_temporary_storage_block(max(size, current->size*2), current->offset + current->size);
+		current->next = next;
+		temporary_storage_stats.grow_count += 1;
+	}
+	
+	temporary_storage_use_block(next, temporary_storage_block_data(next));
 }
 
 void* talloc(u64 size) {
 	
-	assert(size < TEMPORARY_STORAGE_SIZE, "Bruddah this is too large for temp allocator");
+	assert(temporary_storage, "Temporary storage was not initialized on this thread");
+	
+	size = align_next(size, 8);
+	
+	if ((u64)(temporary_storage_end - temporary_storage_pointer) < size) {
+		temporary_storage_grow(size);
+	}
 	
 	void* p = temporary_storage_pointer;
 	
-	temporary_storage_pointer = (u8*)temporary_storage_pointer + size;
+	temporary_storage_pointer += size;
 	
-	if ((u8*)temporary_storage_pointer >= (u8*)temporary_storage+TEMPORARY_STORAGE_SIZE) {
-		if (!has_warned_temporary_storage_overflow) {
-			os_write_string_to_stdout(STR("WARNING: temporary storage was overflown, we wrap around at the start.\n"));
-			has_warned_temporary_storage_overflow = true;
-		}
-		temporary_storage_pointer = temporary_storage;
-		return talloc(size);;
-	}
+	temporary_storage_stats.allocation_count += 1;
+	u64 used = temporary_storage_block->offset + (u64)(temporary_storage_pointer - temporary_storage_block_data(temporary_storage_block));
+	if (used > temporary_storage_stats.high_water) temporary_storage_stats.high_water = used;
 	
 	return p;
 }
 
 void reset_temporary_storage() {
-	temporary_storage_pointer = temporary_storage;	
-	has_warned_temporary_storage_overflow = false;
+	Temporary_Storage_Stats *stats = &temporary_storage_stats;
+	
+	stats->last_frame_allocation_count = stats->allocation_count;
+	stats->last_frame_high_water = stats->high_water;
+	stats->peak_high_water = max(stats->peak_high_water, stats->high_water);
+	
+	if (temporary_storage->next) {
+		if (stats->high_water <= temporary_storage->size) stats->quiet_frame_count += 1;
+		else stats->quiet_frame_count = 0;
+		
+		if (stats->quiet_frame_count >= TEMPORARY_STORAGE_SHRINK_FRAMES) {
+			free_temporary_storage_blocks(temporary_storage->next);
+			temporary_storage->next = 0;
+			stats->quiet_frame_count = 0;
+		}
+	}
+	
+	stats->allocation_count = 0;
+	stats->high_water = 0;
+	
+	temporary_storage_use_block(temporary_storage, temporary_storage_block_data(temporary_storage));
+}
+
+Temporary_Storage_Mark push_temporary_storage_mark() {
+	Temporary_Storage_Mark mark;
+	mark.block = temporary_storage_block;
+	mark.pointer = temporary_storage_pointer;
+	return mark;
+}
+void pop_temporary_storage_mark(Temporary_Storage_Mark mark) {
+	// Blocks after the mark's block stay chained to be reused
+	temporary_storage_use_block(mark.block, mark.pointer);
+}
+
+Temporary_Storage_Stats get_temporary_storage_stats() {
+	return temporary_storage_stats;
 }
 
 #endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
@@ -749,3 +1112,156 @@ Allocator make_arena_allocator_from_arena(Arena *arena) {
 	
 	return allocator;
 }
+
+///
+///
+// Virtual arena
+///
+
+// A bump arena in its own address space reservation, outside of program memory.
+// Pages are committed as the arena grows and stay committed across resets, so once
+// it has reached its high water mark, pushing is just a pointer bump.
+// The last allocation can grow in place (ALLOCATOR_REALLOCATE_IN_PLACE), which is
+// what lets a growing array living in here grow without ever copying.
+
+#define VIRTUAL_ARENA_COMMIT_GRANULARITY KB(64)
+
+typedef struct Virtual_Arena {
+	u8 *base;
+	u64 reserved;
+	u64 committed;
+	u64 used;
+	void *last_allocation;
+	u64 peak_used;
+	// Set by make_virtual_arena_allocator
+	bool release_when_empty;
+} Virtual_Arena;
+
+u64 virtual_arena_header_size() {
+	return align_next(sizeof(Virtual_Arena), 16);
+}
+
+Virtual_Arena *make_virtual_arena(u64 size_to_reserve) {
+	u64 header_size = virtual_arena_header_size();
+	size_to_reserve = align_next(size_to_reserve + header_size, os.page_size);
+	
+	u8 *base = (u8*)os_reserve_virtual_memory(size_to_reserve);
+	assert(base, "Failed reserving %llu bytes for virtual arena", size_to_reserve);
+	
+	u64 committed = align_next(header_size, VIRTUAL_ARENA_COMMIT_GRANULARITY);
+	committed = min(committed, size_to_reserve);
+	bool ok = os_commit_virtual_memory(base, committed);
+	assert(ok, "Failed committing virtual arena memory");
+	
+	Virtual_Arena *arena = (Virtual_Arena*)base;
+	arena->base = base;
+	arena->reserved = size_to_reserve;
+	arena->committed = committed;
+	arena->used = header_size;
+	arena->last_allocation = 0;
+	arena->peak_used = header_size;
+	arena->release_when_empty = false;
+	
+	return arena;
+}
+void destroy_virtual_arena(Virtual_Arena *arena) {
+	os_release_virtual_memory(arena->base);
+}
+
+bool virtual_arena_ensure_committed(Virtual_Arena *arena, u64 used) {
+	if (used <= arena->committed) return true;
+	if (used > arena->reserved) return false;
+	
+	u64 new_committed = align_next(used, VIRTUAL_ARENA_COMMIT_GRANULARITY);
+	new_committed = min(new_committed, arena->reserved);
+	
+	if (!os_commit_virtual_memory(arena->base+arena->committed, new_committed-arena->committed)) {
+		return false;
+	}
+	arena->committed = new_committed;
+	return true;
+}
+
+void *virtual_arena_push(Virtual_Arena *arena, u64 size) {
+	u64 start = align_next(arena->used, 16);
+	u64 new_used = start + size;
+	
+	bool ok = virtual_arena_ensure_committed(arena, new_used);
+	assert(ok, "Virtual arena ran out of its %llu bytes of reserved memory (or the OS refused to commit more)", arena->reserved);
+	
+	arena->used = new_used;
+	arena->peak_used = max(arena->peak_used, new_used);
+	arena->last_allocation = arena->base+start;
+	
+	return arena->last_allocation;
+}
+
+// Grows the last allocation to size. Returns false if p isn't the last allocation or
+// the reservation can't fit it.
+bool virtual_arena_grow_last(Virtual_Arena *arena, void *p, u64 size) {
+	if (!p || p != arena->last_allocation) return false;
+	
+	u64 new_used = ((u8*)p - arena->base) + size;
+	if (new_used <= arena->used) return true;
+	if (!virtual_arena_ensure_committed(arena, new_used)) return false;
+	
+	arena->used = new_used;
+	arena->peak_used = max(arena->peak_used, new_used);
+	return true;
+}
+
+// Rewinds the arena. Committed pages are kept.
+void virtual_arena_reset(Virtual_Arena *arena) {
+	arena->used = virtual_arena_header_size();
+	arena->last_allocation = 0;
+}
+
+void* virtual_arena_allocator_proc(u64 size, void *p, Allocator_Message message, void* data) {
+	Virtual_Arena *arena = (Virtual_Arena*)data;
+	switch (message) {
+		case ALLOCATOR_ALLOCATE: {
+			return virtual_arena_push(arena, size);
+		}
+		case ALLOCATOR_DEALLOCATE: {
+			// Only the last allocation can be given back
+			if (p && p == arena->last_allocation) {
+				arena->used = (u64)((u8*)p - arena->base);
+				arena->last_allocation = 0;
+				
+				if (arena->release_when_empty && arena->used <= virtual_arena_header_size()) {
+					destroy_virtual_arena(arena);
+				}
+			}
+			return 0;
+		}
+		case ALLOCATOR_REALLOCATE: {
+			if (!p) return virtual_arena_push(arena, size);
+			if (virtual_arena_grow_last(arena, p, size)) return p;
+			
+			u64 old_size = (u64)((arena->base+arena->used) - (u8*)p);
+			void *new = virtual_arena_push(arena, size);
+			memcpy(new, p, min(size, old_size));
+			return new;
+		}
+		case ALLOCATOR_REALLOCATE_IN_PLACE: {
+			if (virtual_arena_grow_last(arena, p, size)) return p;
+			return 0;
+		}
+	}
+	return 0;
+}
+
+Allocator get_virtual_arena_allocator(Virtual_Arena *arena) {
+	Allocator a;
+	a.proc = virtual_arena_allocator_proc;
+	a.data = arena;
+	return a;
+}
+// Makes an arena that owns itself: it's released once everything in it is deallocated.
+// Handy when one allocation should have a whole reservation to grow into
+// (see growing_array_init_virtual).
+Allocator make_virtual_arena_allocator(u64 size_to_reserve) {
+	Virtual_Arena *arena = make_virtual_arena(size_to_reserve);
+	arena->release_when_empty = true;
+	return get_virtual_arena_allocator(arena);
+}
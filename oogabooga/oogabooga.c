@@ -110,6 +110,16 @@
 			
 				#define RUN_TESTS 1
 				
+		- RUN_BENCHMARKS
+			Run ooga booga benchmarks (after the tests if both are enabled). These take a while.
+		
+			0: Disable
+			1: Enable
+			
+			Example:
+			
+				#define RUN_BENCHMARKS 1
+				
 		- ENABLE_PROFILING
 			Enable time profiling which will be dumped to google_trace.json.
 		
@@ -465,6 +475,10 @@ int main(int argc, char **argv) {
 		oogabooga_run_tests();
 	#endif
 	
+	#if RUN_BENCHMARKS
+		oogabooga_run_benchmarks();
+	#endif
+	
 	int code = ENTRY_PROC(argc, argv);
 	
 #if ENABLE_PROFILING
@@ -473,6 +487,11 @@ int main(int argc, char **argv) {
 	
 #endif
 	
+	parallel_radix_sort_deinit();
+	
+	// Threads from os_thread_start do this when they exit, the main thread never goes through that
+	heap_release_thread_cache();
+	
 	// This is so any threads waiting for window to close will close on exit
 	window.should_close = true;
 	
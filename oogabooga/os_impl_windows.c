@@ -21,6 +21,7 @@
 #define VIRTUAL_MEMORY_BASE ((void*)0x0000690000000000ULL)
 void* heap_alloc(u64);
 void heap_dealloc(void*);
+void heap_release_thread_cache();
 
 u16 *win32_fixed_utf8_to_null_terminated_wide(string utf8, Allocator allocator) {
 
@@ -659,8 +660,13 @@ DWORD WINAPI win32_thread_invoker(LPVOID param) {
 	
 #if CONFIGURATION == RELEASE
 	// #Configurable #Copypaste
-	SetPriorityClass(GetCurrentProcess(), REALTIME_PRIORITY_CLASS);
-	SetThreadPriority(t->os_handle, THREAD_PRIORITY_TIME_CRITICAL);
+	if (t->normal_priority) {
+		// Still relative to the process priority class, which other threads may have raised
+		SetThreadPriority(t->os_handle, THREAD_PRIORITY_NORMAL);
+	} else {
+		SetPriorityClass(GetCurrentProcess(), REALTIME_PRIORITY_CLASS);
+		SetThreadPriority(t->os_handle, THREAD_PRIORITY_TIME_CRITICAL);
+	}
 	timeBeginPeriod(1);
 #endif
 	
@@ -671,7 +677,8 @@ DWORD WINAPI win32_thread_invoker(LPVOID param) {
 	
 	t->proc(t);
 	
-	heap_dealloc(temporary_storage);
+	temporary_storage_deinit();
+	heap_release_thread_cache();
 	
 	return 0;
 }
@@ -1508,6 +1515,27 @@ os_lock_program_memory_pages(void *start, u64 size) {
 #endif
 }
 
+void*
+os_reserve_virtual_memory(u64 size) {
+	size = align_next(size, os.granularity);
+	void *p = VirtualAlloc(0, size, MEM_RESERVE, PAGE_NOACCESS);
+	if (!p) log_error("Failed reserving %llu bytes of virtual memory, error %d", size, GetLastError());
+	return p;
+}
+
+bool
+os_commit_virtual_memory(void *start, u64 size) {
+	assert((u64)start % os.page_size == 0, "When committing memory pages, the start address must be the start of a page");
+	assert(size       % os.page_size == 0, "When committing memory pages, the size must be aligned to page_size");
+	return VirtualAlloc(start, size, MEM_COMMIT, PAGE_READWRITE) != 0;
+}
+
+void
+os_release_virtual_memory(void *start) {
+	BOOL ok = VirtualFree(start, 0, MEM_RELEASE);
+	assert(ok, "VirtualFree Failed with error %d", GetLastError());
+}
+
 ///
 ///
 // Mouse pointer
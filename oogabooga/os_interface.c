@@ -132,6 +132,7 @@ typedef struct Thread {
 	Context initial_context;
 	void* data;
 	u64 temporary_storage_size; // Defaults to KB(10)
+	bool normal_priority; // In RELEASE threads run at time critical priority, unless this is set before os_thread_start
 	Thread_Proc proc;
 	Thread_Handle os_handle;
 	
@@ -491,6 +492,15 @@ os_unlock_program_memory_pages(void *start, u64 size);
 void ogb_instance
 os_lock_program_memory_pages(void *start, u64 size);
 
+// Raw address space outside of program memory.
+// Reserved memory is not usable until it's committed; start & size passed to commit must be page aligned.
+ogb_instance void*
+os_reserve_virtual_memory(u64 size);
+bool ogb_instance
+os_commit_virtual_memory(void *start, u64 size);
+void ogb_instance
+os_release_virtual_memory(void *start);
+
 ///
 ///
 // Mouse pointer
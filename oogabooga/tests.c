@@ -14,17 +14,18 @@ void log_heap() {
 		
 		print("\tBLOCK @ 0x%I64x, %llu bytes\n", (u64)block, block->size);
 		
-		Heap_Free_Node *node = block->free_head;
+		Heap_Allocation_Metadata *chunk = (Heap_Allocation_Metadata*)block->start;
 
 		u64 total_free = 0;
 		
-		while (node != 0) {
+		while (chunk != 0) {
 		
-			print("\t\tFREE NODE @ 0x%I64x, %llu bytes\n", (u64)node, node->size);
-			
-			total_free += node->size;
+			if (heap_chunk_is_free(chunk)) {
+				print("\t\tFREE NODE @ 0x%I64x, %llu bytes\n", (u64)chunk, heap_chunk_size(chunk));
+				total_free += heap_chunk_size(chunk);
+			}
 		
-			node = node->next;
+			chunk = heap_chunk_next(chunk);
 		}
 		
 		print("\t TOTAL FREE: %llu\n\n", total_free);
@@ -197,6 +198,169 @@ void test_allocator(bool do_log_heap) {
     if (do_log_heap) log_heap();
 }
 
+void test_temporary_storage() {
+    reset_temporary_storage();
+    
+    u64 first_block_size = temporary_storage->size;
+    u64 chunk_size = KB(64);
+    u64 chunk_count = (first_block_size*3)/chunk_size;
+    
+    // Overflowing the first block should chain more blocks instead of wrapping around
+    u8 **chunks = alloc(get_heap_allocator(), chunk_count*sizeof(u8*));
+    for (u64 i = 0; i < chunk_count; i++) {
+        chunks[i] = talloc(chunk_size);
+        memset(chunks[i], (int)(i & 0xFF), chunk_size);
+    }
+    for (u64 i = 0; i < chunk_count; i++) {
+        assert(chunks[i][0] == (u8)i && chunks[i][chunk_size-1] == (u8)i, "Temporary storage was overwritten after growing");
+    }
+    
+    Temporary_Storage_Stats stats = get_temporary_storage_stats();
+    assert(stats.block_count > 1, "Temporary storage should have grown");
+    assert(stats.allocation_count == chunk_count, "Expected %llu temporary allocations, got %llu", chunk_count, stats.allocation_count);
+    assert(stats.high_water >= chunk_count*chunk_size, "Temporary storage high-water mark is too low");
+    
+    // Marks
+    Temporary_Storage_Mark mark = push_temporary_storage_mark();
+    void *a = talloc(100);
+    talloc(chunk_size);
+    pop_temporary_storage_mark(mark);
+    void *b = talloc(100);
+    assert(a == b, "Popping a temporary storage mark should give back the memory allocated after it");
+    
+    reset_temporary_storage();
+    stats = get_temporary_storage_stats();
+    assert(stats.last_frame_high_water >= chunk_count*chunk_size, "Last frame high-water mark was not recorded");
+    assert(stats.peak_high_water >= stats.last_frame_high_water, "Peak high-water mark is wrong");
+    assert(stats.allocation_count == 0 && stats.high_water == 0, "Temporary storage stats were not reset");
+    
+    // The grown blocks are reused until enough quiet frames go by
+    void *first = talloc(16);
+    for (u64 i = 0; i < TEMPORARY_STORAGE_SHRINK_FRAMES; i++) {
+        assert(get_temporary_storage_stats().block_count > 1, "Temporary storage shrunk too early");
+        reset_temporary_storage();
+        void *p = talloc(16);
+        assert(p == first, "Temporary storage should start at the first block after reset");
+    }
+    reset_temporary_storage();
+    stats = get_temporary_storage_stats();
+    assert(stats.block_count == 1, "Temporary storage should have shrunk after %d quiet frames", TEMPORARY_STORAGE_SHRINK_FRAMES);
+    assert(stats.capacity == first_block_size, "Temporary storage capacity should be back to the first block");
+    
+    dealloc(get_heap_allocator(), chunks);
+}
+
+// Replays a trace shaped like a game frame: lots of short lived small allocations,
+// growing arrays that reallocate to double size, medium allocations that live for a
+// while and a few large long lived ones.
+typedef struct Heap_Trace_Op {
+	u32 slot;
+	u32 size; // 0 means free the slot
+} Heap_Trace_Op;
+void benchmark_heap_trace() {
+	Allocator heap = get_heap_allocator();
+	
+	const u32 frame_count = 2000;
+	const u32 frame_slot_count = 64;
+	const u32 growing_array_count = 8;
+	const u32 medium_slot_count = 1024;
+	const u32 large_slot_count = 16;
+	
+	const u32 frame_slots_start   = 0;
+	const u32 growing_slots_start = frame_slots_start + frame_slot_count;
+	const u32 medium_slots_start  = growing_slots_start + growing_array_count*2;
+	const u32 large_slots_start   = medium_slots_start + medium_slot_count;
+	const u32 slot_count          = large_slots_start + large_slot_count;
+	
+	u64 max_op_count = (u64)frame_count*(frame_slot_count*2 + growing_array_count*2 + 16 + 2) + slot_count;
+	Heap_Trace_Op *ops = alloc(heap, max_op_count*sizeof(Heap_Trace_Op));
+	u32 *sizes = alloc(heap, slot_count*sizeof(u32));
+	memset(sizes, 0, slot_count*sizeof(u32));
+	u64 op_count = 0;
+	
+	#define TRACE_ALLOC(s, n) { ops[op_count++] = (Heap_Trace_Op){ (s), (n) }; sizes[s] = (n); }
+	#define TRACE_FREE(s)     { ops[op_count++] = (Heap_Trace_Op){ (s), 0 };   sizes[s] = 0;   }
+	
+	seed_for_random = 1337;
+	for (u32 f = 0; f < frame_count; f++) {
+		// Short lived small allocations, mostly tiny
+		for (u32 i = 0; i < frame_slot_count; i++) {
+			u32 size = (get_random() % 4 == 0) ? (u32)get_random_int_in_range(64, 1024) : (u32)get_random_int_in_range(8, 96);
+			TRACE_ALLOC(frame_slots_start + i, size);
+		}
+		
+		// Growing arrays, allocate the bigger one before freeing the old one like realloc
+		for (u32 i = 0; i < growing_array_count; i++) {
+			u32 a = growing_slots_start + i*2;
+			u32 b = a + 1;
+			u32 old_slot = sizes[a] ? a : b;
+			u32 new_slot = old_slot == a ? b : a;
+			u32 old_size = sizes[old_slot];
+			if (old_size == 0) {
+				TRACE_ALLOC(new_slot, 64);
+			} else if (get_random() % 4 == 0) {
+				u32 new_size = old_size >= KB(64) ? 64 : old_size*2;
+				TRACE_ALLOC(new_slot, new_size);
+				TRACE_FREE(old_slot);
+			}
+		}
+		
+		// Medium allocations living for a while
+		for (u32 i = 0; i < 16; i++) {
+			u32 slot = medium_slots_start + (u32)(get_random() % medium_slot_count);
+			if (sizes[slot]) TRACE_FREE(slot)
+			else             TRACE_ALLOC(slot, (u32)get_random_int_in_range(KB(1), KB(16)));
+		}
+		
+		// Rarely some big long lived buffer
+		if (get_random() % 50 == 0) {
+			u32 slot = large_slots_start + (u32)(get_random() % large_slot_count);
+			if (sizes[slot]) TRACE_FREE(slot)
+			else             TRACE_ALLOC(slot, (u32)get_random_int_in_range(KB(256), MB(1)));
+		}
+		
+		for (u32 i = 0; i < frame_slot_count; i++) {
+			TRACE_FREE(frame_slots_start + i);
+		}
+	}
+	for (u32 slot = 0; slot < slot_count; slot++) {
+		if (sizes[slot]) TRACE_FREE(slot);
+	}
+	
+	#undef TRACE_ALLOC
+	#undef TRACE_FREE
+	
+	assert(op_count <= max_op_count, "Heap trace overflowed");
+	
+	u32 **pointers = alloc(heap, slot_count*sizeof(u32*));
+	memset(pointers, 0, slot_count*sizeof(u32*));
+	
+	u64 alloc_count = 0;
+	u64 start_cycles = rdtsc();
+	float64 start_seconds = os_get_elapsed_seconds();
+	for (u64 i = 0; i < op_count; i++) {
+		Heap_Trace_Op op = ops[i];
+		if (op.size) {
+			pointers[op.slot] = alloc(heap, op.size);
+			*pointers[op.slot] = op.slot;
+			alloc_count += 1;
+		} else {
+			assert(*pointers[op.slot] == op.slot, "Heap trace memory was corrupted");
+			dealloc(heap, pointers[op.slot]);
+			pointers[op.slot] = 0;
+		}
+	}
+	float64 end_seconds = os_get_elapsed_seconds();
+	u64 end_cycles = rdtsc();
+	
+	print("Heap trace: %llu allocations and %llu deallocations in %.2f ms, %llu cycles per operation\n",
+		alloc_count, op_count-alloc_count, (end_seconds-start_seconds)*1000.0, (end_cycles-start_cycles)/op_count);
+	
+	dealloc(heap, pointers);
+	dealloc(heap, sizes);
+	dealloc(heap, ops);
+}
+
 void test_thread_proc1(Thread* t) {
 	os_sleep(5);
 	print("Hello from thread %llu\n", t->id);
@@ -225,37 +389,125 @@ void test_threads() {
 	os_unlock_mutex(m);
 }
 
+// Shared between test_allocator_threaded threads. Each thread hands a batch of its allocations
+// to the next thread which frees them, so frees also happen on other threads.
+#define ALLOCATOR_HANDOFF_COUNT 64
+typedef struct Allocator_Contention_Thread {
+	u64 index;
+	u64 thread_count;
+	u64 iterations;
+	struct Allocator_Contention_Thread *threads;
+	
+	void *handoff[ALLOCATOR_HANDOFF_COUNT];
+	volatile bool handoff_full;
+	
+	u64 op_count;
+} Allocator_Contention_Thread;
+
 void test_allocator_threaded(Thread *t) {
 
+	Allocator_Contention_Thread *data = (Allocator_Contention_Thread*)t->data;
+	Allocator_Contention_Thread *next = &data->threads[(data->index+1) % data->thread_count];
+	
 	Allocator heap = get_heap_allocator();
+	
+	seed_for_random = data->index*1337 + 69;
+	
+	u64 op_count = 0;
 
-    for (int i = 0; i < 1000; ++i) {
-        void* temp = alloc(heap, 128);
-        assert(temp != NULL && "Repeated allocation failed");
-        dealloc(heap, temp);
-    }
-
-    void* mixed_blocks[40];
-    for (int i = 0; i < 40; ++i) {
-        if (i % 2 == 0) {
-            mixed_blocks[i] = alloc(heap, 128);
-        } else {
-            mixed_blocks[i] = alloc(heap, 1024 * 1024); // 1MB blocks
-        }
-        assert(mixed_blocks[i] != NULL && "Mixed size allocation failed");
-    }
-
-    for (int i = 0; i < 40; ++i) {
-        if (i % 2 == 0) {
-            dealloc(heap, mixed_blocks[i]);
-        }
-    }
+	for (u64 iteration = 0; iteration < data->iterations; iteration++) {
+	
+		// Same thread churn of small allocations
+		void *blocks[64];
+		for (int i = 0; i < 64; ++i) {
+			u64 size = (u64)get_random_int_in_range(8, 512);
+			blocks[i] = alloc(heap, size);
+			assert(blocks[i] != NULL, "Repeated allocation failed");
+			*(u64*)blocks[i] = size;
+		}
+		for (int i = 63; i >= 0; --i) {
+			assert(*(u64*)blocks[i] <= 512, "Memory corrupted");
+			dealloc(heap, blocks[i]);
+		}
+		op_count += 128;
+		
+		// Free what the previous thread handed to us
+		if (data->handoff_full) {
+			MEMORY_BARRIER;
+			for (int i = 0; i < ALLOCATOR_HANDOFF_COUNT; ++i) {
+				assert(*(u64*)data->handoff[i] == data->index, "Memory corrupted in cross thread free");
+				dealloc(heap, data->handoff[i]);
+			}
+			MEMORY_BARRIER;
+			data->handoff_full = false;
+			op_count += ALLOCATOR_HANDOFF_COUNT;
+		}
+		
+		// Hand some allocations to the next thread
+		if (!next->handoff_full) {
+			for (int i = 0; i < ALLOCATOR_HANDOFF_COUNT; ++i) {
+				next->handoff[i] = alloc(heap, 16 + (i % 8)*32);
+				*(u64*)next->handoff[i] = next->index;
+			}
+			MEMORY_BARRIER;
+			next->handoff_full = true;
+			op_count += ALLOCATOR_HANDOFF_COUNT;
+		}
+		
+		// Occasionally something big that goes past the thread caches
+		if (iteration % 16 == 0) {
+			void *big = alloc(heap, 1024 * 64);
+			assert(big != NULL, "Big allocation failed");
+			dealloc(heap, big);
+			op_count += 2;
+		}
+	}
+	
+	data->op_count = op_count;
+}
 
-    for (int i = 0; i < 40; ++i) {
-        if (i % 2 != 0) {
-            dealloc(heap, mixed_blocks[i]);
-        }
-    }
+void benchmark_allocator_threaded() {
+	Allocator heap = get_heap_allocator();
+	
+	u64 max_threads = max(os_get_number_of_logical_processors(), 1);
+	const u64 iterations = 2000;
+	
+	for (u64 thread_count = 1; thread_count <= max_threads; thread_count = thread_count < max_threads ? min(thread_count*2, max_threads) : thread_count+1) {
+		Allocator_Contention_Thread *datas = alloc(heap, thread_count*sizeof(Allocator_Contention_Thread));
+		memset(datas, 0, thread_count*sizeof(Allocator_Contention_Thread));
+		Thread *threads = alloc(heap, thread_count*sizeof(Thread));
+		
+		for (u64 i = 0; i < thread_count; i++) {
+			datas[i].index = i;
+			datas[i].thread_count = thread_count;
+			datas[i].iterations = iterations;
+			datas[i].threads = datas;
+			os_thread_init(&threads[i], test_allocator_threaded);
+			threads[i].data = &datas[i];
+		}
+		
+		float64 start_seconds = os_get_elapsed_seconds();
+		for (u64 i = 0; i < thread_count; i++) os_thread_start(&threads[i]);
+		for (u64 i = 0; i < thread_count; i++) os_thread_join(&threads[i]);
+		float64 seconds = os_get_elapsed_seconds() - start_seconds;
+		
+		u64 op_count = 0;
+		for (u64 i = 0; i < thread_count; i++) {
+			op_count += datas[i].op_count;
+			os_thread_destroy(&threads[i]);
+			
+			// Whatever was handed off last but never picked up
+			if (datas[i].handoff_full) {
+				for (int j = 0; j < ALLOCATOR_HANDOFF_COUNT; ++j) dealloc(heap, datas[i].handoff[j]);
+			}
+		}
+		
+		f64 ops_per_second = (f64)op_count / seconds;
+		print("%llu threads: %.2f million heap ops/sec, %.2f million per thread\n", thread_count, ops_per_second/1000000.0, ops_per_second/1000000.0/(f64)thread_count);
+		
+		dealloc(heap, threads);
+		dealloc(heap, datas);
+	}
 }
 
 void test_strings() {
@@ -1338,10 +1590,186 @@ void test_hash_table() {
     found_value = hash_table_find(&table, key1);
     assert(found_value == NULL, "Failed: Hash table should be empty after reset");
 
+    // Keys are compared by their characters, not by pointer
+    string key1_copy = string_copy(key1, get_heap_allocator());
+    hash_table_set(&table, key1, value1);
+    found_value = hash_table_find(&table, key1_copy);
+    assert(found_value != NULL && *found_value == 69, "Failed: Key should be found with a copy of the key string");
+    dealloc_string(get_heap_allocator(), key1_copy);
+
     hash_table_destroy(&table);
     assert(table.entries == NULL, "Failed: Hash table entries should be NULL after destroy");
     assert(table.count == 0, "Failed: Hash table count should be 0 after destroy");
     assert(table.capacity_count == 0, "Failed: Hash table capacity count should be 0 after destroy");
+    
+    // Colliding hashes, keys need to be told apart by comparing them
+    Hash_Table collisions = make_hash_table(u64, u64, get_heap_allocator());
+    for (u64 i = 0; i < 100; i++) {
+        u64 value = i*10;
+        hash_table_add_raw(&collisions, 1234, &i, &value, sizeof(u64), sizeof(u64));
+    }
+    for (u64 i = 0; i < 100; i++) {
+        u64 *found = hash_table_find_raw(&collisions, 1234, &i, sizeof(u64));
+        assert(found != NULL && *found == i*10, "Failed: Colliding key %llu not found", i);
+    }
+    for (u64 i = 0; i < 100; i += 2) {
+        bool removed = hash_table_remove_raw(&collisions, 1234, &i, sizeof(u64));
+        assert(removed, "Failed: Colliding key %llu should be removed", i);
+    }
+    assert(collisions.count == 50, "Failed: Expected 50 colliding entries left, got %llu", collisions.count);
+    for (u64 i = 0; i < 100; i++) {
+        u64 *found = hash_table_find_raw(&collisions, 1234, &i, sizeof(u64));
+        bool should_exist = i % 2 != 0;
+        assert((found != NULL) == should_exist, "Failed: Colliding key %llu found after removal or lost", i);
+        assert(!found || *found == i*10, "Failed: Colliding key %llu has wrong value after removals", i);
+    }
+    hash_table_destroy(&collisions);
+    
+    // Many keys, growing and removing
+    const u64 key_count = 100000;
+    Hash_Table numbers = make_hash_table(u64, u64, get_heap_allocator());
+    for (u64 i = 0; i < key_count; i++) {
+        u64 value = i*3;
+        bool added = hash_table_set(&numbers, i, value);
+        assert(added, "Failed: Key %llu should be newly added", i);
+    }
+    assert(numbers.count == key_count, "Failed: Expected %llu entries, got %llu", key_count, numbers.count);
+    assert(numbers.count*4 <= numbers.slot_count*3, "Failed: Hash table index is over 3/4 full");
+    
+    u64 value_sum = 0;
+    for (u64 i = 0; i < numbers.count; i++) {
+        value_sum += *(u64*)hash_table_get_nth_value(&numbers, i);
+    }
+    assert(value_sum == 3*(key_count*(key_count-1))/2, "Failed: Sum of values from hash_table_get_nth_value is wrong");
+    
+    for (u64 i = 0; i < key_count; i += 3) {
+        bool removed = hash_table_remove(&numbers, i);
+        assert(removed, "Failed: Key %llu should be removed", i);
+        removed = hash_table_remove(&numbers, i);
+        assert(!removed, "Failed: Key %llu should not be removed twice", i);
+    }
+    for (u64 i = 0; i < key_count; i++) {
+        u64 *found = hash_table_find(&numbers, i);
+        bool should_exist = i % 3 != 0;
+        assert((found != NULL) == should_exist, "Failed: Key %llu found after removal or lost", i);
+        assert(!found || *found == i*3, "Failed: Key %llu has wrong value after removals", i);
+    }
+    
+    hash_table_reset(&numbers);
+    for (u64 i = 0; i < key_count; i++) {
+        assert(!hash_table_contains(&numbers, i), "Failed: Hash table should be empty after reset");
+    }
+    hash_table_destroy(&numbers);
+}
+
+// The hash table before open addressing, kept to compare against in benchmark_hash_table
+typedef struct Legacy_Hash_Table {
+    void *entries; // hash-value
+    u64 count;
+    u64 capacity_count;
+    u64 _entry_size;
+} Legacy_Hash_Table;
+
+void legacy_hash_table_add(Legacy_Hash_Table *t, u64 hash, void *v, u64 value_size) {
+    if (t->count >= t->capacity_count) {
+        u64 new_count = max(get_next_power_of_two(t->count+1), 128);
+        void *new_entries = alloc(get_heap_allocator(), new_count*t->_entry_size);
+        if (t->entries) {
+            memcpy(new_entries, t->entries, t->count*t->_entry_size);
+            dealloc(get_heap_allocator(), t->entries);
+        }
+        t->entries = new_entries;
+        t->capacity_count = new_count;
+    }
+    u8 *entry = (u8*)t->entries + t->count*t->_entry_size;
+    memcpy(entry, &hash, sizeof(u64));
+    memcpy(entry+sizeof(u64), v, value_size);
+    t->count += 1;
+}
+void *legacy_hash_table_find(Legacy_Hash_Table *t, u64 hash) {
+    for (u64 i = 0; i < t->count; i += 1) {
+        u64 existing_hash = *(u64*)((u8*)t->entries + i*t->_entry_size);
+        if (existing_hash == hash) {
+            return (u8*)t->entries + i*t->_entry_size + sizeof(u64);
+        }
+    }
+    return 0;
+}
+
+void benchmark_hash_table() {
+    const u64 entry_counts[] = { 10, 1000, 1000000 };
+    // The linear table is O(n) per lookup, so on big tables only a sample of the keys is looked up
+    const u64 max_legacy_lookups = 2000;
+    
+    for (u64 c = 0; c < sizeof(entry_counts)/sizeof(entry_counts[0]); c++) {
+        u64 entry_count = entry_counts[c];
+        u64 repeats = max(1, 1000000 / entry_count);
+        
+        u64 *keys = alloc(get_heap_allocator(), entry_count*sizeof(u64));
+        for (u64 i = 0; i < entry_count; i++) keys[i] = get_random();
+        
+        Hash_Table table = make_hash_table(u64, u64, get_heap_allocator());
+        Legacy_Hash_Table legacy = ZERO(Legacy_Hash_Table);
+        legacy._entry_size = sizeof(u64)*2;
+        
+        u64 start_cycles = rdtsc();
+        for (u64 i = 0; i < entry_count; i++) hash_table_add(&table, keys[i], i);
+        u64 insert_cycles = rdtsc() - start_cycles;
+        
+        start_cycles = rdtsc();
+        for (u64 i = 0; i < entry_count; i++) legacy_hash_table_add(&legacy, get_hash(keys[i]), &i, sizeof(u64));
+        u64 legacy_insert_cycles = rdtsc() - start_cycles;
+        
+        u64 sum = 0;
+        u64 lookups = 0;
+        start_cycles = rdtsc();
+        for (u64 r = 0; r < repeats; r++) {
+            for (u64 i = 0; i < entry_count; i++) {
+                sum += *(u64*)hash_table_find(&table, keys[i]);
+                lookups += 1;
+            }
+        }
+        u64 find_cycles = rdtsc() - start_cycles;
+        
+        u64 legacy_sum = 0;
+        u64 legacy_lookups = 0;
+        u64 legacy_step = max(1, entry_count / max_legacy_lookups);
+        start_cycles = rdtsc();
+        for (u64 r = 0; r < repeats; r++) {
+            for (u64 i = 0; i < entry_count; i += legacy_step) {
+                legacy_sum += *(u64*)legacy_hash_table_find(&legacy, get_hash(keys[i]));
+                legacy_lookups += 1;
+            }
+        }
+        u64 legacy_find_cycles = rdtsc() - start_cycles;
+        
+        // Misses need to walk the whole probe run
+        u64 misses = 0;
+        start_cycles = rdtsc();
+        for (u64 i = 0; i < entry_count; i++) {
+            u64 key = keys[i] ^ 0x5555555555555555ULL;
+            if (!hash_table_contains(&table, key)) misses += 1;
+        }
+        u64 miss_cycles = rdtsc() - start_cycles;
+        
+        start_cycles = rdtsc();
+        for (u64 i = 0; i < entry_count; i++) hash_table_remove(&table, keys[i]);
+        u64 remove_cycles = rdtsc() - start_cycles;
+        assert(table.count == 0, "Failed: Hash table should be empty after removing all keys");
+        
+        print("Hash table %llu entries:\n", entry_count);
+        print("    open addressing: insert %llu, find %llu, miss %llu, remove %llu cycles/op\n",
+            insert_cycles/entry_count, find_cycles/lookups, miss_cycles/max(misses, 1), remove_cycles/entry_count);
+        print("    linear (old):    insert %llu, find %llu cycles/op (%llu lookups)\n",
+            legacy_insert_cycles/entry_count, legacy_find_cycles/legacy_lookups, legacy_lookups);
+        
+        hash_table_destroy(&table);
+        dealloc(get_heap_allocator(), legacy.entries);
+        dealloc(get_heap_allocator(), keys);
+        
+        assert(sum == repeats*(entry_count*(entry_count-1)/2), "Failed: Hash table benchmark found wrong values");
+        assert(legacy_sum != 0, "Failed: Old hash table benchmark found wrong values");
+    }
 }
 
 #define NUM_BINS 100
@@ -1431,76 +1859,846 @@ void test_mutex() {
 
 #ifndef OOGABOOGA_HEADLESS
 int compare_draw_quads(const void *a, const void *b) {
-    return ((Draw_Quad*)a)->z-((Draw_Quad*)b)->z;
+    return ((Draw_Quad_Packed*)a)->z-((Draw_Quad_Packed*)b)->z;
 }
-void test_sort() {
-    
-    int num_samples = 500;
-    u64 id_bits = 21;
-    u64 item_count = 50000;
+
+// radix_sort before it sorted key/index pairs, kept to compare against in benchmark_sort
+void legacy_radix_sort(void *collection, void *help_buffer, u64 item_count, u64 item_size, u64 sort_value_offset_in_item, u64 number_of_bits) {
+    const int RADIX = 256;
+    const int BITS_PER_PASS = 8;
+    const int PASS_COUNT = ((number_of_bits + BITS_PER_PASS - 1) / BITS_PER_PASS);
+    const u64 HALF_RANGE_OF_VALUE_BITS = 1ULL << (number_of_bits - 1);
+
+    u64 count[256];
+    u64 prefix_sum[256];
+
+    for (u32 pass = 0; pass < PASS_COUNT; ++pass) {
+        u32 shift = pass * BITS_PER_PASS;
+        memset(count, 0, sizeof(count));
+        for (u64 i = 0; i < item_count; ++i) {
+            u8 *item = (u8*)collection + i * item_size;
+            u64 sort_value = *(u32*)(item + sort_value_offset_in_item) + HALF_RANGE_OF_VALUE_BITS;
+            ++count[(sort_value >> shift) & (RADIX-1)];
+        }
+        prefix_sum[0] = 0;
+        for (u32 i = 1; i < RADIX; ++i) prefix_sum[i] = prefix_sum[i - 1] + count[i - 1];
+        for (u64 i = 0; i < item_count; ++i) {
+            u8 *item = (u8*)collection + i * item_size;
+            u64 sort_value = *(u32*)(item + sort_value_offset_in_item) + HALF_RANGE_OF_VALUE_BITS;
+            u32 digit = (sort_value >> shift) & (RADIX-1);
+            memcpy((u8*)help_buffer + prefix_sum[digit] * item_size, item, item_size);
+            ++prefix_sum[digit];
+        }
+        memcpy(collection, help_buffer, item_count * item_size);
+    }
+}
+
+void test_draw_frame_sort_quads() {
+    Draw_Frame frame;
+    draw_frame_init(&frame);
+    
+    const u64 quad_count = 3000;
+    u64 *pairs = alloc(get_heap_allocator(), quad_count*sizeof(u64)*2);
+    
+    for (int image_variants = 5; image_variants <= 300; image_variants += 295) {
+        draw_frame_clear_quads(&frame);
+        Draw_Quad_Packed *quads = growing_array_add_multiple_empty((void**)&frame.quad_buffer, quad_count);
+        for (u64 i = 0; i < quad_count; i++) {
+            quads[i] = ZERO(Draw_Quad_Packed);
+            quads[i].z = (s32)(i % 3) - 1;
+            // Never dereferenced
+            u64 image = get_random_int_in_range(0, image_variants-1);
+            quads[i].image = (Gfx_Image*)(image*16);
+        }
+        
+        frame.enable_z_sorting_image_batching = true;
+        u64 *sorted = draw_frame_sort_quads(&frame, pairs, pairs + quad_count);
+        
+        // Rank of each image by first appearance, like the sort keys them
+        bool batched = image_variants < 255;
+        u64 ranks[300] = {0};
+        u64 next_rank = 1;
+        for (u64 i = 0; i < quad_count; i++) {
+            u64 image = (u64)quads[i].image/16;
+            if (image != 0 && ranks[image] == 0) ranks[image] = next_rank++;
+        }
+        
+        for (u64 i = 1; i < quad_count; i++) {
+            Draw_Quad_Packed *a = &quads[sorted[i-1] & 0xFFFFFFFF];
+            Draw_Quad_Packed *b = &quads[sorted[i] & 0xFFFFFFFF];
+            assert(a->z <= b->z, "Failed: quads not sorted by z");
+            if (a->z != b->z) continue;
+            u64 rank_a = batched ? ranks[(u64)a->image/16] : 0;
+            u64 rank_b = batched ? ranks[(u64)b->image/16] : 0;
+            assert(rank_a <= rank_b, "Failed: quads on the same z not grouped by image");
+            if (rank_a == rank_b) {
+                assert((sorted[i-1] & 0xFFFFFFFF) < (sorted[i] & 0xFFFFFFFF), "Failed: quad sort is not stable");
+            }
+        }
+    }
     
-    f64 seconds = 0;
-    u64 cycles = 0;
+    dealloc(get_heap_allocator(), pairs);
+    draw_frame_deinit(&frame);
+}
+
+void test_audio_kernels() {
+    Audio_Kernels scalar = {0};
+    audio_use_scalar_kernels(&scalar);
+    Audio_Kernels *kernels = audio_get_kernels();
+    
+    const u64 max_count = 1037; // Not a multiple of any register width, so the tails get tested
+    s16 *a16 = alloc(get_heap_allocator(), max_count*2*sizeof(s16));
+    s16 *b16 = alloc(get_heap_allocator(), max_count*2*sizeof(s16));
+    s16 *expected16 = alloc(get_heap_allocator(), max_count*2*sizeof(s16));
+    s16 *result16   = alloc(get_heap_allocator(), max_count*2*sizeof(s16));
+    f32 *af = alloc(get_heap_allocator(), max_count*2*sizeof(f32));
+    f32 *bf = alloc(get_heap_allocator(), max_count*2*sizeof(f32));
+    f32 *expectedf = alloc(get_heap_allocator(), max_count*2*sizeof(f32));
+    f32 *resultf   = alloc(get_heap_allocator(), max_count*2*sizeof(f32));
+    
+    for (int run = 0; run < 20; run++) {
+        u64 count = get_random_int_in_range(0, max_count);
+        for (u64 i = 0; i < max_count; i++) {
+            a16[i] = (s16)get_random_int_in_range(S16_MIN, S16_MAX);
+            b16[i] = (s16)get_random_int_in_range(S16_MIN, S16_MAX);
+            af[i] = get_random_float32_in_range(-1.5, 1.5);
+            bf[i] = get_random_float32_in_range(-1.0, 1.0);
+        }
+        f32 gain = get_random_float32_in_range(0, 3);
+        
+        memcpy(expected16, a16, count*sizeof(s16)); memcpy(result16, a16, count*sizeof(s16));
+        scalar.mix_s16(expected16, b16, count); kernels->mix_s16(result16, b16, count);
+        assert(bytes_match(expected16, result16, count*sizeof(s16)), "Failed: %cs mix_s16", kernels->name);
+        
+        memcpy(expectedf, af, count*sizeof(f32)); memcpy(resultf, af, count*sizeof(f32));
+        scalar.mix_f32(expectedf, bf, count); kernels->mix_f32(resultf, bf, count);
+        assert(bytes_match(expectedf, resultf, count*sizeof(f32)), "Failed: %cs mix_f32", kernels->name);
+        
+        memcpy(expected16, a16, count*sizeof(s16)); memcpy(result16, a16, count*sizeof(s16));
+        scalar.gain_s16(expected16, count, gain); kernels->gain_s16(result16, count, gain);
+        assert(bytes_match(expected16, result16, count*sizeof(s16)), "Failed: %cs gain_s16", kernels->name);
+        
+        memcpy(expectedf, af, count*sizeof(f32)); memcpy(resultf, af, count*sizeof(f32));
+        scalar.gain_f32(expectedf, count, gain); kernels->gain_f32(resultf, count, gain);
+        assert(bytes_match(expectedf, resultf, count*sizeof(f32)), "Failed: %cs gain_f32", kernels->name);
+        
+        scalar.s16_to_f32(expectedf, a16, count); kernels->s16_to_f32(resultf, a16, count);
+        assert(bytes_match(expectedf, resultf, count*sizeof(f32)), "Failed: %cs s16_to_f32", kernels->name);
+        
+        // af goes past 1.0 on purpose to test saturation
+        scalar.f32_to_s16(expected16, af, count); kernels->f32_to_s16(result16, af, count);
+        assert(bytes_match(expected16, result16, count*sizeof(s16)), "Failed: %cs f32_to_s16", kernels->name);
+        
+        scalar.mono_to_stereo_s16(expected16, a16, count); kernels->mono_to_stereo_s16(result16, a16, count);
+        assert(bytes_match(expected16, result16, count*2*sizeof(s16)), "Failed: %cs mono_to_stereo_s16", kernels->name);
+        
+        scalar.mono_to_stereo_f32(expectedf, af, count); kernels->mono_to_stereo_f32(resultf, af, count);
+        assert(bytes_match(expectedf, resultf, count*2*sizeof(f32)), "Failed: %cs mono_to_stereo_f32", kernels->name);
+        
+        // What convert_frames does for mono s16 -> stereo f32: convert into the second half, then spread out
+        Audio_Format mono_s16   = { AUDIO_BITS_16, 1, 48000 };
+        Audio_Format stereo_f32 = { AUDIO_BITS_32, 2, 48000 };
+        convert_frames(resultf, stereo_f32, a16, mono_s16, count);
+        for (u64 i = 0; i < count; i++) {
+            f32 x = (f32)a16[i] * (1.0f / 32768.0f);
+            assert(resultf[i*2] == x && resultf[i*2+1] == x, "Failed: convert_frames mono s16 -> stereo f32");
+        }
+    }
     
-    Draw_Quad *items = alloc(get_heap_allocator(), (item_count * 2) * sizeof(Draw_Quad));
-    Draw_Quad *buffer = items + item_count;
+    dealloc(get_heap_allocator(), a16); dealloc(get_heap_allocator(), b16);
+    dealloc(get_heap_allocator(), expected16); dealloc(get_heap_allocator(), result16);
+    dealloc(get_heap_allocator(), af); dealloc(get_heap_allocator(), bf);
+    dealloc(get_heap_allocator(), expectedf); dealloc(get_heap_allocator(), resultf);
+}
 
-    for (int a = 0; a < num_samples; a++) {
+// What the mixer does per voice and callback for a mono s16 clip into a stereo output:
+// convert_frames, apply_audio_volume, mix_frames. Doesn't touch the audio device.
+void benchmark_audio_mixing() {
+    const u64 frames_per_callback = 480; // 10ms at 48khz
+    const u64 voice_count = 64;
+    const u64 callback_count = 200;
+    
+    Audio_Format source_format = { AUDIO_BITS_16, 1, 48000 };
+    Audio_Format output_formats[] = {
+        { AUDIO_BITS_32, 2, 48000 },
+        { AUDIO_BITS_16, 2, 48000 },
+    };
+    
+    s16 *source = alloc(get_heap_allocator(), frames_per_callback*voice_count*sizeof(s16));
+    for (u64 i = 0; i < frames_per_callback*voice_count; i++) {
+        source[i] = (s16)get_random_int_in_range(-8000, 8000);
+    }
+    void *voice_buffer = alloc(get_heap_allocator(), frames_per_callback*2*sizeof(f32));
+    void *output = alloc(get_heap_allocator(), frames_per_callback*2*sizeof(f32));
+    
+    Audio_Kernels selected = *audio_get_kernels();
+    Cpu_Capabilities cpu = query_cpu_capabilities();
+    Audio_Kernels candidates[3] = {0};
+    audio_use_scalar_kernels(&candidates[0]);
+    audio_select_kernels(&candidates[1], (Cpu_Capabilities){.sse2 = cpu.sse2});
+    audio_select_kernels(&candidates[2], cpu);
+    
+    for (u64 f = 0; f < sizeof(output_formats)/sizeof(output_formats[0]); f++) {
+        Audio_Format out_format = output_formats[f];
+        print("Mix %llu voices of %llu frames into %llu channel %cs:\n", voice_count, frames_per_callback, out_format.channels, out_format.bit_width == AUDIO_BITS_32 ? "f32" : "s16");
         
-        for (u64 i = 0; i < item_count; i++) {
-            if (i % 2 == 0) items[i].z = get_random_int_in_range(0, pow(2, id_bits) / 2);
-            else items[i].z = i;
+        float64 scalar_ms = 0;
+        for (u64 c = 0; c < 3; c++) {
+            if (c > 0 && strcmp(candidates[c].name, candidates[c-1].name) == 0) continue;
+            audio_kernels = candidates[c];
+            audio_kernels.initted = true;
+            
+            float64 start_seconds = os_get_elapsed_seconds();
+            for (u64 callback = 0; callback < callback_count; callback++) {
+                memset(output, 0, frames_per_callback*2*sizeof(f32));
+                for (u64 v = 0; v < voice_count; v++) {
+                    convert_frames(voice_buffer, out_format, source + v*frames_per_callback, source_format, frames_per_callback);
+                    apply_audio_volume(voice_buffer, out_format, frames_per_callback, 0.8);
+                    mix_frames(output, voice_buffer, frames_per_callback, out_format);
+                }
+            }
+            float64 ms = (os_get_elapsed_seconds() - start_seconds) * 1000.0;
+            if (c == 0) scalar_ms = ms;
+            
+            print("    %cs: %.1f voices/ms (%.2fx)\n", candidates[c].name, (float64)(voice_count*callback_count) / ms, scalar_ms / ms);
         }
+    }
     
-        u64 item_size = sizeof(Draw_Quad);
-        u64 sort_value_offset_in_item = offsetof(Draw_Quad, z);
+    audio_kernels = selected;
     
+    dealloc(get_heap_allocator(), source);
+    dealloc(get_heap_allocator(), voice_buffer);
+    dealloc(get_heap_allocator(), output);
+}
+
+// Memory source made by hand so the audio tests don't depend on any files. Sources can share
+// pcm, but each needs its own uid or :PhaseCancellation mutes the ones started together.
+Audio_Source make_test_audio_source(s16 *pcm, u64 frame_count) {
+    Audio_Source source = ZERO(Audio_Source);
+    source.kind = AUDIO_SOURCE_MEMORY;
+    source.format = (Audio_Format){ AUDIO_BITS_16, 1, 48000 };
+    source.number_of_frames = frame_count;
+    source.uid = next_audio_source_uid;
+    source.allocator = get_heap_allocator();
+    source.pcm_frames = pcm;
+    next_audio_source_uid += 1;
+    return source;
+}
+
+typedef struct Audio_Mixer_Benchmark_Job {
+    u64 callback_count;
+    u64 frames_per_callback;
+    Audio_Format format;
+    void *output;
+    float64 total_ms;
+    float64 worst_ms;
+    volatile bool done;
+} Audio_Mixer_Benchmark_Job;
+
+void audio_mixer_benchmark_proc(Thread *t) {
+    Audio_Mixer_Benchmark_Job *job = (Audio_Mixer_Benchmark_Job*)t->data;
+    for (u64 i = 0; i < job->callback_count; i++) {
         float64 start_seconds = os_get_elapsed_seconds();
-        u64 start_cycles = rdtsc();
-        radix_sort(items, buffer, item_count, item_size, sort_value_offset_in_item, id_bits);
-        u64 end_cycles = rdtsc();
-        float64 end_seconds = os_get_elapsed_seconds();
-    
-        for (u64 i = 1; i < item_count; i++) {
-            assert(items[i].z >= items[i-1].z, "Failed: not correctly sorted");
+        audio_mix_players(job->frames_per_callback, job->format, job->output);
+        float64 ms = (os_get_elapsed_seconds() - start_seconds) * 1000.0;
+        job->total_ms += ms;
+        job->worst_ms = max(job->worst_ms, ms);
+    }
+    MEMORY_BARRIER;
+    job->done = true;
+}
+
+// Runs the job's callbacks on another thread like the audio thread would, optionally with this
+// thread posting commands as fast as it can meanwhile.
+void run_audio_mixer_benchmark_job(Audio_Mixer_Benchmark_Job *job, Audio_Player **players, u64 player_count, bool post_commands, u64 *posted_count) {
+    Thread thread;
+    os_thread_init(&thread, audio_mixer_benchmark_proc);
+    thread.data = job;
+    os_thread_start(&thread);
+    
+    *posted_count = 0;
+    while (post_commands && !job->done) {
+        // Don't block on a full queue, the job might be done by the time there's room
+        if (audio_mixer.write_index - audio_mixer.read_index >= AUDIO_COMMAND_QUEUE_CAPACITY) {
+            os_yield_thread();
+            continue;
         }
+        Audio_Player *p = players[*posted_count % player_count];
+        if (*posted_count % 2) audio_player_set_volume(p, get_random_float32_in_range(0.5, 1.0));
+        else                   audio_player_set_progression_factor(p, get_random_float32_in_range(0.0, 1.0));
+        *posted_count += 1;
+    }
+    
+    os_thread_join(&thread);
+}
+
+// The whole mixer (audio_mix_players) with the audio device held off, once with nothing
+// posting commands and once with this thread flooding the command queue. Since the mixer only
+// drains the queue and never waits on the game thread, the worst callback shouldn't move much.
+void benchmark_audio_mixer() {
+    const u64 frames_per_callback = 480; // 10ms at 48khz
+    const u64 voice_count = 64;
+    const u64 callback_count = 500;
+    const u64 source_frame_count = 48000*2;
+    u32 max_voices = audio_mixer.max_voices;
+    
+    audio_mixer_hold();
+    audio_set_max_voices(0);
+    
+    s16 *pcm = alloc(get_heap_allocator(), source_frame_count*sizeof(s16));
+    for (u64 i = 0; i < source_frame_count; i++) {
+        pcm[i] = (s16)get_random_int_in_range(-8000, 8000);
+    }
+    Audio_Player *players[voice_count];
+    for (u64 v = 0; v < voice_count; v++) {
+        Audio_Source source = make_test_audio_source(pcm, source_frame_count);
         
-        seconds += end_seconds - start_seconds;
-        cycles += end_cycles - start_cycles;
+        players[v] = audio_player_get_one();
+        audio_player_set_source(players[v], source);
+        audio_player_set_looping(players[v], true);
+        audio_player_set_state(players[v], AUDIO_PLAYER_STATE_PLAYING);
+    }
+    
+    Audio_Mixer_Benchmark_Job job = {0};
+    job.frames_per_callback = frames_per_callback;
+    job.format = (Audio_Format){ AUDIO_BITS_32, 2, 48000 };
+    job.output = alloc(get_heap_allocator(), frames_per_callback*2*sizeof(f32));
+    
+    u64 posted_count = 0;
+    print("Mix %llu voices of %llu frames, %llu callbacks:\n", voice_count, frames_per_callback, callback_count);
+    for (int flood = 0; flood <= 1; flood++) {
+        job.callback_count = callback_count;
+        job.total_ms = 0;
+        job.worst_ms = 0;
+        job.done = false;
+        run_audio_mixer_benchmark_job(&job, players, voice_count, flood, &posted_count);
+        
+        print("    %cs: %.3fms avg, %.3fms worst per callback", flood ? "Flooding commands" : "No commands", job.total_ms / (float64)callback_count, job.worst_ms);
+        if (flood) print(", %llu commands (%.1f per callback)", posted_count, (float64)posted_count / (float64)callback_count);
+        print("\n");
+    }
+    
+    // Drain what's left of the flood, then let one more callback apply the releases so
+    // nothing samples pcm after it's freed
+    job.callback_count = 1;
+    job.done = false;
+    run_audio_mixer_benchmark_job(&job, players, voice_count, false, &posted_count);
+    for (u64 v = 0; v < voice_count; v++) audio_player_release(players[v]);
+    job.done = false;
+    run_audio_mixer_benchmark_job(&job, players, voice_count, false, &posted_count);
+    assert(audio_mixer.read_index == audio_mixer.write_index, "Failed: audio mixer didn't apply all commands");
+    for (u64 v = 0; v < voice_count; v++) {
+        assert(!players[v]->allocated, "Failed: released audio player is still allocated");
+    }
+    
+    audio_set_max_voices(max_voices);
+    audio_mixer_resume();
+    
+    dealloc(get_heap_allocator(), pcm);
+    dealloc(get_heap_allocator(), job.output);
+}
+
+// Players of source (any source if 0), only the ones counted against the voice budget if only_voices
+u64 count_test_audio_players(Audio_Source *source, bool only_voices) {
+    u64 count = 0;
+    for (Audio_Player_Block *block = &audio_player_block; block; block = block->next) {
+        for (u64 i = 0; i < AUDIO_PLAYERS_PER_BLOCK; i++) {
+            Audio_Player *p = &block->players[i];
+            if (!p->allocated || (only_voices && !audio_player_is_voice(p))) continue;
+            if (source && (!p->has_source || p->source.uid != source->uid)) continue;
+            count += 1;
+        }
+    }
+    return count;
+}
+
+void test_audio_voice_budget() {
+    const u64 source_frame_count = 48000*2;
+    u32 max_voices = audio_mixer.max_voices;
+    
+    audio_mixer_hold();
+    audio_set_max_voices(4);
+    
+    s16 *pcm = alloc(get_heap_allocator(), source_frame_count*sizeof(s16));
+    for (u64 i = 0; i < source_frame_count; i++) {
+        pcm[i] = (s16)get_random_int_in_range(-8000, 8000);
+    }
+    Audio_Mixer_Benchmark_Job job = {0};
+    job.callback_count = 1;
+    job.frames_per_callback = 480;
+    job.format = (Audio_Format){ AUDIO_BITS_32, 2, 48000 };
+    job.output = alloc(get_heap_allocator(), job.frames_per_callback*2*sizeof(f32));
+    u64 unused;
+    
+    Audio_Playback_Config config = {0};
+    config.volume = 1.0;
+    config.playback_speed = 1.0;
+    u64 stolen_before = audio_mixer.stolen_voice_count;
+    
+    // At most 2 at once, so the third steals the first. Started apart, or :PhaseCancellation
+    // would mute them.
+    Audio_Source capped = make_test_audio_source(pcm, source_frame_count);
+    for (int i = 0; i < 3; i++) {
+        play_one_audio_clip_source_with_limit(capped, config, 2);
+        run_audio_mixer_benchmark_job(&job, 0, 0, false, &unused);
+        os_sleep(70);
     }
+    assert(count_test_audio_players(&capped, true) == 2, "Failed: audio clip instance limit");
+    assert(audio_mixer.stolen_voice_count == stolen_before + 1, "Failed: audio clip instance limit should steal one voice");
+    
+    // 7 voices for a budget of 4: the quiet one goes first, then the lower priority ones
+    Audio_Source important[4];
+    config.priority = 1;
+    for (int i = 0; i < 4; i++) {
+        important[i] = make_test_audio_source(pcm, source_frame_count);
+        play_one_audio_clip_source_with_config(important[i], config);
+    }
+    Audio_Source quiet = make_test_audio_source(pcm, source_frame_count);
+    config.priority = 0;
+    config.volume = 0.1;
+    play_one_audio_clip_source_with_config(quiet, config);
+    
+    run_audio_mixer_benchmark_job(&job, 0, 0, false, &unused);
     
-    print("Radix sort took on average %llu cycles and %.2f ms\n", cycles / num_samples, (seconds * 1000.0) / (float64)num_samples);
+    assert(count_test_audio_players(0, true) == 4, "Failed: voice budget, %llu voices playing", count_test_audio_players(0, true));
+    for (int i = 0; i < 4; i++) {
+        assert(count_test_audio_players(&important[i], true) == 1, "Failed: voice budget stole a higher priority voice");
+    }
+    assert(audio_mixer.stolen_voice_count == stolen_before + 4, "Failed: voice budget should have stolen 3 voices");
+    
+    // The quiet one was never mixed so it's released right away, the others after fading out
+    assert(count_test_audio_players(&quiet, false) == 0, "Failed: stolen voice that was never mixed is still allocated");
+    run_audio_mixer_benchmark_job(&job, 0, 0, false, &unused);
+    assert(count_test_audio_players(&capped, false) == 0, "Failed: stolen voices are still allocated after fading out");
+    
+    audio_mixer_forget_source(capped.uid);
+    audio_mixer_forget_source(quiet.uid);
+    for (int i = 0; i < 4; i++) audio_mixer_forget_source(important[i].uid);
+    run_audio_mixer_benchmark_job(&job, 0, 0, false, &unused);
+    assert(count_test_audio_players(0, true) == 0, "Failed: forgotten sources are still playing");
+    
+    audio_set_max_voices(max_voices);
+    audio_mixer_resume();
+    
+    dealloc(get_heap_allocator(), pcm);
+    dealloc(get_heap_allocator(), job.output);
+}
 
-	seconds = 0;
-    cycles = 0;
-	for (int a = 0; a < num_samples; a++) {
+// A burst of one-shots, like a frame with a lot of bounces, with and without a voice budget
+void benchmark_audio_voice_budget() {
+    const u64 burst_count = 256;
+    const u64 callback_count = 50;
+    const u32 budget = 32;
+    const u64 source_frame_count = 48000*2;
+    u32 max_voices = audio_mixer.max_voices;
+    
+    audio_mixer_hold();
+    
+    s16 *pcm = alloc(get_heap_allocator(), source_frame_count*sizeof(s16));
+    for (u64 i = 0; i < source_frame_count; i++) {
+        pcm[i] = (s16)get_random_int_in_range(-8000, 8000);
+    }
+    Audio_Mixer_Benchmark_Job job = {0};
+    job.frames_per_callback = 480;
+    job.format = (Audio_Format){ AUDIO_BITS_32, 2, 48000 };
+    job.output = alloc(get_heap_allocator(), job.frames_per_callback*2*sizeof(f32));
+    u64 unused;
+    
+    Audio_Source sources[burst_count];
+    print("Burst of %llu one-shot voices, %llu callbacks:\n", burst_count, callback_count);
+    for (int with_budget = 0; with_budget <= 1; with_budget++) {
+        audio_set_max_voices(with_budget ? budget : 0);
         
-        for (u64 i = 0; i < item_count; i++) {
-            if (i % 2 == 0) items[i].z = get_random_int_in_range(0, pow(2, id_bits) / 2);
-            else items[i].z = i;
+        for (u64 i = 0; i < burst_count; i++) {
+            Audio_Playback_Config config = {0};
+            config.volume = get_random_float32_in_range(0.2, 1.0);
+            config.playback_speed = 1.0;
+            config.priority = i % 4;
+            sources[i] = make_test_audio_source(pcm, source_frame_count);
+            play_one_audio_clip_source_with_config(sources[i], config);
         }
+        
+        job.callback_count = callback_count;
+        job.total_ms = 0;
+        job.worst_ms = 0;
+        run_audio_mixer_benchmark_job(&job, 0, 0, false, &unused);
+        
+        u64 playing = count_test_audio_players(0, true);
+        if (with_budget) print("    Budget of %u: ", budget);
+        else             print("    No budget: ");
+        print("%.3fms avg, %.3fms worst per callback, %llu voices playing\n", job.total_ms / (float64)callback_count, job.worst_ms, playing);
+        
+        for (u64 i = 0; i < burst_count; i++) audio_mixer_forget_source(sources[i].uid);
+        job.callback_count = 1;
+        run_audio_mixer_benchmark_job(&job, 0, 0, false, &unused);
+    }
     
-        u64 item_size = sizeof(Draw_Quad);
-        u64 sort_value_offset_in_item = offsetof(Draw_Quad, z);
+    audio_set_max_voices(max_voices);
+    audio_mixer_resume();
     
+    dealloc(get_heap_allocator(), pcm);
+    dealloc(get_heap_allocator(), job.output);
+}
+
+// Releases in chunks with a callback in between, so the command queue never fills up while the
+// audio thread is held
+void release_test_audio_players(Audio_Player **players, u64 count, Audio_Mixer_Benchmark_Job *job) {
+    u64 unused;
+    u64 callback_count = job->callback_count;
+    job->callback_count = 1;
+    for (u64 i = 0; i < count; i++) {
+        audio_player_release(players[i]);
+        if ((i+1) % (AUDIO_COMMAND_QUEUE_CAPACITY/2) == 0 || i+1 == count) {
+            run_audio_mixer_benchmark_job(job, 0, 0, false, &unused);
+        }
+    }
+    job->callback_count = callback_count;
+}
+
+// A big pool of players (like after a burst of one-shots) with only a few of them playing.
+// Getting a player and a callback should only cost in proportion to the players in use.
+void benchmark_audio_player_slots() {
+    const u64 player_count = AUDIO_PLAYERS_PER_BLOCK*32;
+    const u64 playing_count = 8;
+    const u64 callback_count = 200;
+    const u64 source_frame_count = 48000*2;
+    
+    audio_mixer_hold();
+    
+    s16 *pcm = alloc(get_heap_allocator(), source_frame_count*sizeof(s16));
+    for (u64 i = 0; i < source_frame_count; i++) {
+        pcm[i] = (s16)get_random_int_in_range(-8000, 8000);
+    }
+    Audio_Mixer_Benchmark_Job job = {0};
+    job.frames_per_callback = 480;
+    job.format = (Audio_Format){ AUDIO_BITS_32, 2, 48000 };
+    job.output = alloc(get_heap_allocator(), job.frames_per_callback*2*sizeof(f32));
+    u64 unused;
+    
+    Audio_Player **players = alloc(get_heap_allocator(), player_count*sizeof(Audio_Player*));
+    
+    // First time around this also makes the blocks
+    for (int round = 0; round < 2; round++) {
         float64 start_seconds = os_get_elapsed_seconds();
-        u64 start_cycles = rdtsc();
-        merge_sort(items, buffer, item_count, item_size, compare_draw_quads);
-        u64 end_cycles = rdtsc();
-        float64 end_seconds = os_get_elapsed_seconds();
+        for (u64 i = 0; i < player_count; i++) players[i] = audio_player_get_one();
+        float64 ms = (os_get_elapsed_seconds() - start_seconds) * 1000.0;
+        print("    Get %llu players (%cs): %.3fms, %.1fns per player\n", player_count, round == 0 ? "new pool" : "free list", ms, ms*1000000.0 / (float64)player_count);
+        
+        if (round == 0) release_test_audio_players(players, player_count, &job);
+    }
+    
+    for (u64 i = 0; i < playing_count; i++) {
+        audio_player_set_source(players[i], make_test_audio_source(pcm, source_frame_count));
+        audio_player_set_looping(players[i], true);
+        audio_player_set_state(players[i], AUDIO_PLAYER_STATE_PLAYING);
+    }
+    
+    job.callback_count = callback_count;
+    job.total_ms = 0;
+    job.worst_ms = 0;
+    run_audio_mixer_benchmark_job(&job, 0, 0, false, &unused);
+    print("    %llu playing out of %llu players: %.3fms avg, %.3fms worst per callback\n", playing_count, player_count, job.total_ms / (float64)callback_count, job.worst_ms);
+    
+    release_test_audio_players(players, player_count, &job);
+    assert(growing_array_get_valid_count(audio_mixer.active_players) == 0, "Failed: released audio players are still in the active list");
     
-        for (u64 i = 1; i < item_count; i++) {
-            assert(items[i].z >= items[i-1].z, "Failed: not correctly sorted");
+    audio_mixer_resume();
+    
+    dealloc(get_heap_allocator(), players);
+    dealloc(get_heap_allocator(), pcm);
+    dealloc(get_heap_allocator(), job.output);
+}
+
+// How draw_quad_projected_in_frame placed quads before it went through Affine2
+Draw_Quad reference_project_quad(Draw_Quad q, Matrix4 world_to_clip) {
+    q.bottom_left  = m4_transform(world_to_clip, v4(v2_expand(q.bottom_left), 0, 1)).xy;
+    q.top_left     = m4_transform(world_to_clip, v4(v2_expand(q.top_left), 0, 1)).xy;
+    q.top_right    = m4_transform(world_to_clip, v4(v2_expand(q.top_right), 0, 1)).xy;
+    q.bottom_right = m4_transform(world_to_clip, v4(v2_expand(q.bottom_right), 0, 1)).xy;
+    
+    float pixel_width = 2.0/(float)window.width;
+    float pixel_height = 2.0/(float)window.height;
+    Vector2 *corners[] = { &q.bottom_left, &q.top_left, &q.top_right, &q.bottom_right };
+    for (int i = 0; i < 4; i++) {
+        corners[i]->x = round(corners[i]->x / pixel_width)  * pixel_width;
+        corners[i]->y = round(corners[i]->y / pixel_height) * pixel_height;
+    }
+    return q;
+}
+bool quad_corners_roughly_match(Draw_Quad *a, Draw_Quad *b) {
+    return floats_roughly_match(a->bottom_left.x,  b->bottom_left.x)  && floats_roughly_match(a->bottom_left.y,  b->bottom_left.y)
+        && floats_roughly_match(a->top_left.x,     b->top_left.x)     && floats_roughly_match(a->top_left.y,     b->top_left.y)
+        && floats_roughly_match(a->top_right.x,    b->top_right.x)    && floats_roughly_match(a->top_right.y,    b->top_right.y)
+        && floats_roughly_match(a->bottom_right.x, b->bottom_right.x) && floats_roughly_match(a->bottom_right.y, b->bottom_right.y);
+}
+
+void test_draw_affine() {
+    Draw_Frame frame;
+    draw_frame_init(&frame);
+    draw_frame_reset(&frame);
+    
+    for (int camera = 0; camera < 3; camera++) {
+        if (camera == 1) frame.camera_xform = m4_scale(m4_make_translation(v3(40, -25, 0)), v3(0.5, 2.0, 1));
+        if (camera == 2) frame.camera_xform = m4_rotate_z(frame.camera_xform, 0.3);
+        Matrix4 world_to_clip = m4_mul(frame.projection, m4_inverse(frame.camera_xform));
+        
+        for (int i = 0; i < 1000; i++) {
+            Vector2 pos  = v2(get_random_float32_in_range(-window.width, window.width), get_random_float32_in_range(-window.height, window.height));
+            Vector2 size = v2(get_random_float32_in_range(-50, 50), get_random_float32_in_range(-50, 50));
+            
+            Draw_Quad rect = ZERO(Draw_Quad);
+            rect.bottom_left  = v2(pos.x, pos.y);
+            rect.top_left     = v2(pos.x, pos.y+size.y);
+            rect.top_right    = v2(pos.x+size.x, pos.y+size.y);
+            rect.bottom_right = v2(pos.x+size.x, pos.y);
+            Draw_Quad expected = reference_project_quad(rect, world_to_clip);
+            
+            Draw_Quad *q = draw_rect_in_frame(pos, size, COLOR_WHITE, &frame);
+            if (q != &_nil_quad) {
+                assert(quad_corners_roughly_match(q, &expected), "Failed: draw_rect_in_frame is not where the Matrix4 path put it");
+            }
+            
+            Matrix4 xform = m4_make_translation(v3(pos.x, pos.y, 0));
+            if (i % 2) xform = m4_rotate_z(xform, (float32)i);
+            if (i % 3) xform = m4_scale(xform, v3(1.5, 0.5, 1));
+            rect.bottom_left  = v2(0, 0);
+            rect.top_left     = v2(0, size.y);
+            rect.top_right    = v2(size.x, size.y);
+            rect.bottom_right = v2(size.x, 0);
+            expected = reference_project_quad(rect, m4_mul(world_to_clip, xform));
+            
+            q = draw_rect_xform_in_frame(xform, size, COLOR_WHITE, &frame);
+            if (q != &_nil_quad) {
+                assert(quad_corners_roughly_match(q, &expected), "Failed: draw_rect_xform_in_frame is not where the Matrix4 path put it");
+            }
+        }
+    }
+    
+    // Changing the camera mid-frame applies to whatever is drawn after
+    draw_frame_reset(&frame);
+    Draw_Quad *q = draw_rect_in_frame(v2(0, 0), v2(10, 10), COLOR_WHITE, &frame);
+    float32 left = q->bottom_left.x;
+    frame.camera_xform = m4_make_translation(v3(-10, 0, 0));
+    q = draw_rect_in_frame(v2(0, 0), v2(10, 10), COLOR_WHITE, &frame);
+    assert(q->bottom_left.x > left, "Failed: camera_xform change not picked up");
+    
+    draw_frame_deinit(&frame);
+}
+
+// Quads/sec through the draw_rect path, with a camera and about a quarter of them culled
+void benchmark_draw_rect_submission() {
+    const u64 quad_count = 1000000;
+    
+    Draw_Frame frame;
+    draw_frame_init(&frame);
+    
+    Vector2 *positions = alloc(get_heap_allocator(), quad_count * sizeof(Vector2));
+    for (u64 i = 0; i < quad_count; i++) {
+        positions[i] = v2(get_random_float32_in_range(-window.width, window.width), get_random_float32_in_range(-window.height, window.height));
+    }
+    Vector2 size = v2(8, 8);
+    Matrix4 camera = m4_scale(m4_make_translation(v3(13, 7, 0)), v3(1.25, 1.25, 1));
+    
+    for (int variant = 0; variant < 4; variant++) {
+        draw_frame_reset(&frame);
+        frame.camera_xform = camera;
+        
+        float64 start_seconds = os_get_elapsed_seconds();
+        for (u64 i = 0; i < quad_count; i++) {
+            Vector2 pos = positions[i];
+            switch (variant) {
+                case 0: {
+                    // Roughly what every draw_rect did before: invert & multiply the camera and 4 m4_transform's
+                    Matrix4 world_to_clip = m4_mul(frame.projection, m4_inverse(frame.camera_xform));
+                    Draw_Quad q = ZERO(Draw_Quad);
+                    q.bottom_left  = m4_transform(world_to_clip, v4(pos.x, pos.y, 0, 1)).xy;
+                    q.top_left     = m4_transform(world_to_clip, v4(pos.x, pos.y+size.y, 0, 1)).xy;
+                    q.top_right    = m4_transform(world_to_clip, v4(pos.x+size.x, pos.y+size.y, 0, 1)).xy;
+                    q.bottom_right = m4_transform(world_to_clip, v4(pos.x+size.x, pos.y, 0, 1)).xy;
+                    q.color = COLOR_WHITE;
+                    draw_quad_projected_in_frame(q, m4_identity(), &frame);
+                    break;
+                }
+                case 1: draw_rect_in_frame(pos, size, COLOR_WHITE, &frame); break;
+                case 2: draw_rect_xform_in_frame(m4_make_translation(v3(pos.x, pos.y, 0)), size, COLOR_WHITE, &frame); break;
+                case 3: draw_rect_xform_in_frame(m4_rotate_z(m4_make_translation(v3(pos.x, pos.y, 0)), (float32)i), size, COLOR_WHITE, &frame); break;
+            }
         }
+        draw_frame_flush(&frame);
+        float64 seconds = os_get_elapsed_seconds() - start_seconds;
         
-        seconds += end_seconds - start_seconds;
-        cycles += end_cycles - start_cycles;
+        const char *names[] = { "per-quad Matrix4", "draw_rect", "draw_rect_xform translate", "draw_rect_xform rotated" };
+        print("    %cs: %.1f M quads/s (%llu of %llu drawn)\n", names[variant], (float64)quad_count / seconds / 1000000.0, draw_frame_get_quad_count(&frame), quad_count);
     }
     
-    print("Merge sort took on average %llu cycles and %.2f ms\n", cycles / num_samples, (seconds * 1000.0) / (float64)num_samples);
+    dealloc(get_heap_allocator(), positions);
+    draw_frame_deinit(&frame);
+}
+
+void benchmark_sort() {
+    const u64 item_counts[] = { 10000, 100000, 1000000 };
+    const u64 id_bits = MAX_Z_BITS;
+    
+    for (u64 c = 0; c < sizeof(item_counts)/sizeof(item_counts[0]); c++) {
+        u64 item_count = item_counts[c];
+        u64 num_samples = max(2, 1000000 / item_count);
+        
+        Draw_Quad_Packed *source = alloc(get_heap_allocator(), item_count * sizeof(Draw_Quad_Packed));
+        Draw_Quad_Packed *items  = alloc(get_heap_allocator(), item_count * sizeof(Draw_Quad_Packed));
+        Draw_Quad_Packed *legacy = alloc(get_heap_allocator(), item_count * sizeof(Draw_Quad_Packed));
+        Draw_Quad_Packed *buffer = alloc(get_heap_allocator(), item_count * sizeof(Draw_Quad_Packed));
+        u64 *pairs = alloc(get_heap_allocator(), item_count * sizeof(u64) * 2);
+        
+        // Random z's and all on the same z
+        for (int uniform = 0; uniform <= 1; uniform++) {
+            for (u64 i = 0; i < item_count; i++) {
+                source[i] = ZERO(Draw_Quad_Packed);
+                source[i].extras = (u32)i;
+                if (uniform) source[i].z = 7;
+                else if (i % 2 == 0) source[i].z = get_random_int_in_range(-MAX_Z+1, MAX_Z-1);
+                else source[i].z = (s32)(i % MAX_Z);
+            }
+            
+            u64 legacy_cycles = 0;
+            u64 radix_cycles = 0;
+            u64 pair_cycles = 0;
+            for (u64 s = 0; s < num_samples; s++) {
+                memcpy(legacy, source, item_count * sizeof(Draw_Quad_Packed));
+                u64 start_cycles = rdtsc();
+                legacy_radix_sort(legacy, buffer, item_count, sizeof(Draw_Quad_Packed), offsetof(Draw_Quad_Packed, z), id_bits);
+                legacy_cycles += rdtsc() - start_cycles;
+                
+                memcpy(items, source, item_count * sizeof(Draw_Quad_Packed));
+                start_cycles = rdtsc();
+                radix_sort(items, buffer, pairs, item_count, sizeof(Draw_Quad_Packed), offsetof(Draw_Quad_Packed, z), id_bits);
+                radix_cycles += rdtsc() - start_cycles;
+                
+                // What the renderer does: sort pairs, then read quads through the sorted indices
+                start_cycles = rdtsc();
+                for (u64 i = 0; i < item_count; i++) {
+                    pairs[i] = ((u64)(u32)(source[i].z + MAX_Z - 1) << 32) | i;
+                }
+                u64 *sorted = radix_sort_key_index_pairs(pairs, pairs + item_count, item_count, id_bits);
+                pair_cycles += rdtsc() - start_cycles;
+                
+                for (u64 i = 0; i < item_count; i++) {
+                    assert(source[sorted[i] & 0xFFFFFFFF].extras == legacy[i].extras, "Failed: key/index sort order differs from the old radix sort");
+                }
+            }
+            
+            assert(bytes_match(items, legacy, item_count * sizeof(Draw_Quad_Packed)), "Failed: radix sort differs from the old radix sort");
+            for (u64 i = 1; i < item_count; i++) {
+                assert(items[i].z >= items[i-1].z, "Failed: not correctly sorted");
+                if (items[i].z == items[i-1].z) assert(items[i].extras > items[i-1].extras, "Failed: radix sort is not stable");
+            }
+            
+            memcpy(items, source, item_count * sizeof(Draw_Quad_Packed));
+            u64 start_cycles = rdtsc();
+            merge_sort(items, buffer, item_count, sizeof(Draw_Quad_Packed), compare_draw_quads);
+            u64 merge_cycles = rdtsc() - start_cycles;
+            assert(bytes_match(items, legacy, item_count * sizeof(Draw_Quad_Packed)), "Failed: merge sort differs from radix sort");
+            
+            print("Sort %llu quads, %cs z:\n", item_count, uniform ? "same" : "random");
+            print("    old radix %llu, radix %llu, key/index pairs only %llu, merge %llu cycles/quad\n", 
+                legacy_cycles / num_samples / item_count, radix_cycles / num_samples / item_count, 
+                pair_cycles / num_samples / item_count, merge_cycles / item_count);
+        }
+        
+        dealloc(get_heap_allocator(), source);
+        dealloc(get_heap_allocator(), items);
+        dealloc(get_heap_allocator(), legacy);
+        dealloc(get_heap_allocator(), buffer);
+        dealloc(get_heap_allocator(), pairs);
+    }
 }
 #endif /* OOGABOOGA_HEADLESS */
 
+// Small enough for the test run, big enough that the parallel sort doesn't fall back to one thread
+void test_sort() {
+    const u64 item_count = PARALLEL_RADIX_SORT_MIN_COUNT*2;
+    const u64 number_of_bits = 24;
+    
+    u64 *source   = alloc(get_heap_allocator(), item_count * sizeof(u64));
+    u64 *expected = alloc(get_heap_allocator(), item_count * sizeof(u64));
+    u64 *pairs    = alloc(get_heap_allocator(), item_count * sizeof(u64) * 2);
+    
+    for (u64 i = 0; i < item_count; i++) {
+        u64 key = get_random_int_in_range(0, (1 << number_of_bits) - 1);
+        source[i] = (key << 32) | i;
+    }
+    
+    memcpy(pairs, source, item_count * sizeof(u64));
+    u64 *sorted = radix_sort_key_index_pairs(pairs, pairs + item_count, item_count, number_of_bits);
+    // Indices are unique, so a stable sort gives strictly increasing pairs
+    for (u64 i = 1; i < item_count; i++) {
+        assert(sorted[i] > sorted[i-1], "Failed: key/index pairs not correctly sorted");
+    }
+    memcpy(expected, sorted, item_count * sizeof(u64));
+    
+    // Twice, with the workers stopped in between, so they have to be started again
+    for (int run = 0; run < 2; run++) {
+        memcpy(pairs, source, item_count * sizeof(u64));
+        sorted = radix_sort_key_index_pairs_parallel(pairs, pairs + item_count, item_count, number_of_bits, 4);
+        assert(bytes_match(sorted, expected, item_count * sizeof(u64)), "Failed: parallel radix sort differs from radix sort");
+        parallel_radix_sort_deinit();
+    }
+    
+    dealloc(get_heap_allocator(), source);
+    dealloc(get_heap_allocator(), expected);
+    dealloc(get_heap_allocator(), pairs);
+}
+
+void benchmark_parallel_sort() {
+    const u64 item_counts[] = { 1024*256, 1024*1024, 1024*1024*4 };
+    const u64 number_of_bits = 24;
+    u64 max_threads = min(os_get_number_of_logical_processors(), PARALLEL_RADIX_SORT_MAX_THREADS);
+    
+    for (u64 c = 0; c < sizeof(item_counts)/sizeof(item_counts[0]); c++) {
+        u64 item_count = item_counts[c];
+        u64 num_samples = max(2, 8*1024*1024 / item_count);
+        
+        u64 *source   = alloc(get_heap_allocator(), item_count * sizeof(u64));
+        u64 *expected = alloc(get_heap_allocator(), item_count * sizeof(u64));
+        u64 *pairs    = alloc(get_heap_allocator(), item_count * sizeof(u64) * 2);
+        
+        for (u64 i = 0; i < item_count; i++) {
+            u64 key = get_random_int_in_range(0, (1 << number_of_bits) - 1);
+            source[i] = (key << 32) | i;
+        }
+        memcpy(pairs, source, item_count * sizeof(u64));
+        u64 *sorted = radix_sort_key_index_pairs(pairs, pairs + item_count, item_count, number_of_bits);
+        memcpy(expected, sorted, item_count * sizeof(u64));
+        
+        print("Sort %llu key/index pairs:\n", item_count);
+        float64 single_thread_ms = 0;
+        // 1, 2, 4 ... and always max_threads last
+        u64 thread_count = 1;
+        while (true) {
+            float64 seconds = 0;
+            for (u64 s = 0; s < num_samples; s++) {
+                memcpy(pairs, source, item_count * sizeof(u64));
+                float64 start_seconds = os_get_elapsed_seconds();
+                sorted = radix_sort_key_index_pairs_parallel(pairs, pairs + item_count, item_count, number_of_bits, thread_count);
+                seconds += os_get_elapsed_seconds() - start_seconds;
+                
+                assert(bytes_match(sorted, expected, item_count * sizeof(u64)), "Failed: parallel radix sort differs from radix sort with %llu threads", thread_count);
+            }
+            float64 ms = seconds * 1000.0 / num_samples;
+            if (thread_count == 1) single_thread_ms = ms;
+            print("    %llu threads: %.3fms (%.2fx)\n", thread_count, ms, single_thread_ms / ms);
+            
+            if (thread_count == max_threads) break;
+            thread_count = min(thread_count*2, max_threads);
+        }
+        
+        dealloc(get_heap_allocator(), source);
+        dealloc(get_heap_allocator(), expected);
+        dealloc(get_heap_allocator(), pairs);
+    }
+    
+    parallel_radix_sort_deinit();
+}
+
 typedef struct Test_Thing {
     int foo;
     float bar;
@@ -1565,6 +2763,106 @@ void test_growing_array() {
     assert(!bytes_match(&copy, thing, sizeof(Test_Thing)), "Failed: growing_array_unordered_remove_by_pointer");
     
     assert(growing_array_get_valid_count(things) == 99, "Failed: growing_array_get_valid_count");
+    
+    growing_array_deinit((void**)&things);
+    
+    // Virtual arrays never move
+    u64 *numbers = 0;
+    growing_array_init_virtual((void**)&numbers, sizeof(u64), 100000);
+    u64 *first = numbers;
+    for (u64 i = 0; i < 100000; i += 1) {
+        growing_array_add((void**)&numbers, &i);
+    }
+    assert(numbers == first, "Failed: virtual growing array moved when growing");
+    assert(growing_array_get_valid_count(numbers) == 100000, "Failed: growing_array_get_valid_count");
+    for (u64 i = 0; i < 100000; i += 1) {
+        assert(numbers[i] == i, "Failed: virtual growing array lost a value");
+    }
+    growing_array_clear((void**)&numbers);
+    u64 zero = 0;
+    growing_array_add((void**)&numbers, &zero);
+    assert(numbers == first, "Failed: virtual growing array moved after clear");
+    growing_array_deinit((void**)&numbers);
+}
+
+// Heap allocator which keeps track of how many bytes are live, to see the peak memory
+// use of a heap growing array (old and new buffer are both alive while it copies).
+typedef struct Counting_Allocator_Stats {
+    u64 live_bytes;
+    u64 peak_bytes;
+} Counting_Allocator_Stats;
+void *counting_heap_allocator_proc(u64 size, void *p, Allocator_Message message, void *data) {
+    Counting_Allocator_Stats *stats = (Counting_Allocator_Stats*)data;
+    switch (message) {
+        case ALLOCATOR_ALLOCATE: {
+            u64 *block = (u64*)alloc(get_heap_allocator(), size + 16);
+            block[0] = size;
+            stats->live_bytes += size;
+            stats->peak_bytes = max(stats->peak_bytes, stats->live_bytes);
+            return block + 2;
+        }
+        case ALLOCATOR_DEALLOCATE: {
+            u64 *block = (u64*)p - 2;
+            stats->live_bytes -= block[0];
+            dealloc(get_heap_allocator(), block);
+            return 0;
+        }
+        default: {
+            return 0;
+        }
+    }
+}
+
+void benchmark_growing_array() {
+    const u64 counts[] = { 1000, 100000, 10000000 };
+    
+    for (u64 c = 0; c < sizeof(counts)/sizeof(counts[0]); c++) {
+        u64 count = counts[c];
+        
+        Counting_Allocator_Stats stats = ZERO(Counting_Allocator_Stats);
+        Allocator counting_allocator;
+        counting_allocator.proc = counting_heap_allocator_proc;
+        counting_allocator.data = &stats;
+        
+        u64 *heap_numbers = 0;
+        growing_array_init((void**)&heap_numbers, sizeof(u64), counting_allocator);
+        u64 start_cycles = rdtsc();
+        for (u64 i = 0; i < count; i++) growing_array_add((void**)&heap_numbers, &i);
+        u64 heap_cycles = rdtsc() - start_cycles;
+        
+        // Second round on the already grown array, like a buffer reused each frame
+        growing_array_clear((void**)&heap_numbers);
+        start_cycles = rdtsc();
+        for (u64 i = 0; i < count; i++) growing_array_add((void**)&heap_numbers, &i);
+        u64 heap_reuse_cycles = rdtsc() - start_cycles;
+        
+        u64 *virtual_numbers = 0;
+        growing_array_init_virtual((void**)&virtual_numbers, sizeof(u64), count);
+        start_cycles = rdtsc();
+        for (u64 i = 0; i < count; i++) growing_array_add((void**)&virtual_numbers, &i);
+        u64 virtual_cycles = rdtsc() - start_cycles;
+        
+        growing_array_clear((void**)&virtual_numbers);
+        start_cycles = rdtsc();
+        for (u64 i = 0; i < count; i++) growing_array_add((void**)&virtual_numbers, &i);
+        u64 virtual_reuse_cycles = rdtsc() - start_cycles;
+        
+        Growing_Array_Header *header = ((Growing_Array_Header*)virtual_numbers) - 1;
+        Virtual_Arena *arena = (Virtual_Arena*)header->allocator.data;
+        u64 virtual_peak_bytes = arena->committed;
+        
+        assert(heap_numbers[count-1] == count-1 && virtual_numbers[count-1] == count-1, "Failed: growing array benchmark lost values");
+        
+        print("Growing array %llu pushes:\n", count);
+        print("    heap:    %llu cycles/push (%llu reused), peak %llu KB\n", 
+            heap_cycles/count, heap_reuse_cycles/count, stats.peak_bytes/1024);
+        print("    virtual: %llu cycles/push (%llu reused), peak %llu KB committed\n", 
+            virtual_cycles/count, virtual_reuse_cycles/count, virtual_peak_bytes/1024);
+        
+        growing_array_deinit((void**)&heap_numbers);
+        growing_array_deinit((void**)&virtual_numbers);
+        assert(stats.live_bytes == 0, "Failed: counting allocator leaked");
+    }
 }
 
 
@@ -1708,6 +3006,10 @@ void oogabooga_run_tests() {
 	test_allocator(true);
 	print("OK!\n");
 	
+	print("Testing temporary storage... ");
+	test_temporary_storage();
+	print("OK!\n");
+	
 	print("Testing threads... ");
 	test_threads();
 	print("OK!\n");
@@ -1747,14 +3049,75 @@ void oogabooga_run_tests() {
 	print("Testing binary semaphore... ");
 	test_os_binary_semaphore();
 	print("OK!\n");
-
-#ifndef OOGABOOGA_HEADLESS
+	
 	print("Testing radix sort... ");
 	test_sort();
 	print("OK!\n");
+
+#ifndef OOGABOOGA_HEADLESS
+	print("Testing draw frame quad sort... ");
+	test_draw_frame_sort_quads();
+	print("OK!\n");
+	
+	print("Testing draw affine fast path... ");
+	test_draw_affine();
+	print("OK!\n");
+	
+	print("Testing audio kernels... ");
+	test_audio_kernels();
+	print("OK!\n");
+	
+	print("Testing audio voice budget... ");
+	test_audio_voice_budget();
+	print("OK!\n");
 #endif
 
 	
 	
 	print("All tests ok!\n");
 }
+
+// These take a lot longer than the tests, so they have their own flag (RUN_BENCHMARKS).
+// Most of them also check their results against a reference implementation.
+void oogabooga_run_benchmarks() {
+	
+	print("Benchmarking growing array...\n");
+	benchmark_growing_array();
+	
+	print("Benchmarking heap allocator...\n");
+	benchmark_heap_trace();
+	print("OK!\n");
+	
+	print("Benchmarking heap allocator contention...\n");
+	benchmark_allocator_threaded();
+	print("OK!\n");
+	
+	print("Benchmarking hash table...\n");
+	benchmark_hash_table();
+	print("OK!\n");
+
+#ifndef OOGABOOGA_HEADLESS
+	print("Benchmarking draw rect submission...\n");
+	benchmark_draw_rect_submission();
+	
+	print("Benchmarking audio mixing...\n");
+	benchmark_audio_mixing();
+	
+	print("Benchmarking audio mixer with command queue...\n");
+	benchmark_audio_mixer();
+	
+	print("Benchmarking audio voice budget...\n");
+	benchmark_audio_voice_budget();
+	
+	print("Benchmarking audio player slots...\n");
+	benchmark_audio_player_slots();
+	
+	print("Benchmarking radix sort...\n");
+	benchmark_sort();
+#endif
+	
+	print("Benchmarking parallel radix sort...\n");
+	benchmark_parallel_sort();
+	
+	print("All benchmarks done!\n");
+}
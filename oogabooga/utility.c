@@ -11,58 +11,88 @@
 
 
 
-// This is a very niche sort algorithm.
-// I use it for Z sorting quads.
-// help_buffer should be same size as collection.
-// This only works with integers, and it will use the first number_of_bits in the integer
-// at sort_value_offset_in_item for sorting.
-// There is a cost of memory as we need to double the buffer we're sorting BUT the performance
-// gain is very promising.
-// At 21 bits I'm able to sort a completely randomized collection of 100k integers at around
-// 8m cycles (or 2.5-2.6ms on my shitty laptop i5-11300H)
-void radix_sort(void *collection, void *help_buffer, u64 item_count, u64 item_size, u64 sort_value_offset_in_item, u64 number_of_bits) {
+// Radix sort of (key << 32 | index) pairs, on the lowest number_of_bits (max 32) bits of key.
+// Stable. Returns whichever of pairs and help_pairs ends up holding the sorted pairs.
+// All digit histograms are counted in one go up front, and passes where every key has
+// the same digit (i.e. all quads on the same z layer) are skipped.
+// For big arrays there's a multi-threaded version, radix_sort_key_index_pairs_parallel in concurrency.c
+u64 *radix_sort_key_index_pairs(u64 *pairs, u64 *help_pairs, u64 count, u64 number_of_bits) {
     local_persist const int RADIX = 256;
     local_persist const int BITS_PER_PASS = 8;
     
-    const int PASS_COUNT = ((number_of_bits + BITS_PER_PASS - 1) / BITS_PER_PASS);
-    const u64 HALF_RANGE_OF_VALUE_BITS = 1ULL << (number_of_bits - 1);
-
-    u64 count[RADIX];
-    u64 prefix_sum[RADIX];
-
-    for (u32 pass = 0; pass < PASS_COUNT; ++pass) {
-        u32 shift = pass * BITS_PER_PASS;
-
-        memset(count, 0, sizeof(count));
-
-        for (u64 i = 0; i < item_count; ++i) {
-        	u8 *item = (u8*)collection + i * item_size;
-        	
-            u64 sort_value = *(u64*)(item + sort_value_offset_in_item);
-            sort_value += HALF_RANGE_OF_VALUE_BITS; // We treat the value as a signed integer
-            
-            u32 digit = (sort_value >> shift) & (RADIX-1);
-            ++count[digit];
+    assert(number_of_bits <= 32, "Keys are 32 bits at most");
+    if (count <= 1) return pairs;
+    
+    const u32 PASS_COUNT = (u32)((number_of_bits + BITS_PER_PASS - 1) / BITS_PER_PASS);
+    
+    u64 counts[4][256];
+    memset(counts, 0, sizeof(counts));
+    for (u64 i = 0; i < count; ++i) {
+        u32 key = (u32)(pairs[i] >> 32);
+        for (u32 pass = 0; pass < PASS_COUNT; ++pass) {
+            ++counts[pass][(key >> (pass*BITS_PER_PASS)) & (RADIX-1)];
         }
-
+    }
+    
+    u64 *src = pairs;
+    u64 *dst = help_pairs;
+    for (u32 pass = 0; pass < PASS_COUNT; ++pass) {
+        u32 shift = 32 + pass*BITS_PER_PASS;
+        u64 *digit_count = counts[pass];
+        
+        u32 first_digit = (src[0] >> shift) & (RADIX-1);
+        if (digit_count[first_digit] == count) continue;
+        
+        u64 prefix_sum[256];
         prefix_sum[0] = 0;
         for (u32 i = 1; i < RADIX; ++i) {
-            prefix_sum[i] = prefix_sum[i - 1] + count[i - 1];
+            prefix_sum[i] = prefix_sum[i - 1] + digit_count[i - 1];
         }
-
-        for (u64 i = 0; i < item_count; ++i) {
-        	u8 *item = (u8*)collection + i * item_size;
-        	
-            u64 sort_value = *(u64*)(item + sort_value_offset_in_item);
-            sort_value += HALF_RANGE_OF_VALUE_BITS; // We treat the value as a signed integer
-            
-            u32 digit = (sort_value >> shift) & (RADIX-1);
-            memcpy((u8*)help_buffer + prefix_sum[digit] * item_size, item, item_size);
-            ++prefix_sum[digit];
+        
+        for (u64 i = 0; i < count; ++i) {
+            u32 digit = (src[i] >> shift) & (RADIX-1);
+            dst[prefix_sum[digit]++] = src[i];
         }
+        
+        u64 *t = src;
+        src = dst;
+        dst = t;
+    }
+    
+    return src;
+}
 
-        memcpy(collection, help_buffer, item_count * item_size);
+// This is a very niche sort algorithm.
+// I use it for Z sorting quads.
+// help_buffer should be same size as collection.
+// pairs is scratch space for the caller to provide, room for item_count*2 u64's, so sorting never allocates.
+// This only works with integers, and it will use the first number_of_bits (max 32) in the integer
+// at sort_value_offset_in_item for sorting. The value is treated as signed.
+// Only (value, index) pairs are moved around while sorting, the items are then moved once
+// into help_buffer in sorted order and copied back.
+void radix_sort(void *collection, void *help_buffer, u64 *pairs, u64 item_count, u64 item_size, u64 sort_value_offset_in_item, u64 number_of_bits) {
+    if (item_count <= 1) return;
+    assert(item_count <= 0xFFFFFFFF, "radix_sort sorts at most 2^32 items");
+    
+    const u32 HALF_RANGE_OF_VALUE_BITS = 1U << (number_of_bits - 1);
+    const u32 MASK = number_of_bits >= 32 ? 0xFFFFFFFF : ((1U << number_of_bits) - 1);
+    
+    u64 *help_pairs = pairs + item_count;
+    
+    for (u64 i = 0; i < item_count; ++i) {
+        u32 sort_value;
+        memcpy(&sort_value, (u8*)collection + i*item_size + sort_value_offset_in_item, sizeof(u32));
+        sort_value = (sort_value + HALF_RANGE_OF_VALUE_BITS) & MASK; // We treat the value as a signed integer
+        pairs[i] = ((u64)sort_value << 32) | i;
+    }
+    
+    u64 *sorted = radix_sort_key_index_pairs(pairs, help_pairs, item_count, number_of_bits);
+    
+    for (u64 i = 0; i < item_count; ++i) {
+        u64 index = sorted[i] & 0xFFFFFFFF;
+        memcpy((u8*)help_buffer + i*item_size, (u8*)collection + index*item_size, item_size);
     }
+    memcpy(collection, help_buffer, item_count*item_size);
 }
 
 void merge_sort(void *collection, void *help_buffer, u64 item_count, u64 item_size, int (*compare)(const void *, const void *)) {